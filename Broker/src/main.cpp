@@ -4,6 +4,7 @@
 #include <esp_heap_caps.h>
 #include "esp_crc.h"
 #include "esp_timer.h"
+#include "i2cbus.h"          // lib/i2cbus, shared with VSTPRO
 
 /* ================================
    OLED (XIAO Expansion Board)
@@ -29,6 +30,45 @@ SSCMA AI;
    ================================ */
 static constexpr uint8_t CONFIDENCE_THRESHOLD = 70; // percent
 
+/* ================================
+   TWO-PHASE ACQUISITION
+   ================================ */
+// Phase 1 reads perf + boxes only (a few hundred bytes over I2C) and
+// drives the actuators and the OLED. Phase 2 reads the Base64 JPEG
+// (~14 KB, most of a 400 kHz frame) only when the policy below wants it;
+// otherwise the frame goes out with IMAGE 0. Opt-in: off, every frame
+// carries its image as before.
+static constexpr bool     TWO_PHASE         = false;
+static constexpr uint8_t  IMAGE_MIN_SCORE   = CONFIDENCE_THRESHOLD; // a box this good fetches the image
+static constexpr uint32_t IMAGE_EVERY_MS    = 60000;                // and any frame N ms after the last image (0 = never)
+static constexpr uint8_t  IMAGE_RETRIES     = 1;                    // more captures while a box-triggered image has no such box
+
+// The phase-1 result that asked for the image; it goes out as "trigger"
+// next to the boxes of the capture that was stored
+struct ImageTrigger
+{
+    uint8_t  boxes;
+    uint8_t  target, score;     // best box
+    uint16_t x, y, w, h;
+    bool     confirmed;         // the stored capture still has a box >= IMAGE_MIN_SCORE
+    uint32_t lag_ms;            // phase-1 result to image result
+};
+
+/* ================================
+   I2C CLOCK (Vision AI + OLED on Wire)
+   ================================ */
+// Managed by lib/i2cbus (the same code as VSTPRO): the fastest clock
+// whose probes pass at boot (both devices ACK, the module answers
+// AT+ID?). I2C_MAX_ERRORS faults within I2C_WINDOW_MS step it down;
+// I2C_CLEAN_MS without one step it back up after probing.
+static constexpr uint8_t  AI_I2C_ADDR    = 0x62;
+static constexpr uint32_t I2C_CLOCKS[]   = { 100000, 400000, 1000000 };
+static constexpr uint8_t  I2C_PROBES     = 5;
+static constexpr uint8_t  I2C_MAX_ERRORS = 3;
+static constexpr uint32_t I2C_WINDOW_MS  = 30000;
+static constexpr uint32_t I2C_CLEAN_MS   = 10UL * 60UL * 1000UL;
+static constexpr uint32_t I2C_REPORT_MS  = 15UL * 60UL * 1000UL;  // KB/s per clock on Serial
+
 /* ================================
    UART CONFIG (XIAO → T-SIM)
    ================================ */
@@ -74,6 +114,7 @@ static constexpr uint8_t  MAX_ACK_TIMEOUT_RETRIES = 5;
 static uint32_t frame_id = 0;
 static bool     awaiting_ack = false;
 static uint32_t last_send_ms = 0;
+static uint32_t last_image_ms = 0;
 
 /* timeout retry tracking + transport pause */
 static uint8_t ack_timeout_retries = 0;
@@ -86,6 +127,9 @@ static String cached_image;
 static size_t cached_image_len = 0;
 static uint32_t cached_image_crc = 0;
 
+/* I2C clock report */
+static uint32_t i2c_report_ms = 0;
+
 /* UART RX line assembly (non-blocking) */
 static String uart_line;
 
@@ -224,6 +268,93 @@ static inline void trigger_actuator(int pin, esp_timer_handle_t tmr, uint32_t &u
     }
 }
 
+/* ================================
+   I2C CLOCK
+   ================================ */
+static bool i2c_ack(uint8_t addr)
+{
+    Wire.beginTransmission(addr);
+    return Wire.endTransmission() == 0;
+}
+
+// AT+ID? straight through the library's transport: NONE on code 0,
+// TIMEOUT without a full reply, CRC on a reply that does not check out
+static I2cFault ping_module()
+{
+    static const char cmd[] = "AT+ID?\r\n";
+    char buf[160];
+    size_t len = 0;
+
+    AI.write(cmd, sizeof(cmd) - 1);
+    uint32_t t0 = millis();
+    while (millis() - t0 < 500 && len < sizeof(buf) - 1)
+    {
+        int n = AI.available();
+        if (n <= 0)
+        {
+            delay(2);
+            continue;
+        }
+        if (n > (int)(sizeof(buf) - 1 - len)) n = (int)(sizeof(buf) - 1 - len);
+        int got = AI.read(buf + len, n);
+        if (got <= 0) continue;
+        len += (size_t)got;
+        buf[len] = 0;
+
+        if (!strstr(buf, "}\n")) continue;
+        const char *c = strstr(buf, "\"code\":");
+        if (!strstr(buf, "\"ID?\"") || !c) return I2cFault::CRC;
+        for (c += 7; *c == ' '; c++) {}
+        return *c == '0' ? I2cFault::NONE : I2cFault::CRC;
+    }
+    return I2cFault::TIMEOUT;
+}
+
+static void i2c_set_clock(uint32_t hz) { Wire.setClock(hz); }
+
+// Both devices ACK, then an AT+ID? round trip
+static I2cFault i2c_probe()
+{
+    if (!i2c_ack(AI_I2C_ADDR) || (OLED_OK && !i2c_ack(OLED_ADDR)))
+        return I2cFault::NACK;
+    return ping_module();
+}
+
+static void i2c_begin()
+{
+    I2cBusConfig c = i2cbus_default_config();
+    c.n_clocks = 0;
+    for (uint32_t hz : I2C_CLOCKS)
+        if (c.n_clocks < I2CBUS_MAX_CLOCKS) c.clocks[c.n_clocks++] = hz;
+    c.probes = I2C_PROBES;
+    c.max_errors = I2C_MAX_ERRORS;
+    c.window_ms = I2C_WINDOW_MS;
+    c.clean_ms = I2C_CLEAN_MS;
+    if (!i2cbus_begin(I2cBusPort{ i2c_set_clock, i2c_probe }, c))
+        Serial.println("⚠️ I2C: no clock passed its probes");
+    i2c_report_ms = millis();
+}
+
+// A failed invoke: the library's timeout is a TIMEOUT, a bus error a
+// NACK, anything else (a reply that did not parse) CRC
+static void i2c_invoke_failed(int rc)
+{
+    if (rc == CMD_ETIMEDOUT) i2cbus_fault(I2cFault::TIMEOUT);
+    else if (rc == CMD_EIO) i2cbus_fault(I2cFault::NACK);
+    else i2cbus_fault(I2cFault::CRC);
+}
+
+// Between frames: the clock step, and KB/s per clock every I2C_REPORT_MS
+static void i2c_step()
+{
+    i2cbus_step();
+    if (millis() - i2c_report_ms >= I2C_REPORT_MS)
+    {
+        i2cbus_report();
+        i2c_report_ms = millis();
+    }
+}
+
 /* ================================
    SEND FRAME (CACHED)
    ================================ */
@@ -262,11 +393,127 @@ void send_cached_frame()
 /* ================================
    PREPARE NEXT FRAME
    ================================ */
+// INF line from the last invoke
+static void build_inf(const ImageTrigger *trig = nullptr)
+{
+    cached_inf = "";
+    cached_inf += "{\"frame\":";
+    cached_inf += frame_id;
+    cached_inf += ",\"perf\":{";
+    cached_inf += "\"preprocess\":";
+    cached_inf += AI.perf().prepocess;
+    cached_inf += ",\"inference\":";
+    cached_inf += AI.perf().inference;
+    cached_inf += ",\"postprocess\":";
+    cached_inf += AI.perf().postprocess;
+    cached_inf += "},\"boxes\":[";
+
+    for (size_t i = 0; i < AI.boxes().size(); i++)
+    {
+        auto &b = AI.boxes()[i];
+        if (i) cached_inf += ",";
+        cached_inf += "{\"target\":";
+        cached_inf += b.target;
+        cached_inf += ",\"score\":";
+        cached_inf += b.score;
+        cached_inf += ",\"x\":";
+        cached_inf += b.x;
+        cached_inf += ",\"y\":";
+        cached_inf += b.y;
+        cached_inf += ",\"w\":";
+        cached_inf += b.w;
+        cached_inf += ",\"h\":";
+        cached_inf += b.h;
+        cached_inf += "}";
+    }
+    cached_inf += "]";
+
+    if (trig)
+    {
+        cached_inf += ",\"trigger\":{\"boxes\":";
+        cached_inf += trig->boxes;
+        cached_inf += ",\"confirmed\":";
+        cached_inf += trig->confirmed ? "true" : "false";
+        cached_inf += ",\"lag_ms\":";
+        cached_inf += trig->lag_ms;
+        if (trig->boxes)
+        {
+            cached_inf += ",\"best\":{\"target\":";
+            cached_inf += trig->target;
+            cached_inf += ",\"score\":";
+            cached_inf += trig->score;
+            cached_inf += ",\"x\":";
+            cached_inf += trig->x;
+            cached_inf += ",\"y\":";
+            cached_inf += trig->y;
+            cached_inf += ",\"w\":";
+            cached_inf += trig->w;
+            cached_inf += ",\"h\":";
+            cached_inf += trig->h;
+            cached_inf += "}";
+        }
+        cached_inf += "}";
+    }
+    cached_inf += "}";
+
+    cached_json = cached_inf;
+}
+
+static void clear_image()
+{
+    cached_image = "";
+    cached_image_len = 0;
+    cached_image_crc = 0;
+}
+
+// Score clause of the image policy, on the boxes of the last invoke
+static bool has_image_box()
+{
+    for (size_t i = 0; i < AI.boxes().size(); i++)
+        if (AI.boxes()[i].score >= IMAGE_MIN_SCORE) return true;
+    return false;
+}
+
+// The last invoke's boxes as the trigger of the image that follows
+static ImageTrigger take_trigger()
+{
+    ImageTrigger t{};
+    t.boxes = AI.boxes().size() > 255 ? 255 : (uint8_t)AI.boxes().size();
+    for (size_t i = 0; i < AI.boxes().size(); i++)
+    {
+        auto &b = AI.boxes()[i];
+        if (i && b.score <= t.score) continue;
+        t.target = b.target;
+        t.score = b.score;
+        t.x = b.x;
+        t.y = b.y;
+        t.w = b.w;
+        t.h = b.h;
+    }
+    return t;
+}
+
+// Two-phase image policy: a good box, or the first frame in a while
+static bool wants_image(bool have_best, uint8_t best_score)
+{
+    if (!TWO_PHASE) return true;
+    if (have_best && best_score >= IMAGE_MIN_SCORE) return true;
+    return IMAGE_EVERY_MS && (last_image_ms == 0 || millis() - last_image_ms >= IMAGE_EVERY_MS);
+}
+
 bool prepare_frame()
 {
-    int rc = AI.invoke(1, false, false);
+    i2c_step();
+
+    // invoke(1, false, false) returns the image; show=true leaves it out
+    uint32_t invoke_ms = millis();
+    int rc = AI.invoke(1, false, TWO_PHASE);
+    invoke_ms = millis() - invoke_ms;
     if (rc != CMD_OK)
+    {
+        i2c_invoke_failed(rc);
         return false;
+    }
 
     Serial.println("🧠 RAW INFERENCE RESULT");
     Serial.printf("boxes: %u\n", (unsigned)AI.boxes().size());
@@ -320,47 +567,12 @@ bool prepare_frame()
         oled_show_no_detection();
 
     frame_id++;
-
-    cached_inf = "";
-    cached_inf += "{\"frame\":";
-    cached_inf += frame_id;
-    cached_inf += ",\"perf\":{";
-    cached_inf += "\"preprocess\":";
-    cached_inf += AI.perf().prepocess;
-    cached_inf += ",\"inference\":";
-    cached_inf += AI.perf().inference;
-    cached_inf += ",\"postprocess\":";
-    cached_inf += AI.perf().postprocess;
-    cached_inf += "},\"boxes\":[";
-
-    for (size_t i = 0; i < AI.boxes().size(); i++)
-    {
-        auto &b = AI.boxes()[i];
-        if (i) cached_inf += ",";
-        cached_inf += "{\"target\":";
-        cached_inf += b.target;
-        cached_inf += ",\"score\":";
-        cached_inf += b.score;
-        cached_inf += ",\"x\":";
-        cached_inf += b.x;
-        cached_inf += ",\"y\":";
-        cached_inf += b.y;
-        cached_inf += ",\"w\":";
-        cached_inf += b.w;
-        cached_inf += ",\"h\":";
-        cached_inf += b.h;
-        cached_inf += "}";
-    }
-    cached_inf += "]}";
-
-    cached_json = cached_inf;
+    build_inf();
 
     // If UART transport is paused (timeouts), skip heavy image work entirely
     if (!ENABLE_UART_TRANSPORT || transport_paused)
     {
-        cached_image = "";
-        cached_image_len = 0;
-        cached_image_crc = 0;
+        clear_image();
 
         Serial.printf(
             "🧠 prepared frame %lu (img=SKIPPED transport_paused=%s)\n",
@@ -370,8 +582,53 @@ bool prepare_frame()
         return true;
     }
 
+    if (!wants_image(have_best, best_score))
+    {
+        clear_image();
+
+        Serial.printf("🧠 prepared frame %lu (img=NOT WANTED)\n", frame_id);
+        return true;
+    }
+
+    // Phase 2: the image. A new capture, so perf and boxes in INF are
+    // the ones that belong to it and the phase-1 result goes along as the
+    // trigger. A box-triggered image whose capture lost the box is
+    // retried IMAGE_RETRIES times, then sent with confirmed=false.
+    if (TWO_PHASE)
+    {
+        ImageTrigger trig = take_trigger();
+        bool need = has_image_box();
+        uint32_t trig_ms = millis();
+        for (uint8_t attempt = 0;; attempt++)
+        {
+            invoke_ms = millis();
+            rc = AI.invoke(1, false, false);
+            invoke_ms = millis() - invoke_ms;
+            if (rc != CMD_OK)
+            {
+                i2c_invoke_failed(rc);
+                clear_image();
+                Serial.printf("⚠️ image invoke failed rc=%d, frame %lu without image\n", rc, frame_id);
+                return true;
+            }
+            trig.confirmed = !need || has_image_box();
+            if (trig.confirmed || attempt >= IMAGE_RETRIES) break;
+            Serial.printf("🔁 frame %lu: image capture lost the detection, capturing again\n", frame_id);
+        }
+        trig.lag_ms = millis() - trig_ms;
+        if (!trig.confirmed)
+            Serial.printf("⚠️ frame %lu: image stored without the trigger's detection\n", frame_id);
+        build_inf(&trig);
+    }
+
     cached_image = AI.last_image();
     cached_image_len = cached_image.length();
+    last_image_ms = millis();
+
+    // Transfer rate: the invoke less the module's own pipeline
+    uint32_t pipeline_ms = AI.perf().prepocess + AI.perf().inference + AI.perf().postprocess;
+    if (invoke_ms > pipeline_ms)
+        i2cbus_transfer((uint32_t)cached_image_len, (invoke_ms - pipeline_ms) * 1000UL);
 
     cached_image_crc = esp_crc32_le(
         0,
@@ -498,7 +755,7 @@ void setup()
     }
 
     Wire.begin();
-    Wire.setClock(400000);
+    Wire.setClock(400000);      // OLED and SSCMA init; i2c_begin() picks the clock after
 
     // OLED init (do NOT hard-fail if missing)
     if (display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR))
@@ -528,6 +785,7 @@ void setup()
     }
 
     Serial.println("✅ SSCMA initialized");
+    i2c_begin();
     log_memory();
 
     // Power-on blink (still works, now via trigger helper)
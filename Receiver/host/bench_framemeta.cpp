@@ -0,0 +1,96 @@
+// bench_framemeta.cpp — host benchmark for framemeta_parse()
+//
+// Builds the same framemeta_json.cpp the firmware uses against the ArduinoJson
+// headers PlatformIO already fetched into .pio/libdeps. See run.sh.
+//
+// Output: per box count, mean and p99 parse time per frame.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "framemeta_json.h"
+
+static constexpr int ITERATIONS = 20000;
+
+// Same layout as prepare_frame() in Broker/src/main.cpp: a frame with
+// boxes carries the trigger of its two-phase image.
+static std::string make_line(uint32_t frame, int boxes)
+{
+    char buf[128];
+    std::string s;
+
+    snprintf(buf, sizeof(buf),
+             "{\"frame\":%u,\"perf\":{\"preprocess\":7,\"inference\":52,\"postprocess\":1},\"boxes\":[",
+             frame);
+    s += buf;
+
+    for (int i = 0; i < boxes; i++)
+    {
+        snprintf(buf, sizeof(buf),
+                 "%s{\"target\":%d,\"score\":%d,\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d}",
+                 i ? "," : "", i % 4, 50 + (i * 7) % 50, 10 + i, 20 + i, 30, 40);
+        s += buf;
+    }
+    s += "]";
+    if (boxes)
+        s += ",\"trigger\":{\"boxes\":2,\"confirmed\":true,\"lag_ms\":180,"
+             "\"best\":{\"target\":3,\"score\":81,\"x\":96,\"y\":84,\"w\":40,\"h\":42}}";
+    s += "}";
+    return s;
+}
+
+static void bench(int boxes)
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 64; i++)
+        lines.push_back(make_line(1000 + i, boxes));
+
+    std::vector<double> ns;
+    ns.reserve(ITERATIONS);
+
+    FrameMeta meta;
+    size_t failures = 0;
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        const std::string &l = lines[i % lines.size()];
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = framemeta_parse(l.c_str(), l.size(), meta);
+        auto t1 = std::chrono::steady_clock::now();
+
+        if (!ok || meta.box_count != std::min<int>(boxes, FRAME_META_MAX_BOXES) ||
+            meta.trigger.valid != (boxes > 0))
+            failures++;
+
+        ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+
+    std::sort(ns.begin(), ns.end());
+    double sum = 0;
+    for (double v : ns) sum += v;
+
+    printf("boxes=%2d  len=%4zu  mean=%8.0f ns  p50=%8.0f ns  p99=%8.0f ns  fail=%zu\n",
+           boxes,
+           lines[0].size(),
+           sum / ns.size(),
+           ns[ns.size() / 2],
+           ns[(ns.size() * 99) / 100],
+           failures);
+}
+
+int main()
+{
+    printf("framemeta_parse benchmark (%d iterations per row)\n", ITERATIONS);
+
+    const int box_counts[] = {0, 1, 4, 8, 16, 24};
+    for (int b : box_counts)
+        bench(b);
+
+    printf("arena high water: %zu bytes\n", framemeta_arena_high_water());
+    return 0;
+}
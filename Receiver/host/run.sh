@@ -0,0 +1,30 @@
+#!/bin/sh
+# Host benchmarks for the receiver.
+#
+# Prerequisite: ArduinoJson 7 headers. Looked up in this order:
+#   1. $ARDUINOJSON_DIR
+#   2. ../.pio/libdeps/t-sim7080g-s3/ArduinoJson/src (`pio pkg install`)
+#   3. host/.deps/ArduinoJson/src, cloned here on first run if git can
+#      reach GitHub
+set -e
+cd "$(dirname "$0")"
+
+AJ_TAG="v7.4.2"
+AJ="${ARDUINOJSON_DIR:-../.pio/libdeps/t-sim7080g-s3/ArduinoJson/src}"
+
+if [ ! -f "$AJ/ArduinoJson.h" ]; then
+    AJ=".deps/ArduinoJson/src"
+    if [ ! -f "$AJ/ArduinoJson.h" ]; then
+        echo "ArduinoJson not found, cloning $AJ_TAG into host/.deps/"
+        if ! git clone -q --depth 1 --branch "$AJ_TAG" \
+                https://github.com/bblanchon/ArduinoJson.git .deps/ArduinoJson; then
+            echo "run.sh: needs ArduinoJson 7. Run 'pio pkg install' in Receiver/," >&2
+            echo "        or set ARDUINOJSON_DIR to an ArduinoJson/src folder." >&2
+            exit 1
+        fi
+    fi
+fi
+
+g++ -O2 -std=c++17 -Wall -I../src -I../../lib/vstcore -I"$AJ" \
+    bench_framemeta.cpp ../src/framemeta_json.cpp -o bench_framemeta
+./bench_framemeta
@@ -0,0 +1,210 @@
+// framemeta_json.cpp
+//
+// Inference metadata parser. ArduinoJson 7 allocates through an
+// Allocator; we hand it a bump arena over a static buffer so the
+// per-frame parse never reaches malloc(). The arena is rewound before
+// every parse, so fragmentation cannot build up over weeks of uptime.
+//
+// No Arduino.h here on purpose: the file also builds on the host for
+// Receiver/host/bench_framemeta.cpp.
+
+#include "framemeta_json.h"
+
+#include <string.h>
+#include <ArduinoJson.h>
+
+/* =========================================================
+   STATIC ARENA ALLOCATOR
+   ========================================================= */
+static constexpr size_t FRAME_META_ARENA_SZ  = 6144;
+static constexpr size_t FRAME_FILTER_ARENA_SZ = 1024;   // boxes and trigger keys
+
+class StaticArena : public ArduinoJson::Allocator
+{
+public:
+    StaticArena(uint8_t *buf, size_t size) : buf_(buf), size_(size) {}
+
+    void *allocate(size_t n) override
+    {
+        size_t need = HDR + align(n);
+        if (top_ + need > size_) return nullptr;
+
+        uint8_t *blk = buf_ + top_;
+        *(size_t*)blk = n;
+        last_ = top_;
+        top_ += need;
+        if (top_ > high_) high_ = top_;
+        return blk + HDR;
+    }
+
+    void deallocate(void *p) override
+    {
+        // Only the most recent block can be released; everything
+        // else is reclaimed by reset() before the next parse.
+        if (p && block_of(p) == buf_ + last_)
+            top_ = last_;
+    }
+
+    void *reallocate(void *p, size_t n) override
+    {
+        if (!p) return allocate(n);
+
+        uint8_t *blk = block_of(p);
+        size_t old = *(size_t*)blk;
+
+        if (blk == buf_ + last_)
+        {
+            size_t need = HDR + align(n);
+            if (last_ + need > size_) return nullptr;
+            *(size_t*)blk = n;
+            top_ = last_ + need;
+            if (top_ > high_) high_ = top_;
+            return p;
+        }
+
+        if (n <= old)
+            return p;
+
+        void *q = allocate(n);
+        if (q) memcpy(q, p, old);
+        return q;
+    }
+
+    void reset()
+    {
+        top_ = 0;
+        last_ = 0;
+    }
+
+    size_t high_water() const { return high_; }
+
+private:
+    static constexpr size_t HDR = 8;    // keeps payloads 8-byte aligned
+
+    static size_t align(size_t n) { return (n + 7) & ~(size_t)7; }
+    static uint8_t *block_of(void *p) { return (uint8_t*)p - HDR; }
+
+    uint8_t *buf_;
+    size_t   size_;
+    size_t   top_  = 0;
+    size_t   last_ = 0;
+    size_t   high_ = 0;
+};
+
+alignas(8) static uint8_t g_arena_buf[FRAME_META_ARENA_SZ];
+alignas(8) static uint8_t g_filter_buf[FRAME_FILTER_ARENA_SZ];
+
+static StaticArena g_arena(g_arena_buf, sizeof(g_arena_buf));
+static StaticArena g_filter_arena(g_filter_buf, sizeof(g_filter_buf));
+
+static JsonDocument g_doc(&g_arena);
+static JsonDocument g_filter(&g_filter_arena);
+static bool g_filter_ready = false;
+
+/* =========================================================
+   FILTER (built once, drops any field we do not store)
+   ========================================================= */
+static void build_filter()
+{
+    g_filter["frame"] = true;
+
+    g_filter["perf"]["preprocess"]  = true;
+    g_filter["perf"]["inference"]   = true;
+    g_filter["perf"]["postprocess"] = true;
+
+    g_filter["boxes"][0]["target"] = true;
+    g_filter["boxes"][0]["score"]  = true;
+    g_filter["boxes"][0]["x"] = true;
+    g_filter["boxes"][0]["y"] = true;
+    g_filter["boxes"][0]["w"] = true;
+    g_filter["boxes"][0]["h"] = true;
+
+    g_filter["trigger"]["boxes"]     = true;
+    g_filter["trigger"]["confirmed"] = true;
+    g_filter["trigger"]["lag_ms"]    = true;
+    g_filter["trigger"]["best"]      = true;
+
+    g_filter_ready = true;
+}
+
+static uint16_t clamp_u16(uint32_t v)
+{
+    return (v > 0xFFFF) ? 0xFFFF : (uint16_t)v;
+}
+
+static uint8_t clamp_u8(uint32_t v)
+{
+    return (v > 0xFF) ? 0xFF : (uint8_t)v;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+bool framemeta_parse(const char *json, size_t len, FrameMeta &out)
+{
+    memset(&out, 0, sizeof(out));
+    if (!json || len == 0) return false;
+
+    if (!g_filter_ready) build_filter();
+
+    g_doc.clear();
+    g_arena.reset();
+
+    DeserializationError err = deserializeJson(
+        g_doc, json, len,
+        DeserializationOption::Filter(g_filter));
+
+    if (err || !g_doc["frame"].is<uint32_t>())
+        return false;
+
+    out.frame = g_doc["frame"].as<uint32_t>();
+
+    JsonObjectConst perf = g_doc["perf"];
+    out.perf.preprocess  = clamp_u16(perf["preprocess"]  | 0u);
+    out.perf.inference   = clamp_u16(perf["inference"]   | 0u);
+    out.perf.postprocess = clamp_u16(perf["postprocess"] | 0u);
+
+    JsonArrayConst boxes = g_doc["boxes"];
+    for (JsonObjectConst b : boxes)
+    {
+        if (out.box_count >= FRAME_META_MAX_BOXES)
+        {
+            if (out.boxes_dropped < 0xFF) out.boxes_dropped++;
+            continue;
+        }
+
+        FrameBox &fb = out.boxes[out.box_count++];
+        fb.target = clamp_u8(b["target"] | 0u);
+        fb.score  = clamp_u8(b["score"]  | 0u);
+        fb.x = clamp_u16(b["x"] | 0u);
+        fb.y = clamp_u16(b["y"] | 0u);
+        fb.w = clamp_u16(b["w"] | 0u);
+        fb.h = clamp_u16(b["h"] | 0u);
+    }
+
+    // Two-phase broker: the result that asked for the image
+    JsonObjectConst trig = g_doc["trigger"];
+    if (!trig.isNull())
+    {
+        FrameTrigger &t = out.trigger;
+        t.valid = true;
+        t.confirmed = trig["confirmed"] | false;
+        t.box_count = clamp_u8(trig["boxes"] | 0u);
+        t.lag_ms = trig["lag_ms"] | 0u;
+        JsonObjectConst best = trig["best"];
+        t.best.target = clamp_u8(best["target"] | 0u);
+        t.best.score  = clamp_u8(best["score"]  | 0u);
+        t.best.x = clamp_u16(best["x"] | 0u);
+        t.best.y = clamp_u16(best["y"] | 0u);
+        t.best.w = clamp_u16(best["w"] | 0u);
+        t.best.h = clamp_u16(best["h"] | 0u);
+    }
+
+    out.valid = true;
+    return true;
+}
+
+size_t framemeta_arena_high_water()
+{
+    return g_arena.high_water();
+}
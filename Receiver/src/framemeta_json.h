@@ -0,0 +1,25 @@
+// framemeta_json.h — broker JSON line → FrameMeta
+#pragma once
+#include <stddef.h>
+#include "framemeta.h"
+
+/* =========================================================
+   INFERENCE METADATA PARSER
+   =========================================================
+   Input is the broker "JSON {...}" line without the prefix:
+
+     {"frame":N,
+      "perf":{"preprocess":a,"inference":b,"postprocess":c},
+      "boxes":[{"target":t,"score":s,"x":x,"y":y,"w":w,"h":h}, ...],
+      "trigger":{"boxes":n,"confirmed":b,"lag_ms":l,"best":{box}}}
+
+   "trigger" is optional (two-phase broker, see FrameTrigger).
+*/
+
+// Parse one JSON metadata line (without the "JSON " prefix).
+// Uses a static arena for ArduinoJson; never touches the heap.
+// On failure out.valid == false and out.frame is left at 0.
+bool framemeta_parse(const char *json, size_t len, FrameMeta &out);
+
+// Peak arena usage of the parser in bytes (for sizing FRAME_META_ARENA_SZ).
+size_t framemeta_arena_high_water();
@@ -8,6 +8,7 @@
 
 #include "sdcard.h"
 #include "modem.h"
+#include "framemeta_json.h"
 
 /* =========================================================
    BROKER UART CONFIG
@@ -25,6 +26,7 @@ enum RxState {
     WAIT_JSON,
     WAIT_IMAGE_HEADER,
     READ_IMAGE,
+    SKIP_IMAGE,
     WAIT_END
 };
 
@@ -38,6 +40,42 @@ static String   image_base64;
 static size_t   image_expected_len = 0;
 static uint32_t image_expected_crc = 0;
 static uint32_t frame_id = 0;
+static FrameMeta frame_meta = {};
+static bool     skip_frame = false;       // duplicate or unknown id: read past it
+static bool     frame_id_known = false;   // this frame's id, not the last one's
+static size_t   image_skipped = 0;
+
+/* =========================================================
+   DUPLICATE SUPPRESSION
+   =========================================================
+   A lost ACK makes the broker resend the same frame (same id,
+   same Base64 CRC). Remember the last committed frames and
+   re-ACK a match at the IMAGE header, skipping decode + SD. */
+static constexpr size_t COMMIT_HISTORY = 16;
+
+struct CommittedFrame {
+    uint32_t frame_id;
+    uint32_t crc;
+    bool     used;
+};
+
+static CommittedFrame committed[COMMIT_HISTORY] = {};
+static size_t   committed_next = 0;
+static uint32_t dup_suppressed = 0;
+
+/* =========================================================
+   SD FAILURES
+   =========================================================
+   A frame that failed a transient write is left un-ACKed so the
+   broker resends it, at most SAVE_ATTEMPTS times in all (below
+   the broker's 5 ACK timeouts, after which it pauses transport).
+   Without a card, on a full card or after the last attempt the
+   frame is ACKed and counted as lost. */
+static constexpr uint8_t SAVE_ATTEMPTS = 2;
+
+static uint32_t save_retry_id = 0;
+static uint8_t  save_retry_n = 0;
+static uint32_t frames_lost = 0;
 
 static char g_timestamp[32] = {0};
 
@@ -50,9 +88,48 @@ static void reset_frame()
     image_base64 = "";
     image_expected_len = 0;
     image_expected_crc = 0;
+    skip_frame = false;
+    frame_id_known = false;
+    image_skipped = 0;
     rx_state = WAIT_JSON;
 }
 
+// Metadata that did not parse may still name its frame
+static bool frame_id_from_json(const String &json, uint32_t *id)
+{
+    int idx = json.indexOf("\"frame\":");
+    if (idx < 0) return false;
+    const char *p = json.c_str() + idx + 8;
+    while (*p == ' ') p++;
+    if (*p < '0' || *p > '9') return false;
+    *id = strtoul(p, nullptr, 10);
+    return true;
+}
+
+static bool is_committed(uint32_t id, uint32_t crc)
+{
+    for (size_t i = 0; i < COMMIT_HISTORY; i++) {
+        if (committed[i].used &&
+            committed[i].frame_id == id &&
+            committed[i].crc == crc)
+            return true;
+    }
+    return false;
+}
+
+static void remember_committed(uint32_t id, uint32_t crc)
+{
+    committed[committed_next] = { id, crc, true };
+    committed_next = (committed_next + 1) % COMMIT_HISTORY;
+}
+
+static void send_ack(uint32_t id)
+{
+    char ack[24];
+    int n = snprintf(ack, sizeof(ack), "ACK %lu\n", (unsigned long)id);
+    uart_write_bytes(BROKER_UART, ack, n);
+}
+
 static bool is_digit(char c)
 {
     return (c >= '0' && c <= '9');
@@ -247,6 +324,12 @@ void loop()
         return;
     }
 
+    if (rx_state == SKIP_IMAGE) {
+        if (++image_skipped >= image_expected_len)
+            rx_state = WAIT_END;
+        return;
+    }
+
     if (c != '\n') {
         line += (char)c;
         return;
@@ -259,12 +342,44 @@ void loop()
         reset_frame();
 
         json_buffer = line.substring(5);
-        int idx = json_buffer.indexOf("\"frame\":");
-        if (idx >= 0)
-            frame_id = json_buffer.substring(idx + 8).toInt();
+
+        uint32_t t0 = micros();
+        bool parsed = framemeta_parse(json_buffer.c_str(), json_buffer.length(), frame_meta);
+        uint32_t parse_us = micros() - t0;
+
+        if (parsed) {
+            frame_id = frame_meta.frame;
+            frame_id_known = true;
+        }
+        else {
+            frame_id_known = frame_id_from_json(json_buffer, &frame_id);
+        }
 
         Serial.println("🧠 INFERENCE");
-        Serial.printf("Frame      : %lu\n", frame_id);
+        if (frame_id_known)
+            Serial.printf("Frame      : %lu\n", frame_id);
+        else
+            Serial.println("Frame      : unknown → dropped, no ACK");
+        Serial.printf("Parse      : %s (%lu us)\n", parsed ? "OK" : "FAILED", parse_us);
+        Serial.printf("Perf       : pre=%u inf=%u post=%u ms\n",
+                      frame_meta.perf.preprocess,
+                      frame_meta.perf.inference,
+                      frame_meta.perf.postprocess);
+        Serial.printf("Boxes      : %u", frame_meta.box_count);
+        if (frame_meta.boxes_dropped)
+            Serial.printf(" (+%u dropped)", frame_meta.boxes_dropped);
+        Serial.println();
+        for (uint8_t i = 0; i < frame_meta.box_count; i++) {
+            const FrameBox &b = frame_meta.boxes[i];
+            Serial.printf("  [%u] target=%u score=%u x=%u y=%u w=%u h=%u\n",
+                          i, b.target, b.score, b.x, b.y, b.w, b.h);
+        }
+        if (frame_meta.trigger.valid) {
+            const FrameTrigger &t = frame_meta.trigger;
+            Serial.printf("Trigger    : %u boxes, best target=%u score=%u, %lu ms earlier%s\n",
+                          t.box_count, t.best.target, t.best.score, (unsigned long)t.lag_ms,
+                          t.confirmed ? "" : " ⚠️ not in this capture");
+        }
         Serial.println(json_buffer);
 
         rx_state = WAIT_IMAGE_HEADER;
@@ -276,8 +391,30 @@ void loop()
         sscanf(line.c_str(), "IMAGE %zu %lx",
                &image_expected_len, &image_expected_crc);
 
-        image_base64.reserve(image_expected_len);
-        rx_state = READ_IMAGE;
+        if (!frame_id_known) {
+            // Nothing to ACK it with: skip it, the broker's timeout resends
+            skip_frame = true;
+            image_skipped = 0;
+            rx_state = (image_expected_len > 0) ? SKIP_IMAGE : WAIT_END;
+        }
+        else if (is_committed(frame_id, image_expected_crc)) {
+            send_ack(frame_id);
+            dup_suppressed++;
+            Serial.printf("♻️ Duplicate frame %lu (crc=%08lx) → re-ACK, skipped (total %lu)\n",
+                          frame_id, image_expected_crc, dup_suppressed);
+
+            skip_frame = true;
+            image_skipped = 0;
+            rx_state = (image_expected_len > 0) ? SKIP_IMAGE : WAIT_END;
+        }
+        else {
+            // IMAGE 0: the broker left the image out (two-phase), END follows
+            image_base64.reserve(image_expected_len);
+            rx_state = (image_expected_len > 0) ? READ_IMAGE : WAIT_END;
+        }
+    }
+    else if (rx_state == WAIT_END && line == "END" && skip_frame) {
+        reset_frame();
     }
     else if (rx_state == WAIT_END && line == "END") {
         uint32_t crc = esp_crc32_le(
@@ -286,21 +423,51 @@ void loop()
             image_base64.length()
         );
 
-        if (crc == image_expected_crc) {
+        if (crc == image_expected_crc && image_expected_len == 0) {
+            Serial.printf("📭 Frame %lu without image (detections only)\n", frame_id);
+            send_ack(frame_id);
+            remember_committed(frame_id, crc);
+        }
+        else if (crc == image_expected_crc) {
             uint8_t *jpeg = nullptr;
             size_t jpeg_len = 0;
 
-            if (decode_base64_to_jpeg(image_base64, &jpeg, &jpeg_len) &&
-                jpeg_sanity_check(jpeg, jpeg_len) &&
-                sdcard_available())
-            {
-                sdcard_save_jpeg(frame_id, jpeg, jpeg_len);
+            // A failed decode is an allocation (retry); a CRC-clean
+            // image that is no JPEG comes the same way again (lost)
+            SdSave saved = SdSave::RETRY;
+            if (decode_base64_to_jpeg(image_base64, &jpeg, &jpeg_len)) {
+                saved = jpeg_sanity_check(jpeg, jpeg_len)
+                      ? sdcard_save_jpeg(frame_id, jpeg, jpeg_len,
+                                         frame_meta.valid ? &frame_meta : nullptr)
+                      : SdSave::FAILED;
             }
 
             free(jpeg);
 
-            String ack = "ACK " + String(frame_id) + "\n";
-            uart_write_bytes(BROKER_UART, ack.c_str(), ack.length());
+            if (saved == SdSave::RETRY) {
+                if (save_retry_id != frame_id) {
+                    save_retry_id = frame_id;
+                    save_retry_n = 0;
+                }
+                if (++save_retry_n >= SAVE_ATTEMPTS)
+                    saved = SdSave::FAILED;
+            }
+
+            // Only a stored frame is remembered for duplicate suppression
+            if (saved == SdSave::OK) {
+                send_ack(frame_id);
+                remember_committed(frame_id, crc);
+            }
+            else if (saved == SdSave::RETRY) {
+                Serial.printf("⚠️ Frame %lu not stored (attempt %u/%u) → no ACK, broker resends\n",
+                              frame_id, save_retry_n, SAVE_ATTEMPTS);
+            }
+            else {
+                send_ack(frame_id);
+                frames_lost++;
+                Serial.printf("❌ Frame %lu lost (SD) → ACK so transport goes on (total %lu)\n",
+                              frame_id, frames_lost);
+            }
         }
 
         reset_frame();
@@ -1,7 +1,9 @@
 //sdcard.cpp
 
 #include "sdcard.h"
+#include "segstore.h"
 #include <SD_MMC.h>
+#include <time.h>
 
 /* =============================
    SD PIN CONFIG (T-SIM7080G-S3)
@@ -10,8 +12,27 @@
 #define SD_CLK  38
 #define SD_DATA 40
 
+static constexpr const char *SD_MOUNT = "/sdcard";
+
+/* =============================
+   STORAGE MODE
+   =============================
+   false : one /frame_<id>.jpg per frame (default)
+   true  : append-only segment container (/seg/SEG_nnnnnn.VSG);
+           frames come back out with tools/vseg_extract.py */
+static constexpr bool     SD_USE_SEGMENTS = false;
+static constexpr uint32_t SEG_MAX_BYTES   = 32UL * 1024UL * 1024UL;
+static constexpr uint32_t SEG_MAX_AGE_S   = 3600;
+static constexpr uint16_t SEG_SYNC_EVERY  = 8;
+static constexpr uint32_t SEG_CHUNK_BYTES = 32UL * 1024UL;
+static constexpr uint32_t SD_STATS_EVERY  = 50;
+static constexpr uint32_t SD_FULL_MARGIN  = 256UL * 1024UL;   // a failed write this close to full: card full
+
 static bool sd_ok = false;
 
+static uint32_t store_frames = 0;
+static uint64_t store_us = 0;
+
 /* =============================
    INIT
    ============================= */
@@ -21,7 +42,7 @@ bool sdcard_init()
 
     SD_MMC.setPins(SD_CLK, SD_CMD, SD_DATA);
 
-    if (!SD_MMC.begin("/sdcard", true))
+    if (!SD_MMC.begin(SD_MOUNT, true))
     {
         Serial.println("❌ SD_MMC mount failed");
         sd_ok = false;
@@ -35,6 +56,17 @@ bool sdcard_init()
     Serial.printf("📦 SD size : %llu MB\n", size / (1024 * 1024));
     Serial.printf("📊 SD usage: %llu / %llu bytes\n", used, size);
 
+    if (SD_USE_SEGMENTS)
+    {
+        SegConfig cfg{ SEG_MAX_BYTES, SEG_MAX_AGE_S, SEG_SYNC_EVERY, SEG_CHUNK_BYTES };
+        if (!segstore_init(SD_MOUNT, cfg))
+        {
+            Serial.println("❌ Segment store init failed");
+            sd_ok = false;
+            return false;
+        }
+    }
+
     sd_ok = true;
     return true;
 }
@@ -47,11 +79,23 @@ bool sdcard_available()
 /* =============================
    SAVE JPEG
    ============================= */
-bool sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len)
+static bool save_segment(uint32_t frame_id, const uint8_t *data, size_t len,
+                         const FrameMeta *meta)
 {
-    if (!sd_ok)
+    time_t now = time(nullptr);
+    uint32_t epoch = (now > 1577836800) ? (uint32_t)now : 0;   // after 2020-01-01
+
+    SegLocation loc{};
+    if (!segstore_append(frame_id, epoch, meta, data, len, &loc))
         return false;
 
+    Serial.printf("💾 JPEG saved: SEG_%06lu.VSG @%lu (%u bytes)\n",
+                  loc.seq, loc.offset, len);
+    return true;
+}
+
+static bool save_per_file(uint32_t frame_id, const uint8_t *data, size_t len)
+{
     char path[32];
     snprintf(path, sizeof(path), "/frame_%06lu.jpg", frame_id);
 
@@ -74,3 +118,40 @@ bool sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len)
     Serial.printf("💾 JPEG saved: %s (%u bytes)\n", path, len);
     return true;
 }
+
+// Free space is only asked for after a failed write: on FAT it is a
+// scan of the allocation table. 0 bytes total: the card is gone.
+static bool sd_full(size_t len)
+{
+    uint64_t total = SD_MMC.totalBytes();
+    uint64_t used = SD_MMC.usedBytes();
+    return total == 0 || used + len + SD_FULL_MARGIN > total;
+}
+
+SdSave sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len,
+                        const FrameMeta *meta)
+{
+    if (!sd_ok)
+        return SdSave::FAILED;
+
+    uint32_t t0 = micros();
+    bool ok = SD_USE_SEGMENTS ? save_segment(frame_id, data, len, meta)
+                              : save_per_file(frame_id, data, len);
+    if (!ok)
+    {
+        if (!sd_full(len))
+            return SdSave::RETRY;
+        Serial.println("❌ SD card full or unreadable");
+        return SdSave::FAILED;
+    }
+
+    store_us += micros() - t0;
+    if (++store_frames % SD_STATS_EVERY == 0)
+    {
+        double avg_ms = (double)store_us / 1000.0 / store_frames;
+        Serial.printf("📊 SD store [%s]: frames=%lu avg_write=%.1f ms -> %.1f frames/s sustained\n",
+                      SD_USE_SEGMENTS ? "SEGMENT" : "PER_FILE",
+                      store_frames, avg_ms, avg_ms > 0 ? 1000.0 / avg_ms : 0.0);
+    }
+    return SdSave::OK;
+}
@@ -1,6 +1,13 @@
 #pragma once
 #include <Arduino.h>
+#include "framemeta.h"
+
+// RETRY: a write failed on a mounted card with room left, a resend may
+// store it. FAILED: no card, or the card is full; resending cannot help.
+enum class SdSave : uint8_t { OK, RETRY, FAILED };
 
 bool sdcard_init();
 bool sdcard_available();
-bool sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len);
+// meta is stored with the image in segment mode (ignored per-file).
+SdSave sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len,
+                        const FrameMeta *meta = nullptr);
@@ -0,0 +1,50 @@
+// at_pty.cpp — modem_at.h port over a tty (see at_pty.h)
+
+#include "at_pty.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int g_fd = -1;
+
+static int pty_read(uint8_t *buf, size_t n)
+{
+    ssize_t r = read(g_fd, buf, n);
+    return r > 0 ? (int)r : 0;
+}
+
+static int pty_write(const uint8_t *buf, size_t n)
+{
+    ssize_t w = write(g_fd, buf, n);
+    return w > 0 ? (int)w : 0;
+}
+
+bool at_pty_open(const char *path, AtPort *port)
+{
+    g_fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (g_fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(g_fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tcsetattr(g_fd, TCSANOW, &tio);
+    }
+    tcflush(g_fd, TCIOFLUSH);
+
+    *port = AtPort{ pty_read, pty_write };
+    return true;
+}
+
+void at_pty_close()
+{
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+}
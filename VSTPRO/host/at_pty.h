@@ -0,0 +1,9 @@
+// at_pty.h — modem_at.h port over a serial device / pseudo-terminal
+//
+// Opens the slave side created by tools/sim7080_emu.py (or a USB-serial
+// adapter wired to a real SIM7080) in raw mode.
+#pragma once
+#include "modem_at.h"
+
+bool at_pty_open(const char *path, AtPort *port);
+void at_pty_close();
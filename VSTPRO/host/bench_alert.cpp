@@ -0,0 +1,210 @@
+// bench_alert.cpp — hornet alert latency over UDP / CoAP, with and without
+// a busy image queue
+//
+// Plays a detection trace (Apis most of the time, two Vespa velutina
+// visits) into alert.cpp while a sender thread plays the alert task,
+// against tools/sim7080_emu.py and tools/coap_standin.py. With --dir a
+// second thread runs the uploader on that store at the same time, the way
+// the two tasks share the modem on the ESP32 (at_lock()).
+//
+//   python3 tools/coap_standin.py --log /tmp/vst_alerts.jsonl &
+//   python3 tools/blob_standin.py &
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --pdp-ms 1500 --latency-ms 300 &
+//   ./bench_upload --dir /tmp/vst_alert --populate 30
+//   ./bench_alert                      # link otherwise idle
+//   ./bench_alert --dir /tmp/vst_alert # uploader busy with 30 frames
+//
+// Reports every alert with its latency (detection to ACK; for repeats held
+// by the gap or the rate limit, from the end of the hold), and how many
+// detections were coalesced or held back.
+// ./run.sh alert runs both.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "alert.h"
+#include "at_pty.h"
+#include "modem_at.h"
+#include "sdstore.h"
+#include "uploader.h"
+
+static std::atomic<bool> g_capturing{true};
+static std::atomic<bool> g_uploading{false};
+static double g_t0 = 0;
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Sent
+{
+    double   at_s;
+    uint32_t latency_ms;
+};
+static std::vector<Sent> g_sent;
+
+// The alert task: sends as soon as due, otherwise polls like its 250 ms wait
+static void run_sender()
+{
+    for (;;)
+    {
+        if (alert_due())
+        {
+            uint32_t before = alert_stats().alerts;
+            at_lock();
+            alert_step();
+            at_unlock();
+            if (alert_stats().alerts != before)
+                g_sent.push_back(Sent{ now_s() - g_t0, alert_stats().last_latency_ms });
+            continue;
+        }
+        if (!g_capturing) break;
+        usleep(20000);
+    }
+}
+
+// The uploader task, one step per modem turn
+static void run_uploader()
+{
+    while (g_uploading)
+    {
+        at_lock();
+        UpState s = uploader_step();
+        at_unlock();
+        if (s == UpState::IDLE) break;
+        if (s == UpState::BACKOFF) usleep(50000);
+    }
+    g_uploading = false;
+}
+
+int main(int argc, char **argv)
+{
+    std::string tty = "/tmp/vst_modem", dir;
+    AlertConfig cfg = alert_default_config();
+    cfg.host = "127.0.0.1";
+    cfg.apn = "";
+    cfg.retry_ms = 500;
+    cfg.gap_ms = 15000;
+    cfg.burst = 2;
+    cfg.refill_ms = 60000;
+    double fps = 5, secs = 90;
+    uint32_t seed = 11;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--host")) cfg.host = argv[i + 1];
+        else if (!strcmp(argv[i], "--port")) cfg.port = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--gap-ms")) cfg.gap_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--burst")) cfg.burst = (uint8_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--refill-ms")) cfg.refill_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--ack-ms")) cfg.ack_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--non")) cfg.confirmable = atoi(argv[i + 1]) == 0;
+        else if (!strcmp(argv[i], "--keep-link")) cfg.keep_link = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--fps")) fps = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    if (at_cmd(2000, "E0") != AtResult::OK)
+    {
+        fprintf(stderr, "no modem on %s\n", tty.c_str());
+        return 1;
+    }
+    if (!alert_init(cfg)) return 1;
+
+    std::thread uploader;
+    if (!dir.empty())
+    {
+        UpConfig uc = uploader_default_config();
+        uc.az.endpoint = "http://127.0.0.1:10000/devstoreaccount1";
+        uc.az.container = "frames";
+        uc.az.sas = "";
+        uc.apn = "";
+        uc.retry_ms = 200;
+        uc.thumb_first = false;
+        uc.request_poll_ms = 0;
+        SdStoreConfig sc = sdstore_default_config();
+        sc.mode = SdStorageMode::SEGMENT;   // as in the README numbers
+        sc.write_behind = false;
+        sc.log_frames = false;
+        sc.stats_every = 0;
+        sc.total_bytes = 1ULL << 40;
+        if (!sdstore_init(dir.c_str(), sc) || !uploader_init(dir.c_str(), uc)) return 1;
+        sdstore_set_time_valid(true);
+        g_uploading = true;
+        uploader = std::thread(run_uploader);
+    }
+
+    g_t0 = now_s();
+    std::thread sender(run_sender);
+
+    // Trace: Apis now and then; velutina visits at 10 % (20 s) and 55 % (10 s)
+    srand(seed);
+    uint32_t frames = (uint32_t)(fps * secs), velutina = 0;
+    uint32_t v1 = frames / 10, v1_end = v1 + (uint32_t)(20 * fps);
+    uint32_t v2 = frames * 55 / 100, v2_end = v2 + (uint32_t)(10 * fps);
+    double next = g_t0;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = i + 1;
+        bool visit = (i >= v1 && i < v1_end) || (i >= v2 && i < v2_end);
+        if (visit && rand() % 10 < 6)
+        {
+            m.boxes[m.box_count++] = FrameBox{ 3, (uint8_t)(62 + rand() % 34),
+                                               (uint16_t)(200 + rand() % 40), (uint16_t)(140 + rand() % 30), 52, 38 };
+            if (m.boxes[0].score >= cfg.min_score) velutina++;
+        }
+        if (rand() % 10 < 3)
+            m.boxes[m.box_count++] = FrameBox{ 0, (uint8_t)(50 + rand() % 45),
+                                               (uint16_t)(rand() % 400), (uint16_t)(rand() % 400), 40, 36 };
+        alert_add(i + 1, &m);
+
+        next += 1.0 / fps;
+        double wait = next - now_s();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+    }
+
+    // Let the last pending alert out (gap / token permitting), then stop
+    double drain_until = now_s() + (cfg.gap_ms + cfg.refill_ms) / 1000.0;
+    while (now_s() < drain_until && alert_stats().alerts + alert_stats().coalesced < alert_stats().detections)
+        usleep(100000);
+    g_capturing = false;
+    sender.join();
+    bool was_uploading = g_uploading;
+    g_uploading = false;
+    if (uploader.joinable()) uploader.join();
+
+    const AlertStats &s = alert_stats();
+    alert_log_stats();
+    printf("\n%s: %.0f s, %u frames, %u velutina detections >= %u%%\n",
+           dir.empty() ? "idle link" : "busy uploader", now_s() - g_t0, frames, velutina, cfg.min_score);
+    for (const Sent &a : g_sent)
+        printf("  alert at %5.1f s, sent %5u ms after it was allowed out\n", a.at_s, a.latency_ms);
+    printf("alerts: %u sent, %u detections coalesced, %u rate limited, %u retransmits, %u failures\n",
+           s.alerts, s.coalesced, s.rate_limited, s.retransmits, s.failures);
+    if (!dir.empty())
+        printf("uploader meanwhile: %u frames, %.1f KB%s\n", uploader_stats().frames,
+               uploader_stats().bytes / 1024.0, was_uploading ? " (still busy at the end)" : "");
+
+    bool ok = s.alerts > 0 && s.detections == velutina && s.alerts + s.coalesced == s.detections;
+    printf("%s\n", ok ? "OK: every velutina detection went out in an alert" : "FAIL: detections not alerted");
+    return ok ? 0 : 1;
+}
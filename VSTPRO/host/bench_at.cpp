@@ -0,0 +1,651 @@
+// bench_at.cpp — AT engine (modem_at.cpp) against scripted modem transcripts
+//
+// No emulator, no pty: a fake AtPort plays the modem side of a transcript
+// and checks every byte the engine writes against it. Each case drives
+// the engine through its public API and checks what comes back:
+// response lines, echo, errors, URCs inside and outside commands,
+// timeouts, pipelined commands, the '>' data phase, a binary payload right
+// behind OK, and the modem bring-up (modemlink.cpp) with the registration
+// and network time URCs.
+//
+//   ./bench_at                       # all cases, then the pipelining timing
+//   ./bench_at --script boot.at      # a captured bring-up through modemlink
+//
+// Transcript lines:
+//   > +CEREG?          the engine must write "AT+CEREG?\r" next (">" alone: "AT\r")
+//   < +CEREG: 0,1      the modem sends "\r\n+CEREG: 0,1\r\n"
+//   << > \r\n          the modem sends raw bytes (\r \n \\ escapes)
+//   >> hello           the engine must write these raw bytes
+//   = 300              the modem pauses 300 ms
+//   # comment
+//
+// The timing part models a 115200 baud UART and a modem that takes a few
+// ms per command, and times a batch of AT+SHAHEAD at pipeline depths 1..8.
+// ./run.sh at runs it.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "modem_at.h"
+#include "modemlink.h"
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* =========================================================
+   SCRIPTED PORT
+   ========================================================= */
+struct Step
+{
+    char        kind;       // '>' command, ')' raw write, '<' line, '~' raw read, '=' pause
+    std::string text;
+    int         line;
+};
+
+static std::vector<Step> g_steps;
+static size_t      g_pos = 0;
+static std::string g_out;           // modem -> engine, not read yet
+static std::string g_written;       // engine -> modem, not matched yet
+static double      g_hold = 0;
+static std::string g_why;           // first failure
+
+static void fail(const char *fmt, ...)
+{
+    if (!g_why.empty()) return;
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    g_why = buf;
+}
+
+static std::string unescape(const std::string &s)
+{
+    std::string o;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] != '\\' || i + 1 == s.size()) { o += s[i]; continue; }
+        char c = s[++i];
+        o += c == 'r' ? '\r' : c == 'n' ? '\n' : c;
+    }
+    return o;
+}
+
+static std::string printable(const std::string &s)
+{
+    std::string o;
+    for (char c : s)
+        o += c == '\r' ? std::string("\\r") : c == '\n' ? std::string("\\n") : std::string(1, c);
+    return o;
+}
+
+static bool load(const std::string &text)
+{
+    g_steps.clear();
+    std::istringstream in(text);
+    std::string l;
+    int n = 0;
+    while (std::getline(in, l))
+    {
+        n++;
+        size_t b = l.find_first_not_of(" \t");
+        if (b == std::string::npos || l[b] == '#') continue;
+        l = l.substr(b);
+        if (!l.compare(0, 3, ">> ")) g_steps.push_back({ ')', unescape(l.substr(3)), n });
+        else if (!l.compare(0, 3, "<< ")) g_steps.push_back({ '~', unescape(l.substr(3)), n });
+        else if (!l.compare(0, 2, "> ") || l == ">") g_steps.push_back({ '>', l.size() > 2 ? l.substr(2) : "", n });
+        else if (!l.compare(0, 2, "< ")) g_steps.push_back({ '<', l.substr(2), n });
+        else if (!l.compare(0, 2, "= ")) g_steps.push_back({ '=', l.substr(2), n });
+        else
+        {
+            fprintf(stderr, "transcript line %d: cannot parse '%s'\n", n, l.c_str());
+            return false;
+        }
+    }
+    g_pos = 0;
+    g_out.clear();
+    g_written.clear();
+    g_hold = 0;
+    g_why.clear();
+    return true;
+}
+
+// Plays the modem side as far as the engine's writes allow
+static void advance()
+{
+    while (g_why.empty() && g_pos < g_steps.size())
+    {
+        const Step &s = g_steps[g_pos];
+        if (s.kind == '>' || s.kind == ')')
+        {
+            std::string want = s.kind == '>' ? "AT" + s.text + "\r" : s.text;
+            if (s.kind == '>' && !s.text.compare(0, 2, "AT")) want = s.text + "\r";
+            size_t n = g_written.size() < want.size() ? g_written.size() : want.size();
+            if (g_written.compare(0, n, want, 0, n) != 0)
+                fail("line %d: engine wrote '%s', transcript expects '%s'", s.line,
+                     printable(g_written).c_str(), printable(want).c_str());
+            if (n < want.size()) return;
+            g_written.erase(0, want.size());
+            g_pos++;
+            continue;
+        }
+        if (s.kind == '=')
+        {
+            if (!g_hold) g_hold = now_ms() + atof(s.text.c_str());
+            if (now_ms() < g_hold) return;
+            g_hold = 0;
+            g_pos++;
+            continue;
+        }
+        g_out += s.kind == '<' ? "\r\n" + s.text + "\r\n" : s.text;
+        g_pos++;
+    }
+    if (g_pos == g_steps.size() && !g_written.empty())
+        fail("engine wrote '%s' after the end of the transcript", printable(g_written).c_str());
+}
+
+static int script_read(uint8_t *buf, size_t n)
+{
+    advance();
+    size_t k = g_out.size() < n ? g_out.size() : n;
+    memcpy(buf, g_out.data(), k);
+    g_out.erase(0, k);
+    return (int)k;
+}
+
+static int script_write(const uint8_t *buf, size_t n)
+{
+    g_written.append((const char*)buf, n);
+    advance();
+    return (int)n;
+}
+
+/* =========================================================
+   CASES
+   ========================================================= */
+#define CHECK(c) do { if (!(c)) { fail("%s (bench_at.cpp:%d)", #c, __LINE__); return false; } } while (0)
+
+static std::vector<std::string> g_urcs;
+static void on_urc(const char *line, void *)
+{
+    g_urcs.push_back(line);
+}
+
+struct Done
+{
+    std::vector<AtResult> results;
+    std::vector<std::string> lines;
+};
+static void on_done(AtResult r, const char *lines, void *ctx)
+{
+    Done *d = (Done*)ctx;
+    d->results.push_back(r);
+    d->lines.push_back(lines);
+}
+
+static bool service_until(size_t n, const std::vector<std::string> &v, double ms)
+{
+    double t0 = now_ms();
+    while (v.size() < n && now_ms() - t0 < ms)
+    {
+        at_service();
+        usleep(1000);
+    }
+    return v.size() >= n;
+}
+
+static const char *T_LINES = R"(
+> +CNACT?
+< +CNACT: 0,1,"10.0.0.2"
+< +CNACT: 1,0,"0.0.0.0"
+< OK
+)";
+static bool c_lines()
+{
+    char v[48];
+    CHECK(at_cmd(1000, "+CNACT?") == AtResult::OK);
+    CHECK(at_find("+CNACT: 0,", v, sizeof(v)) && !strcmp(v, "1,\"10.0.0.2\""));
+    CHECK(at_find("+CNACT: 1,", v, sizeof(v)) && v[0] == '0');
+    CHECK(!at_find("+CGATT: ", v, sizeof(v)));
+    return true;
+}
+
+static const char *T_ECHO = R"(
+> +CEREG?
+< AT+CEREG?
+< +CEREG: 0,2
+< OK
+> +CSQ=9
+< AT+CSQ=9
+< +CME ERROR: 50
+> +CMGS=1
+< ERROR
+)";
+static bool c_echo_errors()
+{
+    char v[16];
+    CHECK(at_cmd(1000, "+CEREG?") == AtResult::OK);
+    CHECK(at_find("+CEREG: ", v, sizeof(v)) && !strcmp(v, "0,2"));
+    CHECK(!strstr(at_lines(), "AT+CEREG?"));
+    CHECK(at_cmd(1000, "+CSQ=9") == AtResult::ERROR);
+    CHECK(at_cmd(1000, "+CMGS=1") == AtResult::ERROR);
+    CHECK(at_stats().errors == 2);
+    return true;
+}
+
+// A message arrives in the middle of an answer; a handler for the
+// answer's own name must not see the query response
+static const char *T_URC_IN_CMD = R"(
+> +CCLK?
+< +SMSUB: "vst-0001/cmd","full 20260601/120455_001042"
+< +CCLK: "26/06/01,12:30:05+08"
+< +APP PDP: 0,ACTIVE
+< OK
+)";
+static bool c_urc_in_cmd()
+{
+    at_on_urc("+SMSUB: ", on_urc, nullptr);
+    at_on_urc("+CCLK: ", on_urc, nullptr);
+    char v[48];
+    CHECK(at_cmd(1000, "+CCLK?") == AtResult::OK);
+    CHECK(g_urcs.size() == 1 && g_urcs[0] == "+SMSUB: \"vst-0001/cmd\",\"full 20260601/120455_001042\"");
+    CHECK(at_find("+CCLK: ", v, sizeof(v)));
+    // Not handled, not the answer: kept for a later wait
+    CHECK(at_wait_line("+APP PDP: 0,", v, sizeof(v), 10) && !strcmp(v, "ACTIVE"));
+    return true;
+}
+
+// Held messages during AT+SMSUB= are messages, not its answer
+static const char *T_URC_SET = R"(
+> +SMSUB="vst-0001/cmd",1
+< +SMSUB: "vst-0001/cmd","held while away"
+< OK
+)";
+static bool c_urc_set()
+{
+    at_on_urc("+SMSUB: ", on_urc, nullptr);
+    CHECK(at_cmd(1000, "+SMSUB=\"vst-0001/cmd\",1") == AtResult::OK);
+    CHECK(g_urcs.size() == 1 && strstr(g_urcs[0].c_str(), "held while away"));
+    return true;
+}
+
+static const char *T_URC_IDLE = R"(
+= 50
+< +CEREG: 5,"1A2B","01A2D101",7
+< *PSUTTZ: 2026,6,1,4,30,5,"+32",0
+< RDY
+> +CEREG?
+< +CEREG: 1,5
+< OK
+)";
+static bool c_urc_idle()
+{
+    at_on_urc("+CEREG: ", on_urc, nullptr);
+    at_on_urc("*PSUTTZ: ", on_urc, nullptr);
+    CHECK(service_until(2, g_urcs, 500));
+    CHECK(g_urcs[0] == "+CEREG: 5,\"1A2B\",\"01A2D101\",7" && !strncmp(g_urcs[1].c_str(), "*PSUTTZ: 2026", 13));
+    CHECK(at_cmd(1000, "+CEREG?") == AtResult::OK);
+    CHECK(g_urcs.size() == 2);
+    CHECK(at_stats().urcs == 2);
+    return true;
+}
+
+static const char *T_TIMEOUT = R"(
+> +CGATT?
+>
+< OK
+)";
+static bool c_timeout()
+{
+    double t0 = now_ms();
+    CHECK(at_cmd(300, "+CGATT?") == AtResult::TIMEOUT);
+    double ms = now_ms() - t0;
+    CHECK(ms >= 295 && ms < 400);
+    CHECK(at_cmd(300, "") == AtResult::OK);
+    CHECK(at_stats().timeouts == 1);
+    return true;
+}
+
+// Three commands written before the first answer
+static const char *T_PIPE = R"(
+> +SHCONF="URL","http://10.0.0.1:10000"
+> +SHCONF="BODYLEN",4096
+> +SHCONF="HEADERLEN",350
+< OK
+< +CME ERROR: 3
+< OK
+)";
+static bool c_pipeline()
+{
+    at_pipeline(3);
+    Done d;
+    CHECK(at_submit(1000, on_done, &d, "+SHCONF=\"URL\",\"%s\"", "http://10.0.0.1:10000"));
+    CHECK(at_submit(1000, on_done, &d, "+SHCONF=\"BODYLEN\",%u", 4096u));
+    CHECK(at_submit(1000, on_done, &d, "+SHCONF=\"HEADERLEN\",%u", 350u));
+    CHECK(at_pending() == 3);
+    double t0 = now_ms();
+    while (d.results.size() < 3 && now_ms() - t0 < 1000)
+    {
+        at_service();
+        usleep(1000);
+    }
+    CHECK(d.results.size() == 3);
+    CHECK(d.results[0] == AtResult::OK && d.results[1] == AtResult::ERROR && d.results[2] == AtResult::OK);
+    CHECK(at_stats().pipelined == 2 && at_pending() == 0);
+    return true;
+}
+
+// The same batch one at a time: the transcript fails if the engine writes
+// ahead
+static const char *T_BATCH = R"(
+> +SHCHEAD
+< OK
+> +SHAHEAD="x-ms-blob-type","BlockBlob"
+< OK
+> +SHAHEAD="x-ms-version","2021-08-06"
+< ERROR
+)";
+static bool c_batch()
+{
+    at_batch_begin();
+    at_batch_add(1000, "+SHCHEAD");
+    at_batch_add(1000, "+SHAHEAD=\"%s\",\"%s\"", "x-ms-blob-type", "BlockBlob");
+    at_batch_add(1000, "+SHAHEAD=\"%s\",\"%s\"", "x-ms-version", "2021-08-06");
+    CHECK(at_batch_wait() == AtResult::ERROR);
+    CHECK(at_stats().commands == 3 && at_stats().pipelined == 0);
+    return true;
+}
+
+// A timeout with two in flight fails both: the late answers cannot be
+// matched any more
+static const char *T_PIPE_TIMEOUT = R"(
+> +CNACT=0,1
+> +CNACT?
+)";
+static bool c_pipeline_timeout()
+{
+    at_pipeline(2);
+    Done d;
+    CHECK(at_submit(200, on_done, &d, "+CNACT=0,1"));
+    CHECK(at_submit(200, on_done, &d, "+CNACT?"));
+    double t0 = now_ms();
+    while (d.results.size() < 2 && now_ms() - t0 < 1000)
+    {
+        at_service();
+        usleep(1000);
+    }
+    CHECK(d.results.size() == 2 && d.results[0] == AtResult::TIMEOUT && d.results[1] == AtResult::TIMEOUT);
+    CHECK(now_ms() - t0 < 300);
+    return true;
+}
+
+// Data phase; nothing else may be written between the command and its
+// payload even with pipelining on
+static const char *T_DATA = R"(
+> +SHBOD=11,10000
+<< \r\n>
+>> hello world
+< OK
+> +SHSTATE?
+< +SHSTATE: 1
+< OK
+)";
+static bool c_data_phase()
+{
+    at_pipeline(4);
+    Done d;
+    CHECK(at_send("+SHBOD=%u,10000", 11u));
+    CHECK(at_submit(1000, on_done, &d, "+SHSTATE?"));
+    CHECK(at_wait_prompt(500));
+    CHECK(at_write("hello world", 11));
+    CHECK(at_result(1000) == AtResult::OK);
+    while (d.results.empty()) { at_service(); usleep(1000); }
+    CHECK(d.results[0] == AtResult::OK && d.lines[0] == "+SHSTATE: 1\n");
+    return true;
+}
+
+// The payload of AT+SHREAD follows OK in the same burst and contains
+// "\r\nOK\r\n" itself
+static const char *T_BINARY = R"(
+> +SHREAD=0,12
+<< \r\nOK\r\n\r\n+SHREAD: 12\r\nab\r\nOK\r\nxyz!
+>
+< OK
+)";
+static bool c_binary()
+{
+    char v[16];
+    uint8_t body[12];
+    CHECK(at_cmd(1000, "+SHREAD=0,%u", 12u) == AtResult::OK);
+    CHECK(at_wait_line("+SHREAD: ", v, sizeof(v), 500) && atoi(v) == 12);
+    CHECK(at_read(body, sizeof(body), 500) && !memcmp(body, "ab\r\nOK\r\nxyz!", 12));
+    CHECK(at_cmd(1000, "") == AtResult::OK);
+    return true;
+}
+
+// Bring-up: registration from the URC, the clock right after *PSUTTZ
+static const char *T_BOOT = R"(
+>
+< OK
+> E0
+< OK
+> +CLTS=1
+< OK
+> +CTZR=1
+< OK
+> +CEREG=1
+< OK
+> +CEREG?
+< +CEREG: 1,2
+< OK
+= 300
+< +CEREG: 1
+< *PSUTTZ: 2026,6,1,4,30,5,"+32",0
+< DST: 0
+> +CCLK?
+< +CCLK: "26/06/01,12:30:05+32"
+< OK
+)";
+static uint32_t g_epoch = 0;
+static void on_time(uint32_t epoch)
+{
+    g_epoch = epoch;
+}
+
+static bool run_link(double limit_ms)
+{
+    g_epoch = 0;
+    modemlink_begin(LinkHooks{ nullptr, on_time });
+    double t0 = now_ms();
+    while (modemlink_state() != LinkState::READY && g_why.empty() && now_ms() - t0 < limit_ms)
+    {
+        uint32_t ms = modemlink_step();
+        usleep((ms ? ms : 1) * 1000);
+    }
+    return modemlink_state() == LinkState::READY;
+}
+
+static bool c_boot()
+{
+    double t0 = now_ms();
+    CHECK(run_link(3000));
+    double ms = now_ms() - t0;
+    CHECK(g_epoch == modemlink_parse_cclk("\"26/06/01,12:30:05+32\"") && g_epoch);
+    // The URC, not the next +CEREG? poll seconds later
+    const LinkStats &s = modemlink_stats();
+    CHECK(s.reg_ms >= 300 && s.reg_ms < 1000);
+    CHECK(s.time_ms - s.reg_ms < 100);
+    CHECK(s.polls == 7);
+    printf("      boot: registered %lu ms, time %lu ms, %lu commands (%.0f ms)\n", (unsigned long)s.reg_ms,
+           (unsigned long)s.time_ms, (unsigned long)s.polls, ms);
+    return true;
+}
+
+struct Case
+{
+    const char *name;
+    const char *script;
+    bool (*run)();
+};
+
+static const Case CASES[] = {
+    { "response lines",        T_LINES,        c_lines },
+    { "echo and errors",       T_ECHO,         c_echo_errors },
+    { "URC inside a command",  T_URC_IN_CMD,   c_urc_in_cmd },
+    { "URC during a set",      T_URC_SET,      c_urc_set },
+    { "URCs while idle",       T_URC_IDLE,     c_urc_idle },
+    { "timeout",               T_TIMEOUT,      c_timeout },
+    { "pipelined commands",    T_PIPE,         c_pipeline },
+    { "batch, one at a time",  T_BATCH,        c_batch },
+    { "pipeline timeout",      T_PIPE_TIMEOUT, c_pipeline_timeout },
+    { "data phase",            T_DATA,         c_data_phase },
+    { "binary after OK",       T_BINARY,       c_binary },
+    { "bring-up with URCs",    T_BOOT,         c_boot },
+};
+
+static void reset_engine()
+{
+    at_begin(AtPort{ script_read, script_write });
+    at_pipeline(1);
+    static const char *const prefixes[] = { "+SMSUB: ", "+CCLK: ", "+CEREG: ", "*PSUTTZ: ", "+CTZV: " };
+    for (const char *p : prefixes) at_on_urc(p, nullptr, nullptr);
+    g_urcs.clear();
+}
+
+static bool run_case(const char *name, const std::string &script, bool (*run)())
+{
+    if (!load(script)) return false;
+    reset_engine();
+    double t0 = now_ms();
+    bool ok = run();
+    // Let the engine drain, then the transcript must be played out
+    for (int i = 0; i < 20 && g_why.empty() && g_pos < g_steps.size(); i++)
+    {
+        at_service();
+        usleep(1000);
+    }
+    if (ok && g_why.empty() && g_pos < g_steps.size())
+        fail("transcript stopped at line %d", g_steps[g_pos].line);
+    ok = ok && g_why.empty();
+    printf("%s  %-24s %6.1f ms%s%s\n", ok ? "PASS" : "FAIL", name, now_ms() - t0,
+           ok ? "" : "  ", ok ? "" : g_why.c_str());
+    return ok;
+}
+
+/* =========================================================
+   TIMING MODEL
+   ========================================================= */
+// A UART at 115200 baud (87 us per byte each way) and a modem that
+// answers each command proc_ms after it has it, one at a time
+static double g_byte_ms = 10.0 / 115200 * 1000;
+static double g_proc_ms = 3;
+static double g_line_free = 0;      // engine -> modem line busy until
+static double g_modem_free = 0;
+static std::string g_model_cmd;
+static std::deque<std::pair<double, std::string>> g_answers;
+
+static int model_write(const uint8_t *buf, size_t n)
+{
+    double t = now_ms();
+    for (size_t i = 0; i < n; i++)
+    {
+        g_line_free = (g_line_free > t ? g_line_free : t) + g_byte_ms;
+        g_model_cmd += (char)buf[i];
+        if (buf[i] != '\r') continue;
+        double start = g_line_free > g_modem_free ? g_line_free : g_modem_free;
+        g_modem_free = start + g_proc_ms;
+        g_answers.push_back({ g_modem_free + 6 * g_byte_ms, "\r\nOK\r\n" });
+        g_model_cmd.clear();
+    }
+    return (int)n;
+}
+
+static int model_read(uint8_t *buf, size_t n)
+{
+    size_t k = 0;
+    while (!g_answers.empty() && g_answers.front().first <= now_ms() && k + 6 <= n)
+    {
+        memcpy(buf + k, g_answers.front().second.data(), 6);
+        k += 6;
+        g_answers.pop_front();
+    }
+    return (int)k;
+}
+
+static double time_batch(uint8_t depth, int n)
+{
+    at_begin(AtPort{ model_read, model_write });
+    at_pipeline(depth);
+    g_line_free = g_modem_free = 0;
+    g_answers.clear();
+    double t0 = now_ms();
+    at_batch_begin();
+    for (int i = 0; i < n; i++)
+        at_batch_add(1000, "+SHAHEAD=\"x-ms-meta-frame\",\"20260601/120455_%06d\"", i);
+    bool ok = at_batch_wait() == AtResult::OK;
+    return ok ? now_ms() - t0 : -1;
+}
+
+/* =========================================================
+   MAIN
+   ========================================================= */
+int main(int argc, char **argv)
+{
+    const char *script = nullptr;
+    int headers = 8;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--script")) script = argv[i + 1];
+        else if (!strcmp(argv[i], "--headers")) headers = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--proc-ms")) g_proc_ms = atof(argv[i + 1]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--script transcript] [--headers 8] [--proc-ms 3]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (script)
+    {
+        std::ifstream f(script);
+        if (!f)
+        {
+            fprintf(stderr, "cannot read %s\n", script);
+            return 2;
+        }
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return run_case(script, ss.str(), [] { return run_link(60000); }) ? 0 : 1;
+    }
+
+    int failed = 0;
+    for (const Case &c : CASES)
+        failed += !run_case(c.name, c.script, c.run);
+    printf("%d of %d cases passed\n", (int)(sizeof(CASES) / sizeof(CASES[0])) - failed,
+           (int)(sizeof(CASES) / sizeof(CASES[0])));
+
+    printf("\nbatch of %d AT+SHAHEAD, 115200 baud, %.0f ms per command in the modem:\n", headers, g_proc_ms);
+    double base = 0;
+    for (uint8_t depth : { 1, 2, 4, 8 })
+    {
+        double ms = time_batch(depth, headers);
+        if (depth == 1) base = ms;
+        printf("  depth %u: %6.1f ms%s\n", depth, ms,
+               depth == 1 || ms <= 0 ? "" : ("  (" + std::to_string((int)(100 - 100 * ms / base)) + "% less)").c_str());
+    }
+    return failed ? 1 : 0;
+}
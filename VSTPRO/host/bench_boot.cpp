@@ -0,0 +1,183 @@
+// bench_boot.cpp — time-to-first-frame with the modem brought up in the background
+//
+// Replays the boot of the firmware: the SD store starts without network
+// time, the modem state machine (modemlink.cpp) runs on its own thread
+// against tools/sim7080_emu.py, and frames are stored at --fps from the
+// first moment. The emulator's --reg-delay plays poor coverage.
+//
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --reg-delay 8 &
+//   ./bench_boot --dir /tmp/vst_boot --secs 15            # capture at once
+//   ./bench_boot --dir /tmp/vst_boot2 --secs 15 --blocking 1  # old boot order
+//
+// Reports time-to-first-frame, when the link reached AT / registration /
+// time, and checks that every frame saved before the time arrived was
+// re-dated: NOTIME.VIX / NOTIME.CSV must be empty afterwards and the day
+// files must hold all frames, the earliest one stamped within a couple of
+// seconds of the real time it was captured. ./run.sh boot runs both orders.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "corpus.h"
+#include "frameindex.h"
+#include "modemlink.h"
+#include "sdstore.h"
+
+static std::atomic<bool> g_synced{false};
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// The host clock is already right; the store only needs to learn that it
+// is from now on (the firmware calls settimeofday() first).
+static void on_time(uint32_t epoch)
+{
+    printf("network time %lu (host %ld)\n", (unsigned long)epoch, (long)time(nullptr));
+    sdstore_set_time_valid(true);
+    g_synced = true;
+}
+
+static void run_link()
+{
+    while (modemlink_state() != LinkState::READY)
+    {
+        uint32_t ms = modemlink_step();
+        usleep((ms ? ms : 1) * 1000);
+    }
+}
+
+static uint32_t count_lines(const std::string &path)
+{
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return 0;
+    uint32_t n = 0;
+    for (int c; (c = fgetc(f)) != EOF; ) n += c == '\n';
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_boot";
+    std::string tty = "/tmp/vst_modem";
+    std::string images = "../../images";
+    double fps = 10, secs = 15;
+    bool blocking = false, per_file = false, write_behind = true;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--fps")) fps = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--blocking")) blocking = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--per-file")) per_file = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--write-behind")) write_behind = atoi(argv[i + 1]) != 0;
+    }
+
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    if (corpus.empty())
+    {
+        fprintf(stderr, "no JPEGs under %s\n", images.c_str());
+        return 1;
+    }
+
+    double t0 = now_s();
+    time_t wall_first = 0;
+
+    mkdir(dir.c_str(), 0775);
+    SdStoreConfig sc = sdstore_default_config();
+    sc.mode = per_file ? SdStorageMode::PER_FILE : SdStorageMode::SEGMENT;
+    sc.write_behind = write_behind;
+    sc.log_frames = false;
+    sc.stats_every = 0;
+    sc.total_bytes = 1ULL << 40;
+    if (!sdstore_init(dir.c_str(), sc)) return 1;
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    modemlink_begin(LinkHooks{ nullptr, on_time });
+
+    // Old boot order: nothing is captured before the network time
+    std::thread link;
+    if (blocking) run_link();
+    else link = std::thread(run_link);
+
+    double first = -1;
+    uint32_t frames = 0, presync = 0;
+    double next = now_s();
+    while (now_s() - t0 < secs)
+    {
+        const Jpeg &j = corpus[frames % corpus.size()];
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = frames + 1;
+        m.box_count = frames % 2;
+        m.boxes[0] = FrameBox{ 1, 88, 120, 90, 40, 40 };
+        bool synced = g_synced;
+        if (sdstore_save(frames + 1, j.data.data(), j.data.size(), &m))
+        {
+            if (first < 0)
+            {
+                first = now_s() - t0;
+                wall_first = time(nullptr);
+            }
+            presync += !synced;
+        }
+        frames++;
+
+        next += 1.0 / fps;
+        double wait = next - now_s();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+    }
+
+    if (link.joinable()) link.join();
+    sdstore_close();
+
+    const LinkStats &ls = modemlink_stats();
+    printf("\n%s boot: time-to-first-frame %.0f ms\n", blocking ? "blocking" : "async", first * 1000);
+    printf("modem: AT %lu ms, registered %lu ms, time %lu ms, %lu polls\n",
+           (unsigned long)ls.at_ms, (unsigned long)ls.reg_ms, (unsigned long)ls.time_ms,
+           (unsigned long)ls.polls);
+    printf("frames: %u stored, %u before network time\n", frames, presync);
+
+    // Re-dating check: nothing left in NOTIME, everything dated
+    frameindex_init(dir.c_str(), 1);
+    uint32_t notime = frameindex_count(-1), dated = 0, earliest = UINT32_MAX;
+    for (int32_t d = frameindex_first_day(); d >= 0 && d <= frameindex_last_day(); d++)
+    {
+        uint32_t n = frameindex_count(d);
+        dated += n;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            IdxRecord r;
+            if (frameindex_read(d, i, r) && r.epoch < earliest) earliest = r.epoch;
+        }
+    }
+    uint32_t csv_notime = count_lines(dir + "/meta/NOTIME.CSV");
+    printf("index: %u dated, %u NOTIME; csv NOTIME lines %u; earliest frame %+ld s off\n",
+           dated, notime, csv_notime > 0 ? csv_notime - 1 : 0,
+           earliest == UINT32_MAX ? 0L : (long)earliest - (long)wall_first);
+
+    bool ok = notime == 0 && dated == frames && csv_notime <= 1 &&
+              earliest != UINT32_MAX && labs((long)earliest - (long)wall_first) <= 2;
+    printf("%s\n", ok ? "OK: all frames dated" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// bench_index.cpp — frame index query cost vs directory listing
+//
+// Writes --days of simulated frames (one every --interval seconds, ~2 %
+// with a class-1 detection) through frameindex.cpp, then answers
+// "all class 1 detections in the last 24 h" twice:
+//
+//   INDEX : frameindex_query() (binary search + range scan)
+//   LIST  : what the firmware had to do before — walk the per-file tree and
+//           open every JPEG in range (here: stat + open/read 64 B)
+//
+//   ./bench_index --dir /mnt/fat --days 7 --interval 10
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frameindex.h"
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool count_hit(const IdxRecord &, void *ctx)
+{
+    (*(uint32_t*)ctx)++;
+    return true;
+}
+
+// Per-file equivalent: one tiny file per frame, name carries the epoch,
+// detections are only visible by opening the file.
+static void write_files(const std::string &dir, uint32_t t0, uint32_t frames, uint32_t interval)
+{
+    mkdir(dir.c_str(), 0775);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%u_%06u.jpg", dir.c_str(), t0 + i * interval, i + 1);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+        if (fd < 0) return;
+        uint8_t b[64] = {0};
+        b[0] = (i % 50 == 0) ? 1 : 0;
+        (void)!write(fd, b, sizeof(b));
+        close(fd);
+    }
+}
+
+static uint32_t list_query(const std::string &dir, uint32_t from, uint32_t to)
+{
+    uint32_t hits = 0;
+    DIR *d = opendir(dir.c_str());
+    if (!d) return 0;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr)
+    {
+        unsigned long t = 0;
+        if (sscanf(e->d_name, "%lu_", &t) != 1 || t < from || t > to) continue;
+
+        std::string p = dir + "/" + e->d_name;
+        int fd = open(p.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        uint8_t b[64];
+        if (read(fd, b, sizeof(b)) > 0 && b[0] == 1) hits++;
+        close(fd);
+    }
+    closedir(d);
+    return hits;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_index";
+    uint32_t days = 7;
+    uint32_t interval = 10;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--days")) days = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--interval")) interval = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    mkdir(dir.c_str(), 0775);
+    if (!frameindex_init(dir.c_str(), 8)) return 1;
+
+    const uint32_t t0 = 1780272000; // 2026-06-01 00:00:00 UTC
+    uint32_t frames = days * 86400 / interval;
+
+    double a = now_ms();
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = i + 1;
+        if (i % 50 == 0)
+        {
+            m.box_count = 1;
+            m.boxes[0] = FrameBox{ 1, 87, 120, 96, 40, 38 };
+        }
+        SegLocation loc{ 1 + i / 1000, 32 + (i % 1000) * 200000, 200000, SEG_STREAM_DETECT };
+        frameindex_append(frameindex_make(i + 1, t0 + i * interval, &loc, 199000, &m));
+    }
+    frameindex_flush();
+    double build_ms = now_ms() - a;
+    printf("index: %u frames over %u days in %.1f ms (%.2f us/frame)\n",
+           frames, days, build_ms, build_ms * 1000.0 / frames);
+
+    uint32_t to = t0 + days * 86400 - 1;
+    uint32_t from = to - 86400 + 1;
+
+    IdxQuery q{ from, to, 1, 50, 0 };
+    uint32_t hits = 0;
+    a = now_ms();
+    frameindex_query(q, count_hit, &hits);
+    double idx_ms = now_ms() - a;
+    printf("INDEX  last 24 h class 1: %u hits in %.2f ms (%u reads)\n",
+           hits, idx_ms, (unsigned)frameindex_stats().reads);
+
+    std::string files = dir + "/files";
+    write_files(files, t0, frames, interval);
+    a = now_ms();
+    uint32_t list_hits = list_query(files, from, to);
+    double list_ms = now_ms() - a;
+    printf("LIST   last 24 h class 1: %u hits in %.2f ms (%u files in directory)\n",
+           list_hits, list_ms, frames);
+    return 0;
+}
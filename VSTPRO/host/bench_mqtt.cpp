@@ -0,0 +1,242 @@
+// bench_mqtt.cpp — wake cycles of detection metadata and thumbnails over
+// HTTP (one connection per cycle) vs the MQTT session (mqttlink.cpp)
+//
+// Each wake cycle brings the bearer up, sends --meta metadata messages
+// (one detection record each, VTB1 like telemetry.h) and --thumbs small
+// JPEG thumbnails made from the corpus (jpegthumb.h), and takes the bearer
+// down again:
+//
+//   --mode http            SHCONN once per cycle, one Put Blob per message
+//   --mode mqtt --window 1 one MQTT session per cycle, each message confirmed
+//   --mode mqtt            the same, QoS1 messages pipelined (--window 8)
+//
+// against tools/sim7080_emu.py (--pdp-ms, --latency-ms, --connect-ms for
+// bearer, round trip and TCP/TLS setup) with tools/blob_standin.py and
+// tools/mqtt_standin.py (or Mosquitto) behind it:
+//
+//   python3 tools/mqtt_standin.py --log /tmp/vst_mqtt.jsonl &
+//   python3 tools/blob_standin.py &
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --pdp-ms 1500 --latency-ms 300 --connect-ms 900 &
+//   ./bench_mqtt --mode http
+//   ./bench_mqtt --mode mqtt
+//
+// Reports time per cycle (bearer up -> down, what the radio is on for),
+// modem UART bytes per message, and any commands that arrived on
+// <device>/cmd: with the persistent session, a command published while the
+// node was away (python3 tools/mqtt_standin.py pub ...) arrives on the next
+// cycle. ./run.sh mqtt runs the three modes and that command.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "azblob.h"
+#include "corpus.h"
+#include "jpegthumb.h"
+#include "modem_at.h"
+#include "mqttlink.h"
+#include "simhttp.h"
+#include "simnet.h"
+#include "telemetry.h"
+
+static std::vector<std::string> g_commands;
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Mem
+{
+    const std::vector<uint8_t> *src;
+    size_t off;
+};
+
+static size_t mem_read(void *ctx, uint8_t *buf, size_t len)
+{
+    Mem *m = (Mem*)ctx;
+    size_t n = m->src->size() - m->off < len ? m->src->size() - m->off : len;
+    memcpy(buf, m->src->data() + m->off, n);
+    m->off += n;
+    return n;
+}
+
+static void on_command(const char *topic, const char *payload)
+{
+    g_commands.push_back(std::string(topic) + " '" + payload + "'");
+}
+
+int main(int argc, char **argv)
+{
+    std::string tty = "/tmp/vst_modem", images = "../../images", mode = "mqtt";
+    std::string device = "vst-0001";
+    MqttConfig mc = mqtt_default_config();
+    mc.host = "127.0.0.1";
+    mc.apn = "";
+    mc.window = 8;
+    AzConfig az{ "http://127.0.0.1:10000/devstoreaccount1", "frames", "" };
+    uint32_t cycles = 4, metas = 10, thumbs = 3;
+    double wait_s = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--mode")) mode = argv[i + 1];
+        else if (!strcmp(argv[i], "--device")) device = argv[i + 1];
+        else if (!strcmp(argv[i], "--host")) mc.host = argv[i + 1];
+        else if (!strcmp(argv[i], "--port")) mc.port = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--window")) mc.window = (uint8_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--endpoint")) az.endpoint = argv[i + 1];
+        else if (!strcmp(argv[i], "--cycles")) cycles = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--meta")) metas = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--thumbs")) thumbs = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--wait-s")) wait_s = atof(argv[i + 1]);
+    }
+    mc.client_id = device.c_str();
+    bool http = mode == "http";
+
+    // Thumbnails from the corpus, made the way the uploader makes them
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    std::vector<std::vector<uint8_t>> thumb;
+    for (size_t i = 0; i < corpus.size() && thumb.size() < thumbs * cycles; i++)
+    {
+        std::vector<uint8_t> out(4096);
+        size_t n = 0;
+        Mem m{ &corpus[i].data, 0 };
+        if (!jpegthumb_make(ThumbReader{ mem_read, &m }, 128, 60, out.data(), out.size(), &n, nullptr)) continue;
+        out.resize(n);
+        thumb.push_back(out);
+    }
+    if (thumbs && thumb.empty())
+    {
+        fprintf(stderr, "no thumbnails from %s\n", images.c_str());
+        return 1;
+    }
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    if (at_cmd(2000, "E0") != AtResult::OK)
+    {
+        fprintf(stderr, "no modem on %s\n", tty.c_str());
+        return 1;
+    }
+    if (http ? !azblob_begin(az) : !mqtt_init(mc)) return 1;
+    mqtt_on_message(on_command);
+
+    uint32_t messages = 0, failed = 0, tn = 0;
+    uint64_t payload = 0;
+    double busy_s = 0;
+    const AtStats &as = at_stats();
+    uint64_t wire0 = as.tx_bytes + as.rx_bytes;
+    bool container_ok = false;
+
+    for (uint32_t c = 0; c < cycles; c++)
+    {
+        double t0 = now_s();
+        std::vector<uint32_t> seqs;
+        if (http)
+        {
+            if (!simnet_up("", 60000) || !azblob_connect()) { failed += metas + thumbs; continue; }
+            if (!container_ok) container_ok = azblob_ensure_container();
+        }
+        else if (!mqtt_open())
+        {
+            failed += metas + thumbs;
+            continue;
+        }
+        else if (wait_s > 0)
+        {
+            // Commands queued by the broker come in right after SMCONN
+            double until = now_s() + wait_s;
+            while (now_s() < until) mqtt_service();
+        }
+
+        for (uint32_t i = 0; i < metas + thumbs; i++)
+        {
+            char topic[MQTT_TOPIC_MAX];
+            uint8_t rec[128];
+            const uint8_t *data = rec;
+            size_t len;
+            if (i < metas)
+            {
+                TelemRecord r{};
+                r.frame_id = c * 1000 + i + 1;
+                r.mono_ms = 0;
+                r.box_count = 1;
+                r.boxes[0] = FrameBox{ (uint8_t)(i % 3 ? 0 : 3), (uint8_t)(60 + i % 40), 210, 150, 52, 38 };
+                uint32_t n = 0;
+                len = telemetry_encode(&r, 1, 1, 1780000000u + c * 3600, 0, rec, sizeof(rec), &n);
+                snprintf(topic, sizeof(topic), "%s/meta/%02u/%06u.vtb", device.c_str(), c, i);
+            }
+            else
+            {
+                const std::vector<uint8_t> &t = thumb[tn++ % thumb.size()];
+                data = t.data();
+                len = t.size();
+                snprintf(topic, sizeof(topic), "%s/thumb/%02u/%06u_t.jpg", device.c_str(), c, i);
+            }
+
+            if (http)
+            {
+                if (azblob_put_blob(topic, data, len, "application/octet-stream") == 201)
+                {
+                    messages++;
+                    payload += len;
+                }
+                else failed++;
+            }
+            else
+            {
+                uint32_t seq = mqtt_publish(topic, data, len);
+                if (seq) seqs.push_back(seq);
+                else failed++;
+                payload += len;
+            }
+        }
+
+        if (http)
+        {
+            simhttp_disconnect();
+            simnet_down();
+        }
+        else
+        {
+            mqtt_close();
+            for (uint32_t s : seqs)
+            {
+                if (mqtt_delivery(s) == MqttDelivery::CONFIRMED) messages++;
+                else failed++;
+            }
+        }
+        double secs = now_s() - t0;
+        busy_s += secs;
+        printf("  cycle %u: %.2f s bearer up\n", c + 1, secs);
+    }
+
+    uint64_t wire = as.tx_bytes + as.rx_bytes - wire0;
+    if (!http) mqtt_log_stats();
+    uint32_t total = (metas + thumbs) * cycles;
+    printf("%s%s: %u cycles of %u metadata + %u thumbnails: %.2f s per cycle, %.0f ms per message, "
+           "%.1f KB payload, modem %.0f B per message, %u confirmed, %u failed\n",
+           http ? "http" : "mqtt", http ? "" : (mc.window > 1 ? " pipelined" : " window 1"),
+           cycles, metas, thumbs, busy_s / cycles, busy_s * 1000.0 / total, payload / 1024.0,
+           (double)wire / total, messages, failed);
+    if (!http)
+    {
+        const MqttStats &s = mqtt_stats();
+        printf("mqtt: %u connects, avg %u ms, %u parts, %u flushes\n", s.connects,
+               s.connects ? s.connect_ms / s.connects : 0, s.parts, s.flushes);
+    }
+    for (const std::string &c : g_commands) printf("command: %s\n", c.c_str());
+    return failed ? 1 : 0;
+}
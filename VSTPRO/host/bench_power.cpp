@@ -0,0 +1,355 @@
+// bench_power.cpp — modem energy per uploaded byte, always awake vs the
+// power manager (modempower.cpp)
+//
+// Plays a day / night detection trace: during the first --day-s seconds a
+// detection every few frames queues a thumbnail (made from the corpus like
+// the uploader's), then nothing; alerts at --alerts seconds. A sender
+// thread plays the uplink tasks (one Put Blob per thumbnail, alerts
+// first, under at_lock() and only while power_awake()), a modem thread
+// runs power_step() the way the modem task does on the ESP32:
+//
+//   --managed 0   modem always awake, every thumbnail sent when it is queued
+//   --managed 1   PSM between wakes at --wake-kb queued, an alert or
+//                 --max-sleep-s; rails off after --rails-off-s with nothing
+//                 to send
+//
+// against tools/sim7080_emu.py, whose PSM, PWRKEY (SIGUSR1) and rails
+// (SIGUSR2) are driven through --emu-pid, and tools/blob_standin.py:
+//
+//   python3 tools/blob_standin.py &
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --pdp-ms 1500 --latency-ms 300 & EMU=$!
+//   ./bench_power --emu-pid $EMU --managed 0
+//   ./bench_power --emu-pid $EMU --managed 1
+//
+// Timers are scaled down (seconds instead of hours) so a run takes a few
+// minutes; the energy model is modempower.h's. Reports the estimated
+// energy, bytes uploaded, energy per byte, alert latency and how long
+// thumbnails waited. ./run.sh power runs both.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "azblob.h"
+#include "corpus.h"
+#include "jpegthumb.h"
+#include "modem_at.h"
+#include "modemlink.h"
+#include "modempower.h"
+#include "simhttp.h"
+#include "simnet.h"
+
+struct Item
+{
+    double   queued_s;
+    bool     alert;
+    uint32_t n;
+    const std::vector<uint8_t> *data;
+};
+
+static std::mutex g_qmux;
+static std::deque<Item> g_queue;
+static std::atomic<bool> g_capturing{true};
+static std::atomic<bool> g_running{true};
+static std::atomic<bool> g_sending{false};
+static pid_t g_emu = 0;
+static bool g_rails = true;
+static double g_t0 = 0;
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Mem
+{
+    const std::vector<uint8_t> *src;
+    size_t off;
+};
+
+static size_t mem_read(void *ctx, uint8_t *buf, size_t len)
+{
+    Mem *m = (Mem*)ctx;
+    size_t n = m->src->size() - m->off < len ? m->src->size() - m->off : len;
+    memcpy(buf, m->src->data() + m->off, n);
+    m->off += n;
+    return n;
+}
+
+/* =========================================================
+   HOOKS (modem.cpp on the ESP32)
+   ========================================================= */
+static void emu_pwrkey()
+{
+    kill(g_emu, SIGUSR1);
+    usleep(1150000);        // as pwrkey_pulse()
+}
+
+static bool emu_rails(bool on)
+{
+    if (on != g_rails) kill(g_emu, SIGUSR2);
+    g_rails = on;
+    usleep(100000);
+    return true;
+}
+
+static bool alert_pending()
+{
+    std::lock_guard<std::mutex> l(g_qmux);
+    return !g_queue.empty() && g_queue.front().alert;
+}
+
+static bool queue_idle()
+{
+    std::lock_guard<std::mutex> l(g_qmux);
+    return g_queue.empty() && !g_sending;
+}
+
+/* =========================================================
+   UPLINK (the uploader / alert tasks)
+   ========================================================= */
+struct Sent
+{
+    double wait_s;
+    bool   alert;
+};
+static std::vector<Sent> g_sent;
+static uint32_t g_failed = 0;
+static uint64_t g_payload = 0;
+
+static void run_sender(const std::string &device)
+{
+    bool container_ok = false;
+    std::vector<uint8_t> alert(48, 0xA5);
+    for (;;)
+    {
+        bool did = false;
+        at_lock();
+        if (power_awake())
+        {
+            Item it{};
+            {
+                std::lock_guard<std::mutex> l(g_qmux);
+                if (!g_queue.empty())
+                {
+                    it = g_queue.front();
+                    g_queue.pop_front();
+                    g_sending = true;
+                    did = true;
+                }
+            }
+            if (did)
+            {
+                bool ok = simhttp_connected() || (simnet_up("", 60000) && azblob_connect());
+                if (ok && !container_ok) container_ok = azblob_ensure_container();
+                char blob[64];
+                snprintf(blob, sizeof(blob), "%s/%s/%06u%s", device.c_str(), it.alert ? "alert" : "thumb",
+                         it.n, it.alert ? ".bin" : "_t.jpg");
+                const std::vector<uint8_t> &d = it.alert ? alert : *it.data;
+                if (ok && azblob_put_blob(blob, d.data(), d.size(), "application/octet-stream") == 201)
+                {
+                    g_sent.push_back(Sent{ now_s() - it.queued_s, it.alert });
+                    g_payload += d.size();
+                }
+                else
+                {
+                    // Back in line, the link comes up again on the next turn
+                    g_failed++;
+                    simhttp_disconnect();
+                    std::lock_guard<std::mutex> l(g_qmux);
+                    g_queue.push_front(it);
+                }
+                g_sending = false;
+            }
+        }
+        at_unlock();
+        if (!did)
+        {
+            if (!g_running) break;
+            usleep(100000);
+        }
+    }
+}
+
+static void run_modem()
+{
+    while (g_running)
+    {
+        uint32_t wait_ms = power_step();
+        usleep((wait_ms ? wait_ms : 1) * 1000);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string tty = "/tmp/vst_modem", images = "../../images", device = "vst-power";
+    AzConfig az{ "http://127.0.0.1:10000/devstoreaccount1", "frames", "" };
+    PowerConfig cfg = power_default_config();
+    cfg.managed = true;
+    cfg.tau_s = 120;
+    cfg.active_s = 4;
+    cfg.wake_bytes = 24 * 1024;
+    cfg.max_sleep_ms = 45000;
+    cfg.linger_ms = 2000;
+    cfg.rails_off_ms = 30000;
+    cfg.log_ms = 0;
+    double fps = 2, secs = 150, day_s = 60, every = 4;
+    std::vector<double> alerts = { 20, 120 };
+    uint32_t seed = 7;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--device")) device = argv[i + 1];
+        else if (!strcmp(argv[i], "--endpoint")) az.endpoint = argv[i + 1];
+        else if (!strcmp(argv[i], "--emu-pid")) g_emu = (pid_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--managed")) cfg.managed = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--psm")) cfg.psm = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--active-s")) cfg.active_s = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--wake-kb")) cfg.wake_bytes = (uint32_t)strtoul(argv[i + 1], nullptr, 10) * 1024;
+        else if (!strcmp(argv[i], "--max-sleep-s")) cfg.max_sleep_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--rails-off-s")) cfg.rails_off_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--linger-ms")) cfg.linger_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--fps")) fps = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--day-s")) day_s = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--every")) every = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--alerts"))
+        {
+            alerts.clear();
+            for (char *p = argv[i + 1]; *p; )
+            {
+                alerts.push_back(strtod(p, &p));
+                if (*p == ',') p++;
+                else break;
+            }
+        }
+    }
+    if (cfg.managed && !g_emu)
+    {
+        fprintf(stderr, "--managed 1 needs --emu-pid (PWRKEY / rails)\n");
+        return 1;
+    }
+
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    std::vector<std::vector<uint8_t>> thumb;
+    for (size_t i = 0; i < corpus.size() && thumb.size() < 32; i++)
+    {
+        std::vector<uint8_t> out(4096);
+        size_t n = 0;
+        Mem m{ &corpus[i].data, 0 };
+        if (!jpegthumb_make(ThumbReader{ mem_read, &m }, 128, 60, out.data(), out.size(), &n, nullptr)) continue;
+        out.resize(n);
+        thumb.push_back(out);
+    }
+    if (thumb.empty())
+    {
+        fprintf(stderr, "no thumbnails from %s\n", images.c_str());
+        return 1;
+    }
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    if (!azblob_begin(az)) return 1;
+
+    // Bring-up as the modem task does, then the power manager takes over
+    PowerHooks hooks{};
+    hooks.pwrkey = g_emu ? emu_pwrkey : nullptr;
+    hooks.rails = g_emu ? emu_rails : nullptr;
+    hooks.urgent = alert_pending;
+    hooks.uplink_idle = queue_idle;
+    modemlink_begin(LinkHooks{ hooks.pwrkey, nullptr });
+    double deadline = now_s() + 60;
+    while (modemlink_state() != LinkState::READY && now_s() < deadline)
+        usleep(modemlink_step() * 1000 + 1000);
+    if (modemlink_state() != LinkState::READY)
+    {
+        fprintf(stderr, "modem not ready on %s\n", tty.c_str());
+        return 1;
+    }
+    power_init(cfg, hooks);
+
+    g_t0 = now_s();
+    std::thread modem(run_modem);
+    std::thread sender(run_sender, device);
+
+    // Capture: detections during the day, alerts on schedule
+    srand(seed);
+    uint32_t frames = 0, detections = 0;
+    size_t next_alert = 0;
+    for (double t = 0; t < secs; t = now_s() - g_t0)
+    {
+        frames++;
+        if (t < day_s && rand() % 1000 < (int)(1000 / every))
+        {
+            const std::vector<uint8_t> &d = thumb[detections % thumb.size()];
+            {
+                std::lock_guard<std::mutex> l(g_qmux);
+                g_queue.push_back(Item{ now_s(), false, ++detections, &d });
+            }
+            power_note_queued((uint32_t)d.size());
+        }
+        if (next_alert < alerts.size() && t >= alerts[next_alert])
+        {
+            std::lock_guard<std::mutex> l(g_qmux);
+            g_queue.push_front(Item{ now_s(), true, (uint32_t)++next_alert, nullptr });
+        }
+        usleep((useconds_t)(1e6 / fps));
+    }
+    g_capturing = false;
+
+    g_running = false;
+    modem.join();
+    sender.join();
+    power_step();
+
+    size_t left;
+    {
+        std::lock_guard<std::mutex> l(g_qmux);
+        left = g_queue.size();
+    }
+    double wait_sum = 0, wait_max = 0, alert_max = 0;
+    uint32_t thumbs = 0, alerts_sent = 0;
+    for (const Sent &s : g_sent)
+    {
+        if (s.alert)
+        {
+            alerts_sent++;
+            if (s.wait_s > alert_max) alert_max = s.wait_s;
+            continue;
+        }
+        thumbs++;
+        wait_sum += s.wait_s;
+        if (s.wait_s > wait_max) wait_max = s.wait_s;
+    }
+
+    power_log_stats();
+    const PowerStats &ps = power_stats();
+    double mj = power_energy_mj();
+    printf("%s: %.0f s, %u detections, %u thumbnails + %u alerts up (%.1f KB payload, %zu left, %u retries)\n",
+           cfg.managed ? "managed" : "always awake", secs, detections, thumbs, alerts_sent,
+           g_payload / 1024.0, left, g_failed);
+    printf("%s: connected %.0f s, idle %.0f s, PSM %.0f s, off %.0f s, %u wakes, wake %u ms max\n",
+           cfg.managed ? "managed" : "always awake", ps.connected_ms / 1000.0, ps.idle_ms / 1000.0,
+           ps.psm_ms / 1000.0, ps.off_ms / 1000.0, ps.wakes, ps.wake_ms_max);
+    printf("%s: %.0f mJ, %.2f uJ per uploaded byte; thumbnail wait avg %.1f s max %.1f s, alert latency max %.1f s\n",
+           cfg.managed ? "managed" : "always awake", mj, ps.tx_bytes ? mj * 1000.0 / (double)ps.tx_bytes : 0.0,
+           thumbs ? wait_sum / thumbs : 0.0, wait_max, alert_max);
+    return 0;
+}
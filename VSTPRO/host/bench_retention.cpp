@@ -0,0 +1,164 @@
+// bench_retention.cpp — watermark eviction on a simulated small card
+//
+// Streams --frames JPEGs from the corpus into the segment store the way
+// sdcard.cpp does (every --detect-every-th frame has a detection and goes
+// to SEG_, the rest to EMP_), with retention pretending the card holds
+// --cap-mb. Prints how much of each kind survived, the worst
+// retention_service() time and checks that usage never passed the cap.
+// --per-file 1 writes one JPEG per frame into /YYYYMMDD/HH/ instead, a
+// frame every 10 s, evicts them through the frame index and checks that
+// the index lists exactly the files left on the card.
+//
+//   ./bench_retention --dir /mnt/fat --cap-mb 64 --frames 2000 [--per-file 1]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "corpus.h"
+#include "frameindex.h"
+#include "retention.h"
+#include "sdlayout.h"
+#include "segstore.h"
+
+static bool count_hit(const IdxRecord &, void *ctx)
+{
+    (*(uint32_t*)ctx)++;
+    return true;
+}
+
+static bool mark_listed(const IdxRecord &rec, void *ctx)
+{
+    std::vector<bool> &v = *(std::vector<bool>*)ctx;
+    if (rec.frame_id < v.size()) v[rec.frame_id] = true;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_retention";
+    std::string images = "../../images";
+    uint32_t cap_mb = 64;
+    uint32_t frames = 2000;
+    uint32_t detect_every = 25;
+    bool per_file = false;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--cap-mb")) cap_mb = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--frames")) frames = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--per-file")) per_file = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--detect-every")) detect_every = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    if (corpus.empty())
+    {
+        fprintf(stderr, "no JPEGs under %s\n", images.c_str());
+        return 1;
+    }
+
+    mkdir(dir.c_str(), 0775);
+    SegConfig sc{ 4UL * 1024UL * 1024UL, 3600, 8, 32768 };
+    if (!segstore_init(dir.c_str(), sc)) return 1;
+    if (!frameindex_init(dir.c_str(), 8)) return 1;
+
+    uint64_t cap = (uint64_t)cap_mb << 20;
+    RetConfig rc{ 90, 80, 1, 4096, 4, 32768, 0,
+                  per_file ? SdStorageMode::PER_FILE : SdStorageMode::SEGMENT, SdLayout::DATE_HOUR };
+    if (!retention_init(dir.c_str(), rc, cap, 0)) return 1;
+
+    const uint32_t t0 = 1780272000;
+    uint64_t peak = 0;
+    uint32_t written[SEG_STREAMS] = {0};
+    uint64_t written_bytes = 0;
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        const std::vector<uint8_t> &j = corpus[i % corpus.size()].data;
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = i + 1;
+        if (detect_every && i % detect_every == 0)
+        {
+            m.box_count = 1;
+            m.boxes[0] = FrameBox{ 1, 80, 100, 100, 40, 40 };
+        }
+
+        SegStream s = m.box_count ? SEG_STREAM_DETECT : SEG_STREAM_EMPTY;
+        if (per_file)
+        {
+            char path[160];
+            if (!sdlayout_frame_path(dir.c_str(), SdLayout::DATE_HOUR, t0 + i * 10, true, 0, i + 1,
+                                     path, sizeof(path)))
+                return 1;
+            FILE *f = fopen(path, "wb");
+            if (!f || fwrite(j.data(), 1, j.size(), f) != j.size()) return 1;
+            fclose(f);
+            frameindex_append(frameindex_make(i + 1, t0 + i * 10, nullptr, (uint32_t)j.size(), &m));
+            retention_on_write(nullptr, (uint32_t)j.size(), IDX_REC_LEN);
+        }
+        else
+        {
+            SegLocation loc{};
+            if (!segstore_append(i + 1, t0 + i, &m, j.data(), j.size(), &loc, s)) return 1;
+            frameindex_append(frameindex_make(i + 1, t0 + i, &loc, (uint32_t)j.size(), &m));
+            retention_on_write(&loc, loc.size, IDX_REC_LEN);
+        }
+        retention_service();
+
+        written[s]++;
+        written_bytes += j.size();
+        if (retention_stats().used_bytes > peak) peak = retention_stats().used_bytes;
+    }
+    segstore_close();
+    frameindex_flush();
+
+    uint32_t live_detect = 0, live_all = 0;
+    IdxQuery qd{ 0, t0 + frames * 10, 1, 0, 0 };
+    IdxQuery qa{ 0, t0 + frames * 10, -1, 0, 0 };
+    frameindex_query(qd, count_hit, &live_detect);
+    frameindex_query(qa, count_hit, &live_all);
+
+    // PER_FILE: the index must list exactly the files still on the card
+    uint32_t stale = 0, orphans = 0;
+    if (per_file)
+    {
+        std::vector<bool> listed(frames + 1, false);
+        frameindex_query(qa, mark_listed, &listed);
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            char path[160];
+            struct stat st;
+            sdlayout_frame_name(dir.c_str(), SdLayout::DATE_HOUR, t0 + i * 10, true, 0, i + 1, path, sizeof(path));
+            bool on_card = stat(path, &st) == 0;
+            if (listed[i + 1] && !on_card) stale++;
+            // The last records may still be in the index buffer
+            if (on_card && !listed[i + 1] && i + 8 < frames) orphans++;
+        }
+    }
+
+    retention_log_stats();
+    printf("written: %u detection + %u empty frames (%.1f MB) into a %u MB card\n",
+           written[SEG_STREAM_DETECT], written[SEG_STREAM_EMPTY],
+           (double)written_bytes / 1048576.0, cap_mb);
+    printf("kept   : %u / %u detection frames, %u / %u empty frames\n",
+           live_detect, written[SEG_STREAM_DETECT],
+           live_all - live_detect, written[SEG_STREAM_EMPTY]);
+    if (per_file)
+        printf("index  : %u listed frames missing on the card, %u files not listed\n", stale, orphans);
+    bool ok = peak <= cap && !stale && !orphans;
+    printf("peak usage %.1f MB (%.1f %% of card), worst service %.2f ms -> %s\n",
+           (double)peak / 1048576.0, 100.0 * peak / cap,
+           retention_stats().service_us_max / 1000.0,
+           ok ? "OK" : peak > cap ? "OVERFLOW" : "INDEX MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+// bench_shard.cpp — create latency vs file count, FLAT vs DATE_HOUR
+//
+// Creates up to --files small frames with sdlayout_frame_path() the same
+// way save_per_file() does, simulating one frame every --interval seconds,
+// and prints the mean / p99 create+write+close latency of each window of
+// 1000 files at the 1k, 2k, 5k, 10k, 20k, 50k and 100k marks.
+//
+// Run it against a FAT filesystem (SD card in a reader, or a vfat image
+// mounted via loop) — ext4/tmpfs use hashed directories and hide the
+// effect this is about.
+//
+//   ./bench_shard --dir /mnt/fat --files 100000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "sdlayout.h"
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void run(const char *label, SdLayout layout, const std::string &root,
+                size_t files, size_t bytes, uint32_t interval_s)
+{
+    static const size_t marks[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000};
+    const size_t WINDOW = 1000;
+
+    mkdir(root.c_str(), 0775);
+    sdlayout_reset();
+
+    std::vector<uint8_t> payload(bytes, 0xA5);
+    std::vector<double> window;
+    size_t mark = 0;
+
+    time_t t = 1780315200; // 2026-06-01 12:00:00 UTC
+
+    printf("%s (%zu bytes/file, one frame every %u s)\n", label, bytes, interval_s);
+
+    for (size_t i = 1; i <= files; i++, t += interval_s)
+    {
+        char path[256];
+        double a = now_ms();
+
+        if (!sdlayout_frame_path(root.c_str(), layout, t, true, 0, (uint32_t)i, path, sizeof(path)))
+            return;
+
+        FILE *fp = fopen(path, "wb");
+        if (!fp)
+        {
+            printf("  create failed at file %zu (%s) — directory full?\n", i, path);
+            return;
+        }
+        fwrite(payload.data(), 1, payload.size(), fp);
+        fclose(fp);
+
+        window.push_back(now_ms() - a);
+        if (window.size() > WINDOW)
+            window.erase(window.begin());
+
+        while (mark < sizeof(marks) / sizeof(marks[0]) && marks[mark] < i) mark++;
+        if (mark < sizeof(marks) / sizeof(marks[0]) && marks[mark] == i)
+        {
+            std::vector<double> s = window;
+            std::sort(s.begin(), s.end());
+            double sum = 0;
+            for (double v : s) sum += v;
+            printf("  %6zu files: mean=%7.3f ms  p99=%7.3f ms\n",
+                   i, sum / s.size(), s[(s.size() * 99) / 100]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_shard";
+    size_t files = 100000;
+    size_t bytes = 2048;
+    uint32_t interval = 3;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--files")) files = strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--bytes")) bytes = strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--interval")) interval = strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    // Keep file names identical to the firmware (localtime).
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    mkdir(dir.c_str(), 0775);
+    run("FLAT", SdLayout::FLAT, dir + "/flat", files, bytes, interval);
+    run("DATE_HOUR", SdLayout::DATE_HOUR, dir + "/sharded", files, bytes, interval);
+    return 0;
+}
@@ -0,0 +1,363 @@
+// bench_storage.cpp — the firmware storage path (sdstore.cpp) on Linux
+//
+// Replays the JPEG corpus (../../images) through sdstore_save(), the same
+// call sdcard_save_jpeg() makes, in four configurations:
+//
+//   PER_FILE         one file per frame (FRAME.TMP + rename), inline
+//   SEGMENT          append-only segments, inline
+//   PER_FILE+WB      per-file behind the sdwriter queue
+//   SEGMENT+WB       segments behind the sdwriter queue
+//
+// Point --dir at a FAT filesystem (./run.sh sd builds and loop-mounts an
+// image) to get numbers that mean something; on tmpfs only the CPU cost
+// shows and the device columns read N/A.
+//
+// Per mode: frames/s, payload and logical bytes per frame, device bytes
+// per frame from /sys/dev/block/<dev>/stat (write amplification = device
+// bytes / JPEG bytes, includes FAT and directory updates), and p50/p99/max
+// latency of sdstore_save(). Write-behind modes are paced at --fps like the
+// camera; their save latency is the enqueue, the task's write latency and
+// drops come from sdwriter_stats().
+//
+//   ./bench_storage --dir /mnt/vstfat --frames 1000 [--fps 15] [--modes 0123]
+//
+// --modes p checks PER_FILE frames saved before network time instead:
+// two boots store frames 1..N without time (frame ids restart every
+// boot), the second then gets the time and stores N more. Every index
+// record, re-dated or left in NOTIME.VIX, must open its own JPEG.
+//
+// Each mode runs in a forked child so module state starts clean, just
+// like a reboot.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "corpus.h"
+#include "crc32.h"
+#include "frameindex.h"
+#include "sdlayout.h"
+#include "sdstore.h"
+#include "sdwriter.h"
+
+struct Mode
+{
+    const char   *name;
+    const char   *sub;      // short: the store root must fit 31 chars
+    SdStorageMode mode;
+    bool          write_behind;
+};
+
+static const Mode MODES[] = {
+    { "PER_FILE",    "pf",  SdStorageMode::PER_FILE, false },
+    { "SEGMENT",     "sg",  SdStorageMode::SEGMENT,  false },
+    { "PER_FILE+WB", "pfw", SdStorageMode::PER_FILE, true  },
+    { "SEGMENT+WB",  "sgw", SdStorageMode::SEGMENT,  true  },
+};
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static FrameMeta fake_meta(uint32_t frame)
+{
+    FrameMeta m{};
+    m.valid = true;
+    m.frame = frame;
+    m.perf = {7, 52, 1};
+    m.box_count = (uint8_t)(frame % 3);
+    for (uint8_t i = 0; i < m.box_count; i++)
+        m.boxes[i] = {3, 80, 100, 80, 40, 40};
+    return m;
+}
+
+// Bytes the block device under `dir` has written so far, -1 if there is
+// no block device (tmpfs, overlay).
+static int64_t device_written(const std::string &dir)
+{
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0) return -1;
+
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/stat", major(st.st_dev), minor(st.st_dev));
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    unsigned long long f[7] = {0};
+    int n = fscanf(fp, "%llu %llu %llu %llu %llu %llu %llu",
+                   &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6]);
+    fclose(fp);
+    return n == 7 ? (int64_t)(f[6] * 512ULL) : -1;    // field 7: sectors written
+}
+
+static void sync_dir(const std::string &dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    syncfs(fd);
+    close(fd);
+}
+
+static double pct(std::vector<double> &v, int p)
+{
+    if (v.empty()) return 0;
+    return v[std::min(v.size() - 1, (v.size() * p) / 100)];
+}
+
+static int run_mode(const Mode &m, const std::string &dir, const std::vector<Jpeg> &corpus,
+                    size_t frames, double fps)
+{
+    std::string root = dir + "/" + m.sub;
+    std::string cmd = "rm -rf '" + root + "'";
+    (void)!system(cmd.c_str());
+    mkdir(root.c_str(), 0775);
+
+    SdStoreConfig cfg = sdstore_default_config();
+    cfg.mode = m.mode;
+    cfg.write_behind = m.write_behind;
+    cfg.stats_every = 0;
+    cfg.log_frames = false;
+
+    struct statvfs vs;
+    if (statvfs(root.c_str(), &vs) == 0)
+    {
+        cfg.total_bytes = (uint64_t)vs.f_blocks * vs.f_frsize;
+        cfg.used_bytes = (uint64_t)(vs.f_blocks - vs.f_bfree) * vs.f_frsize;
+    }
+
+    if (!sdstore_init(root.c_str(), cfg)) return 1;
+    sdstore_set_time_valid(true);
+
+    sync_dir(root);
+    int64_t dev0 = device_written(root);
+
+    std::vector<double> lat;
+    lat.reserve(frames);
+    uint32_t rejected = 0;
+    double t0 = now_s();
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const Jpeg &j = corpus[i % corpus.size()];
+        FrameMeta meta = fake_meta((uint32_t)i + 1);
+
+        if (m.write_behind && fps > 0)
+        {
+            double due = t0 + i / fps;
+            while (now_s() < due) usleep(200);
+        }
+
+        double a = now_s();
+        if (!sdstore_save((uint32_t)i + 1, j.data.data(), j.data.size(), &meta)) rejected++;
+        lat.push_back((now_s() - a) * 1000.0);
+    }
+    sdstore_close();
+    double secs = now_s() - t0;
+
+    sync_dir(root);
+    int64_t dev1 = device_written(root);
+
+    SdStoreStats s = sdstore_stats();
+    std::sort(lat.begin(), lat.end());
+    double per = s.frames ? 1.0 / s.frames : 0;
+
+    printf("%-12s %6lu frames %7.1f f/s  jpeg %6.1f KB/f  store %6.1f KB/f  ",
+           m.name, (unsigned long)s.frames, s.frames / secs,
+           s.jpeg_bytes * per / 1024.0, s.store_bytes * per / 1024.0);
+    if (dev0 >= 0 && dev1 >= dev0 && s.jpeg_bytes)
+        printf("device %6.1f KB/f  WA %.2fx  ", (dev1 - dev0) * per / 1024.0,
+               (double)(dev1 - dev0) / s.jpeg_bytes);
+    else
+        printf("device    N/A          ");
+    printf("save p50=%.2f p99=%.2f max=%.2f ms", pct(lat, 50), pct(lat, 99), lat.empty() ? 0 : lat.back());
+
+    if (m.write_behind)
+    {
+        SdWriterStats w = sdwriter_stats();
+        printf("  write p50=%lu p99=%lu max=%lu ms  dropped=%lu",
+               (unsigned long)w.write_p50_ms, (unsigned long)w.write_p99_ms,
+               (unsigned long)w.write_max_ms, (unsigned long)w.dropped);
+    }
+    printf("%s\n", rejected ? "  (some frames rejected)" : "");
+    return 0;
+}
+
+/* =========================================================
+   PRE-SYNC FRAMES OVER TWO BOOTS
+   ========================================================= */
+// The JPEG boot k stores as frame id
+static const Jpeg &presync_jpeg(const std::vector<Jpeg> &corpus, unsigned k, uint32_t id)
+{
+    return corpus[(k * 7 + id) % corpus.size()];
+}
+
+// One boot in a forked child: n frames without network time, then (time)
+// n more with it
+static int presync_boot(const std::string &root, const std::vector<Jpeg> &corpus,
+                        unsigned k, size_t n, bool time)
+{
+    SdStoreConfig cfg = sdstore_default_config();
+    cfg.mode = SdStorageMode::PER_FILE;
+    cfg.layout = SdLayout::DATE_HOUR;
+    cfg.write_behind = false;
+    cfg.stats_every = 0;
+    cfg.log_frames = false;
+    if (!sdstore_init(root.c_str(), cfg)) return 1;
+
+    uint32_t id = 1;
+    for (size_t i = 0; i < n; i++, id++)
+    {
+        const Jpeg &j = presync_jpeg(corpus, k, id);
+        FrameMeta meta = fake_meta(id);
+        if (!sdstore_save(id, j.data.data(), j.data.size(), &meta)) return 1;
+    }
+    if (time)
+    {
+        sdstore_set_time_valid(true);
+        for (size_t i = 0; i < n; i++, id++)
+        {
+            const Jpeg &j = presync_jpeg(corpus, k, id);
+            FrameMeta meta = fake_meta(id);
+            if (!sdstore_save(id, j.data.data(), j.data.size(), &meta)) return 1;
+        }
+    }
+    sdstore_close();
+    return 0;
+}
+
+static bool same_file(const char *path, const Jpeg &j)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    std::vector<uint8_t> b(j.data.size() + 1);
+    size_t got = fread(b.data(), 1, b.size(), f);
+    fclose(f);
+    return got == j.data.size() && !memcmp(b.data(), j.data.data(), got);
+}
+
+static int run_presync(const std::string &dir, const std::vector<Jpeg> &corpus, size_t n)
+{
+    std::string root = dir + "/ps";
+    std::string cmd = "rm -rf '" + root + "'";
+    (void)!system(cmd.c_str());
+    mkdir(root.c_str(), 0775);
+
+    // Boot numbers on a fresh card are 1, 2, ...: boot k + 1 is bench boot k
+    for (unsigned k = 0; k < 2; k++)
+    {
+        pid_t pid = fork();
+        if (pid == 0) _exit(presync_boot(root, corpus, k, n, k == 1));
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    }
+
+    // Read back as the uploader does: path from the record alone
+    frameindex_init(root.c_str(), 1);
+    uint32_t recs = 0, rebased = 0, notime = 0, wrong = 0;
+    int32_t first = frameindex_first_day(), last = frameindex_last_day();
+    for (int32_t day = -1; day <= last; day = (day < 0 && first >= 0) ? first : day + 1)
+    {
+        uint32_t count = frameindex_count(day);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            IdxRecord r;
+            if (!frameindex_read(day, i, r) || r.seq) continue;
+            recs++;
+            if (r.flags & IDX_F_REBASED) rebased++;
+            if (day < 0) notime++;
+
+            char path[96];
+            sdlayout_frame_name(root.c_str(), SdLayout::DATE_HOUR, (time_t)r.epoch,
+                                !(r.flags & IDX_F_REBASED), r.boot, r.frame_id, path, sizeof(path));
+            if (!r.boot || !same_file(path, presync_jpeg(corpus, r.boot - 1u, r.frame_id)))
+            {
+                if (!wrong) printf("  wrong JPEG: boot %u frame %lu at %s\n",
+                                   (unsigned)r.boot, (unsigned long)r.frame_id, path);
+                wrong++;
+            }
+        }
+        if (day < 0 && first < 0) break;
+    }
+
+    printf("presync: 2 boots x %zu frames before network time, %zu after: %lu records "
+           "(%lu re-dated, %lu in NOTIME), %lu with the wrong JPEG\n",
+           n, n, (unsigned long)recs, (unsigned long)rebased, (unsigned long)notime,
+           (unsigned long)wrong);
+    return (wrong || recs != 3 * n) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_bench";
+    std::string images = "../../images";
+    std::string modes = "0123";
+    size_t frames = 1000;
+    double fps = 15.0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--frames")) frames = strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--fps")) fps = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--modes")) modes = argv[i + 1];
+    }
+
+    if (dir.size() > 27)
+    {
+        fprintf(stderr, "--dir must be at most 27 chars (firmware root limit)\n");
+        return 1;
+    }
+
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    if (corpus.empty())
+    {
+        fprintf(stderr, "no JPEGs under %s\n", images.c_str());
+        return 1;
+    }
+
+    mkdir(dir.c_str(), 0775);
+    printf("corpus: %zu JPEGs from %s, target: %s, write-behind paced at %.0f fps\n",
+           corpus.size(), images.c_str(), dir.c_str(), fps);
+    fflush(stdout);
+
+    int rc = 0;
+    for (char c : modes)
+    {
+        if (c == 'p')
+        {
+            if (run_presync(dir, corpus, frames < 200 ? frames : 200)) rc = 1;
+            continue;
+        }
+
+        unsigned k = (unsigned)(c - '0');
+        if (k >= sizeof(MODES) / sizeof(MODES[0])) continue;
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int r = run_mode(MODES[k], dir, corpus, frames, fps);
+            fflush(stdout);
+            _exit(r);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) rc = 1;
+    }
+    return rc;
+}
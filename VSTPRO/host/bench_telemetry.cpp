@@ -0,0 +1,149 @@
+// bench_telemetry.cpp — batched vs per-detection telemetry over the modem
+//
+// Feeds a detection trace (mostly empty frames, some Apis / crabro boxes
+// and one high-score velutina) into telemetry.cpp while a second thread
+// plays the telemetry task, against tools/sim7080_emu.py. The emulator's
+// --pdp-ms and --latency-ms stand in for bearer activation and LTE-M
+// round trips, so the radio-on time is the time the firmware code keeps
+// the bearer up.
+//
+//   python3 tools/blob_standin.py --dir /tmp/vst_blobs &
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --pdp-ms 1500 --latency-ms 300 &
+//   ./bench_telemetry --records 1                  # one session per detection
+//   ./bench_telemetry --flush-s 20 --records 200   # batched
+//
+// Reports batches, radio-on seconds (and with an RRC tail per session,
+// --tail-ms, which the network adds after the bearer goes down) and bytes
+// per detection. tools/vtb_decode.py reads the stored batches back;
+// ./run.sh telemetry runs both modes and decodes them.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "telemetry.h"
+
+static std::atomic<bool> g_capturing{true};
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// The telemetry task: step when due, otherwise poll
+static void run_sender()
+{
+    for (;;)
+    {
+        if (telemetry_due())
+        {
+            telemetry_step();
+            continue;
+        }
+        if (!g_capturing && telemetry_stats().sent_records == telemetry_stats().records) break;
+        usleep(50000);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string tty = "/tmp/vst_modem";
+    TelemConfig cfg = telemetry_default_config();
+    cfg.az.endpoint = "http://127.0.0.1:10000/devstoreaccount1";
+    cfg.az.container = "frames";
+    cfg.az.sas = "";
+    cfg.apn = "";
+    cfg.retry_ms = 200;
+    cfg.flush_ms = 20000;
+    cfg.urgent_hold_ms = 10000;
+    double fps = 5, secs = 60, p_detect = 0.05;
+    uint32_t tail_ms = 10000, seed = 7;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--endpoint")) cfg.az.endpoint = argv[i + 1];
+        else if (!strcmp(argv[i], "--device")) cfg.device_id = argv[i + 1];
+        else if (!strcmp(argv[i], "--flush-s")) cfg.flush_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--records")) cfg.max_records = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--keep-link")) cfg.keep_link = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--fps")) fps = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--p-detect")) p_detect = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--tail-ms")) tail_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    if (at_cmd(2000, "E0") != AtResult::OK)
+    {
+        fprintf(stderr, "no modem on %s\n", tty.c_str());
+        return 1;
+    }
+    if (!telemetry_init(cfg)) return 1;
+
+    std::thread sender(run_sender);
+
+    // Trace: detections with probability p_detect, one velutina at 40 %
+    srand(seed);
+    uint32_t frames = (uint32_t)(fps * secs), detections = 0, velutina_at = frames * 2 / 5;
+    double t0 = now_s(), next = t0;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = i + 1;
+        if (i == velutina_at)
+        {
+            m.box_count = 1;
+            m.boxes[0] = FrameBox{ 3, 86, 212, 140, 52, 38 };
+        }
+        else if (rand() < p_detect * RAND_MAX)
+        {
+            m.box_count = 1 + rand() % 2;
+            for (uint8_t b = 0; b < m.box_count; b++)
+                m.boxes[b] = FrameBox{ (uint8_t)(rand() % 2), (uint8_t)(40 + rand() % 55),
+                                       (uint16_t)(rand() % 400), (uint16_t)(rand() % 400),
+                                       (uint16_t)(20 + rand() % 60), (uint16_t)(20 + rand() % 60) };
+        }
+        detections += m.box_count;
+        telemetry_add(i + 1, &m);
+
+        next += 1.0 / fps;
+        double wait = next - now_s();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+    }
+
+    // Whatever is left goes out as one last batch
+    telemetry_flush_now();
+    g_capturing = false;
+    sender.join();
+    double wall = now_s() - t0;
+
+    const TelemStats &s = telemetry_stats();
+    telemetry_log_stats();
+    double per = s.sent_detections ? 1.0 / s.sent_detections : 0;
+    printf("\n%s: %.0f s, %u frames, %u records, %u detections\n",
+           cfg.max_records <= 1 ? "per-detection" : "batched", wall, s.frames, s.records, detections);
+    printf("sent: %u batches (%u urgent), %u records, %u detections, %u failures\n",
+           s.batches, s.urgent, s.sent_records, s.sent_detections, s.failures);
+    printf("radio-on: %.1f s in %u sessions (%.2f s/detection); with a %.0f s RRC tail: %.1f s\n",
+           s.radio_ms / 1000.0, s.sessions, s.radio_ms / 1000.0 * per, tail_ms / 1000.0,
+           (s.radio_ms + (double)s.sessions * tail_ms) / 1000.0);
+    printf("bytes/detection: %.1f payload, %.1f on the modem UART\n",
+           s.payload_bytes * per, s.wire_bytes * per);
+
+    bool ok = s.sent_records == s.records && s.sent_detections == detections && !s.dropped;
+    printf("%s\n", ok ? "OK: every record sent" : "FAIL: records missing");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// bench_time.cpp — network time resync and drift compensation
+//
+// Runs modemlink.cpp up to READY and then timesync.cpp against
+// tools/sim7080_emu.py, whose +CCLK? reads the host's real clock. The
+// device side gets a clock of its own: esp_timer runs --ppm slow against
+// the host (a crystal that is off, exaggerated so that minutes show what
+// hours would), and the system clock is that plus an offset that
+// timesync.cpp steps and slews like settimeofday() / adjtime().
+//
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem --baud 115200 &
+//   ./bench_time --tty /tmp/vst_modem --secs 120 --ppm 1000 --resync-s 20
+//
+// Every second three clocks are compared with the host clock:
+//
+//   once     the old way: +CCLK? at boot, whole seconds, then free running
+//   stamps   timesync_now_ms(), what frames are stamped with
+//   system   the slewed system clock, what time() returns
+//
+// and the mean / largest error and the error at the end are printed, with
+// the resync statistics. ./run.sh time runs it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "modemlink.h"
+#include "timesync.h"
+
+static double g_ppm = 1000;             // device clock slow by this much
+static uint64_t g_host_t0 = 0;
+static int64_t  g_sys_offset_ms = 0;    // system clock = device mono + offset
+static bool     g_sys_set = false;
+static uint32_t g_first_epoch = 0;      // the old way
+static uint64_t g_first_mono = 0;
+
+static uint64_t host_mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static int64_t host_real_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// esp_timer of a device whose oscillator is g_ppm slow; boots at 5 s
+static uint64_t dev_mono_us()
+{
+    double host = (double)(host_mono_us() - g_host_t0);
+    return 5000000ULL + (uint64_t)(host * (1.0 - g_ppm * 1e-6));
+}
+
+static int64_t sys_ms()            { return (int64_t)(dev_mono_us() / 1000) + g_sys_offset_ms; }
+static void sys_step(int64_t ms)   { g_sys_offset_ms = ms - (int64_t)(dev_mono_us() / 1000); }
+static void sys_slew(int32_t ms)   { g_sys_offset_ms += ms; }   // adjtime() all at once
+
+// As main.cpp: the first network time sets the clock and asks for a
+// tick search; later ones leave resyncs to TIME_RESYNC_MS
+static void on_time(uint32_t epoch)
+{
+    if (!timesync_valid()) timesync_request();
+    if (!g_first_epoch)
+    {
+        g_first_epoch = epoch;
+        g_first_mono = dev_mono_us();
+    }
+    if (timesync_valid() || g_sys_set) return;
+    sys_step((int64_t)epoch * 1000);
+    g_sys_set = true;
+}
+
+struct Err
+{
+    const char *name;
+    double   sum = 0;
+    int64_t  max = 0;
+    int64_t  last = 0;
+    uint32_t n = 0;
+
+    void add(int64_t e)
+    {
+        sum += std::fabs((double)e);
+        if (std::llabs(e) > std::llabs(max)) max = e;
+        last = e;
+        n++;
+    }
+    void print() const
+    {
+        printf("%-8s mean |error| %7.1f ms   max %6lld ms   at the end %6lld ms\n",
+               name, n ? sum / n : 0.0, (long long)max, (long long)last);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    std::string tty = "/tmp/vst_modem";
+    double secs = 120;
+    TimeSyncConfig cfg = timesync_default_config();
+    cfg.resync_ms = 20000;
+    cfg.drift_min_ms = 30000;
+    cfg.trim_ms = 5000;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--ppm")) g_ppm = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--resync-s")) cfg.resync_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--drift-min-s")) cfg.drift_min_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--trim-s")) cfg.trim_ms = (uint32_t)(atof(argv[i + 1]) * 1000);
+        else if (!strcmp(argv[i], "--max-ppm")) cfg.max_ppm = (uint16_t)atoi(argv[i + 1]);
+    }
+    if (cfg.max_ppm < g_ppm * 2) cfg.max_ppm = (uint16_t)(g_ppm * 2);
+    g_host_t0 = host_mono_us();
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+
+    TimeSyncHooks hooks{ dev_mono_us, sys_ms, sys_step, sys_slew };
+    timesync_init(cfg, hooks);
+    modemlink_begin(LinkHooks{ nullptr, on_time });
+    while (modemlink_state() != LinkState::READY)
+    {
+        uint32_t ms = modemlink_step();
+        usleep((ms ? ms : 1) * 1000);
+    }
+    printf("device clock %.0f ppm slow, resync every %lu s, rate from %lu s, trim every %lu s\n",
+           g_ppm, (unsigned long)(cfg.resync_ms / 1000), (unsigned long)(cfg.drift_min_ms / 1000),
+           (unsigned long)(cfg.trim_ms / 1000));
+
+    Err once{ "once" }, stamps{ "stamps" }, sys{ "system" };
+    uint64_t end = host_mono_us() + (uint64_t)(secs * 1e6);
+    uint64_t next_check = 0;
+    while (host_mono_us() < end)
+    {
+        uint32_t wait = timesync_step(true);
+        uint64_t now = host_mono_us();
+        if (now >= next_check && timesync_valid())
+        {
+            next_check = now + 1000000;
+            int64_t real = host_real_ms();
+            int64_t old = (int64_t)g_first_epoch * 1000 + (int64_t)((dev_mono_us() - g_first_mono) / 1000);
+            once.add(old - real);
+            stamps.add(timesync_now_ms() - real);
+            sys.add(sys_ms() - real);
+        }
+        if (wait > 100) wait = 100;
+        usleep((wait ? wait : 1) * 1000);
+    }
+
+    once.print();
+    stamps.print();
+    sys.print();
+    const TimeSyncStats &s = timesync_stats();
+    printf("resync: %u ticks found, %u failed, %.1f polls each, window +/-%u ms (max %u), "
+           "drift %.1f ppm estimated (%.0f set), %u steps, %u slews\n",
+           s.syncs, s.failed, s.syncs ? (double)s.polls / s.syncs : 0.0, s.window_ms, s.window_max_ms,
+           (double)s.ppm, g_ppm, s.steps, s.slews);
+    timesync_log_stats();
+    return 0;
+}
@@ -0,0 +1,326 @@
+// bench_upload.cpp — end-to-end blob upload through the modem AT dialect
+//
+// Runs the firmware uploader (uploader.cpp, azblob.cpp, simhttp.cpp,
+// simnet.cpp, modem_at.cpp unchanged) against a serial port: normally the
+// pseudo-terminal of tools/sim7080_emu.py, which turns AT+SH* into real
+// HTTP requests to Azurite (or tools/blob_standin.py) on localhost.
+//
+//   python3 tools/blob_standin.py &                 # or: azurite-blob --loose
+//   python3 tools/sim7080_emu.py --link /tmp/vst_modem &
+//   ./bench_upload --dir /tmp/vst_up --populate 30           # store 30 frames
+//   ./bench_upload --dir /tmp/vst_up --stop-after 40         # power cut mid-frame
+//   ./bench_upload --dir /tmp/vst_up                         # resumes, finishes
+//   ./bench_upload --dir /tmp/vst_up --verify 30             # read back + compare
+//
+// --stop-after N exits abruptly after N accepted blocks, like a power cut:
+// the next run must continue from the cursor, which shows up as
+// "resumed" frames and saved blocks in the report. ./run.sh upload runs
+// the whole sequence.
+//
+// --thumb 1 uploads thumbnails first (full frames only above the policy
+// scores, or when listed in requests.txt, read every --poll-ms);
+// ./run.sh thumbs compares its daily bytes with full uploads. --mqtt 1
+// publishes the thumbnails on an MQTT session (mqttlink.h, broker on
+// 127.0.0.1:--mqtt-port) instead; ./run.sh mqtt cuts that session once.
+//
+// --budget-day / --budget-month put the uploader on a data plan (modem
+// bytes), --full-pct / --thumb-pct set the tier thresholds (velutina,
+// crabro, other) and --velutina-first 0 turns the tier leads off; ./run.sh
+// budget compares a plain cut-off with the tiered scheduler. --kinds 01
+// stores only Apis (0) and crabro (1) detections.
+//
+// --sync-url asks a sync service (tools/sync_standin.py) which stored
+// frames the container is missing once --sync-backlog frames wait;
+// ./run.sh sync re-sends an archive after a lost cursor with and without.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "at_pty.h"
+#include "mqttlink.h"
+#include "corpus.h"
+#include "frameindex.h"
+#include "sdstore.h"
+#include "simnet.h"
+#include "uploader.h"
+#include "upsync.h"
+
+// "a,b,c" -> one percentage per tier
+static void parse_pct(const char *arg, uint8_t *pct)
+{
+    for (uint8_t t = 0; t < UP_TIERS && *arg; t++)
+    {
+        pct[t] = (uint8_t)atoi(arg);
+        const char *comma = strchr(arg, ',');
+        if (!comma) break;
+        arg = comma + 1;
+    }
+}
+
+static double now_s()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void populate(const std::string &images, uint32_t frames, uint32_t detect_every, const char *kinds)
+{
+    std::vector<Jpeg> corpus;
+    load_corpus(images, corpus);
+    if (corpus.empty())
+    {
+        fprintf(stderr, "no JPEGs under %s\n", images.c_str());
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        const Jpeg &j = corpus[i % corpus.size()];
+        FrameMeta m{};
+        m.valid = true;
+        m.frame = i + 1;
+        m.perf = {7, 52, 1};
+        if (detect_every && i % detect_every == 0)
+        {
+            // Apis, crabro and velutina in turn (those of --kinds), scores
+            // around the policy
+            static const FrameBox boxes[] = {
+                { 0, 81, 300, 220, 60, 48 }, { 1, 88, 120, 90, 40, 40 }, { 3, 74, 510, 400, 52, 38 },
+                { 0, 93, 90, 610, 58, 44 },  { 1, 92, 700, 300, 44, 40 }, { 3, 55, 220, 150, 50, 36 },
+            };
+            static const size_t n_boxes = sizeof(boxes) / sizeof(boxes[0]);
+            const FrameBox *b = &boxes[(i / detect_every) % n_boxes];
+            for (size_t k = 1; k < n_boxes && !strchr(kinds, '0' + b->target); k++)
+                b = &boxes[(i / detect_every + k) % n_boxes];
+            m.box_count = 1;
+            m.boxes[0] = *b;
+        }
+        sdstore_save(i + 1, j.data.data(), j.data.size(), &m);
+    }
+    sdstore_flush(10000);
+    printf("stored %u frames (every %u-th with a detection)\n", frames, detect_every);
+}
+
+// Reads back the first n uploaded frames and compares them with the card.
+static int verify(uint32_t n, bool all)
+{
+    static uint8_t got[SH_BODY_MAX];
+    uint32_t checked = 0, bad = 0;
+
+    for (int32_t day = frameindex_first_day(); day >= 0 && day <= frameindex_last_day() && checked < n; day++)
+    {
+        uint32_t count = frameindex_count(day);
+        for (uint32_t r = 0; r < count && checked < n; r++)
+        {
+            IdxRecord rec;
+            if (!frameindex_read(day, r, rec) || (!all && !rec.box_count)) continue;
+
+            int fd;
+            uint32_t off, len;
+            if (!uploader_open_frame(rec, &fd, &off, &len)) continue;
+
+            char blob[64];
+            uploader_blob_name(rec, blob, sizeof(blob));
+
+            std::vector<uint8_t> src(len);
+            bool ok = pread(fd, src.data(), len, off) == (ssize_t)len;
+            close(fd);
+
+            for (uint32_t at = 0; ok && at < len; at += SH_BODY_MAX)
+            {
+                uint32_t want = len - at < SH_BODY_MAX ? len - at : (uint32_t)SH_BODY_MAX;
+                size_t k = 0;
+                int st = azblob_get_range(blob, at, want, got, &k);
+                ok = (st == 206 || st == 200) && k == want && !memcmp(got, src.data() + at, want);
+            }
+
+            checked++;
+            if (!ok)
+            {
+                bad++;
+                printf("MISMATCH %s\n", blob);
+            }
+        }
+    }
+
+    printf("verify: %u blobs checked, %u mismatched\n", checked, bad);
+    return bad || !checked ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "/tmp/vst_up";
+    std::string tty = "/tmp/vst_modem";
+    std::string images = "../../images";
+    UpConfig cfg = uploader_default_config();
+    cfg.az.endpoint = "http://127.0.0.1:10000/devstoreaccount1";
+    cfg.az.container = "frames";
+    cfg.az.sas = "";
+    cfg.apn = "";
+    cfg.retry_ms = 200;
+    cfg.thumb_first = false;
+    cfg.request_poll_ms = 0;
+    cfg.thumb_mqtt = false;
+    MqttConfig mc = mqtt_default_config();
+    mc.host = "127.0.0.1";
+    mc.apn = "";
+    uint32_t populate_n = 0, detect_every = 2, stop_after = 0, verify_n = 0;
+    const char *kinds = "013";
+    double timeout_s = 600;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--dir")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "--tty")) tty = argv[i + 1];
+        else if (!strcmp(argv[i], "--images")) images = argv[i + 1];
+        else if (!strcmp(argv[i], "--endpoint")) cfg.az.endpoint = argv[i + 1];
+        else if (!strcmp(argv[i], "--container")) cfg.az.container = argv[i + 1];
+        else if (!strcmp(argv[i], "--device")) cfg.device_id = argv[i + 1];
+        else if (!strcmp(argv[i], "--sas")) cfg.az.sas = argv[i + 1];
+        else if (!strcmp(argv[i], "--block")) cfg.block_bytes = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--all")) cfg.upload_empty = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--populate")) populate_n = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--detect-every")) detect_every = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--kinds")) kinds = argv[i + 1];
+        else if (!strcmp(argv[i], "--stop-after")) stop_after = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--verify")) verify_n = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--timeout")) timeout_s = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--thumb")) cfg.thumb_first = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--thumb-side")) cfg.thumb_side = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--poll-ms")) cfg.request_poll_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--mqtt")) cfg.thumb_mqtt = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--mqtt-port")) mc.port = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--budget-day")) cfg.budget_day = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--budget-month")) cfg.budget_month = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--full-pct")) parse_pct(argv[i + 1], cfg.budget_full_pct);
+        else if (!strcmp(argv[i], "--thumb-pct")) parse_pct(argv[i + 1], cfg.budget_thumb_pct);
+        else if (!strcmp(argv[i], "--velutina-first")) cfg.velutina_first = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--sync-url")) cfg.sync_url = argv[i + 1];
+        else if (!strcmp(argv[i], "--sync-backlog")) cfg.sync_backlog = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    mkdir(dir.c_str(), 0775);
+    SdStoreConfig sc = sdstore_default_config();
+    sc.mode = SdStorageMode::SEGMENT;   // as in the README numbers
+    sc.write_behind = false;
+    sc.log_frames = false;
+    sc.stats_every = 0;
+    sc.total_bytes = 1ULL << 40;    // no retention pressure here
+    if (!sdstore_init(dir.c_str(), sc)) return 1;
+    sdstore_set_time_valid(true);
+
+    if (populate_n)
+    {
+        populate(images, populate_n, detect_every, kinds);
+        sdstore_close();
+        return 0;
+    }
+
+    AtPort port;
+    if (!at_pty_open(tty.c_str(), &port)) return 1;
+    at_begin(port);
+    if (at_cmd(2000, "E0") != AtResult::OK)
+    {
+        fprintf(stderr, "no modem on %s\n", tty.c_str());
+        return 1;
+    }
+    if (!uploader_init(dir.c_str(), cfg)) return 1;
+    if (cfg.thumb_mqtt)
+    {
+        mc.client_id = cfg.device_id;
+        if (!mqtt_init(mc)) return 1;
+    }
+
+    if (verify_n)
+    {
+        if (!simnet_up(cfg.apn, 60000) || !azblob_connect()) return 1;
+        return verify(verify_n, cfg.upload_empty);
+    }
+
+    double t0 = now_s();
+    double velutina_done = 0, crabro_done = 0, other_first = 0;
+    uint32_t velutina = 0, crabro = 0, crabro_ahead = 0, backoffs = 0;
+    while (now_s() - t0 < timeout_s)
+    {
+        UpState s = uploader_step();
+        const UpStats &st = uploader_stats();
+        if (st.tier_full[0] + st.tier_thumb[0] != velutina)
+        {
+            velutina = st.tier_full[0] + st.tier_thumb[0];
+            velutina_done = now_s() - t0;
+        }
+        if (st.tier_full[1] + st.tier_thumb[1] != crabro)
+        {
+            crabro = st.tier_full[1] + st.tier_thumb[1];
+            crabro_done = now_s() - t0;
+        }
+        if (!other_first && st.tier_full[2] + st.tier_thumb[2])
+        {
+            other_first = now_s() - t0;
+            crabro_ahead = crabro;
+        }
+        if (s == UpState::IDLE) break;
+        if (s == UpState::BACKOFF)
+        {
+            backoffs++;
+            usleep(50000);
+        }
+        if (stop_after && uploader_stats().blocks >= stop_after)
+        {
+            printf("power cut after %u blocks\n", uploader_stats().blocks);
+            fflush(stdout);
+            _exit(3);
+        }
+    }
+    if (cfg.thumb_mqtt) mqtt_close();
+    double secs = now_s() - t0;
+
+    const UpStats &u = uploader_stats();
+    const AtStats &a = at_stats();
+    const SimHttpStats &h = simhttp_stats();
+    uploader_log_stats();
+    printf("%.1f s: %u frames, %.1f KB JPEG -> %.1f KB/s, %.0f ms/frame, %u backoffs\n",
+           secs, u.frames, u.bytes / 1024.0, u.bytes / 1024.0 / (secs > 0 ? secs : 1),
+           u.frames ? secs * 1000.0 / u.frames : 0.0, backoffs);
+    printf("modem: %u AT commands, %u HTTP requests, tx %.1f KB (%.2f x JPEG), rx %.1f KB\n",
+           a.commands, h.requests, a.tx_bytes / 1024.0,
+           u.bytes ? (double)a.tx_bytes / u.bytes : 0.0, a.rx_bytes / 1024.0);
+    if (cfg.thumb_mqtt)
+        printf("mqtt: %u thumbnails confirmed, %u lost and sent again, %u connects\n",
+               mqtt_stats().messages, mqtt_stats().lost, mqtt_stats().connects);
+    if (cfg.budget_day || cfg.budget_month)
+    {
+        uint32_t share, used;
+        uploader_budget(&share, &used);
+        printf("budget: %.1f of %.1f KB today | full/thumb/meta  velutina %u/%u/%u  crabro %u/%u/%u  "
+               "other %u/%u/%u | last velutina at %.2f s, last crabro at %.2f s, first other at %.2f s "
+               "(%u crabro before it) of %.2f s\n",
+               used / 1024.0, share / 1024.0,
+               u.tier_full[0], u.tier_thumb[0], u.tier_meta[0], u.tier_full[1], u.tier_thumb[1],
+               u.tier_meta[1], u.tier_full[2], u.tier_thumb[2], u.tier_meta[2], velutina_done, crabro_done,
+               other_first, crabro_ahead, secs);
+    }
+    if (upsync_enabled())
+    {
+        const SyncStats &y = upsync_stats();
+        printf("sync: %u round(s), %u frames in %u chunks (%u complete, %u split), %u missing ranges, "
+               "%u B manifest / %u B reply, %u frames skipped\n",
+               y.rounds, y.listed, y.chunks, y.chunks_complete, y.refined, y.ranges, y.manifest_bytes,
+               y.reply_bytes, u.synced);
+    }
+    const UpDay &d = uploader_today();
+    if (d.day >= 0)
+        printf("today: %u thumbs %.1f KB + %u full %.1f KB (%u requested) = %.1f KB, "
+               "as full frames %.1f KB, modem %.1f KB\n",
+               d.thumbs, d.thumb_bytes / 1024.0, d.fulls, d.full_bytes / 1024.0, d.requested,
+               (d.thumb_bytes + d.full_bytes) / 1024.0, d.full_equiv / 1024.0, d.wire_bytes / 1024.0);
+    return 0;
+}
@@ -0,0 +1,464 @@
+// bench_vision.cpp — Grove Vision AI acquisition: invoke per frame vs
+// continuous invoke
+//
+// Runs sscmalink.cpp against a simulated module on the far side of the
+// SSCMA library's I2C transport. No hardware: the module and the bus are a
+// timing model, played in real time.
+//
+//   module   capture (--capture-ms), then preprocess / inference /
+//            postprocess (--perf 7,52,1); the INVOKE event carries perf,
+//            boxes (--detect probability; --stay after a capture with
+//            boxes) and a Base64 JPEG (--image-kb).
+//            After a single invoke it answers busy for --rearm-ms.
+//            In continuous invoke it captures back to back into its
+//            transport buffer (--tx-kb). A result that finds no room is
+//            dropped (--full drop) or held, with the next capture, until
+//            the host has read enough (--full hold); which of the two the
+//            module firmware does is not documented.
+//   bus      like the library: every transaction is a 6 byte header, a
+//            wait_delay (2 ms) and the payload at --hz, reads of at most
+//            250 bytes. available() is one transaction. --fault HZ:P,...
+//            corrupts one byte of a read or write with probability P at
+//            HZ and above, and fails an address probe the same way.
+//            --clocks 100000,400000,1000000 hands the clock to i2cbus.cpp
+//            (probe at start, step down on errors, up when clean).
+//
+//   ./bench_vision --mode single     --secs 20
+//   ./bench_vision --mode continuous --secs 20 --hz 1000000
+//   ./bench_vision --two-phase 1 --detect 0     (idle scene, images by time only)
+//   ./bench_vision --clocks 100000,400000,1000000 --fault 1000000:0.005 --clean-ms 20000
+//
+// Reports frames per second and the latency from capture to the parsed
+// result, and what the link spent on it (invokes, busy answers, backoff,
+// polls). With --two-phase the results come without the image and
+// sscma_image() fetches it when sscma_want_image() says so; "actuator"
+// is then the latency from capture to the boxes of a detection, and
+// "image" counts the captures added (--retries) because the image
+// capture had lost the trigger's boxes.
+// ./run.sh vision runs both modes; ./run.sh twophase compares the two;
+// ./run.sh i2c fixed clocks against the clock manager.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "i2cbus.h"
+#include "sscmalink.h"
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* ===== BUS ===== */
+static uint32_t g_hz = 400000;
+static uint32_t g_wait_ms = 2;              // the library's wait_delay
+static constexpr int MAX_PL = 250;          // bytes per read transaction
+static double g_bus_ms = 0;                 // time spent in transactions
+static std::vector<std::pair<uint32_t, double>> g_fault;   // from this clock up: P per transaction
+static uint32_t g_corrupted = 0;
+
+static double transaction(int payload)
+{
+    double us = g_wait_ms * 1000.0 + (6 + payload) * 9 * 1e6 / g_hz;
+    g_bus_ms += us / 1000.0;
+    usleep((useconds_t)us);
+    return us;
+}
+
+static bool fault_now()
+{
+    double p = 0;
+    for (auto &f : g_fault)
+        if (g_hz >= f.first) p = f.second;
+    return p > 0 && rand() < p * (double)RAND_MAX;
+}
+
+static void corrupt(char *buf, int n)
+{
+    if (n <= 0 || !fault_now()) return;
+    buf[rand() % n] ^= 0x21;
+    g_corrupted++;
+}
+
+/* ===== MODULE ===== */
+struct Module
+{
+    // settings
+    uint16_t perf[3] = { 7, 52, 1 };
+    uint32_t capture_ms = 33;
+    uint32_t rearm_ms = 60;
+    uint32_t image_len = 16384;             // Base64 bytes
+    double   detect = 0.2;
+    double   stay = -1;                     // detect after a capture with boxes (< 0: detect)
+    size_t   tx_cap = 24 * 1024;
+    bool     hold = false;                  // no room in tx: hold the result, do not drop it
+
+    // state
+    std::string tx;                         // bytes for the host
+    std::vector<double> captured;           // capture time per event count
+    bool     streaming = false;
+    bool     running = false;               // a capture / inference in progress
+    bool     result_only = false;
+    double   started = 0;                   // capture of the running job
+    double   done = 0;
+    double   busy_until = 0;
+    double   blocked_ms = 0;                // continuous: waited for room in tx
+    uint32_t dropped = 0;                   // continuous: results that found no room
+    uint32_t events = 0;
+    bool     last_boxes = false;
+    std::string image;
+};
+static Module g_m;
+
+static double pipeline_ms()
+{
+    return g_m.capture_ms + g_m.perf[0] + g_m.perf[1] + g_m.perf[2];
+}
+
+static void reply(const char *name, int code)
+{
+    char b[96];
+    snprintf(b, sizeof(b), "\r{\"type\": 0, \"name\": \"%s\", \"code\": %d, \"data\": {}}\n", name, code);
+    g_m.tx += b;
+}
+
+static size_t event_len()
+{
+    return 160 + (g_m.result_only ? 0 : g_m.image.size());
+}
+
+static void event(double captured)
+{
+    char b[256];
+    int n = snprintf(b, sizeof(b),
+                     "\r{\"type\": 1, \"name\": \"INVOKE\", \"code\": 0, \"data\": {\"count\": %u, "
+                     "\"perf\": [%u, %u, %u], \"boxes\": [",
+                     g_m.events, g_m.perf[0], g_m.perf[1], g_m.perf[2]);
+    std::string e(b, n);
+    double p = (g_m.last_boxes && g_m.stay >= 0) ? g_m.stay : g_m.detect;
+    g_m.last_boxes = rand() < p * (double)RAND_MAX;
+    if (g_m.last_boxes)
+    {
+        int k = 1 + rand() % 2;
+        for (int i = 0; i < k; i++)
+        {
+            snprintf(b, sizeof(b), "%s[%d, %d, 40, 32, %d, %d]", i ? ", " : "",
+                     60 + rand() % 100, 60 + rand() % 100, 50 + rand() % 50, rand() % 3);
+            e += b;
+        }
+    }
+    e += "]";
+    if (!g_m.result_only) e += ", \"image\": \"" + g_m.image + "\"";
+    e += "}}\n";
+    g_m.tx += e;
+    g_m.captured.push_back(captured);
+    g_m.events++;
+}
+
+// Plays the module up to t
+static void advance(double t)
+{
+    while (g_m.running && g_m.done <= t)
+    {
+        if (!g_m.streaming)
+        {
+            event(g_m.started);
+            g_m.running = false;
+            g_m.busy_until = g_m.done + g_m.rearm_ms;
+            break;
+        }
+        if (g_m.tx.size() + event_len() > g_m.tx_cap && !g_m.hold)
+        {
+            g_m.dropped++;
+            g_m.started = g_m.done;
+            g_m.done = g_m.started + pipeline_ms();
+            continue;
+        }
+        if (g_m.tx.size() + event_len() > g_m.tx_cap)
+        {
+            // Result held until the host has read enough; the next
+            // capture starts after it is queued
+            g_m.blocked_ms += t - g_m.done;
+            g_m.done = t;
+            break;
+        }
+        event(g_m.started);
+        g_m.started = g_m.done;
+        g_m.done = g_m.started + pipeline_ms();
+    }
+}
+
+static void command(const std::string &cmd, double t)
+{
+    advance(t);
+    int times = 0, differed = 0, result_only = 0;
+    if (sscanf(cmd.c_str(), "AT+INVOKE=%d,%d,%d", &times, &differed, &result_only) >= 1)
+    {
+        if (g_m.running || g_m.streaming || t < g_m.busy_until)
+        {
+            reply("INVOKE", 3);
+            return;
+        }
+        reply("INVOKE", 0);
+        g_m.result_only = result_only != 0;
+        g_m.streaming = times < 0;
+        g_m.running = true;
+        g_m.started = t;
+        g_m.done = t + pipeline_ms();
+    }
+    else if (cmd == "AT+ID?")
+    {
+        g_m.tx += "\r{\"type\": 0, \"name\": \"ID?\", \"code\": 0, \"data\": \"8f3b1c2a\"}\n";
+    }
+    else if (cmd.rfind("AT+BREAK", 0) == 0)
+    {
+        g_m.streaming = false;
+        g_m.running = false;
+        reply("BREAK", 0);
+    }
+    else
+    {
+        reply("UNKNOWN", 1);
+    }
+}
+
+/* ===== PORT (the library's calls) ===== */
+static int port_available()
+{
+    transaction(2);
+    advance(now_ms());
+    return (int)std::min<size_t>(g_m.tx.size(), 0xFFFF);
+}
+
+static int port_read(char *buf, int n)
+{
+    int got = 0;
+    while (got < n)
+    {
+        int k = std::min(MAX_PL, n - got);
+        double us = transaction(k);
+        advance(now_ms());
+        k = (int)std::min<size_t>((size_t)k, g_m.tx.size());
+        if (k <= 0) break;
+        memcpy(buf + got, g_m.tx.data(), (size_t)k);
+        corrupt(buf + got, k);
+        g_m.tx.erase(0, (size_t)k);
+        i2cbus_transfer((uint32_t)k, (uint32_t)us);
+        got += k;
+    }
+    return got;
+}
+
+static std::string g_line;
+
+static int port_write(const char *buf, int n)
+{
+    for (int off = 0; off < n; off += MAX_PL)
+        i2cbus_transfer((uint32_t)std::min(MAX_PL, n - off), (uint32_t)transaction(std::min(MAX_PL, n - off)));
+    size_t at = g_line.size();
+    g_line.append(buf, (size_t)n);
+    corrupt(&g_line[at], n);
+    size_t eol;
+    while ((eol = g_line.find("\r\n")) != std::string::npos)
+    {
+        command(g_line.substr(0, eol), now_ms());
+        g_line.erase(0, eol + 2);
+    }
+    return n;
+}
+
+/* ===== CLOCK MANAGER (i2cbus.h) ===== */
+static void bus_set_clock(uint32_t hz) { g_hz = hz; }
+
+static I2cFault bus_probe()
+{
+    transaction(0);
+    if (fault_now()) return I2cFault::NACK;
+    int ping = sscma_ping(200);
+    if (ping > 0) return I2cFault::NONE;
+    return ping < 0 ? I2cFault::CRC : I2cFault::TIMEOUT;
+}
+
+// Like visionai.cpp: stalls as timeouts, replies that did not parse and
+// images that do not check out as CRC
+template <typename Call>
+static bool counted(Call call)
+{
+    SscmaStats before = sscma_stats();
+    bool ok = call();
+    const SscmaStats &after = sscma_stats();
+    for (uint32_t i = before.errors; i != after.errors; i++) i2cbus_fault(I2cFault::CRC);
+    if (after.stalls != before.stalls) i2cbus_fault(I2cFault::TIMEOUT);
+    return ok;
+}
+
+static void summary(std::vector<double> &v, double *mean, double *p95)
+{
+    *mean = *p95 = 0;
+    if (v.empty()) return;
+    for (double x : v) *mean += x;
+    *mean /= (double)v.size();
+    std::sort(v.begin(), v.end());
+    *p95 = v[std::min(v.size() - 1, v.size() * 95 / 100)];
+}
+
+int main(int argc, char **argv)
+{
+    SscmaConfig cfg = sscma_default_config();
+    I2cBusConfig bus = i2cbus_default_config();
+    bus.n_clocks = 0;
+    double secs = 20;
+    uint32_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--mode")) cfg.mode = strcmp(argv[i + 1], "single") ? SscmaMode::CONTINUOUS : SscmaMode::SINGLE;
+        else if (!strcmp(argv[i], "--secs")) secs = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--hz")) g_hz = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--wait-ms")) g_wait_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--poll-ms")) cfg.poll_ms = (uint16_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--capture-ms")) g_m.capture_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--rearm-ms")) g_m.rearm_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--image-kb")) g_m.image_len = (uint32_t)(atof(argv[i + 1]) * 1024) & ~3u;
+        else if (!strcmp(argv[i], "--tx-kb")) g_m.tx_cap = (size_t)(atof(argv[i + 1]) * 1024);
+        else if (!strcmp(argv[i], "--full")) g_m.hold = !strcmp(argv[i + 1], "hold");
+        else if (!strcmp(argv[i], "--detect")) g_m.detect = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--stay")) g_m.stay = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--retries")) cfg.image_retries = (uint8_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--two-phase")) cfg.result_only = atoi(argv[i + 1]) != 0;
+        else if (!strcmp(argv[i], "--min-score")) memset(cfg.image_min_score, atoi(argv[i + 1]), sizeof(cfg.image_min_score));
+        else if (!strcmp(argv[i], "--every-ms")) cfg.image_every_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--clocks"))
+        {
+            bus.n_clocks = 0;
+            for (char *p = argv[i + 1]; *p && bus.n_clocks < I2CBUS_MAX_CLOCKS; p += *p == ',')
+                bus.clocks[bus.n_clocks++] = (uint32_t)strtoul(p, &p, 10);
+        }
+        else if (!strcmp(argv[i], "--fault"))
+        {
+            for (char *p = argv[i + 1]; *p; p += *p == ',')
+            {
+                uint32_t hz = (uint32_t)strtoul(p, &p, 10);
+                if (*p++ != ':') break;
+                g_fault.emplace_back(hz, strtod(p, &p));
+            }
+        }
+        else if (!strcmp(argv[i], "--max-errors")) bus.max_errors = (uint8_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--window-ms")) bus.window_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--clean-ms")) bus.clean_ms = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--perf"))
+            sscanf(argv[i + 1], "%hu,%hu,%hu", &g_m.perf[0], &g_m.perf[1], &g_m.perf[2]);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    g_m.image.resize(g_m.image_len);
+    for (auto &c : g_m.image) c = B64[rand() % 64];
+
+    std::vector<char> buf(96 * 1024);
+    if (!sscma_begin(SscmaPort{ port_available, port_read, port_write }, cfg, buf.data(), buf.size()))
+        return 1;
+    const bool adaptive = bus.n_clocks > 0;
+    if (adaptive && !i2cbus_begin(I2cBusPort{ bus_set_clock, bus_probe }, bus))
+        fprintf(stderr, "no clock passed its probes, running at %lu kHz\n", (unsigned long)(g_hz / 1000));
+
+    const bool single = cfg.mode == SscmaMode::SINGLE;
+    std::vector<double> lat, act;
+    uint32_t bad = 0, stalls = 0, detections = 0, images = 0;
+    double t0 = now_ms();
+    while (now_ms() - t0 < secs * 1000)
+    {
+        if (adaptive) i2cbus_step();
+        SscmaFrame f;
+        if (!counted([&] { return sscma_next(&f); }))
+        {
+            stalls++;
+            sscma_stop();
+            continue;
+        }
+        double t = now_ms();
+        double at = f.seq < g_m.captured.size() ? g_m.captured[f.seq] : t;
+        if (f.box_count)
+        {
+            detections++;
+            act.push_back(t - at);          // the LEDs would go on here
+        }
+        if (cfg.result_only && sscma_want_image(f.boxes, f.box_count))
+        {
+            FrameBox trigger[FRAME_META_MAX_BOXES];
+            uint8_t n = f.box_count;
+            memcpy(trigger, f.boxes, n * sizeof(FrameBox));
+            if (!counted([&] { return sscma_image(&f, trigger, n); }))
+            {
+                stalls++;
+                sscma_stop();
+                continue;
+            }
+            t = now_ms();
+        }
+        if (f.image_len)
+        {
+            images++;
+            lat.push_back(t - at);
+            if (f.image_len != g_m.image_len || memcmp(f.image, g_m.image.data(), f.image_len))
+            {
+                bad++;
+                i2cbus_fault(I2cFault::CRC);    // the JPEG check on the device
+            }
+        }
+    }
+    double elapsed = (now_ms() - t0) / 1000.0;
+    sscma_stop();
+
+    const SscmaStats &s = sscma_stats();
+    double lat_mean, lat_p95, act_mean, act_p95;
+    summary(lat, &lat_mean, &lat_p95);
+    summary(act, &act_mean, &act_p95);
+
+    char clock[32];
+    if (adaptive) snprintf(clock, sizeof(clock), "adaptive, now %lu kHz", (unsigned long)(g_hz / 1000));
+    else snprintf(clock, sizeof(clock), "%lu kHz", (unsigned long)(g_hz / 1000));
+    printf("%s%s @ %s: %.1f s, %lu frames -> %.2f fps, %lu images, latency mean %.0f ms, p95 %.0f ms\n",
+           single ? "single" : g_m.hold ? "continuous, hold" : "continuous",
+           cfg.result_only ? ", two-phase" : "", clock, elapsed,
+           (unsigned long)s.frames, s.frames / elapsed, (unsigned long)images, lat_mean, lat_p95);
+    printf("actuator: %lu detections, capture to boxes mean %.0f ms, p95 %.0f ms\n",
+           (unsigned long)detections, act_mean, act_p95);
+    if (cfg.result_only)
+        printf("image: %lu fetched, %lu captures retried, %lu stored without the trigger's boxes\n",
+               (unsigned long)s.images, (unsigned long)s.image_retries, (unsigned long)s.image_misses);
+    printf("link: %lu invokes, %lu busy, %lu ms backoff, %lu polls (%lu empty), %.1f KB read, bus %.0f%%",
+           (unsigned long)s.invokes, (unsigned long)s.busy, (unsigned long)s.backoff_ms,
+           (unsigned long)s.polls, (unsigned long)s.empty_polls, s.rx_bytes / 1024.0,
+           100.0 * g_bus_ms / (elapsed * 1000));
+    if (!single && g_m.hold) printf(", module waited %.0f ms for room", g_m.blocked_ms);
+    if (!single && !g_m.hold) printf(", module dropped %lu results", (unsigned long)g_m.dropped);
+    printf("\n");
+    printf("frames: %lu bad images, %lu stalls, %lu errors",
+           (unsigned long)bad, (unsigned long)stalls, (unsigned long)s.errors);
+    if (!g_fault.empty()) printf(", %lu bytes corrupted on the bus", (unsigned long)g_corrupted);
+    printf("\n");
+    if (adaptive) i2cbus_report();
+    else
+    {
+        const I2cClockStats &c = i2cbus_stats().clock[0];
+        printf("i2c %lu kHz: %.1f KB in %lu transfers -> %.1f KB/s\n", (unsigned long)(g_hz / 1000),
+               c.bytes / 1024.0, (unsigned long)c.transfers, c.us ? c.bytes * 1e6 / 1024.0 / (double)c.us : 0.0);
+    }
+    if (!g_fault.empty()) return 0;             // errors were the point
+    return bad || s.errors ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+// corpus.h — the JPEG corpus (../../images) shared by the host benches
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+struct Jpeg
+{
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+static inline void load_corpus(const std::string &dir, std::vector<Jpeg> &out)
+{
+    DIR *d = opendir(dir.c_str());
+    if (!d) return;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr)
+    {
+        if (e->d_name[0] == '.') continue;
+        std::string path = dir + "/" + e->d_name;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            load_corpus(path, out);
+            continue;
+        }
+
+        size_t n = strlen(e->d_name);
+        if (n < 4 || strcasecmp(e->d_name + n - 4, ".jpg") != 0) continue;
+
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp) continue;
+        Jpeg j;
+        j.name = path;
+        j.data.resize(st.st_size);
+        if (fread(j.data.data(), 1, j.data.size(), fp) == j.data.size())
+            out.push_back(std::move(j));
+        fclose(fp);
+    }
+    closedir(d);
+}
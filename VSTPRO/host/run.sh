@@ -0,0 +1,406 @@
+#!/bin/sh
+# Host builds of the VSTPRO storage code.
+#   ./run.sh storage --dir /mnt/sd --frames 2000
+#   ./run.sh presync --frames 50     (PER_FILE frames of two boots before network time)
+#   ./run.sh sd      --size-mb 512 --frames 1000   (FAT32 image on loop, root)
+#   ./run.sh shard   --dir /mnt/fat --files 100000
+#   ./run.sh index   --dir /mnt/fat --days 7
+#   ./run.sh retention --dir /mnt/fat --cap-mb 64 --frames 2000 [--per-file 1]
+#   ./run.sh recovery  --dir /mnt/fat --fills 16,64,256
+#   ./run.sh upload    --frames 30   (SIM7080 emulator + blob stand-in, see tools/)
+#   ./run.sh boot      --secs 15     (time-to-first-frame, REG_DELAY=8 s coverage)
+#   ./run.sh telemetry --secs 60     (batched vs per-detection radio-on time)
+#   ./run.sh thumbs    --frames 30   (thumbnail-first vs full uploads, bytes per day)
+#   ./run.sh alert     --secs 90     (CoAP alert latency, idle link vs busy uploader)
+#   ./run.sh mqtt      --cycles 4    (HTTP vs MQTT session per wake cycle, offline commands)
+#   ./run.sh power     --secs 150    (modem always awake vs PSM / rails off, energy per byte)
+#   ./run.sh at                      (AT engine against scripted transcripts, pipelining)
+#   ./run.sh time      --secs 120    (clock resync: +CCLK? tick timing, drift, slewing)
+#   ./run.sh faults    --frames 10   (upload through a slow, then a lossy emulated link)
+#   ./run.sh budget    --frames 60   (data plan: plain cut-off vs tiered, velutina first)
+#   ./run.sh sync      --frames 60   (lost cursor: re-send the archive vs manifest delta sync)
+#   ./run.sh vision    --secs 20     (Vision AI: invoke per frame vs continuous invoke, simulated module)
+#   ./run.sh twophase  --secs 20     (Vision AI: image every frame vs boxes first, image on demand)
+#   ./run.sh i2c       --secs 60     (Vision AI I2C clock: fixed 400 kHz / 1 MHz vs probed and adapted)
+set -e
+cd "$(dirname "$0")"
+
+CXX="${CXX:-g++}"
+LIB=../../lib     # code shared with Receiver/Broker, see lib/README.md
+CXXFLAGS="-O2 -std=c++17 -Wall -I../src -I$LIB/vstcore -I$LIB/segstore -I$LIB/i2cbus"
+
+# Everything behind sdcard_save_jpeg()
+STORE_SRC="../src/sdstore.cpp $LIB/segstore/segstore.cpp $LIB/segstore/chunkwriter.cpp ../src/sdwriter.cpp \
+  ../src/frameindex.cpp ../src/metalog.cpp ../src/retention.cpp ../src/sdlayout.cpp"
+
+# Modem uplink (AT dialect -> PDP -> HTTP -> Azure Blob)
+UP_SRC="../src/uploader.cpp ../src/jpegthumb.cpp ../src/azblob.cpp ../src/simhttp.cpp \
+  ../src/simnet.cpp ../src/modem_at.cpp ../src/mqttlink.cpp ../src/upsync.cpp"
+
+BENCH="${1:-storage}"
+[ $# -gt 0 ] && shift
+
+case "$BENCH" in
+  storage)
+    $CXX $CXXFLAGS bench_storage.cpp $STORE_SRC -pthread -o bench_storage
+    ./bench_storage "$@" ;;
+  presync)
+    $CXX $CXXFLAGS bench_storage.cpp $STORE_SRC -pthread -o bench_storage
+    ./bench_storage --modes p "$@" ;;
+  sd)
+    # Same bench on a real FAT32 filesystem: image file -> loop -> vfat.
+    # Needs root and dosfstools. Cluster size 32 KB like a formatted SD.
+    SIZE_MB=512
+    if [ "$1" = "--size-mb" ]; then SIZE_MB="$2"; shift 2; fi
+    IMG="${VST_FAT_IMG:-/tmp/vst_fat.img}"
+    MNT="${VST_FAT_MNT:-/mnt/vstfat}"
+    $CXX $CXXFLAGS bench_storage.cpp $STORE_SRC -pthread -o bench_storage
+    rm -f "$IMG"
+    truncate -s "${SIZE_MB}M" "$IMG"
+    mkfs.vfat -F 32 -s 64 "$IMG" >/dev/null
+    mkdir -p "$MNT"
+    mount -o loop "$IMG" "$MNT"
+    trap 'umount "$MNT"' EXIT
+    ./bench_storage --dir "$MNT" "$@" ;;
+  shard)
+    $CXX $CXXFLAGS bench_shard.cpp ../src/sdlayout.cpp -o bench_shard
+    ./bench_shard "$@" ;;
+  index)
+    $CXX $CXXFLAGS bench_index.cpp ../src/frameindex.cpp -o bench_index
+    ./bench_index "$@" ;;
+  retention)
+    $CXX $CXXFLAGS bench_retention.cpp ../src/retention.cpp ../src/frameindex.cpp \
+        $LIB/segstore/segstore.cpp $LIB/segstore/chunkwriter.cpp ../src/sdlayout.cpp -o bench_retention
+    ./bench_retention "$@" ;;
+  recovery)
+    $CXX $CXXFLAGS bench_recovery.cpp ../src/frameindex.cpp $LIB/segstore/segstore.cpp \
+        $LIB/segstore/chunkwriter.cpp -o bench_recovery
+    ./bench_recovery "$@" ;;
+  upload)
+    # populate -> upload with a power cut -> resume -> read back and compare.
+    # BLOB=azurite uses an already running Azurite instead of the stand-in.
+    FRAMES=30
+    if [ "$1" = "--frames" ]; then FRAMES="$2"; shift 2; fi
+    DIR="${VST_UP_DIR:-/tmp/vst_up}"
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    rm -rf "$DIR"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    if [ "${BLOB:-standin}" != azurite ]; then
+      python3 ../../tools/blob_standin.py & PIDS="$PIDS $!"
+    fi
+    python3 ../../tools/sim7080_emu.py --link "$TTY" & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_upload --dir "$DIR" --populate "$FRAMES" "$@"
+    ./bench_upload --dir "$DIR" --tty "$TTY" --stop-after $((FRAMES / 2)) "$@" || true
+    ./bench_upload --dir "$DIR" --tty "$TTY" "$@"
+    ./bench_upload --dir "$DIR" --tty "$TTY" --verify "$FRAMES" "$@" ;;
+  faults)
+    # Same stored frames through a clean link, a slow one (UART and radio
+    # limits, LTE-M round trips) and a lossy one (slow + ERRORs, commands
+    # left unanswered, failed requests, a coverage gap). The faults are
+    # drawn from SEED, so a run repeats. Each upload is read back.
+    FRAMES=10
+    if [ "$1" = "--frames" ]; then FRAMES="$2"; shift 2; fi
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+    SLOW="--baud ${BAUD:-115200} --uplink-kbps ${UP_KBPS:-300} --downlink-kbps ${DOWN_KBPS:-1000} \
+          --latency-ms ${LATENCY_MS:-300} --pdp-ms ${PDP_MS:-1500} --connect-ms ${CONNECT_MS:-900}"
+    LOSSY="--error-rate ${ERROR_RATE:-0.05} --drop-rate ${DROP_RATE:-0.02} \
+           --http-fail-rate ${HTTP_FAIL_RATE:-0.05} --outage ${OUTAGE:-40:20} --seed ${SEED:-1}"
+    for LINK in clean slow lossy; do
+      case $LINK in
+        clean) EMU_ARGS="" ;;
+        slow)  EMU_ARGS="$SLOW" ;;
+        lossy) EMU_ARGS="$SLOW $LOSSY" ;;
+      esac
+      rm -rf /tmp/vst_faults_$LINK
+      ./bench_upload --dir /tmp/vst_faults_$LINK --populate "$FRAMES" "$@" >/dev/null
+      # shellcheck disable=SC2086
+      python3 ../../tools/sim7080_emu.py --link "$TTY" $EMU_ARGS > /tmp/vst_faults_emu_$LINK.log 2>&1 &
+      EMU=$!
+      sleep 1
+      echo "== $LINK link"
+      ./bench_upload --dir /tmp/vst_faults_$LINK --tty "$TTY" --device vst-$LINK "$@" | \
+          grep -E "^[0-9.]+ s:|^modem:|uploader: frames" || true
+      kill $EMU; wait $EMU 2>/dev/null || true
+      echo "emulator $(grep '^stats:' /tmp/vst_faults_emu_$LINK.log | \
+          grep -oE "'(requests|injected_errors|dropped|http_failed|outages)': [0-9]+" | tr -d "'" | paste -sd ' ')"
+      # read back over a clean link: the stored blobs are checked, not the faults
+      python3 ../../tools/sim7080_emu.py --link "$TTY" >/dev/null 2>&1 &
+      EMU=$!
+      sleep 1
+      ./bench_upload --dir /tmp/vst_faults_$LINK --tty "$TTY" --device vst-$LINK --verify "$FRAMES" "$@" | \
+          grep -E "^verify" || true
+      kill $EMU; wait $EMU 2>/dev/null || true
+    done ;;
+  time)
+    # Boot-time +CCLK? only vs periodic resync with drift compensation,
+    # device clock PPM slow against the emulator's (the host's) clock
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_time.cpp at_pty.cpp ../src/timesync.cpp ../src/modemlink.cpp ../src/modem_at.cpp \
+        -pthread -o bench_time
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/sim7080_emu.py --link "$TTY" --baud "${BAUD:-115200}" >/dev/null 2>&1 & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_time --tty "$TTY" --ppm "${PPM:-1000}" "$@" ;;
+  vision)
+    # Simulated module behind the library's I2C timing: the old invoke +
+    # backoff loop, then continuous invoke (module drops results that find
+    # its buffer full, then holds them)
+    $CXX $CXXFLAGS bench_vision.cpp ../src/sscmalink.cpp $LIB/i2cbus/i2cbus.cpp -o bench_vision
+    ./bench_vision --mode single "$@"
+    ./bench_vision --mode continuous "$@"
+    ./bench_vision --mode continuous --full hold "$@" ;;
+  twophase)
+    # Image with every result vs boxes first and the image only for a
+    # detection (or once a minute); a busy scene, then an empty one
+    $CXX $CXXFLAGS bench_vision.cpp ../src/sscmalink.cpp $LIB/i2cbus/i2cbus.cpp -o bench_vision
+    for DETECT in 0.2 0; do
+      echo "== detection probability $DETECT"
+      ./bench_vision --detect $DETECT "$@"
+      ./bench_vision --detect $DETECT --two-phase 1 "$@"
+    done
+    # The image is a later capture: a hornet still there 60 % of the
+    # time, without and with a retry of the image capture
+    echo "== detection probability 0.2, stays 0.6"
+    for R in 0 1 2; do
+      ./bench_vision --detect 0.2 --stay 0.6 --two-phase 1 --retries $R "$@"
+    done ;;
+  i2c)
+    # Fixed clocks vs the clock manager on a clean bus, on one that
+    # corrupts a byte in RATE of the transactions at 1 MHz, and on one
+    # where 1 MHz does not work at all. Shortened windows so a minute
+    # shows the steps.
+    $CXX $CXXFLAGS bench_vision.cpp ../src/sscmalink.cpp $LIB/i2cbus/i2cbus.cpp -o bench_vision
+    ADAPT="--clocks 100000,400000,1000000 --window-ms 5000 --clean-ms ${CLEAN_MS:-10000}"
+    SHOW="^continuous|^frames|^i2c|🔌 i2c .*KB/s|🔌 i2c: [0-9]+ down"
+    for BUS in clean flaky broken; do
+      case $BUS in
+        clean)  FAULT="" ;;
+        flaky)  FAULT="--fault 1000000:${RATE:-0.002}" ;;
+        broken) FAULT="--fault 1000000:0.5" ;;
+      esac
+      echo "== $BUS bus"
+      # shellcheck disable=SC2086
+      for CLOCK in "--hz 400000" "--hz 1000000" "$ADAPT"; do
+        ./bench_vision $CLOCK $FAULT "$@" | grep -E "$SHOW"
+      done
+    done ;;
+  at)
+    $CXX $CXXFLAGS bench_at.cpp ../src/modem_at.cpp ../src/modemlink.cpp -pthread -o bench_at
+    ./bench_at "$@" ;;
+  boot)
+    # Async boot (capture at once) vs the old blocking order, same coverage
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_boot.cpp at_pty.cpp $STORE_SRC ../src/modemlink.cpp ../src/modem_at.cpp \
+        -pthread -o bench_boot
+    for ORDER in 0 1; do
+      rm -rf /tmp/vst_boot$ORDER
+      python3 ../../tools/sim7080_emu.py --link "$TTY" --reg-delay "${REG_DELAY:-8}" >/dev/null &
+      EMU=$!
+      sleep 1
+      ./bench_boot --dir /tmp/vst_boot$ORDER --tty "$TTY" --blocking $ORDER "$@" || true
+      kill $EMU; wait $EMU 2>/dev/null || true
+    done ;;
+  telemetry)
+    # Same detection trace sent one detection per session, then batched.
+    # PDP_MS / LATENCY_MS play bearer setup and LTE-M round trips.
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    BLOBS="${VST_BLOBS:-/tmp/vst_telem_blobs}"
+    $CXX $CXXFLAGS bench_telemetry.cpp at_pty.cpp ../src/telemetry.cpp $UP_SRC \
+        ../src/frameindex.cpp ../src/sdlayout.cpp $LIB/segstore/segstore.cpp $LIB/segstore/chunkwriter.cpp -pthread -o bench_telemetry
+    rm -rf "$BLOBS"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py --dir "$BLOBS" >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" --pdp-ms "${PDP_MS:-1500}" \
+        --latency-ms "${LATENCY_MS:-300}" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_telemetry --tty "$TTY" --device vst-single --records 1 "$@" || true
+    ./bench_telemetry --tty "$TTY" --device vst-batch "$@" || true
+    for D in vst-single vst-batch; do
+      printf "%s stored: " $D
+      python3 ../../tools/vtb_decode.py "$BLOBS/frames/$D" --summary
+    done ;;
+  thumbs)
+    # Same stored frames uploaded in full, then thumbnail-first; then one
+    # frame the policy skipped is requested and must arrive in full.
+    FRAMES=30
+    if [ "$1" = "--frames" ]; then FRAMES="$2"; shift 2; fi
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    BLOBS="${VST_BLOBS:-/tmp/vst_thumb_blobs}"
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    rm -rf /tmp/vst_full /tmp/vst_thumb "$BLOBS"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py --dir "$BLOBS" >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_upload --dir /tmp/vst_full --populate "$FRAMES" "$@" >/dev/null
+    ./bench_upload --dir /tmp/vst_thumb --populate "$FRAMES" "$@" >/dev/null
+    echo "== full frames"
+    ./bench_upload --dir /tmp/vst_full --tty "$TTY" --device vst-full "$@" | grep -E "^today|^[0-9.]+ s:"
+    echo "== thumbnails first"
+    ./bench_upload --dir /tmp/vst_thumb --tty "$TTY" "$@" --thumb 1 | grep -E "^today|^[0-9.]+ s:"
+    # A thumbnail without its full frame, asked for by the "server"
+    T=$(cd "$BLOBS/frames/vst-0001" && for t in */*_t.jpg; do
+          [ -e "${t%_t.jpg}.jpg" ] || { echo "${t%_t.jpg}"; break; }; done)
+    python3 ../../tools/request_full.py --device vst-0001 "$T"
+    ./bench_upload --dir /tmp/vst_thumb --tty "$TTY" "$@" --thumb 1 --poll-ms 1000 | grep -E "^today|on request"
+    if [ -e "$BLOBS/frames/vst-0001/$T.jpg" ]; then echo "OK: $T.jpg arrived on request"; else echo "FAIL: $T.jpg missing"; fi
+    echo "== up/DAYS.CSV"; cat /tmp/vst_full/up/DAYS.CSV /tmp/vst_thumb/up/DAYS.CSV ;;
+  budget)
+    # A day's backlog (thumbnails first, empty frames too) sent without a
+    # plan, then with SHARE % of those modem bytes as the day's budget:
+    # once as a plain cut-off in stored order, once tiered with the leads;
+    # then tiered again on a backlog of crabro and Apis frames only.
+    FRAMES=60
+    if [ "$1" = "--frames" ]; then FRAMES="$2"; shift 2; fi
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    rm -rf /tmp/vst_bud_all /tmp/vst_bud_cut /tmp/vst_bud_tier /tmp/vst_bud_mix
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    for D in all cut tier; do
+      ./bench_upload --dir /tmp/vst_bud_$D --populate "$FRAMES" "$@" >/dev/null
+    done
+    ./bench_upload --dir /tmp/vst_bud_mix --populate "$FRAMES" --kinds 01 "$@" >/dev/null
+    SHOW="^budget|^[0-9.]+ s:"
+    echo "== no plan"
+    ./bench_upload --dir /tmp/vst_bud_all --tty "$TTY" --device vst-all --thumb 1 --all 1 \
+        --velutina-first 0 "$@" | grep -E "$SHOW"
+    ALL=$(tail -1 /tmp/vst_bud_all/up/DAYS.CSV | cut -d, -f8)
+    DAY=$((ALL * ${SHARE:-30} / 100))
+    echo "== cut-off at $DAY B (${SHARE:-30}% of $ALL B)"
+    ./bench_upload --dir /tmp/vst_bud_cut --tty "$TTY" --device vst-cut --thumb 1 --all 1 \
+        --budget-day "$DAY" --full-pct 100,100,100 --thumb-pct 100,100,100 --velutina-first 0 "$@" | grep -E "$SHOW"
+    echo "== tiered, velutina first"
+    ./bench_upload --dir /tmp/vst_bud_tier --tty "$TTY" --device vst-tier --thumb 1 --all 1 \
+        --budget-day "$DAY" "$@" | grep -E "$SHOW|💸"
+    echo "== tiered, crabro and Apis backlog"
+    ./bench_upload --dir /tmp/vst_bud_mix --tty "$TTY" --device vst-mix --thumb 1 --all 1 \
+        --budget-day "$DAY" "$@" | grep -E "$SHOW" ;;
+  sync)
+    # Two devices with the same archive, all of it in the container but
+    # DROP blobs; ids restart after a reboot. Both lose their cursor: one
+    # walks and re-sends everything, one syncs a manifest first.
+    FRAMES=60
+    DROP=5
+    if [ "$1" = "--frames" ]; then FRAMES="$2"; shift 2; fi
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    BLOBS="${VST_BLOBS:-/tmp/vst_sync_blobs}"
+    ACC=http://127.0.0.1:10000/devstoreaccount1
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    rm -rf /tmp/vst_sync_a /tmp/vst_sync_b "$BLOBS"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py --dir "$BLOBS" >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sync_standin.py --blob "$ACC" >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    for D in a b; do
+      ./bench_upload --dir /tmp/vst_sync_$D --populate "$FRAMES" "$@" >/dev/null
+      ./bench_upload --dir /tmp/vst_sync_$D --tty "$TTY" --device vst-s$D "$@" >/dev/null
+      sleep 1
+      ./bench_upload --dir /tmp/vst_sync_$D --populate $((FRAMES / 2)) "$@" >/dev/null
+      ./bench_upload --dir /tmp/vst_sync_$D --tty "$TTY" --device vst-s$D "$@" >/dev/null
+      rm -f /tmp/vst_sync_$D/up/CURSOR.VUC
+      (cd "$BLOBS/frames" && ls vst-s$D/*/*.jpg | awk -v n="$DROP" 'NR % 7 == 3 && k++ < n') |
+        while read -r B; do curl -s -X DELETE "$ACC/frames/$B" >/dev/null; done
+    done
+    echo "== cursor lost, $DROP blobs gone: walk"
+    ./bench_upload --dir /tmp/vst_sync_a --tty "$TTY" --device vst-sa "$@" | grep -E "^[0-9.]+ s:|^modem"
+    echo "== same, manifest first"
+    ./bench_upload --dir /tmp/vst_sync_b --tty "$TTY" --device vst-sb --sync-url http://127.0.0.1:10001/sync \
+        --sync-backlog 1 "$@" | grep -E "^[0-9.]+ s:|^modem|^sync|🔁"
+    ./bench_upload --dir /tmp/vst_sync_b --tty "$TTY" --device vst-sb --verify 100000 "$@" | grep -E "^verify|MISMATCH" ;;
+  alert)
+    # Same detection trace with the link idle, then while the uploader
+    # works through 30 stored frames. Alerts land in $ALERTS.
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    ALERTS="${VST_ALERTS:-/tmp/vst_alerts.jsonl}"
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    $CXX $CXXFLAGS bench_alert.cpp at_pty.cpp ../src/alert.cpp $STORE_SRC $UP_SRC -pthread -o bench_alert
+    rm -rf /tmp/vst_alert "$ALERTS"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/coap_standin.py --log "$ALERTS" >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" --pdp-ms "${PDP_MS:-1500}" \
+        --latency-ms "${LATENCY_MS:-300}" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_upload --dir /tmp/vst_alert --populate 30 >/dev/null
+    ./bench_alert --tty "$TTY" "$@" || true
+    ./bench_alert --tty "$TTY" --dir /tmp/vst_alert "$@" || true
+    echo "server received $(wc -l < "$ALERTS") alerts" ;;
+  mqtt)
+    # Metadata + thumbnails per wake cycle: HTTP, MQTT confirming every
+    # message, MQTT pipelined. Then a command published while the node is
+    # away must arrive on its next session, and the uploader's MQTT
+    # thumbnails must survive a session cut by the broker.
+    # BROKER=mosquitto uses a running Mosquitto on 1883 instead.
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    LOG="${VST_MQTT_LOG:-/tmp/vst_mqtt.jsonl}"
+    $CXX $CXXFLAGS bench_mqtt.cpp at_pty.cpp ../src/telemetry.cpp $UP_SRC \
+        ../src/frameindex.cpp ../src/sdlayout.cpp $LIB/segstore/segstore.cpp $LIB/segstore/chunkwriter.cpp -pthread -o bench_mqtt
+    $CXX $CXXFLAGS bench_upload.cpp at_pty.cpp $STORE_SRC $UP_SRC -pthread -o bench_upload
+    rm -rf /tmp/vst_mqtt_up "$LOG"
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    if [ "${BROKER:-standin}" != mosquitto ]; then
+      python3 ../../tools/mqtt_standin.py --log "$LOG" >/dev/null & PIDS="$PIDS $!"
+    fi
+    python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+    python3 ../../tools/sim7080_emu.py --link "$TTY" --pdp-ms "${PDP_MS:-1500}" \
+        --latency-ms "${LATENCY_MS:-300}" --connect-ms "${CONNECT_MS:-900}" >/dev/null & PIDS="$PIDS $!"
+    sleep 1
+    ./bench_mqtt --tty "$TTY" --mode http "$@" || true
+    ./bench_mqtt --tty "$TTY" --mode mqtt --window 1 "$@" || true
+    ./bench_mqtt --tty "$TTY" --mode mqtt "$@" || true
+    echo "== command while the node is away"
+    python3 ../../tools/mqtt_standin.py pub --topic vst-0001/cmd "full 20260601/120455_001042"
+    ./bench_mqtt --tty "$TTY" --mode mqtt --cycles 1 --wait-s 1 "$@" | grep -E "^command|^mqtt pipelined" || true
+    if [ "${BROKER:-standin}" != mosquitto ]; then
+      echo "== uploader thumbnails over MQTT, session cut on the 5th publish"
+      kill $PIDS 2>/dev/null; wait 2>/dev/null || true
+      PIDS=""
+      python3 ../../tools/mqtt_standin.py --kill-after 5 --dir /tmp/vst_mqtt_up/broker >/dev/null & PIDS="$PIDS $!"
+      python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+      python3 ../../tools/sim7080_emu.py --link "$TTY" >/dev/null & PIDS="$PIDS $!"
+      sleep 1
+      ./bench_upload --dir /tmp/vst_mqtt_up --populate 30 >/dev/null
+      ./bench_upload --dir /tmp/vst_mqtt_up --tty "$TTY" --thumb 1 --mqtt 1 | grep -E "^mqtt|^today"
+      echo "thumbnails at the broker: $(find /tmp/vst_mqtt_up/broker/vst-0001 -name '*_t.jpg*' -path '*/2*' | \
+          sed 's,_t.jpg.*,,' | sort -u | wc -l)"
+    fi ;;
+  power)
+    # Same day / night trace with the modem always awake, then with the
+    # power manager: PSM between wakes, rails off at night. The emulator
+    # gets PWRKEY and the rails as signals.
+    TTY="${VST_MODEM:-/tmp/vst_modem}"
+    $CXX $CXXFLAGS bench_power.cpp at_pty.cpp ../src/modempower.cpp ../src/modemlink.cpp $UP_SRC \
+        ../src/frameindex.cpp ../src/sdlayout.cpp $LIB/segstore/segstore.cpp $LIB/segstore/chunkwriter.cpp -pthread -o bench_power
+    PIDS=""
+    trap 'kill $PIDS 2>/dev/null' EXIT
+    python3 ../../tools/blob_standin.py >/dev/null & PIDS="$PIDS $!"
+    for MANAGED in 0 1; do
+      python3 ../../tools/sim7080_emu.py --link "$TTY" --pdp-ms "${PDP_MS:-1500}" \
+          --latency-ms "${LATENCY_MS:-300}" > /tmp/vst_power_emu$MANAGED.log 2>&1 &
+      EMU=$!
+      sleep 1
+      ./bench_power --tty "$TTY" --emu-pid $EMU --managed $MANAGED "$@" | grep -E "^(always|managed)" || true
+      kill $EMU; wait $EMU 2>/dev/null || true
+      echo "emulator $(grep '^power:' /tmp/vst_power_emu$MANAGED.log | tail -1)"
+    done ;;
+  *)
+    echo "usage: $0 {storage|sd|shard|index|retention|recovery|upload|faults|at|time|boot|telemetry|thumbs|budget|sync|vision|twophase|i2c|alert|mqtt|power} [args]"; exit 1 ;;
+esac
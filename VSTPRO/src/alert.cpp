@@ -0,0 +1,531 @@
+// src/alert.cpp — hornet alerts over UDP / CoAP (see alert.h)
+
+#include "alert.h"
+#include "config.h"
+#include "modem_at.h"
+#include "modempower.h"
+#include "simnet.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+static SemaphoreHandle_t g_mux = nullptr;
+static TaskHandle_t g_task = nullptr;
+static inline void r_lock()   { if (g_mux) xSemaphoreTake(g_mux, portMAX_DELAY); }
+static inline void r_unlock() { if (g_mux) xSemaphoreGive(g_mux); }
+static inline void wake()     { if (g_task) xTaskNotifyGive(g_task); }
+#else
+#include <mutex>
+static std::mutex g_mux;
+static inline void r_lock()   { g_mux.lock(); }
+static inline void r_unlock() { g_mux.unlock(); }
+static inline void wake()     {}
+#endif
+
+static constexpr uint32_t ALERT_EPOCH_MIN = 1577836800;  // 2020-01-01, as frameindex
+static constexpr int      ALERT_CID       = 0;           // AT+CAOPEN connection id
+static constexpr uint8_t  ALERT_VERSION   = 1;
+
+// CoAP (RFC 7252)
+static constexpr uint8_t COAP_CON  = 0, COAP_NON = 1, COAP_ACK = 2, COAP_RST = 3;
+static constexpr uint8_t COAP_POST = 0x02;
+static constexpr uint8_t COAP_OPT_URI_PATH = 11, COAP_OPT_CONTENT_FORMAT = 12;
+static constexpr uint8_t COAP_OCTET_STREAM = 42;
+
+struct Pending
+{
+    bool     valid;
+    bool     limited;       // counted as rate limited once
+    uint32_t first_ms;      // first detection, monotonic
+    uint32_t due_ms;        // allowed out (gap and token free), 0 = not yet
+    uint32_t frames;
+    uint32_t frame_id;      // of the best box
+    FrameBox best;
+};
+
+static AlertConfig g_cfg = {};
+static bool        g_ready = false;
+static Pending     g_pend = {};
+static uint32_t    g_last_sent_ms = 0;
+static bool        g_sent_any = false;
+static uint32_t    g_tokens_x1000 = 0;      // token bucket, milli-tokens
+static uint32_t    g_refill_at = 0;
+static uint16_t    g_seq = 0;
+static uint16_t    g_msg_id = 0;
+static bool        g_sock_open = false;
+static uint32_t    g_backoff_ms = 0;
+static uint32_t    g_retry_at = 0;
+static AlertStats  g_stats = {};
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+/* =========================================================
+   COALESCING / RATE LIMIT (capture side)
+   ========================================================= */
+static void merge(Pending &into, const Pending &p)
+{
+    if (!into.valid)
+    {
+        into = p;
+        return;
+    }
+    if ((int32_t)(p.first_ms - into.first_ms) < 0) into.first_ms = p.first_ms;
+    if (p.due_ms && (!into.due_ms || (int32_t)(p.due_ms - into.due_ms) < 0)) into.due_ms = p.due_ms;
+    into.frames += p.frames;
+    if (p.best.score > into.best.score)
+    {
+        into.best = p.best;
+        into.frame_id = p.frame_id;
+    }
+}
+
+void alert_add(uint32_t frame_id, const FrameMeta *meta)
+{
+    if (!g_ready || !meta || !meta->valid) return;
+
+    int best = -1;
+    for (int i = 0; i < (int)meta->box_count && i < (int)FRAME_META_MAX_BOXES; i++)
+    {
+        const FrameBox &b = meta->boxes[i];
+        if (b.target != g_cfg.target || b.score < g_cfg.min_score) continue;
+        if (best < 0 || b.score > meta->boxes[best].score) best = i;
+    }
+    if (best < 0) return;
+
+    Pending p = {};
+    p.valid = true;
+    p.first_ms = mono_ms();
+    p.frames = 1;
+    p.frame_id = frame_id;
+    p.best = meta->boxes[best];
+
+    r_lock();
+    g_stats.detections++;
+    if (g_pend.valid) g_stats.coalesced++;
+    merge(g_pend, p);
+    r_unlock();
+    wake();
+}
+
+static void refill(uint32_t now)
+{
+    uint32_t full = (uint32_t)g_cfg.burst * 1000;
+    if (g_tokens_x1000 >= full)
+    {
+        g_refill_at = now;
+        return;
+    }
+    uint32_t dt = now - g_refill_at;
+    uint32_t add = (uint32_t)((uint64_t)dt * 1000 / g_cfg.refill_ms);
+    if (!add) return;
+    g_tokens_x1000 = g_tokens_x1000 + add > full ? full : g_tokens_x1000 + add;
+    g_refill_at = now;
+}
+
+bool alert_due()
+{
+    if (!g_ready) return false;
+    uint32_t now = mono_ms();
+    if (g_retry_at && (int32_t)(now - g_retry_at) < 0) return false;
+
+    r_lock();
+    bool due = g_pend.valid && (!g_sent_any || now - g_last_sent_ms >= g_cfg.gap_ms);
+    if (due)
+    {
+        refill(now);
+        if (g_tokens_x1000 < 1000)
+        {
+            if (!g_pend.limited) g_stats.rate_limited++;
+            g_pend.limited = true;
+            due = false;
+        }
+        else if (!g_pend.due_ms)
+        {
+            // Held by the gap: out when it ended; by a token: now
+            uint32_t at = g_pend.limited ? now : g_pend.first_ms;
+            if (g_sent_any && (int32_t)(g_last_sent_ms + g_cfg.gap_ms - at) > 0) at = g_last_sent_ms + g_cfg.gap_ms;
+            g_pend.due_ms = at ? at : 1;
+        }
+    }
+    r_unlock();
+    return due;
+}
+
+/* =========================================================
+   ENCODING
+   ========================================================= */
+static size_t put_u16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); return 2; }
+static size_t put_u32(uint8_t *p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); return 4; }
+
+static size_t encode_alert(const Pending &p, uint32_t epoch, uint16_t seq, uint8_t *out)
+{
+    size_t node = strlen(g_cfg.device_id);
+    if (node > ALERT_NODE_MAX) node = ALERT_NODE_MAX;
+
+    size_t n = 0;
+    out[n++] = ALERT_VERSION;
+    out[n++] = (uint8_t)node;
+    memcpy(out + n, g_cfg.device_id, node);
+    n += node;
+    n += put_u32(out + n, epoch);
+    n += put_u32(out + n, p.frame_id);
+    n += put_u16(out + n, p.frames > 0xFFFF ? 0xFFFF : (uint16_t)p.frames);
+    n += put_u16(out + n, seq);
+    out[n++] = p.best.target;
+    out[n++] = p.best.score;
+    n += put_u16(out + n, p.best.x);
+    n += put_u16(out + n, p.best.y);
+    n += put_u16(out + n, p.best.w);
+    n += put_u16(out + n, p.best.h);
+    return n;
+}
+
+static size_t coap_option(uint8_t *p, uint8_t delta, const uint8_t *val, size_t len)
+{
+    // Deltas here are < 13; lengths up to 268 (one extended byte)
+    size_t n = 0;
+    if (len < 13)
+    {
+        p[n++] = (uint8_t)(delta << 4 | len);
+    }
+    else
+    {
+        p[n++] = (uint8_t)(delta << 4 | 13);
+        p[n++] = (uint8_t)(len - 13);
+    }
+    memcpy(p + n, val, len);
+    return n + len;
+}
+
+static size_t encode_coap(uint16_t msg_id, uint16_t token, const uint8_t *payload, size_t len, uint8_t *out)
+{
+    size_t n = 0;
+    out[n++] = (uint8_t)(0x40 | (g_cfg.confirmable ? COAP_CON : COAP_NON) << 4 | 2);
+    out[n++] = COAP_POST;
+    out[n++] = (uint8_t)(msg_id >> 8);
+    out[n++] = (uint8_t)msg_id;
+    out[n++] = (uint8_t)(token >> 8);
+    out[n++] = (uint8_t)token;
+
+    uint8_t last = 0;
+    size_t path = g_cfg.path ? strlen(g_cfg.path) : 0;
+    if (path)
+    {
+        n += coap_option(out + n, COAP_OPT_URI_PATH, (const uint8_t*)g_cfg.path, path);
+        last = COAP_OPT_URI_PATH;
+    }
+    n += coap_option(out + n, COAP_OPT_CONTENT_FORMAT - last, &COAP_OCTET_STREAM, 1);
+
+    out[n++] = 0xFF;
+    memcpy(out + n, payload, len);
+    return n + len;
+}
+
+/* =========================================================
+   UDP SOCKET (AT+CA*)
+   ========================================================= */
+static bool sock_open()
+{
+    if (g_sock_open) return true;
+    char v[16];
+    if (at_cmd(10000, "+CAOPEN=%d,0,\"UDP\",\"%s\",%u", ALERT_CID, g_cfg.host, g_cfg.port) != AtResult::OK ||
+        !at_find("+CAOPEN: ", v, sizeof(v)) || atoi(strchr(v, ',') ? strchr(v, ',') + 1 : "1") != 0)
+    {
+        VST_LOG("❌ alert: CAOPEN %s:%u failed\n", g_cfg.host, g_cfg.port);
+        return false;
+    }
+    g_sock_open = true;
+    return true;
+}
+
+static void sock_close()
+{
+    if (g_sock_open) at_cmd(3000, "+CACLOSE=%d", ALERT_CID);
+    g_sock_open = false;
+}
+
+static bool sock_send(const uint8_t *msg, size_t len)
+{
+    if (!at_send("+CASEND=%d,%u", ALERT_CID, (unsigned)len) || !at_wait_prompt(3000))
+        return false;
+    if (!at_write(msg, len)) return false;
+    return at_result(5000) == AtResult::OK;
+}
+
+// One datagram after +CADATAIND; returns its length, 0 if none, -1 on error
+static int sock_recv(uint8_t *buf, size_t cap, uint32_t timeout_ms)
+{
+    char urc[16];
+    if (!at_wait_line("+CADATAIND: ", urc, sizeof(urc), timeout_ms)) return 0;
+
+    // +CARECV: <len>,<data>   (data is binary, on the same line)
+    if (!at_send("+CARECV=%d,%u", ALERT_CID, (unsigned)cap) || !at_wait_text("+CARECV: ", 2000))
+        return -1;
+    size_t n = 0;
+    char c = 0;
+    while (at_read(&c, 1, 1000) && c >= '0' && c <= '9') n = n * 10 + (size_t)(c - '0');
+    if (c != ',' || n > cap) n = 0;
+    if (n && !at_read(buf, n, 2000)) return -1;
+    at_result(2000);
+    return (int)n;
+}
+
+/* =========================================================
+   SENDING
+   ========================================================= */
+static UpState fail(const char *what)
+{
+    g_stats.failures++;
+    g_backoff_ms = g_backoff_ms ? g_backoff_ms * 2 : g_cfg.retry_ms;
+    if (g_backoff_ms > g_cfg.retry_ms * 16) g_backoff_ms = g_cfg.retry_ms * 16;
+    g_retry_at = mono_ms() + g_backoff_ms;
+    VST_LOG("⚠️ alert: %s failed, retry in %lu ms\n", what, (unsigned long)g_backoff_ms);
+    return UpState::BACKOFF;
+}
+
+enum class Ack : uint8_t { OK, REJECTED, NONE };
+
+// Sends msg and, if confirmable, waits for the matching ACK with CoAP's
+// retransmission schedule. Reopens the socket once if a send fails (the
+// bearer may have been cycled by another task).
+static Ack deliver(const uint8_t *msg, size_t len, uint16_t msg_id)
+{
+    uint32_t wait = g_cfg.ack_ms;
+    for (uint8_t attempt = 0; attempt <= g_cfg.retries; attempt++)
+    {
+        if (attempt) g_stats.retransmits++;
+        if (!sock_send(msg, len))
+        {
+            sock_close();
+            if (!sock_open() || !sock_send(msg, len)) return Ack::NONE;
+        }
+        if (!g_cfg.confirmable) return Ack::OK;
+
+        uint32_t t0 = mono_ms();
+        while (mono_ms() - t0 < wait)
+        {
+            uint8_t rx[ALERT_MSG_MAX];
+            int n = sock_recv(rx, sizeof(rx), wait - (mono_ms() - t0));
+            if (n < 0) return Ack::NONE;
+            if (n < 4 || rx[0] >> 6 != 1) continue;
+            uint8_t type = (rx[0] >> 4) & 3;
+            uint16_t id = (uint16_t)(rx[2] << 8 | rx[3]);
+            if (id != msg_id) continue;             // late ACK of an earlier alert
+            if (type == COAP_RST) return Ack::REJECTED;
+            if (type != COAP_ACK) continue;
+            // Empty ACK (separate response follows) or 2.xx: delivered
+            uint8_t cls = rx[1] >> 5;
+            return rx[1] == 0 || cls == 2 ? Ack::OK : Ack::REJECTED;
+        }
+        wait *= 2;
+    }
+    return Ack::NONE;
+}
+
+UpState alert_step()
+{
+    if (!alert_due()) return UpState::IDLE;
+    g_retry_at = 0;
+
+    r_lock();
+    Pending p = g_pend;
+    g_pend = {};
+    r_unlock();
+
+    uint32_t now = mono_ms();
+    uint32_t wall = (uint32_t)time(nullptr);
+    uint32_t epoch = wall >= ALERT_EPOCH_MIN ? wall - (now - p.first_ms) / 1000 : 0;
+    uint8_t payload[ALERT_MSG_MAX - 16], msg[ALERT_MSG_MAX];
+    size_t plen = encode_alert(p, epoch, g_seq, payload);
+    uint16_t msg_id = ++g_msg_id;
+    size_t len = encode_coap(msg_id, g_seq, payload, plen, msg);
+
+    const AtStats &as = at_stats();
+    uint64_t wire0 = as.tx_bytes + as.rx_bytes;
+    bool shared = simnet_is_up();
+    if (!shared) g_sock_open = false;       // bearer went down under the socket
+
+    Ack ack = Ack::NONE;
+    const char *what = "bearer";
+    if (simnet_up(g_cfg.apn, 60000))
+    {
+        what = "CAOPEN";
+        if (sock_open())
+        {
+            what = "CoAP send";
+            ack = deliver(msg, len, msg_id);
+        }
+    }
+
+    if (!g_cfg.keep_link)
+    {
+        sock_close();
+        if (!shared) simnet_down();
+    }
+    g_stats.sessions += !shared;
+    g_stats.wire_bytes += as.tx_bytes + as.rx_bytes - wire0;
+
+    if (ack == Ack::NONE)
+    {
+        // Keep it: merged with whatever was detected meanwhile
+        r_lock();
+        p.limited = false;
+        merge(g_pend, p);
+        r_unlock();
+        return fail(what);
+    }
+
+    uint32_t done = mono_ms();
+    r_lock();
+    refill(done);
+    g_tokens_x1000 -= g_tokens_x1000 >= 1000 ? 1000 : g_tokens_x1000;
+    r_unlock();
+    g_last_sent_ms = done;
+    g_sent_any = true;
+    g_seq++;
+    g_backoff_ms = 0;
+
+    if (ack == Ack::REJECTED)
+    {
+        // The server answered: retrying the same payload will not help
+        g_stats.failures++;
+        VST_LOG("❌ alert: server rejected alert %u\n", (unsigned)(uint16_t)(g_seq - 1));
+        return UpState::BUSY;
+    }
+
+    // Time the alert could have left: held repeats do not count
+    uint32_t latency = done - p.due_ms;
+    g_stats.alerts++;
+    g_stats.last_latency_ms = latency;
+    if (latency > g_stats.max_latency_ms) g_stats.max_latency_ms = latency;
+    g_stats.sum_latency_ms += latency;
+
+    VST_LOG("🐝 alert %u: velutina %u%% frame %lu (%lu frames over %lu s) sent in %lu ms\n",
+            (unsigned)(uint16_t)(g_seq - 1), p.best.score, (unsigned long)p.frame_id,
+            (unsigned long)p.frames, (unsigned long)((p.due_ms - p.first_ms) / 1000),
+            (unsigned long)latency);
+    return UpState::BUSY;
+}
+
+/* =========================================================
+   INIT / TASK
+   ========================================================= */
+AlertConfig alert_default_config()
+{
+    AlertConfig c{};
+    c.apn = MODEM_APN;
+    c.host = ALERT_HOST;
+    c.port = ALERT_PORT;
+    c.path = ALERT_PATH;
+    c.device_id = DEVICE_ID;
+    c.target = ALERT_TARGET;
+    c.min_score = ALERT_MIN_SCORE;
+    c.gap_ms = ALERT_GAP_MS;
+    c.burst = ALERT_BURST;
+    c.refill_ms = ALERT_REFILL_MS;
+    c.confirmable = true;
+    c.ack_ms = ALERT_ACK_MS;
+    c.retries = ALERT_RETRIES;
+    c.keep_link = ALERT_KEEP_LINK;
+    c.retry_ms = UP_RETRY_MS;
+    return c;
+}
+
+bool alert_init(const AlertConfig &cfg)
+{
+    g_cfg = cfg;
+    if (!g_cfg.host || !g_cfg.host[0])
+    {
+        VST_LOG("❌ alert: no CoAP host configured\n");
+        return false;
+    }
+    if (g_cfg.path && strlen(g_cfg.path) > 24)
+    {
+        VST_LOG("❌ alert: Uri-Path '%s' too long\n", g_cfg.path);
+        return false;
+    }
+    if (!g_cfg.device_id) g_cfg.device_id = "";
+    if (!g_cfg.burst) g_cfg.burst = 1;
+    if (!g_cfg.refill_ms) g_cfg.refill_ms = 1;
+    if (!g_cfg.ack_ms) g_cfg.ack_ms = 1000;
+    if (!g_cfg.retry_ms) g_cfg.retry_ms = 1000;
+#if defined(ARDUINO)
+    if (!g_mux) g_mux = xSemaphoreCreateMutex();
+#endif
+
+    r_lock();
+    g_pend = {};
+    g_tokens_x1000 = (uint32_t)g_cfg.burst * 1000;
+    g_refill_at = mono_ms();
+    memset(&g_stats, 0, sizeof(g_stats));
+    r_unlock();
+    g_sent_any = false;
+    g_seq = 0;
+    g_msg_id = (uint16_t)(mono_ms() ^ (uint32_t)time(nullptr));
+    g_sock_open = false;
+    g_backoff_ms = g_retry_at = 0;
+    g_ready = true;
+
+    VST_LOG("🐝 alert: CoAP %s:%u/%s, target %u >= %u%%, one per %lu s, %u then one per %lu s\n",
+            g_cfg.host, g_cfg.port, g_cfg.path ? g_cfg.path : "", g_cfg.target, g_cfg.min_score,
+            (unsigned long)(g_cfg.gap_ms / 1000), g_cfg.burst, (unsigned long)(g_cfg.refill_ms / 1000));
+    return true;
+}
+
+#if defined(ARDUINO)
+static void alert_task(void *)
+{
+    for (;;)
+    {
+        UpState s = UpState::IDLE;
+        if (alert_due())
+        {
+            // Asleep: alert_due() wakes the modem (modempower.h), retry then
+            at_lock();
+            if (power_awake()) s = alert_step();
+            at_unlock();
+        }
+        // Woken by alert_add(); the timeout covers gap / token / backoff
+        if (s != UpState::BUSY) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(250));
+    }
+}
+
+void alert_start_task()
+{
+    // Above the uploader and telemetry (1): first in line for the modem
+    xTaskCreatePinnedToCore(alert_task, "alert", 4096, nullptr, 2, &g_task, 0);
+}
+#else
+void alert_start_task()
+{
+}
+#endif
+
+const AlertStats &alert_stats()
+{
+    return g_stats;
+}
+
+void alert_log_stats()
+{
+    const AlertStats &s = g_stats;
+    VST_LOG("📊 alert: detections=%lu alerts=%lu coalesced=%lu rate-limited=%lu retransmits=%lu failures=%lu | "
+            "latency avg %lu ms max %lu ms | %.1f B on the wire per alert\n",
+            (unsigned long)s.detections, (unsigned long)s.alerts, (unsigned long)s.coalesced,
+            (unsigned long)s.rate_limited, (unsigned long)s.retransmits, (unsigned long)s.failures,
+            (unsigned long)(s.alerts ? s.sum_latency_ms / s.alerts : 0), (unsigned long)s.max_latency_ms,
+            s.alerts ? (double)s.wire_bytes / s.alerts : 0.0);
+}
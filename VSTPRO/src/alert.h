@@ -0,0 +1,65 @@
+// src/alert.h — low-latency hornet alerts as CoAP over a SIM7080 UDP socket
+//
+// Coalescing, rate limit and retransmits: README 1.6; payload: README 1.13.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+#include "uploader.h"
+
+static constexpr size_t ALERT_NODE_MAX = 32;
+static constexpr size_t ALERT_MSG_MAX  = 96;     // CoAP datagram
+
+struct AlertConfig
+{
+    const char *apn;
+    const char *host;
+    uint16_t    port;
+    const char *path;           // Uri-Path, "" = none
+    const char *device_id;
+    uint8_t     target;
+    uint8_t     min_score;
+    uint32_t    gap_ms;         // min time between two alerts
+    uint8_t     burst;          // token bucket size
+    uint32_t    refill_ms;      // one token per refill_ms
+    bool        confirmable;    // CON (ACK + retransmit) or NON
+    uint32_t    ack_ms;
+    uint8_t     retries;
+    bool        keep_link;      // leave bearer and socket up between alerts
+    uint32_t    retry_ms;
+};
+
+struct AlertStats
+{
+    uint32_t detections;        // qualifying boxes seen
+    uint32_t alerts;            // sent (and ACKed if confirmable)
+    uint32_t coalesced;         // detections merged into an earlier one
+    uint32_t rate_limited;      // times a pending alert waited for a token
+    uint32_t retransmits;
+    uint32_t failures;
+    uint32_t sessions;          // bearer brought up for an alert
+    uint32_t last_latency_ms;   // detection (or end of the gap / rate hold) -> ACK
+    uint32_t max_latency_ms;
+    uint64_t sum_latency_ms;
+    uint64_t wire_bytes;        // modem UART bytes of the sends
+};
+
+AlertConfig alert_default_config();
+
+bool alert_init(const AlertConfig &cfg);
+
+// Capture side: one call per inferred frame. Never touches the modem.
+void alert_add(uint32_t frame_id, const FrameMeta *meta);
+
+// An alert is pending and may go out now (gap, token, backoff).
+bool alert_due();
+
+// Sends the pending alert. Caller holds the modem (at_lock()).
+UpState alert_step();
+
+// ESP32: task above the uploader that sends alerts as they come.
+void alert_start_task();
+
+const AlertStats &alert_stats();
+void alert_log_stats();
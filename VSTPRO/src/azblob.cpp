@@ -0,0 +1,159 @@
+// src/azblob.cpp — Azure block blobs over simhttp (see azblob.h)
+
+#include "azblob.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static constexpr const char *AZ_API_VERSION = "2019-12-12";   // Azurite 3.x and Azure
+
+static char     g_base[96];         // scheme://host[:port]
+static char     g_prefix[48];       // account path (Azurite) or ""
+static AzConfig g_cfg = {};
+
+static const SimHttpHeader VERSION_HDR = { "x-ms-version", AZ_API_VERSION };
+
+/* =========================================================
+   UTIL
+   ========================================================= */
+void azblob_block_id(uint32_t index, char out[AZ_BLOCK_ID_LEN + 1])
+{
+    static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    char raw[8];
+    snprintf(raw, sizeof(raw), "b%05lu", (unsigned long)(index % 100000));
+
+    // 6 bytes -> 8 chars, no padding. 'b' + digits never map to '+' or '/',
+    // so the id goes into the query string as is.
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t *p = (const uint8_t*)raw + i * 3;
+        uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+        out[i * 4 + 0] = B64[(v >> 18) & 63];
+        out[i * 4 + 1] = B64[(v >> 12) & 63];
+        out[i * 4 + 2] = B64[(v >> 6) & 63];
+        out[i * 4 + 3] = B64[v & 63];
+    }
+    out[AZ_BLOCK_ID_LEN] = 0;
+}
+
+// "/<prefix>/<container>[/<blob>]?<query>[&<sas>]"
+static bool make_path(char *out, size_t out_sz, const char *blob, const char *query)
+{
+    bool sas = g_cfg.sas && g_cfg.sas[0];
+    int n = snprintf(out, out_sz, "%s/%s%s%s%s%s%s%s",
+                     g_prefix, g_cfg.container,
+                     blob ? "/" : "", blob ? blob : "",
+                     (sas || query[0]) ? "?" : "",
+                     query, (sas && query[0]) ? "&" : "", sas ? g_cfg.sas : "");
+    return n > 0 && (size_t)n < out_sz;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+bool azblob_begin(const AzConfig &cfg)
+{
+    g_cfg = cfg;
+    if (!cfg.endpoint || !cfg.container) return false;
+
+    const char *host = strstr(cfg.endpoint, "://");
+    if (!host) return false;
+    const char *slash = strchr(host + 3, '/');
+    size_t base_len = slash ? (size_t)(slash - cfg.endpoint) : strlen(cfg.endpoint);
+
+    if (base_len >= sizeof(g_base)) return false;
+    memcpy(g_base, cfg.endpoint, base_len);
+    g_base[base_len] = 0;
+
+    snprintf(g_prefix, sizeof(g_prefix), "%s", slash ? slash : "");
+    size_t pl = strlen(g_prefix);
+    if (pl && g_prefix[pl - 1] == '/') g_prefix[pl - 1] = 0;
+    return true;
+}
+
+bool azblob_connect()
+{
+    return simhttp_connect(g_base);
+}
+
+bool azblob_ensure_container()
+{
+    char path[SH_PATH_MAX];
+    if (!make_path(path, sizeof(path), nullptr, "restype=container")) return false;
+
+    int st = simhttp_request(SimHttpMethod::PUT, path, &VERSION_HDR, 1, nullptr, 0);
+    if (st == 201 || st == 409) return true;
+
+    VST_LOG("❌ azblob: create container '%s' -> %d\n", g_cfg.container, st);
+    return false;
+}
+
+int azblob_put_block(const char *blob, uint32_t index, const void *data, size_t len)
+{
+    char id[AZ_BLOCK_ID_LEN + 1];
+    azblob_block_id(index, id);
+
+    char query[40];
+    snprintf(query, sizeof(query), "comp=block&blockid=%s", id);
+
+    char path[SH_PATH_MAX];
+    if (!make_path(path, sizeof(path), blob, query)) return -1;
+
+    return simhttp_request(SimHttpMethod::PUT, path, &VERSION_HDR, 1, data, len);
+}
+
+int azblob_put_block_list(const char *blob, uint32_t blocks, const char *content_type)
+{
+    if (!blocks || blocks > AZ_MAX_BLOCKS) return -1;
+
+    static char body[SH_BODY_MAX];
+    size_t n = (size_t)snprintf(body, sizeof(body),
+                                "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>");
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        char id[AZ_BLOCK_ID_LEN + 1];
+        azblob_block_id(i, id);
+        n += (size_t)snprintf(body + n, sizeof(body) - n, "<Latest>%s</Latest>", id);
+    }
+    n += (size_t)snprintf(body + n, sizeof(body) - n, "</BlockList>");
+    if (n >= sizeof(body)) return -1;
+
+    char path[SH_PATH_MAX];
+    if (!make_path(path, sizeof(path), blob, "comp=blocklist")) return -1;
+
+    SimHttpHeader h[] = {
+        VERSION_HDR,
+        { "Content-Type", "application/xml" },
+        { "x-ms-blob-content-type", content_type },
+    };
+    return simhttp_request(SimHttpMethod::PUT, path, h, 3, body, n);
+}
+
+int azblob_put_blob(const char *blob, const void *data, size_t len, const char *content_type)
+{
+    if (len > SH_BODY_MAX) return -1;
+
+    char path[SH_PATH_MAX];
+    if (!make_path(path, sizeof(path), blob, "")) return -1;
+
+    SimHttpHeader h[] = {
+        VERSION_HDR,
+        { "x-ms-blob-type", "BlockBlob" },
+        { "Content-Type", content_type },
+    };
+    return simhttp_request(SimHttpMethod::PUT, path, h, 3, data, len);
+}
+
+int azblob_get_range(const char *blob, uint32_t offset, uint32_t len, uint8_t *out, size_t *out_len)
+{
+    char path[SH_PATH_MAX];
+    if (!make_path(path, sizeof(path), blob, "")) return -1;
+
+    char range[40];
+    snprintf(range, sizeof(range), "bytes=%lu-%lu", (unsigned long)offset, (unsigned long)(offset + len - 1));
+
+    SimHttpHeader h[] = { VERSION_HDR, { "x-ms-range", range } };
+    return simhttp_request(SimHttpMethod::GET, path, h, 2, nullptr, 0, out, len, out_len);
+}
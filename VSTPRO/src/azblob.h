@@ -0,0 +1,44 @@
+// src/azblob.h — Azure Blob Storage block blobs over simhttp (SAS auth)
+//
+// Put Block / Put Block List / ranged GET; also works against Azurite.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "simhttp.h"
+
+// Block ids are base64("b%05u"): same length for every block, as required.
+static constexpr size_t   AZ_BLOCK_ID_LEN = 8;
+// Put Block List body must fit one request: ~25 B per block
+static constexpr uint32_t AZ_MAX_BLOCKS   = (uint32_t)((SH_BODY_MAX - 96) / 25);
+
+struct AzConfig
+{
+    const char *endpoint;   // account URL: https://myaccount.blob.core.windows.net,
+                            // Azurite http://192.168.1.10:10000/devstoreaccount1
+    const char *container;
+    const char *sas;        // query string without '?', "" for none
+};
+
+bool azblob_begin(const AzConfig &cfg);
+
+// Opens the HTTP connection to the account host (simhttp_connect).
+bool azblob_connect();
+
+// Creates the container; 201 and 409 (exists) both count as success.
+bool azblob_ensure_container();
+
+// Return the HTTP status (201 = done), -1 on link failure.
+int azblob_put_block(const char *blob, uint32_t index, const void *data, size_t len);
+int azblob_put_block_list(const char *blob, uint32_t blocks, const char *content_type);
+
+// Whole blob in one request (<= SH_BODY_MAX), for small payloads such as
+// telemetry batches.
+int azblob_put_blob(const char *blob, const void *data, size_t len, const char *content_type);
+
+// Reads [offset, offset + len) of a committed blob (206 / 200), used by
+// the host harness to verify uploads.
+int azblob_get_range(const char *blob, uint32_t offset, uint32_t len,
+                     uint8_t *out, size_t *out_len);
+
+void azblob_block_id(uint32_t index, char out[AZ_BLOCK_ID_LEN + 1]);
@@ -14,10 +14,207 @@ If none provided, default to 7080.
 
 // Common constants
 static constexpr uint32_t LED_ON_MS  = 250;
-static constexpr uint32_t AI_I2C_HZ  = 400000;
+static constexpr uint32_t AI_I2C_HZ  = 400000;   // VisionAI init; then i2cbus.h picks the clock
 static constexpr uint32_t PMU_I2C_HZ = 400000;
 static constexpr uint32_t MODEM_BAUD = 115200;
 
+// VisionAI acquisition (sscmalink.h)
+//   continuous : AT+INVOKE=-1 once, each result collected when the module has it
+//   single     : AT+INVOKE=1 per frame, busy answers retried with backoff (original loop)
+static constexpr bool     AI_CONTINUOUS        = true;
+static constexpr uint16_t AI_POLL_MS           = 5;        // available() poll while waiting for a result
+static constexpr uint32_t AI_RESULT_TIMEOUT_MS = 5000;     // no result this long: reinit
+static constexpr uint32_t AI_RX_BUF            = 96UL * 1024UL; // one reply with its Base64 image
+// Two-phase: results stream without the image (actuators at once); the
+// JPEG is fetched for a box at these per-class scores (Apis, crabro, -,
+// velutina; > 100 = never) and for any frame N ms after the last image.
+// Opt-in: frames without an image are not stored (README 1.11)
+static constexpr bool     AI_TWO_PHASE         = false;
+static constexpr uint8_t  AI_IMAGE_MIN_SCORE[] = { 50, 50, 101, 50 };
+static constexpr uint32_t AI_IMAGE_EVERY_MS    = 60000;    // 0 = detections only
+// The image is a new capture: if a box-triggered capture no longer has a
+// box that passes, try this many more before storing it unconfirmed
+static constexpr uint8_t  AI_IMAGE_RETRIES     = 1;
+
+// VisionAI I2C clock (i2cbus.h): the fastest of AI_I2C_CLOCKS that passes
+// its probes at init; errors step it down, a clean period back up
+static constexpr uint8_t  AI_I2C_ADDR          = 0x62;
+static constexpr uint32_t AI_I2C_CLOCKS[]      = { 100000, 400000, 1000000 };
+static constexpr uint8_t  AI_I2C_MAX_ERRORS    = 3;        // within AI_I2C_WINDOW_MS: one step down
+static constexpr uint32_t AI_I2C_WINDOW_MS     = 30000;
+static constexpr uint32_t AI_I2C_CLEAN_MS      = 10UL * 60UL * 1000UL;  // without errors: one step up
+static constexpr uint32_t AI_I2C_REPORT_MS     = 15UL * 60UL * 1000UL;  // KB/s per clock in the log
+
+// SD storage
+//   PER_FILE : one JPEG file per frame (default, plain JPEGs on the card)
+//   SEGMENT  : append-only segment container, see segstore.h; opt-in,
+//              frames are read back with tools/vseg_extract.py
+enum class SdStorageMode : uint8_t { PER_FILE, SEGMENT };
+static constexpr SdStorageMode SD_STORAGE_MODE = SdStorageMode::PER_FILE;
+
+// PER_FILE layout
+//   FLAT      : /<ts>_frame_<id>.jpg in the SD root
+//   DATE_HOUR : /YYYYMMDD/HH/<ts>_frame_<id>.jpg (dirs created lazily)
+enum class SdLayout : uint8_t { FLAT, DATE_HOUR };
+static constexpr SdLayout SD_LAYOUT = SdLayout::DATE_HOUR;
+
+// Open files on the SD volume (the VFS default of 5 is not enough):
+//   held open: DETECT + EMPTY segments, HEAD.VSH, frame index, metalog,
+//              up/CURSOR.VUC, up/DAYS.CSV, the frame being uploaded   8
+//   short:     segment read / frameindex_read, month_load, sdstore tmp  3
+//   spare                                                              1
+static constexpr uint8_t SD_MAX_FILES = 12;
+
+static constexpr uint32_t SEG_MAX_BYTES  = 32UL * 1024UL * 1024UL;
+static constexpr uint32_t SEG_MAX_AGE_S  = 3600;
+static constexpr uint16_t SEG_SYNC_EVERY = 8;
+static constexpr uint32_t SEG_CHUNK_BYTES = 32UL * 1024UL;   // aligned write size, see chunkwriter.h
+static constexpr uint32_t SD_STATS_EVERY = 50;   // frames between throughput logs
+static constexpr uint16_t IDX_FLUSH_EVERY = 8;   // frame index records per write (frameindex.h)
+
+// Per-frame metadata CSV (metalog.h): perf + boxes for every stored frame,
+// written in batches of META_FLUSH_BYTES or every META_FLUSH_MS.
+static constexpr bool     SD_META_LOG      = true;
+static constexpr uint32_t META_FLUSH_BYTES = 4096;
+static constexpr uint32_t META_FLUSH_MS    = 10000;
+
+// Boot repair after power loss only reads what was written after the last
+// checkpoint (<= SEG_SYNC_EVERY frames), so it does not grow with the card.
+static constexpr uint32_t SD_RECOVERY_BUDGET_MS = 500;
+
+// Retention (retention.h): evict oldest segments above RET_HIGH_PCT until
+// below RET_LOW_PCT, empty-frame segments before detection segments;
+// PER_FILE frames the same way, picked from the frame index.
+static constexpr uint8_t  RET_HIGH_PCT      = 90;
+static constexpr uint8_t  RET_LOW_PCT       = 80;
+static constexpr uint8_t  RET_MAX_DELETES   = 1;      // segments per stored frame
+static constexpr uint16_t RET_MAX_SEGMENTS  = 4096;   // tracked per stream
+static constexpr uint8_t  RET_FILE_DELETES  = 4;      // PER_FILE frames per stored frame
+static constexpr uint32_t RET_CLUSTER_BYTES = 32UL * 1024UL;   // SD cards format with 32 KB clusters
+static constexpr uint32_t RET_RESERVE_BYTES = 16UL * 1024UL * 1024UL;  // up/, HEAD.VSH, directories
+
+// Write-behind: the loop copies frames into a PSRAM ring and a task on
+// core 0 writes them (see sdwriter.h). Frames are dropped, not waited
+// for, when the ring is full. false = write inline as before.
+static constexpr bool     SD_WRITE_BEHIND = true;
+static constexpr uint32_t SDW_RING_BYTES  = 2UL * 1024UL * 1024UL;
+
+// Modem bring-up (modemlink.h) runs on the modem task while capture
+// already runs; frames saved before network time are re-dated when it
+// arrives.
+static constexpr uint16_t MODEM_PULSE_EVERY = 15;     // unanswered ATs before a PWRKEY pulse
+static constexpr uint32_t MODEM_POLL_MS     = 1000;   // +CEREG? / +CCLK? interval
+// Commands written ahead of the answer to the previous one (modem_at.h),
+// for the AT+SHCONF / AT+SHAHEAD / AT+SMCONF batches. 1 = one at a time;
+// raise only after checking the modem firmware takes them that way.
+static constexpr uint8_t  MODEM_AT_PIPELINE = 1;
+
+// Network time resync (timesync.h): the +CCLK? second tick is timed to a
+// few ms while the modem is awake, the oscillator's drift is estimated
+// and slewed out of the system clock in between.
+static constexpr uint32_t TIME_RESYNC_MS    = 6UL * 3600UL * 1000UL;
+static constexpr uint32_t TIME_COARSE_MS    = 100;    // +CCLK? interval until the second changes
+static constexpr uint32_t TIME_GUARD_MS     = 30;     // back to back polls from this long before the tick
+static constexpr uint8_t  TIME_MAX_POLLS    = 60;
+static constexpr uint32_t TIME_DRIFT_MIN_MS = 60UL * 60UL * 1000UL;  // rate from samples this far apart
+static constexpr uint16_t TIME_MAX_PPM      = 500;
+static constexpr uint32_t TIME_STEP_MS      = 1000;   // larger errors step the clock
+static constexpr uint32_t TIME_TRIM_MS      = 10UL * 60UL * 1000UL;
+
+// =========================================================
+// Uplink: stored frames -> Azure Blob Storage over LTE-M (uploader.h)
+// =========================================================
+// Off until an endpoint and a SAS token (container scope, create + write)
+// are filled in. Azurite: "http://<pc ip>:10000/devstoreaccount1".
+static constexpr bool        UPLOAD_ENABLED  = false;
+static constexpr const char *MODEM_APN       = "";       // "" = network default
+static constexpr const char *AZ_ENDPOINT     = "https://myaccount.blob.core.windows.net";
+static constexpr const char *AZ_CONTAINER    = "frames";
+static constexpr const char *AZ_SAS          = "";       // "sv=...&sig=..." without '?'
+static constexpr const char *DEVICE_ID       = "vst-0001";
+static constexpr uint32_t    UP_BLOCK_BYTES  = 4096;     // one AT+SHBOD body
+static constexpr bool        UP_UPLOAD_EMPTY = false;    // detections only
+static constexpr uint32_t    UP_RETRY_MS     = 5000;
+// Thumbnail first: a small grayscale thumbnail per frame, the full JPEG
+// only above these per-class scores (Apis, crabro, -, velutina; > 100 =
+// never) or when requested via <device>/requests.txt
+static constexpr bool        UP_THUMB_FIRST      = true;
+static constexpr uint16_t    UP_THUMB_SIDE       = 128;      // px, 1/8 of the frame at most
+static constexpr uint8_t     UP_THUMB_QUALITY    = 60;
+static constexpr uint8_t     UP_FULL_MIN_SCORE[] = { 101, 90, 101, 60 };
+static constexpr uint32_t    UP_REQUEST_POLL_MS  = 10UL * 60UL * 1000UL;
+// Data plan: modem bytes per month (0 = none) and at most per day. Tiers
+// velutina, crabro, the rest send full frames below the first percentage
+// of today's share, thumbnails below the second, metadata only above
+static constexpr uint32_t    UP_BUDGET_MONTH      = 0;        // e.g. 100 MB plan: 95UL * 1024 * 1024
+static constexpr uint32_t    UP_BUDGET_DAY        = 0;        // 0 = the month's share only
+static constexpr uint8_t     UP_BUDGET_FULL_PCT[] = { 100, 60, 30 };
+static constexpr uint8_t     UP_BUDGET_THUMB_PCT[]= { 150, 90, 60 };
+static constexpr bool        UP_VELUTINA_FIRST    = true;     // velutina, then crabro frames ahead of the backlog
+// Delta sync (upsync.h): after an outage, ask this service which frames
+// the cloud is missing before sending the backlog. "" = off
+static constexpr const char *UP_SYNC_URL          = "";       // e.g. "https://myfunc.azurewebsites.net/api/sync"
+static constexpr uint32_t    UP_SYNC_BACKLOG      = 256;      // frames behind the newest before syncing
+static constexpr uint32_t    UP_SYNC_RETRY_MS     = 30UL * 60UL * 1000UL;
+
+// Detection telemetry (telemetry.h): records batched in RAM and sent as
+// one small blob per radio session. Same endpoint and SAS as above.
+static constexpr bool        TELEM_ENABLED        = false;
+static constexpr uint32_t    TELEM_FLUSH_MS       = 15UL * 60UL * 1000UL;  // every N minutes
+static constexpr uint16_t    TELEM_MAX_RECORDS    = 200;      // or at M records
+static constexpr uint8_t     TELEM_URGENT_TARGET  = 3;        // Vespa velutina
+static constexpr uint8_t     TELEM_URGENT_SCORE   = 70;       // flush early at this score
+static constexpr uint32_t    TELEM_URGENT_HOLD_MS = 60000;    // at most one early flush per minute
+static constexpr bool        TELEM_KEEP_LINK      = false;    // bearer down between batches
+
+// MQTT (mqttlink.h): telemetry batches and thumbnails over one persistent
+// session per wake cycle instead of an HTTP connection each. Full frames
+// stay on Azure Blob. Commands for the node arrive on <DEVICE_ID>/cmd.
+static constexpr bool        MQTT_ENABLED     = false;
+static constexpr const char *MQTT_HOST        = "";
+static constexpr uint16_t    MQTT_PORT        = 1883;
+static constexpr const char *MQTT_USER        = "";
+static constexpr const char *MQTT_PASS        = "";
+static constexpr uint16_t    MQTT_KEEPALIVE_S = 300;        // > MQTT_IDLE_MS: no PINGREQ within a cycle
+static constexpr uint8_t     MQTT_WINDOW      = 8;          // QoS1 messages in flight per confirm
+static constexpr uint32_t    MQTT_IDLE_MS     = 20000;      // session closed after this
+
+// Hornet alerts (alert.h): a Vespa velutina detection goes out as one
+// CoAP datagram within seconds, ahead of the image and telemetry queues.
+static constexpr bool        ALERT_ENABLED     = false;
+static constexpr const char *ALERT_HOST        = "";         // CoAP server, name or IP
+static constexpr uint16_t    ALERT_PORT        = 5683;
+static constexpr const char *ALERT_PATH        = "alert";    // Uri-Path
+static constexpr uint8_t     ALERT_TARGET      = 3;          // Vespa velutina
+static constexpr uint8_t     ALERT_MIN_SCORE   = 70;
+static constexpr uint32_t    ALERT_GAP_MS      = 60000;      // repeats within this merge into the next alert
+static constexpr uint8_t     ALERT_BURST       = 5;          // rate limit: alerts in a row ...
+static constexpr uint32_t    ALERT_REFILL_MS   = 10UL * 60UL * 1000UL;  // ... then one per 10 min
+static constexpr uint32_t    ALERT_ACK_MS      = 3000;       // CoAP CON: first retransmit timeout
+static constexpr uint8_t     ALERT_RETRIES     = 3;
+static constexpr bool        ALERT_KEEP_LINK   = false;
+
+// Modem power (modempower.h): PSM / eDRX between uplink bursts, woken by
+// the queue, alerts and telemetry batches; rails off after long idle.
+// false = always awake as before (energy is still logged).
+static constexpr bool        POWER_MANAGED      = false;
+static constexpr bool        POWER_PSM          = true;
+static constexpr uint32_t    POWER_TAU_S        = 6UL * 3600UL;          // periodic TAU (T3412)
+static constexpr uint32_t    POWER_ACTIVE_S     = 10;                    // T3324, then PSM
+static constexpr bool        POWER_EDRX         = true;
+static constexpr uint8_t     POWER_EDRX_CODE    = 5;                     // 81.92 s
+static constexpr uint32_t    POWER_WAKE_BYTES   = 256UL * 1024UL;        // detection frames stored, then a wake
+static constexpr uint32_t    POWER_MAX_SLEEP_MS = 60UL * 60UL * 1000UL;  // requests / commands
+static constexpr uint32_t    POWER_LINGER_MS    = 5000;
+static constexpr uint32_t    POWER_RAILS_OFF_MS = 3UL * 3600UL * 1000UL; // nothing to send -> rails off
+static constexpr uint32_t    POWER_LOG_MS       = 60UL * 60UL * 1000UL;
+// Energy estimate (SIM7080G datasheet, typical): no current sense on the rail
+static constexpr uint32_t    POWER_RRC_MS       = 10000;                 // connected after traffic
+static constexpr uint16_t    POWER_MV           = 3800;
+static constexpr uint16_t    POWER_AWAKE_MA     = 90;                    // connected, transfers
+static constexpr uint16_t    POWER_IDLE_MA      = 2;                     // registered idle / eDRX
+static constexpr uint16_t    POWER_PSM_UA       = 4;
+
 // =========================================================
 // 7070 / ESP32 (SIM7000/SIM7070 family boards)
 // =========================================================
@@ -56,6 +253,7 @@ static constexpr int SD_SPI_SCLK  = 14;
 static constexpr int SD_SPI_MISO = 2;
 static constexpr int SD_SPI_MOSI = 15;
 static constexpr int SD_SPI_CS   = 13;
+static constexpr const char *SD_MOUNT = "/sd";   // SD.begin() default mount point
 
 // PMU: not used on this board (compile out / ignore)
 static constexpr bool PMU_PRESENT = false;
@@ -96,6 +294,7 @@ static constexpr int MODEM_PWR = 41;
 static constexpr int SD_CMD  = 39;
 static constexpr int SD_CLK  = 38;
 static constexpr int SD_DATA = 40;
+static constexpr const char *SD_MOUNT = "/sdcard";
 
 // PMU: present on your 7080 baseline
 static constexpr bool PMU_PRESENT = true;
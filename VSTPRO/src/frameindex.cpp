@@ -0,0 +1,629 @@
+// src/frameindex.cpp — fixed-record frame index (see frameindex.h)
+
+#include "frameindex.h"
+#include "crc32.h"
+#include "vstlog.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static constexpr uint16_t IDX_BUF_RECORDS = 32;
+static constexpr uint32_t IDX_SCAN_RECORDS = 64;   // records per sequential read
+static constexpr uint32_t IDX_EPOCH_MIN = 1577836800; // 2020-01-01, earlier = no time
+
+static char     g_root[32] = {0};
+static uint16_t g_flush_every = 8;
+static int      g_fd = -1;
+static int32_t  g_day = -2;         // day number of g_fd, -1 = NOTIME
+static uint8_t  g_buf[IDX_BUF_RECORDS * IDX_REC_LEN];
+static uint16_t g_pending = 0;
+static IdxStats g_stats = {};
+static uint32_t g_floor[SEG_STREAMS] = {0};
+static uint32_t g_notime_base = UINT32_MAX; // NOTIME records from earlier boots
+static uint16_t g_boot = 0;
+
+/* =========================================================
+   UTIL
+   ========================================================= */
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static inline int32_t day_of(uint32_t epoch)
+{
+    return epoch >= IDX_EPOCH_MIN ? (int32_t)(epoch / 86400) : -1;
+}
+
+static void day_path(int32_t day, char *out, size_t out_sz)
+{
+    if (day < 0)
+    {
+        snprintf(out, out_sz, "%s/idx/NOTIME.VIX", g_root);
+        return;
+    }
+
+    time_t t = (time_t)day * 86400;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(out, out_sz, "%s/idx/%04d%02d%02d.VIX",
+             g_root, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+static bool read_rec(int fd, uint32_t i, IdxRecord &rec)
+{
+    uint8_t b[IDX_REC_LEN];
+    g_stats.reads++;
+    if (pread(fd, b, sizeof(b), (off_t)i * IDX_REC_LEN) != (ssize_t)sizeof(b)) return false;
+    return frameindex_decode(b, rec);
+}
+
+/* =========================================================
+   WRITE SIDE
+   ========================================================= */
+static bool open_day(int32_t day)
+{
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+
+    char path[80];
+    day_path(day, path, sizeof(path));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0664);
+    if (fd < 0)
+    {
+        VST_LOG("❌ frameindex: cannot open %s (errno=%d)\n", path, errno);
+        return false;
+    }
+
+    // A torn last write leaves a partial record: cut it off so new
+    // records stay on the 32 B grid.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size % IDX_REC_LEN)
+        ftruncate(fd, st.st_size - st.st_size % IDX_REC_LEN);
+
+    // Everything NOTIME.VIX holds before our first append is from a boot
+    // whose time offset is unknown
+    if (day < 0 && g_notime_base == UINT32_MAX)
+        g_notime_base = (uint32_t)(st.st_size / IDX_REC_LEN);
+
+    g_fd = fd;
+    g_day = day;
+    return true;
+}
+
+static bool write_pending()
+{
+    if (!g_pending) return true;
+
+    size_t n = (size_t)g_pending * IDX_REC_LEN;
+    ssize_t w = write(g_fd, g_buf, n);
+    g_pending = 0;
+    g_stats.flushes++;
+
+    if (w != (ssize_t)n)
+    {
+        VST_LOG("❌ frameindex: write failed (%d / %u)\n", (int)w, (unsigned)n);
+        g_stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+// <root>/idx/BOOT.CNT counts boots (1..65535, 0 is never used) so frames
+// saved before network time get a name no other boot reuses
+static uint16_t next_boot(const char *dir)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/BOOT.CNT", dir);
+
+    uint8_t b[2] = {0};
+    uint16_t n = 0;
+    int fd = open(path, O_RDWR | O_CREAT, 0664);
+    if (fd < 0) return 1;
+    if (pread(fd, b, sizeof(b), 0) == (ssize_t)sizeof(b)) n = (uint16_t)(b[0] | (b[1] << 8));
+    if (++n == 0) n = 1;
+    put_u16(b, n);
+    if (pwrite(fd, b, sizeof(b), 0) == (ssize_t)sizeof(b)) fsync(fd);
+    close(fd);
+    return n;
+}
+
+bool frameindex_init(const char *root, uint16_t flush_every)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_flush_every = flush_every ? flush_every : 1;
+    if (g_flush_every > IDX_BUF_RECORDS) g_flush_every = IDX_BUF_RECORDS;
+    g_fd = -1;
+    g_day = -2;
+    g_pending = 0;
+    g_notime_base = UINT32_MAX;
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    char dir[48];
+    snprintf(dir, sizeof(dir), "%s/idx", g_root);
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+    {
+        VST_LOG("❌ frameindex: mkdir %s failed (errno=%d)\n", dir, errno);
+        return false;
+    }
+
+    g_boot = next_boot(dir);
+
+    VST_LOG("🗂 frameindex ready: %s (flush every %u, boot %u)\n", dir,
+            (unsigned)g_flush_every, (unsigned)g_boot);
+    return true;
+}
+
+uint16_t frameindex_boot()
+{
+    return g_boot;
+}
+
+IdxRecord frameindex_make(uint32_t frame_id, uint32_t epoch, const SegLocation *loc,
+                          uint32_t size, const FrameMeta *meta)
+{
+    IdxRecord r{};
+    r.frame_id = frame_id;
+    r.epoch = epoch;
+    r.size = size;
+    r.boot = g_boot;
+    if (loc)
+    {
+        r.seq = loc->seq;
+        r.offset = loc->offset;
+        r.size = loc->size;
+        if (loc->stream == SEG_STREAM_EMPTY) r.flags |= IDX_F_EMPTY_STREAM;
+    }
+
+    if (meta)
+    {
+        r.box_count = meta->box_count;
+        if (meta->trigger.valid && meta->trigger.box_count) r.flags |= IDX_F_TRIGGER;
+        for (uint8_t i = 0; i < meta->box_count; i++)
+        {
+            const FrameBox &b = meta->boxes[i];
+            if (b.target < IDX_CLASSES && b.score > r.score[b.target])
+                r.score[b.target] = b.score;
+        }
+    }
+    return r;
+}
+
+bool frameindex_append(const IdxRecord &rec)
+{
+    if (!g_root[0]) return false;
+
+    int32_t day = day_of(rec.epoch);
+    if (day != g_day || g_fd < 0)
+    {
+        if (g_fd >= 0) write_pending();
+        if (!open_day(day))
+        {
+            g_stats.errors++;
+            return false;
+        }
+    }
+
+    frameindex_encode(rec, g_buf + (size_t)g_pending * IDX_REC_LEN);
+    g_pending++;
+    g_stats.appended++;
+
+    if (g_pending >= g_flush_every)
+        return write_pending();
+    return true;
+}
+
+void frameindex_flush()
+{
+    if (g_fd < 0) return;
+    write_pending();
+    fsync(g_fd);
+}
+
+uint32_t frameindex_rebase(int64_t offset)
+{
+    if (!g_root[0] || g_notime_base == UINT32_MAX) return 0;
+
+    // Unwritten NOTIME records first, and NOTIME.VIX is no longer the
+    // append target
+    frameindex_flush();
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+    g_day = -2;
+
+    char path[80];
+    day_path(-1, path, sizeof(path));
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    uint32_t n = fstat(fd, &st) == 0 ? (uint32_t)(st.st_size / IDX_REC_LEN) : 0;
+    uint32_t moved = 0;
+
+    for (uint32_t i = g_notime_base; i < n; i++)
+    {
+        IdxRecord rec;
+        if (!read_rec(fd, i, rec)) continue;
+
+        int64_t epoch = (int64_t)rec.epoch + offset;
+        if (epoch < IDX_EPOCH_MIN || epoch > UINT32_MAX) continue;
+        rec.epoch = (uint32_t)epoch;
+        rec.flags |= IDX_F_REBASED;
+        if (frameindex_append(rec)) moved++;
+    }
+
+    // Day files are durable before the originals go: a power cut in
+    // between leaves duplicates in NOTIME.VIX, never a lost record
+    frameindex_flush();
+    if (g_notime_base < n) ftruncate(fd, (off_t)g_notime_base * IDX_REC_LEN);
+    fsync(fd);
+    close(fd);
+    g_notime_base = UINT32_MAX;
+    return moved;
+}
+
+/* =========================================================
+   QUERY
+   ========================================================= */
+static bool matches(const IdxRecord &r, const IdxQuery &q)
+{
+    if (r.flags & IDX_F_EVICTED) return false;
+    if (r.seq)
+    {
+        int s = (r.flags & IDX_F_EMPTY_STREAM) ? SEG_STREAM_EMPTY : SEG_STREAM_DETECT;
+        if (r.seq < g_floor[s]) return false;
+    }
+    if (q.cls < 0) return true;
+    if (q.cls >= IDX_CLASSES) return false;
+    uint8_t s = r.score[q.cls];
+    return s > 0 && s >= q.min_score;
+}
+
+// First record with epoch >= from (records are in time order).
+static uint32_t lower_bound(int fd, uint32_t n, uint32_t from)
+{
+    uint32_t lo = 0, hi = n;
+    IdxRecord r;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!read_rec(fd, mid, r) || r.epoch < from) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Scans one day file. Returns false when the visitor or the limit stops the query.
+static bool query_day(int32_t day, const IdxQuery &q, IdxVisitor fn, void *ctx, uint32_t &hits)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return true;
+
+    struct stat st;
+    uint32_t n = (fstat(fd, &st) == 0) ? (uint32_t)(st.st_size / IDX_REC_LEN) : 0;
+    uint32_t i = (day < 0) ? 0 : lower_bound(fd, n, q.from_epoch);
+
+    static uint8_t blk[IDX_SCAN_RECORDS * IDX_REC_LEN];
+    bool more = true;
+
+    while (more && i < n)
+    {
+        uint32_t want = n - i;
+        if (want > IDX_SCAN_RECORDS) want = IDX_SCAN_RECORDS;
+
+        ssize_t got = pread(fd, blk, (size_t)want * IDX_REC_LEN, (off_t)i * IDX_REC_LEN);
+        g_stats.reads++;
+        if (got < (ssize_t)IDX_REC_LEN) break;
+
+        uint32_t k = (uint32_t)got / IDX_REC_LEN;
+        for (uint32_t j = 0; j < k; j++)
+        {
+            IdxRecord r;
+            if (!frameindex_decode(blk + (size_t)j * IDX_REC_LEN, r)) continue;
+            if (day >= 0 && r.epoch > q.to_epoch) { more = false; break; }
+            if (!matches(r, q)) continue;
+
+            hits++;
+            if ((fn && !fn(r, ctx)) || (q.limit && hits >= q.limit))
+            {
+                close(fd);
+                return false;
+            }
+        }
+        i += k;
+    }
+
+    close(fd);
+    return true;
+}
+
+uint32_t frameindex_query(const IdxQuery &q, IdxVisitor fn, void *ctx)
+{
+    uint64_t t0 = mono_us();
+    uint32_t hits = 0;
+    g_stats.queries++;
+    g_stats.reads = 0;
+
+    // NOTIME frames cannot be placed in time: only an open range (from 0) sees them.
+    bool go = true;
+    if (q.from_epoch == 0)
+        go = query_day(-1, q, fn, ctx, hits);
+
+    uint32_t from = q.from_epoch < IDX_EPOCH_MIN ? IDX_EPOCH_MIN : q.from_epoch;
+    for (int32_t d = day_of(from); go && d >= 0 && d <= day_of(q.to_epoch); d++)
+        go = query_day(d, q, fn, ctx, hits);
+
+    g_stats.query_us = (uint32_t)(mono_us() - t0);
+    return hits;
+}
+
+uint32_t frameindex_count(int32_t day)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint32_t)(st.st_size / IDX_REC_LEN) : 0;
+}
+
+bool frameindex_read(int32_t day, uint32_t n, IdxRecord &rec)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    uint8_t b[IDX_REC_LEN];
+    bool ok = pread(fd, b, sizeof(b), (off_t)n * IDX_REC_LEN) == (ssize_t)sizeof(b) &&
+              frameindex_decode(b, rec);
+    close(fd);
+    return ok;
+}
+
+// Day number of "YYYYMMDD.VIX" (days-from-civil), -1 for other names.
+static int32_t parse_day(const char *name)
+{
+    int y, m, d;
+    char ext[4];
+    if (strlen(name) != 12 || sscanf(name, "%4d%2d%2d.%3s", &y, &m, &d, ext) != 4) return -1;
+    if (m < 1 || m > 12 || d < 1 || d > 31) return -1;
+
+    y -= m <= 2;
+    int32_t era = y / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void day_range(int32_t &first, int32_t &last)
+{
+    first = last = -1;
+    char dir[48];
+    snprintf(dir, sizeof(dir), "%s/idx", g_root);
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr)
+    {
+        int32_t day = parse_day(e->d_name);
+        if (day < 0) continue;
+        if (first < 0 || day < first) first = day;
+        if (day > last) last = day;
+    }
+    closedir(d);
+}
+
+int32_t frameindex_first_day()
+{
+    int32_t first, last;
+    day_range(first, last);
+    return first;
+}
+
+int32_t frameindex_last_day()
+{
+    int32_t first, last;
+    day_range(first, last);
+    return last;
+}
+
+int32_t frameindex_append_day()
+{
+    return g_fd >= 0 ? g_day : -2;
+}
+
+uint32_t frameindex_scan(int32_t day, uint32_t first, IdxScanVisitor fn, void *ctx)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return first;
+
+    struct stat st;
+    uint32_t n = (fstat(fd, &st) == 0) ? (uint32_t)(st.st_size / IDX_REC_LEN) : 0;
+    uint32_t i = first;
+
+    static uint8_t blk[IDX_SCAN_RECORDS * IDX_REC_LEN];
+    while (i < n)
+    {
+        uint32_t want = n - i;
+        if (want > IDX_SCAN_RECORDS) want = IDX_SCAN_RECORDS;
+
+        ssize_t got = pread(fd, blk, (size_t)want * IDX_REC_LEN, (off_t)i * IDX_REC_LEN);
+        if (got < (ssize_t)IDX_REC_LEN) break;
+
+        uint32_t k = (uint32_t)got / IDX_REC_LEN;
+        for (uint32_t j = 0; j < k; j++, i++)
+        {
+            IdxRecord r;
+            if (!frameindex_decode(blk + (size_t)j * IDX_REC_LEN, r)) continue;
+            if (!fn(r, i, ctx))
+            {
+                close(fd);
+                return i;
+            }
+        }
+    }
+
+    close(fd);
+    return i;
+}
+
+bool frameindex_set_flags(int32_t day, uint32_t n, uint8_t flags)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return false;
+
+    IdxRecord rec;
+    uint8_t b[IDX_REC_LEN];
+    bool ok = read_rec(fd, n, rec);
+    if (ok && (rec.flags & flags) != flags)
+    {
+        rec.flags |= flags;
+        frameindex_encode(rec, b);
+        ok = pwrite(fd, b, sizeof(b), (off_t)n * IDX_REC_LEN) == (ssize_t)sizeof(b);
+        if (!ok) g_stats.errors++;
+    }
+    close(fd);
+    return ok;
+}
+
+uint32_t frameindex_tag()
+{
+    return g_fd >= 0 ? (uint32_t)(g_day + 2) : 0;
+}
+
+// Rewrites the tail window of one day file without the bad records.
+static uint32_t repair_day(int32_t day, IdxIntact intact)
+{
+    char path[80];
+    day_path(day, path, sizeof(path));
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    uint32_t n = (fstat(fd, &st) == 0) ? (uint32_t)(st.st_size / IDX_REC_LEN) : 0;
+    bool partial = (st.st_size % IDX_REC_LEN) != 0;
+    uint32_t start = n > IDX_RECOVER_RECORDS ? n - IDX_RECOVER_RECORDS : 0;
+
+    static uint8_t win[IDX_RECOVER_RECORDS * IDX_REC_LEN];
+    size_t win_len = (size_t)(n - start) * IDX_REC_LEN;
+    if (pread(fd, win, win_len, (off_t)start * IDX_REC_LEN) != (ssize_t)win_len)
+    {
+        close(fd);
+        return 0;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n - start; i++)
+    {
+        IdxRecord r;
+        uint8_t *p = win + (size_t)i * IDX_REC_LEN;
+        if (!frameindex_decode(p, r)) continue;
+        if (r.seq && intact && !intact(r)) continue;
+        if (kept != i) memmove(win + (size_t)kept * IDX_REC_LEN, p, IDX_REC_LEN);
+        kept++;
+    }
+
+    uint32_t dropped = (n - start) - kept;
+    if (dropped || partial)
+    {
+        bool ok = ftruncate(fd, (off_t)start * IDX_REC_LEN) == 0 &&
+                  pwrite(fd, win, (size_t)kept * IDX_REC_LEN, (off_t)start * IDX_REC_LEN) ==
+                      (ssize_t)((size_t)kept * IDX_REC_LEN);
+        fsync(fd);
+        VST_LOG("🩺 frameindex: %s dropped %lu record(s)%s%s\n", path, (unsigned long)dropped,
+                partial ? " + partial tail" : "", ok ? "" : " (rewrite failed)");
+    }
+    close(fd);
+    return dropped;
+}
+
+uint32_t frameindex_recover(uint32_t tag, IdxIntact intact)
+{
+    if (!tag || !g_root[0]) return 0;
+
+    // The file may have rolled over to the next day after the checkpoint
+    int32_t day = (int32_t)tag - 2;
+    uint32_t dropped = repair_day(day, intact);
+    if (day >= 0) dropped += repair_day(day + 1, intact);
+    return dropped;
+}
+
+void frameindex_set_floor(SegStream stream, uint32_t seq)
+{
+    if (stream < SEG_STREAMS && seq > g_floor[stream]) g_floor[stream] = seq;
+}
+
+const IdxStats &frameindex_stats()
+{
+    return g_stats;
+}
+
+/* =========================================================
+   CODEC
+   ========================================================= */
+void frameindex_encode(const IdxRecord &rec, uint8_t out[IDX_REC_LEN])
+{
+    put_u32(out + 0, rec.frame_id);
+    put_u32(out + 4, rec.epoch);
+    put_u32(out + 8, rec.seq);
+    put_u32(out + 12, rec.offset);
+    put_u32(out + 16, rec.size);
+    memcpy(out + 20, rec.score, IDX_CLASSES);
+    out[24] = rec.box_count;
+    out[25] = rec.flags;
+    put_u16(out + 26, rec.boot);
+    put_u32(out + 28, crc32_update(0, out, 28));
+}
+
+bool frameindex_decode(const uint8_t in[IDX_REC_LEN], IdxRecord &rec)
+{
+    if (get_u32(in + 28) != crc32_update(0, in, 28)) return false;
+
+    rec.frame_id = get_u32(in + 0);
+    rec.epoch = get_u32(in + 4);
+    rec.seq = get_u32(in + 8);
+    rec.offset = get_u32(in + 12);
+    rec.size = get_u32(in + 16);
+    memcpy(rec.score, in + 20, IDX_CLASSES);
+    rec.box_count = in[24];
+    rec.flags = in[25];
+    rec.boot = (uint16_t)(in[26] | (in[27] << 8));
+    return true;
+}
@@ -0,0 +1,125 @@
+// src/frameindex.h — fixed-record frame index on the SD card
+//
+// One 32 B record per stored frame in <root>/idx/YYYYMMDD.VIX (NOTIME.VIX
+// before network time), sorted by epoch. Record layout: README 1.13.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+#include "segstore.h"
+
+static constexpr size_t  IDX_REC_LEN = 32;
+static constexpr uint8_t IDX_CLASSES = 4;    // model targets 0..3
+static constexpr uint32_t IDX_RECOVER_RECORDS = 64; // tail window checked at boot
+
+struct IdxRecord
+{
+    uint32_t frame_id;
+    uint32_t epoch;         // < 2020: seconds since boot, captured before network time
+    uint32_t seq;           // segment number, 0 = PER_FILE
+    uint32_t offset;        // of the segment record header
+    uint32_t size;          // segment record (or JPEG file) size
+    uint8_t  score[IDX_CLASSES];
+    uint8_t  box_count;
+    uint8_t  flags;         // IDX_F_*
+    uint16_t boot;          // frameindex_boot() when stored, 0 = before boot numbers
+};
+
+static constexpr uint8_t IDX_F_EMPTY_STREAM = 0x01;   // record is in an EMP_ segment
+static constexpr uint8_t IDX_F_REBASED      = 0x02;   // epoch corrected after capture:
+                                                      // PER_FILE name is the undated one
+static constexpr uint8_t IDX_F_TRIGGER      = 0x04;   // two-phase image asked for by a result
+                                                      // with boxes: a detection even at box_count 0
+static constexpr uint8_t IDX_F_EVICTED      = 0x08;   // PER_FILE JPEG deleted by retention
+
+struct IdxQuery
+{
+    uint32_t from_epoch;    // inclusive
+    uint32_t to_epoch;      // inclusive
+    int16_t  cls;           // class to match, -1 = any frame
+    uint8_t  min_score;     // with cls >= 0: score[cls] >= min_score (0 = any > 0)
+    uint32_t limit;         // stop after this many matches (0 = no limit)
+};
+
+struct IdxStats
+{
+    uint32_t appended;
+    uint32_t flushes;
+    uint32_t errors;
+    uint32_t queries;
+    uint32_t reads;         // 32 B record reads + scan blocks in the last query
+    uint32_t query_us;      // duration of the last query
+};
+
+// Return false to stop the query early.
+typedef bool (*IdxVisitor)(const IdxRecord &rec, void *ctx);
+
+// Index lives under <root>/idx. Records are buffered and written every
+// flush_every appends (and on frameindex_flush()).
+bool frameindex_init(const char *root, uint16_t flush_every);
+
+// This boot's number from <root>/idx/BOOT.CNT (set by frameindex_init());
+// part of the name of PER_FILE frames saved before network time
+uint16_t frameindex_boot();
+
+// Builds the record for a stored frame. loc == nullptr for PER_FILE.
+IdxRecord frameindex_make(uint32_t frame_id, uint32_t epoch, const SegLocation *loc,
+                          uint32_t size, const FrameMeta *meta);
+
+bool frameindex_append(const IdxRecord &rec);
+void frameindex_flush();
+
+// Visits matching records in time order. Only flushed records are seen,
+// and none of evicted frames.
+// Returns the number of matches.
+uint32_t frameindex_query(const IdxQuery &q, IdxVisitor fn, void *ctx);
+
+// Sequential access for readers that walk the index (uploader.h).
+// Days are UTC day numbers (epoch / 86400). Only flushed records count.
+uint32_t frameindex_count(int32_t day);
+bool frameindex_read(int32_t day, uint32_t n, IdxRecord &rec);
+
+// Oldest / newest dated day file on the card, -1 if there is none.
+int32_t frameindex_first_day();
+int32_t frameindex_last_day();
+
+// Day file being appended to: -1 NOTIME, -2 none yet.
+int32_t frameindex_append_day();
+
+// Visits the records of one day file from record first on, with their
+// record number, until fn returns false. Returns the number of the record
+// fn refused, else the record count. Records that fail their CRC are passed
+// over.
+typedef bool (*IdxScanVisitor)(const IdxRecord &rec, uint32_t n, void *ctx);
+uint32_t frameindex_scan(int32_t day, uint32_t first, IdxScanVisitor fn, void *ctx);
+
+// ORs flags into record n of a day file in place (retention marks the
+// PER_FILE frames it deleted with IDX_F_EVICTED).
+bool frameindex_set_flags(int32_t day, uint32_t n, uint8_t flags);
+
+// Current day file as an opaque tag for segstore_set_tag() (0 = none).
+uint32_t frameindex_tag();
+
+// Boot repair of the day file(s) named by the tag saved with the last
+// checkpoint: the last IDX_RECOVER_RECORDS records are re-read and those
+// that fail their CRC or for which intact() is false are dropped.
+// Returns the number of records dropped.
+typedef bool (*IdxIntact)(const IdxRecord &rec);
+uint32_t frameindex_recover(uint32_t tag, IdxIntact intact);
+
+// Network time arrived: wall = boot seconds + offset. Moves the NOTIME
+// records appended since boot into their day files (IDX_F_REBASED set)
+// and cuts them from NOTIME.VIX. Call on the thread that appends.
+// Returns the number of records moved.
+uint32_t frameindex_rebase(int64_t offset);
+
+// Segments below seq in stream were evicted (retention.h): queries skip
+// their records from now on.
+void frameindex_set_floor(SegStream stream, uint32_t seq);
+
+const IdxStats &frameindex_stats();
+
+// Record codec (shared with tools that read the index).
+void frameindex_encode(const IdxRecord &rec, uint8_t out[IDX_REC_LEN]);
+bool frameindex_decode(const uint8_t in[IDX_REC_LEN], IdxRecord &rec);
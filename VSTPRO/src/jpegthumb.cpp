@@ -0,0 +1,742 @@
+// src/jpegthumb.cpp — DC-only JPEG downscale + grayscale baseline encoder
+// (see jpegthumb.h)
+
+#include "jpegthumb.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t ZIGZAG[64] = {      // zigzag position -> natural index
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/* =========================================================
+   DECODER (luma DC only)
+   ========================================================= */
+struct Huff
+{
+    bool    set;
+    uint8_t look_len[256];  // 8-bit prefix -> code length, 0 = longer code
+    uint8_t look_val[256];
+    int32_t maxcode[17];    // by length, -1 = none
+    int32_t valoff[17];     // vals index = code + valoff[len]
+    uint8_t vals[256];
+};
+
+struct Comp
+{
+    uint8_t id, h, v, tq;
+    uint8_t td, ta;         // tables of the current scan
+    int32_t pred;
+};
+
+struct Dec
+{
+    ThumbReader in;
+    uint8_t  buf[1024];
+    size_t   pos, len;
+
+    uint32_t bits;          // left aligned
+    int      nbits;
+    int      marker;        // marker met inside entropy data, -1 = none
+
+    uint16_t q0[4];         // DC quantizer of each table
+    Huff     dc[4], ac[4];
+    Comp     comp[4];
+    uint8_t  ncomp, hmax, vmax;
+    uint16_t w, h, restart;
+
+    uint8_t *plane;         // luma block means
+    uint16_t pw, ph;
+};
+
+static int get_byte(Dec &d)
+{
+    if (d.pos == d.len)
+    {
+        d.len = d.in.read(d.in.ctx, d.buf, sizeof(d.buf));
+        d.pos = 0;
+        if (!d.len) return -1;
+    }
+    return d.buf[d.pos++];
+}
+
+static int get_u16(Dec &d)
+{
+    int a = get_byte(d), b = get_byte(d);
+    return (a < 0 || b < 0) ? -1 : (a << 8) | b;
+}
+
+static bool skip_bytes(Dec &d, int n)
+{
+    while (n-- > 0)
+        if (get_byte(d) < 0) return false;
+    return true;
+}
+
+// Next marker code (after 0xFF fill bytes), -1 at the end
+static int next_marker(Dec &d)
+{
+    if (d.marker >= 0)
+    {
+        int m = d.marker;
+        d.marker = -1;
+        return m;
+    }
+    int c;
+    do { c = get_byte(d); } while (c >= 0 && c != 0xFF);
+    while (c == 0xFF) c = get_byte(d);
+    return c;
+}
+
+static void fill(Dec &d)
+{
+    while (d.nbits <= 24)
+    {
+        uint32_t b = 0;
+        if (d.marker < 0)
+        {
+            int c = get_byte(d);
+            if (c == 0xFF)
+            {
+                int c2;
+                do { c2 = get_byte(d); } while (c2 == 0xFF);
+                if (c2 == 0) b = 0xFF;
+                else d.marker = c2 < 0 ? 0xD9 : c2;     // feed zeros from here
+            }
+            else if (c < 0) d.marker = 0xD9;
+            else b = (uint32_t)c;
+        }
+        d.bits |= b << (24 - d.nbits);
+        d.nbits += 8;
+    }
+}
+
+static inline uint32_t get_bits(Dec &d, int n)
+{
+    if (!n) return 0;
+    fill(d);
+    uint32_t v = d.bits >> (32 - n);
+    d.bits <<= n;
+    d.nbits -= n;
+    return v;
+}
+
+static inline int32_t extend(uint32_t v, int s)
+{
+    return s && v < (1u << (s - 1)) ? (int32_t)v - (1 << s) + 1 : (int32_t)v;
+}
+
+static int decode_huff(Dec &d, const Huff &t)
+{
+    fill(d);
+    uint32_t look = d.bits >> 24;
+    if (t.look_len[look])
+    {
+        int l = t.look_len[look];
+        d.bits <<= l;
+        d.nbits -= l;
+        return t.look_val[look];
+    }
+    for (int l = 9; l <= 16; l++)
+    {
+        int32_t code = (int32_t)(d.bits >> (32 - l));
+        if (code <= t.maxcode[l])
+        {
+            d.bits <<= l;
+            d.nbits -= l;
+            return t.vals[(code + t.valoff[l]) & 0xFF];
+        }
+    }
+    return -1;
+}
+
+static bool build_huff(Huff &t, const uint8_t counts[16], const uint8_t *vals, int nvals)
+{
+    memset(&t, 0, sizeof(t));
+    memcpy(t.vals, vals, (size_t)nvals);
+    int32_t code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++)
+    {
+        t.valoff[l] = k - code;
+        for (int i = 0; i < counts[l - 1]; i++, k++, code++)
+        {
+            if (l <= 8)
+            {
+                int first = code << (8 - l), n = 1 << (8 - l);
+                for (int j = 0; j < n; j++)
+                {
+                    t.look_len[first + j] = (uint8_t)l;
+                    t.look_val[first + j] = vals[k];
+                }
+            }
+        }
+        t.maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        if (code > (1 << l)) return false;
+        code <<= 1;
+    }
+    t.set = true;
+    return true;
+}
+
+static bool read_dqt(Dec &d, int len)
+{
+    while (len > 0)
+    {
+        int pq = get_byte(d);
+        if (pq < 0 || (pq & 15) > 3) return false;
+        int n = (pq >> 4) ? 128 : 64;
+        int q = (pq >> 4) ? get_u16(d) : get_byte(d);
+        if (q < 0 || !skip_bytes(d, n - ((pq >> 4) ? 2 : 1))) return false;
+        d.q0[pq & 15] = (uint16_t)q;
+        len -= 1 + n;
+    }
+    return len == 0;
+}
+
+static bool read_dht(Dec &d, int len)
+{
+    while (len > 0)
+    {
+        int tc = get_byte(d);
+        uint8_t counts[16], vals[256];
+        int total = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int c = get_byte(d);
+            if (c < 0) return false;
+            counts[i] = (uint8_t)c;
+            total += c;
+        }
+        if (tc < 0 || (tc & 15) > 3 || total > 256) return false;
+        for (int i = 0; i < total; i++)
+        {
+            int c = get_byte(d);
+            if (c < 0) return false;
+            vals[i] = (uint8_t)c;
+        }
+        Huff &t = (tc >> 4) ? d.ac[tc & 15] : d.dc[tc & 15];
+        if (!build_huff(t, counts, vals, total)) return false;
+        len -= 17 + total;
+    }
+    return len == 0;
+}
+
+static bool read_sof(Dec &d, int len)
+{
+    int p = get_byte(d);
+    d.h = (uint16_t)get_u16(d);
+    d.w = (uint16_t)get_u16(d);
+    int n = get_byte(d);
+    if (p != 8 || n < 1 || n > 4 || len != 6 + 3 * n) return false;
+    if (!d.w || !d.h || d.w > THUMB_SRC_MAX || d.h > THUMB_SRC_MAX) return false;
+
+    d.ncomp = (uint8_t)n;
+    d.hmax = d.vmax = 1;
+    for (int i = 0; i < n; i++)
+    {
+        Comp &c = d.comp[i];
+        c.id = (uint8_t)get_byte(d);
+        int hv = get_byte(d);
+        c.tq = (uint8_t)(get_byte(d) & 3);
+        c.h = (uint8_t)(hv >> 4);
+        c.v = (uint8_t)(hv & 15);
+        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4) return false;
+        if (c.h > d.hmax) d.hmax = c.h;
+        if (c.v > d.vmax) d.vmax = c.v;
+    }
+
+    // Luma (first component) blocks, one plane pixel each
+    uint32_t lw = (d.w * d.comp[0].h + d.hmax - 1) / d.hmax;
+    uint32_t lh = (d.h * d.comp[0].v + d.vmax - 1) / d.vmax;
+    d.pw = (uint16_t)((lw + 7) / 8);
+    d.ph = (uint16_t)((lh + 7) / 8);
+    d.plane = (uint8_t*)malloc((size_t)d.pw * d.ph);
+    return d.plane != nullptr;
+}
+
+// One block: DC kept for luma, AC decoded and dropped
+static bool block(Dec &d, Comp &c, bool luma, uint32_t bx, uint32_t by)
+{
+    int s = decode_huff(d, d.dc[c.td]);
+    if (s < 0 || s > 11) return false;
+    c.pred += extend(get_bits(d, s), s);
+
+    for (int k = 1; k < 64; )
+    {
+        int rs = decode_huff(d, d.ac[c.ta]);
+        if (rs < 0) return false;
+        int r = rs >> 4, sz = rs & 15;
+        if (!sz)
+        {
+            if (r != 15) break;     // EOB
+            k += 16;
+            continue;
+        }
+        k += r + 1;
+        get_bits(d, sz);
+    }
+
+    if (luma && bx < d.pw && by < d.ph)
+    {
+        int32_t v = c.pred * (int32_t)d.q0[c.tq] / 8 + 128;
+        d.plane[by * d.pw + bx] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+    return true;
+}
+
+static bool restart(Dec &d, Comp **sc, int ns)
+{
+    d.bits = 0;
+    d.nbits = 0;
+    int m = next_marker(d);
+    if (m < 0xD0 || m > 0xD7) return false;
+    for (int i = 0; i < ns; i++) sc[i]->pred = 0;
+    return true;
+}
+
+// Decodes one scan. Returns 1 when the luma plane is complete, 0 when the
+// scan had no luma (skipped), -1 on error.
+static int scan(Dec &d, int len)
+{
+    int ns = get_byte(d);
+    if (ns < 1 || ns > 4 || len != 4 + 2 * ns) return -1;
+
+    Comp *sc[4];
+    bool has_luma = false;
+    for (int i = 0; i < ns; i++)
+    {
+        int id = get_byte(d), t = get_byte(d);
+        sc[i] = nullptr;
+        for (int j = 0; j < d.ncomp; j++)
+            if (d.comp[j].id == id) sc[i] = &d.comp[j];
+        if (!sc[i] || t < 0) return -1;
+        sc[i]->td = (uint8_t)((t >> 4) & 3);
+        sc[i]->ta = (uint8_t)(t & 3);
+        sc[i]->pred = 0;
+        if (!d.dc[sc[i]->td].set || !d.ac[sc[i]->ta].set) return -1;
+        has_luma |= sc[i] == &d.comp[0];
+    }
+    if (!skip_bytes(d, 3)) return -1;      // Ss, Se, Ah/Al: fixed in baseline
+
+    d.bits = 0;
+    d.nbits = 0;
+    d.marker = -1;
+    if (!has_luma)
+    {
+        // Run to the marker after the entropy data
+        for (;;)
+        {
+            int c = get_byte(d);
+            if (c < 0) return -1;
+            if (c != 0xFF) continue;
+            do { c = get_byte(d); } while (c == 0xFF);
+            if (c > 0 && (c < 0xD0 || c > 0xD7))
+            {
+                d.marker = c;
+                return 0;
+            }
+        }
+    }
+
+    // Non-interleaved: one block per MCU over the component's own grid
+    uint32_t mcux, mcuy;
+    if (ns == 1)
+    {
+        Comp &c = *sc[0];
+        mcux = ((d.w * c.h + d.hmax - 1) / d.hmax + 7) / 8;
+        mcuy = ((d.h * c.v + d.vmax - 1) / d.vmax + 7) / 8;
+    }
+    else
+    {
+        mcux = (d.w + 8 * d.hmax - 1) / (8 * d.hmax);
+        mcuy = (d.h + 8 * d.vmax - 1) / (8 * d.vmax);
+    }
+
+    uint32_t total = mcux * mcuy, todo = d.restart;
+    for (uint32_t m = 0; m < total; m++)
+    {
+        if (d.restart && !todo)
+        {
+            if (!restart(d, sc, ns)) return -1;
+            todo = d.restart;
+        }
+        uint32_t mx = m % mcux, my = m / mcux;
+        for (int i = 0; i < ns; i++)
+        {
+            Comp &c = *sc[i];
+            bool luma = &c == &d.comp[0];
+            if (ns == 1)
+            {
+                if (!block(d, c, luma, mx, my)) return -1;
+                continue;
+            }
+            for (int v = 0; v < c.v; v++)
+                for (int h = 0; h < c.h; h++)
+                    if (!block(d, c, luma, mx * c.h + h, my * c.v + v)) return -1;
+        }
+        todo--;
+    }
+    return 1;
+}
+
+static bool decode_plane(Dec &d)
+{
+    if (get_byte(d) != 0xFF || get_byte(d) != 0xD8) return false;
+
+    for (;;)
+    {
+        int m = next_marker(d);
+        if (m < 0 || m == 0xD9) return false;       // EOI before any luma
+        if (m == 0x01 || (m >= 0xD0 && m <= 0xD7)) continue;
+
+        int len = get_u16(d);
+        if (len < 2) return false;
+        len -= 2;
+
+        bool ok = true;
+        switch (m)
+        {
+        case 0xDB: ok = read_dqt(d, len); break;
+        case 0xC4: ok = read_dht(d, len); break;
+        case 0xC0:
+        case 0xC1: ok = !d.plane && read_sof(d, len); break;
+        case 0xDD:
+            d.restart = (uint16_t)get_u16(d);
+            ok = len == 2;
+            break;
+        case 0xDA:
+        {
+            if (!d.plane) return false;
+            int r = scan(d, len);
+            if (r < 0) return false;
+            if (r > 0) return true;
+            break;
+        }
+        default:
+            // Progressive, lossless and arithmetic coding are not read
+            if ((m >= 0xC2 && m <= 0xCF) && m != 0xC4 && m != 0xC8 && m != 0xCC) return false;
+            ok = skip_bytes(d, len);
+            break;
+        }
+        if (!ok) return false;
+    }
+}
+
+/* =========================================================
+   ENCODER (baseline, one grayscale component)
+   ========================================================= */
+static const uint8_t STD_LUMA_Q[64] = {          // natural order
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t DC_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t DC_VALS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const uint8_t AC_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t AC_VALS[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+struct Enc
+{
+    uint8_t *out;
+    size_t   cap, len;
+    bool     full;
+    uint32_t acc;           // pending bits, right aligned
+    int      nacc;
+    uint16_t dc_code[12];
+    uint8_t  dc_size[12];
+    uint16_t ac_code[256];
+    uint8_t  ac_size[256];
+};
+
+static void put(Enc &e, uint8_t b)
+{
+    if (e.len < e.cap) e.out[e.len++] = b;
+    else e.full = true;
+}
+
+static void put_u16be(Enc &e, uint16_t v)
+{
+    put(e, (uint8_t)(v >> 8));
+    put(e, (uint8_t)v);
+}
+
+static void put_bits(Enc &e, uint32_t code, int size)
+{
+    e.acc = (e.acc << size) | (code & ((1u << size) - 1));
+    e.nacc += size;
+    while (e.nacc >= 8)
+    {
+        uint8_t b = (uint8_t)(e.acc >> (e.nacc - 8));
+        put(e, b);
+        if (b == 0xFF) put(e, 0);
+        e.nacc -= 8;
+    }
+}
+
+static void make_codes(const uint8_t bits[16], const uint8_t *vals, uint16_t *code, uint8_t *size)
+{
+    uint16_t c = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++)
+    {
+        for (int i = 0; i < bits[l - 1]; i++, k++)
+        {
+            code[vals[k]] = c++;
+            size[vals[k]] = (uint8_t)l;
+        }
+        c <<= 1;
+    }
+}
+
+static inline int magnitude(int v)
+{
+    int n = 0;
+    for (v = v < 0 ? -v : v; v; v >>= 1) n++;
+    return n;
+}
+
+static inline void put_value(Enc &e, int v, int n)
+{
+    put_bits(e, (uint32_t)(v < 0 ? v - 1 : v), n);
+}
+
+// Forward DCT of an 8x8 block (level-shifted), separable, float
+static void fdct(const float in[64], float out[64])
+{
+    static float cs[8][8];
+    static bool ready = false;
+    if (!ready)
+    {
+        for (int u = 0; u < 8; u++)
+            for (int x = 0; x < 8; x++)
+                cs[u][x] = (u ? 0.5f : 0.35355339f) * cosf((2 * x + 1) * u * 3.14159265f / 16);
+        ready = true;
+    }
+
+    float tmp[64];
+    for (int y = 0; y < 8; y++)
+        for (int u = 0; u < 8; u++)
+        {
+            float s = 0;
+            for (int x = 0; x < 8; x++) s += cs[u][x] * in[y * 8 + x];
+            tmp[y * 8 + u] = s;
+        }
+    for (int u = 0; u < 8; u++)
+        for (int v = 0; v < 8; v++)
+        {
+            float s = 0;
+            for (int y = 0; y < 8; y++) s += cs[v][y] * tmp[y * 8 + u];
+            out[v * 8 + u] = s;
+        }
+}
+
+size_t jpegthumb_encode_gray(const uint8_t *pix, uint16_t w, uint16_t h, uint8_t quality,
+                             uint8_t *out, size_t out_cap)
+{
+    if (!w || !h) return 0;
+    Enc *e = (Enc*)calloc(1, sizeof(Enc));
+    if (!e) return 0;
+    e->out = out;
+    e->cap = out_cap;
+    make_codes(DC_BITS, DC_VALS, e->dc_code, e->dc_size);
+    make_codes(AC_BITS, AC_VALS, e->ac_code, e->ac_size);
+
+    // IJG quality scaling of the Annex K table
+    int q = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    int scale = q < 50 ? 5000 / q : 200 - 2 * q;
+    uint8_t qt[64];
+    for (int i = 0; i < 64; i++)
+    {
+        int t = (STD_LUMA_Q[i] * scale + 50) / 100;
+        qt[i] = (uint8_t)(t < 1 ? 1 : t > 255 ? 255 : t);
+    }
+
+    static const uint8_t JFIF[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+                                    0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00 };
+    for (uint8_t b : JFIF) put(*e, b);
+
+    put_u16be(*e, 0xFFDB);
+    put_u16be(*e, 67);
+    put(*e, 0);
+    for (int i = 0; i < 64; i++) put(*e, qt[ZIGZAG[i]]);
+
+    put_u16be(*e, 0xFFC0);
+    put_u16be(*e, 11);
+    put(*e, 8);
+    put_u16be(*e, h);
+    put_u16be(*e, w);
+    put(*e, 1);
+    put(*e, 1);
+    put(*e, 0x11);
+    put(*e, 0);
+
+    put_u16be(*e, 0xFFC4);
+    put_u16be(*e, (uint16_t)(2 + 17 + sizeof(DC_VALS) + 17 + sizeof(AC_VALS)));
+    put(*e, 0x00);
+    for (uint8_t b : DC_BITS) put(*e, b);
+    for (uint8_t b : DC_VALS) put(*e, b);
+    put(*e, 0x10);
+    for (uint8_t b : AC_BITS) put(*e, b);
+    for (uint8_t b : AC_VALS) put(*e, b);
+
+    static const uint8_t SOS[] = { 0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00 };
+    for (uint8_t b : SOS) put(*e, b);
+
+    int prev_dc = 0;
+    float blk[64], coef[64];
+    for (int by = 0; by < (h + 7) / 8 && !e->full; by++)
+    {
+        for (int bx = 0; bx < (w + 7) / 8; bx++)
+        {
+            // Edges repeat the last row / column
+            for (int y = 0; y < 8; y++)
+            {
+                int sy = by * 8 + y < h ? by * 8 + y : h - 1;
+                for (int x = 0; x < 8; x++)
+                {
+                    int sx = bx * 8 + x < w ? bx * 8 + x : w - 1;
+                    blk[y * 8 + x] = (float)pix[sy * w + sx] - 128.0f;
+                }
+            }
+            fdct(blk, coef);
+
+            int zz[64];
+            for (int i = 0; i < 64; i++)
+            {
+                float v = coef[ZIGZAG[i]] / qt[ZIGZAG[i]];
+                zz[i] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+            }
+
+            int diff = zz[0] - prev_dc, n = magnitude(diff);
+            prev_dc = zz[0];
+            put_bits(*e, e->dc_code[n], e->dc_size[n]);
+            if (n) put_value(*e, diff, n);
+
+            int run = 0;
+            for (int i = 1; i < 64; i++)
+            {
+                if (!zz[i])
+                {
+                    run++;
+                    continue;
+                }
+                for (; run > 15; run -= 16) put_bits(*e, e->ac_code[0xF0], e->ac_size[0xF0]);
+                n = magnitude(zz[i]);
+                if (n > 10) n = 10, zz[i] = zz[i] < 0 ? -1023 : 1023;
+                int rs = (run << 4) | n;
+                put_bits(*e, e->ac_code[rs], e->ac_size[rs]);
+                put_value(*e, zz[i], n);
+                run = 0;
+            }
+            if (run) put_bits(*e, e->ac_code[0x00], e->ac_size[0x00]);
+        }
+    }
+
+    if (e->nacc) put_bits(*e, 0x7F, 8 - e->nacc);      // pad with ones
+    put_u16be(*e, 0xFFD9);
+
+    size_t len = e->full ? 0 : e->len;
+    free(e);
+    return len;
+}
+
+/* =========================================================
+   PUBLIC
+   ========================================================= */
+bool jpegthumb_make(const ThumbReader &in, uint16_t max_side, uint8_t quality,
+                    uint8_t *out, size_t out_cap, size_t *out_len, ThumbInfo *info)
+{
+    *out_len = 0;
+    Dec *d = (Dec*)calloc(1, sizeof(Dec));
+    if (!d) return false;
+    d->in = in;
+    d->marker = -1;
+
+    bool ok = decode_plane(*d);
+    uint8_t *small = nullptr;
+    uint16_t tw = d->pw, th = d->ph;
+
+    if (ok && max_side && (tw > max_side || th > max_side))
+    {
+        // Area average of the 1/8 plane down to max_side
+        if (tw >= th)
+        {
+            th = (uint16_t)((th * max_side + tw / 2) / tw);
+            tw = max_side;
+        }
+        else
+        {
+            tw = (uint16_t)((tw * max_side + th / 2) / th);
+            th = max_side;
+        }
+        if (!tw) tw = 1;
+        if (!th) th = 1;
+
+        small = (uint8_t*)malloc((size_t)tw * th);
+        ok = small != nullptr;
+        for (uint16_t oy = 0; ok && oy < th; oy++)
+        {
+            uint32_t y0 = (uint32_t)oy * d->ph / th, y1 = (uint32_t)(oy + 1) * d->ph / th;
+            if (y1 <= y0) y1 = y0 + 1;
+            for (uint16_t ox = 0; ox < tw; ox++)
+            {
+                uint32_t x0 = (uint32_t)ox * d->pw / tw, x1 = (uint32_t)(ox + 1) * d->pw / tw;
+                if (x1 <= x0) x1 = x0 + 1;
+                uint32_t sum = 0;
+                for (uint32_t y = y0; y < y1; y++)
+                    for (uint32_t x = x0; x < x1; x++) sum += d->plane[y * d->pw + x];
+                small[oy * tw + ox] = (uint8_t)(sum / ((y1 - y0) * (x1 - x0)));
+            }
+        }
+    }
+
+    uint8_t q = quality;
+    if (ok)
+    {
+        const uint8_t *pix = small ? small : d->plane;
+        for (;;)
+        {
+            *out_len = jpegthumb_encode_gray(pix, tw, th, q, out, out_cap);
+            if (*out_len || q <= 20) break;
+            q = q > 35 ? (uint8_t)(q - 15) : 20;
+        }
+        ok = *out_len > 0;
+    }
+
+    if (info)
+    {
+        info->src_w = d->w;
+        info->src_h = d->h;
+        info->w = tw;
+        info->h = th;
+        info->quality = q;
+    }
+    free(small);
+    free(d->plane);
+    free(d);
+    return ok;
+}
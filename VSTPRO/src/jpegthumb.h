@@ -0,0 +1,33 @@
+// src/jpegthumb.h — grayscale thumbnails from the DC coefficients of a stored JPEG
+//
+// Streams the source (no full decode); baseline / extended sequential
+// only. Uses about 25 KB of heap, freed on return. README 1.4.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr uint16_t THUMB_SRC_MAX = 2048;     // larger sources are refused
+
+// Sequential source: returns bytes read, 0 at the end
+struct ThumbReader
+{
+    size_t (*read)(void *ctx, uint8_t *buf, size_t len);
+    void *ctx;
+};
+
+struct ThumbInfo
+{
+    uint16_t src_w, src_h;      // source frame
+    uint16_t w, h;              // thumbnail
+    uint8_t  quality;           // used (lowered until it fit out_cap)
+};
+
+// Returns false if the source is not a JPEG this can read, or no quality
+// down to 20 fits out_cap.
+bool jpegthumb_make(const ThumbReader &in, uint16_t max_side, uint8_t quality,
+                    uint8_t *out, size_t out_cap, size_t *out_len, ThumbInfo *info);
+
+// Encoder on its own: 8-bit grayscale, w * h pixels row by row.
+// Returns the JPEG length, 0 if it did not fit out_cap.
+size_t jpegthumb_encode_gray(const uint8_t *pix, uint16_t w, uint16_t h, uint8_t quality,
+                             uint8_t *out, size_t out_cap);
@@ -1,15 +1,22 @@
 // src/main.cpp (RFC)
-// - Always initialize MODEM/TIME first, then SD, then VisionAI
+// - Start the modem task first (non-blocking), then SD, then VisionAI
+// - Capture starts without network time; frames saved before it arrives are
+//   re-dated by the SD store once the modem task sets the clock
 // - If VisionAI is missing, DO NOT stall/reset; keep running and retry VisionAI init periodically
-// - SD filenames use SYSTEM TIME (set from modem timestamp at boot)
+// - SD filenames use SYSTEM TIME (set from the modem's network time)
 
 #include <Arduino.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "alert.h"
 #include "config.h"
 #include "modem.h"
+#include "mqttlink.h"
 #include "sdcard.h"
+#include "telemetry.h"
+#include "timesync.h"
+#include "uploader.h"
 #include "VisionAI.h"
 
 /* =========================================================
@@ -37,60 +44,61 @@ static void leds_pulse_for_target(uint8_t target)
 }
 
 /* =========================================================
-   SYSTEM TIME SET (from modem timestamp "YYYYMMDD_HHMMSS")
+   SYSTEM TIME SET (modem task, network time in UTC)
    ========================================================= */
-static bool is_digit(char c) { return (c >= '0' && c <= '9'); }
-
-static bool parse2(const char *p, int &out)
-{
-    if (!is_digit(p[0]) || !is_digit(p[1])) return false;
-    out = (p[0] - '0') * 10 + (p[1] - '0');
-    return true;
-}
-
-static bool parse4(const char *p, int &out)
-{
-    if (!is_digit(p[0]) || !is_digit(p[1]) || !is_digit(p[2]) || !is_digit(p[3])) return false;
-    out = (p[0] - '0') * 1000 + (p[1] - '0') * 100 + (p[2] - '0') * 10 + (p[3] - '0');
-    return true;
-}
-
-static bool set_system_time_from_timestamp(const char *ts)
+// Whole seconds from +CCLK? on every wake. Only the first one sets the
+// clock and asks timesync.h for a tick search; later resyncs run every
+// TIME_RESYNC_MS from timesync_step(), not on every wake.
+static void on_network_time(uint32_t epoch)
 {
-    if (!ts || strlen(ts) != 15 || ts[8] != '_') return false;
-
-    int year, mon, day, hour, min, sec;
-    if (!parse4(ts + 0, year) ||
-        !parse2(ts + 4, mon)  ||
-        !parse2(ts + 6, day)  ||
-        !parse2(ts + 9, hour) ||
-        !parse2(ts + 11, min) ||
-        !parse2(ts + 13, sec))
-        return false;
-
-    struct tm tm{};
-    tm.tm_year = year - 1900;
-    tm.tm_mon  = mon - 1;
-    tm.tm_mday = day;
-    tm.tm_hour = hour;
-    tm.tm_min  = min;
-    tm.tm_sec  = sec;
-    tm.tm_isdst = -1;
-
-    time_t t = mktime(&tm);
-    if (t < 0) return false;
+    if (timesync_valid()) return;
+    timesync_request();
 
     struct timeval tv{};
-    tv.tv_sec = t;
+    tv.tv_sec = (time_t)epoch;
     tv.tv_usec = 0;
     settimeofday(&tv, nullptr);
 
     char buf[32];
+    time_t t = (time_t)epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
     strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
-    Serial.print("🕒 SYSTEM TIME SET: ");
-    Serial.println(buf);
+    Serial.printf("🕒 SYSTEM TIME SET: %s UTC (%lu ms after boot)\n", buf, (unsigned long)millis());
 
-    return true;
+    sdcard_set_time_valid(true);
+}
+
+// <DEVICE_ID>/cmd, e.g. "full 20261018/105933_000123": that frame's
+// full JPEG goes up next (runs on the uploader or telemetry task)
+static void on_mqtt_command(const char *, const char *payload)
+{
+    if (UPLOAD_ENABLED && !uploader_request(payload))
+        Serial.printf("⚠️ mqtt command ignored: %s\n", payload);
+}
+
+// Power manager (modem task): an alert or a due telemetry batch wakes
+// the modem at once, stored frames once enough are queued
+static bool uplink_urgent()
+{
+    return (ALERT_ENABLED && alert_due()) || (TELEM_ENABLED && telemetry_due());
+}
+
+static bool uplink_idle()
+{
+    return !(UPLOAD_ENABLED && uploader_busy());
+}
+
+// Modem task, after the time is set: the uploader and the telemetry
+// batches take over the modem, alerts go first
+static void on_modem_ready()
+{
+    if (ALERT_ENABLED)
+        alert_start_task();
+    if (UPLOAD_ENABLED && sdcard_available() && uploader_init(SD_MOUNT, uploader_default_config()))
+        uploader_start_task();
+    if (TELEM_ENABLED)
+        telemetry_start_task();
 }
 
 static void log_memory()
@@ -102,40 +110,15 @@ static void log_memory()
         psramFound() ? "YES" : "NO");
 }
 
-static char g_timestamp[32] = {0};
+// Time-to-first-frame: from power-on (millis) to the first stored frame
+static bool g_first_frame = false;
 
-static void obtain_modem_timestamp_and_set_time_blocking()
+static void log_first_frame()
 {
-    while (true)
-    {
-        Serial.println("📡 modem_init_early...");
-        if (!modem_init_early())
-        {
-            Serial.println("⚠️ modem_init_early failed; retrying in 5s");
-            delay(5000);
-            continue;
-        }
-
-        Serial.println("🕒 Obtaining modem timestamp (network time)...");
-        if (modem_get_timestamp(g_timestamp, sizeof(g_timestamp)))
-        {
-            Serial.printf("🕒 Modem timestamp: %s\n", g_timestamp);
-
-            if (!set_system_time_from_timestamp(g_timestamp))
-            {
-                Serial.println("⚠️ Failed to set system time from modem timestamp; retrying in 5s");
-                delay(5000);
-                continue;
-            }
-
-            sdcard_set_time_valid(true);
-            Serial.println("[PHASE 1] DONE");
-            return;
-        }
-
-        Serial.println("⚠️ No modem timestamp yet; retrying in 5s");
-        delay(5000);
-    }
+    if (g_first_frame) return;
+    g_first_frame = true;
+    Serial.printf("⏱ time-to-first-frame: %lu ms after boot (modem %s)\n",
+                  (unsigned long)millis(), modemlink_state_name(modem_state()));
 }
 
 /* =========================================================
@@ -179,9 +162,14 @@ void setup()
     digitalWrite(LED_PIN_3, LOW);
 
     // IMPORTANT ORDER:
-    // 1) MODEM/TIME
-    Serial.println("[PHASE 1] MODEM + TIME");
-    obtain_modem_timestamp_and_set_time_blocking();
+    // 1) MODEM: rails + UART here, registration and time on the modem task
+    Serial.println("[PHASE 1] MODEM (async)");
+    PowerHooks power{};
+    power.urgent = uplink_urgent;
+    power.uplink_idle = uplink_idle;
+    if (!modem_start(on_network_time, on_modem_ready, power))
+        Serial.println("⚠️ modem not started (continuing without network time)");
+    Serial.println("[PHASE 1] DONE");
 
     // 2) SD
     Serial.println("[PHASE 2] SD INIT");
@@ -191,6 +179,18 @@ void setup()
     // 3) VisionAI (non-fatal if missing)
     try_visionai_begin_now();
 
+    // 4) Uplink starts from the modem task (on_modem_ready); telemetry
+    //    and alerts queue detections from the first frame on
+    if (TELEM_ENABLED && !telemetry_init(telemetry_default_config()))
+        Serial.println("⚠️ telemetry disabled");
+    if (ALERT_ENABLED && !alert_init(alert_default_config()))
+        Serial.println("⚠️ alerts disabled");
+    if (MQTT_ENABLED)
+    {
+        if (mqtt_init(mqtt_default_config())) mqtt_on_message(on_mqtt_command);
+        else Serial.println("⚠️ MQTT disabled, thumbnails and telemetry will not go out");
+    }
+
     Serial.println("✅ SETUP COMPLETE -> entering loop()");
     log_memory();
 }
@@ -217,15 +217,29 @@ void loop()
     if (r.ok)
     {
         // pulse LEDs for detected targets
-        for (size_t i = 0; i < r.box_count; i++)
+        for (size_t i = 0; i < r.meta.box_count; i++)
         {
-            leds_pulse_for_target(r.targets[i]);
+            leds_pulse_for_target(r.meta.boxes[i].target);
         }
 
+        if (ALERT_ENABLED)
+            alert_add(r.frame_id, &r.meta);
+        if (TELEM_ENABLED)
+            telemetry_add(r.frame_id, &r.meta);
+
+        // Two-phase: LEDs and alerts went off on the boxes, now the image
+        if (VisionAI::wants_image(r))
+            (void)VisionAI::fetch_image(r);
+
         // Save JPEG (kept enabled for debugging)
         if (sdcard_available() && r.jpeg && r.jpeg_len)
         {
-            (void)sdcard_save_jpeg(r.frame_id, r.jpeg, r.jpeg_len);
+            if (sdcard_save_jpeg(r.frame_id, r.jpeg, r.jpeg_len, &r.meta))
+            {
+                log_first_frame();
+                if (UPLOAD_ENABLED && (framemeta_detected(r.meta) || UP_UPLOAD_EMPTY))
+                    power_note_queued(r.jpeg_len);
+            }
         }
     }
     else
@@ -0,0 +1,329 @@
+// src/metalog.cpp — per-frame metadata log (see metalog.h)
+
+#include "metalog.h"
+#include "vstlog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static constexpr size_t   META_BUF_BYTES = 8192;
+static constexpr uint32_t META_EPOCH_MIN = 1577836800;   // 2020-01-01, as frameindex
+
+static const char META_HEADER[] =
+    "frame,epoch,pre_ms,inf_ms,post_ms,boxes,dropped,ref,detections,ms,"
+    "trig_boxes,trig_best,trig_lag_ms,confirmed\n";
+
+static char      g_root[32] = {0};
+static uint32_t  g_flush_bytes = 4096;
+static uint32_t  g_flush_ms = 10000;
+static int       g_fd = -1;
+static int32_t   g_day = -2;            // day number of g_fd, -1 = NOTIME
+static char      g_buf[META_BUF_BYTES];
+static size_t    g_fill = 0;
+static uint64_t  g_first_us = 0;        // when the oldest pending line was added
+static MetaStats g_stats = {};
+static off_t     g_notime_base = -1;    // NOTIME.CSV size before this boot's lines
+static char      g_in[2 * META_LINE_MAX];  // rebase read buffer
+
+static uint64_t mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static inline int32_t day_of(uint32_t epoch)
+{
+    return epoch >= META_EPOCH_MIN ? (int32_t)(epoch / 86400) : -1;
+}
+
+static void day_path(int32_t day, char *out, size_t out_sz)
+{
+    if (day < 0)
+    {
+        snprintf(out, out_sz, "%s/meta/NOTIME.CSV", g_root);
+        return;
+    }
+
+    time_t t = (time_t)day * 86400;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(out, out_sz, "%s/meta/%04d%02d%02d.CSV",
+             g_root, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+/* =========================================================
+   WRITE SIDE
+   ========================================================= */
+// A file started under an older header keeps it: it moves to the first
+// free <name>_V<n>.CSV and the day continues in a new file
+static void retire_old_header(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    char head[sizeof(META_HEADER) - 1];
+    ssize_t r = read(fd, head, sizeof(head));
+    close(fd);
+    if (r <= 0 || (r == (ssize_t)sizeof(head) && !memcmp(head, META_HEADER, sizeof(head)))) return;
+
+    char old[88];
+    struct stat st;
+    for (int v = 1; v <= 9; v++)
+    {
+        snprintf(old, sizeof(old), "%.*s_V%d.CSV", (int)(strlen(path) - 4), path, v);
+        if (stat(old, &st) != 0) break;
+    }
+    if (rename(path, old) == 0)
+        VST_LOG("🗒 metalog: %s has an older header, moved to %s\n", path, old);
+    else
+        VST_LOG("❌ metalog: cannot move %s (errno=%d)\n", path, errno);
+}
+
+static bool open_day(int32_t day)
+{
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+
+    char path[80];
+    day_path(day, path, sizeof(path));
+    retire_old_header(path);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0664);
+    if (fd < 0)
+    {
+        VST_LOG("❌ metalog: cannot open %s (errno=%d)\n", path, errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0)
+    {
+        (void)!write(fd, META_HEADER, sizeof(META_HEADER) - 1);
+    }
+    else
+    {
+        // Torn last line after a power cut: end it so the next line starts clean
+        char last = '\n';
+        if (pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n')
+            (void)!write(fd, "\n", 1);
+    }
+
+    if (day < 0 && g_notime_base < 0)
+        g_notime_base = lseek(fd, 0, SEEK_END);
+
+    g_fd = fd;
+    g_day = day;
+    return true;
+}
+
+static bool write_pending()
+{
+    if (!g_fill || g_fd < 0) return true;
+
+    ssize_t w = write(g_fd, g_buf, g_fill);
+    bool ok = w == (ssize_t)g_fill;
+    g_stats.flushes++;
+    if (ok) g_stats.bytes += g_fill;
+    else
+    {
+        VST_LOG("❌ metalog: write failed (%d / %u)\n", (int)w, (unsigned)g_fill);
+        g_stats.errors++;
+    }
+    g_fill = 0;
+    return ok;
+}
+
+bool metalog_init(const char *root, uint32_t flush_bytes, uint32_t flush_ms)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_flush_bytes = flush_bytes ? flush_bytes : 1;
+    if (g_flush_bytes > META_BUF_BYTES - META_LINE_MAX) g_flush_bytes = META_BUF_BYTES - META_LINE_MAX;
+    g_flush_ms = flush_ms;
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+    g_day = -2;
+    g_fill = 0;
+    g_notime_base = -1;
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    char dir[48];
+    snprintf(dir, sizeof(dir), "%s/meta", g_root);
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+    {
+        VST_LOG("❌ metalog: mkdir %s failed (errno=%d)\n", dir, errno);
+        g_root[0] = 0;
+        return false;
+    }
+
+    VST_LOG("🗒 metalog ready: %s (flush at %lu B or %lu ms)\n", dir,
+            (unsigned long)g_flush_bytes, (unsigned long)g_flush_ms);
+    return true;
+}
+
+size_t metalog_append(uint32_t frame_id, uint32_t epoch, const FrameMeta *meta, const char *ref)
+{
+    if (!g_root[0]) return 0;
+
+    int32_t day = day_of(epoch);
+    if (day != g_day || g_fd < 0)
+    {
+        write_pending();
+        if (!open_day(day))
+        {
+            g_stats.errors++;
+            return 0;
+        }
+    }
+
+    size_t n = metalog_format(g_buf + g_fill, sizeof(g_buf) - g_fill, frame_id, epoch, meta, ref);
+    if (!n) return 0;
+
+    uint64_t now = mono_us();
+    if (!g_fill) g_first_us = now;
+    g_fill += n;
+    g_stats.lines++;
+
+    if (g_fill >= g_flush_bytes || (now - g_first_us) / 1000 >= g_flush_ms)
+        write_pending();
+    return n;
+}
+
+void metalog_flush(bool sync)
+{
+    if (g_fd < 0) return;
+    write_pending();
+    if (sync) fsync(g_fd);
+}
+
+// "frame,epoch,rest" -> same line with epoch + offset, into its day file
+static bool rebase_line(const char *line, int64_t offset)
+{
+    const char *c1 = strchr(line, ',');
+    if (!c1) return false;
+    char *e;
+    int64_t epoch = (int64_t)strtoul(c1 + 1, &e, 10) + offset;
+    if (*e != ',' || epoch < META_EPOCH_MIN || epoch > UINT32_MAX) return false;
+
+    int32_t day = day_of((uint32_t)epoch);
+    if (day != g_day || g_fd < 0)
+    {
+        write_pending();
+        if (!open_day(day)) return false;
+    }
+
+    size_t len = strlen(line) + 12;
+    if (g_fill + len >= sizeof(g_buf)) write_pending();
+    int n = snprintf(g_buf + g_fill, sizeof(g_buf) - g_fill, "%.*s,%lu%s\n",
+                     (int)(c1 - line), line, (unsigned long)epoch, e);
+    if (n <= 0 || (size_t)n >= sizeof(g_buf) - g_fill) return false;
+    g_fill += (size_t)n;
+    return true;
+}
+
+uint32_t metalog_rebase(int64_t offset)
+{
+    if (!g_root[0] || g_notime_base < 0) return 0;
+
+    metalog_flush(true);
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+    g_day = -2;
+
+    char path[80];
+    day_path(-1, path, sizeof(path));
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return 0;
+
+    uint32_t moved = 0;
+    off_t pos = g_notime_base;
+    size_t have = 0;
+    while (true)
+    {
+        ssize_t r = pread(fd, g_in + have, sizeof(g_in) - 1 - have, pos);
+        if (r <= 0) break;
+        pos += r;
+        have += (size_t)r;
+        g_in[have] = 0;
+
+        char *p = g_in;
+        for (char *nl; (nl = strchr(p, '\n')) != nullptr; p = nl + 1)
+        {
+            *nl = 0;
+            if (rebase_line(p, offset)) moved++;
+        }
+        have = (size_t)(g_in + have - p);
+        memmove(g_in, p, have);
+        if (have >= sizeof(g_in) - 1) have = 0;     // not a line of ours
+    }
+
+    // As frameindex_rebase(): the copies are synced before NOTIME is cut
+    metalog_flush(true);
+    ftruncate(fd, g_notime_base);
+    fsync(fd);
+    close(fd);
+    g_notime_base = -1;
+    return moved;
+}
+
+const MetaStats &metalog_stats()
+{
+    return g_stats;
+}
+
+/* =========================================================
+   FORMAT
+   ========================================================= */
+size_t metalog_format(char *out, size_t out_sz, uint32_t frame_id, uint32_t epoch,
+                      const FrameMeta *meta, const char *ref)
+{
+    if (out_sz > META_LINE_MAX) out_sz = META_LINE_MAX;
+    bool m = meta && meta->valid;
+
+    int n = snprintf(out, out_sz, "%lu,%lu,", (unsigned long)frame_id, (unsigned long)epoch);
+    if (m)
+        n += snprintf(out + n, out_sz - n, "%u,%u,%u,%u,%u,",
+                      (unsigned)meta->perf.preprocess, (unsigned)meta->perf.inference,
+                      (unsigned)meta->perf.postprocess, (unsigned)meta->box_count,
+                      (unsigned)meta->boxes_dropped);
+    else
+        n += snprintf(out + n, out_sz - n, ",,,0,0,");
+    n += snprintf(out + n, out_sz - n, "%s,", ref ? ref : "");
+
+    for (uint8_t i = 0; m && i < meta->box_count && n < (int)out_sz; i++)
+    {
+        const FrameBox &b = meta->boxes[i];
+        n += snprintf(out + n, out_sz - n, "%s%u:%u:%u:%u:%u:%u", i ? "|" : "",
+                      (unsigned)b.target, (unsigned)b.score,
+                      (unsigned)b.x, (unsigned)b.y, (unsigned)b.w, (unsigned)b.h);
+    }
+
+    if (m && meta->capture_ms > 0 && n < (int)out_sz)
+        n += snprintf(out + n, out_sz - n, ",%u", (unsigned)(meta->capture_ms % 1000));
+    else if (n < (int)out_sz)
+        n += snprintf(out + n, out_sz - n, ",");
+
+    if (m && meta->trigger.valid && n < (int)out_sz)
+    {
+        const FrameTrigger &t = meta->trigger;
+        n += snprintf(out + n, out_sz - n, ",%u,", (unsigned)t.box_count);
+        if (t.box_count && n < (int)out_sz)
+            n += snprintf(out + n, out_sz - n, "%u:%u:%u:%u:%u:%u", (unsigned)t.best.target,
+                          (unsigned)t.best.score, (unsigned)t.best.x, (unsigned)t.best.y,
+                          (unsigned)t.best.w, (unsigned)t.best.h);
+        if (n < (int)out_sz)
+            n += snprintf(out + n, out_sz - n, ",%lu,%u", (unsigned long)t.lag_ms, t.confirmed ? 1u : 0u);
+    }
+    else if (n < (int)out_sz)
+        n += snprintf(out + n, out_sz - n, ",,,,");
+
+    // Needs room for the newline: a line is never written truncated
+    if (n < 0 || (size_t)n + 1 >= out_sz) return 0;
+    out[n++] = '\n';
+    return (size_t)n;
+}
@@ -0,0 +1,37 @@
+// src/metalog.h — per-frame metadata CSV on the SD card
+//
+// <root>/meta/YYYYMMDD.CSV (NOTIME.CSV before network time), appended in
+// batches of flush_bytes / flush_ms. Columns: README 1.13.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+
+static constexpr size_t META_LINE_MAX = 1024;   // one line, 16 boxes fit easily
+
+struct MetaStats
+{
+    uint32_t lines;
+    uint32_t flushes;
+    uint32_t errors;
+    uint64_t bytes;         // written to the card
+};
+
+bool metalog_init(const char *root, uint32_t flush_bytes, uint32_t flush_ms);
+
+// Buffers one line. Returns its length (0 on error). meta may be nullptr.
+size_t metalog_append(uint32_t frame_id, uint32_t epoch, const FrameMeta *meta, const char *ref);
+
+// Writes the pending batch (and fsyncs when sync is true).
+void metalog_flush(bool sync);
+
+// Network time arrived (wall = boot seconds + offset): re-dates the
+// NOTIME lines written since boot into their day files. Returns lines moved.
+uint32_t metalog_rebase(int64_t offset);
+
+const MetaStats &metalog_stats();
+
+// Formats one line (without writing); exposed for host tools.
+size_t metalog_format(char *out, size_t out_sz, uint32_t frame_id, uint32_t epoch,
+                      const FrameMeta *meta, const char *ref);
@@ -1,17 +1,18 @@
-// src/modem.cpp (RFC) — dual-board modem init
+// src/modem.cpp (RFC) — dual-board modem power + bring-up task
 //
 // 7070 (VST_BOARD_7070):
 //   - NO PMU usage
-//   - Serial1 + TinyGSM AT + network time via +CCLK?
+//   - Serial1, then the modem task
 //
 // 7080 (VST_BOARD_7080):
 //   - PMU rails via XPowers (AXP2101)
-//   - Then Serial1 + TinyGSM AT + network time via +CCLK?
+//   - Then Serial1, then the modem task
 //
-// IMPORTANT RULES (per your requirements):
-//   - No structural/public API changes
-//   - No function renames
-//   - Modem model macro must come from build_flags (platformio.ini)
+// The modem task runs modemlink.h (AT probe, registration, network time)
+// next to capture; setup() no longer waits for the network. After that it
+// stays on as the power manager (modempower.h): PSM between uplink bursts,
+// rails off via the PMU after long idle (7080), and resyncs the clock
+// while the modem is awake (timesync.h).
 //
 // Pins always come from config.h
 
@@ -21,23 +22,14 @@
 #include <Arduino.h>
 #include <Wire.h>
 
-#ifndef TINY_GSM_RX_BUFFER
-#define TINY_GSM_RX_BUFFER 1024
-#endif
-#include <TinyGsmClient.h>
-
 #if defined(VST_BOARD_7080)
 #include <XPowersLib.h>
 static XPowersPMU PMU;
 #endif
 
-static TinyGsm modem(Serial1);
-
-// -----------------------------
-static bool is_plausible_year(int year)
-{
-    return (year >= 2020 && year <= 2099);
-}
+static void (*g_on_time)(uint32_t epoch) = nullptr;
+static void (*g_on_ready)() = nullptr;
+static PowerHooks g_power = {};
 
 // Many LilyGO boards use "inverted" PWRKEY level-shift logic.
 // Your working behavior for 7070/7080 is:
@@ -59,67 +51,6 @@ static void pwrkey_pulse()
     delay(50);
 }
 
-static bool wait_for_at_ready(uint32_t timeout_ms)
-{
-    uint32_t start = millis();
-    int retry = 0;
-
-    while (millis() - start < timeout_ms)
-    {
-        if (modem.testAT(1000))
-            return true;
-
-        delay(200);
-
-        if (++retry > 15)
-        {
-            Serial.println("⚠ AT not ready → PWRKEY pulse");
-            pwrkey_pulse();
-            retry = 0;
-        }
-    }
-    return false;
-}
-
-static bool is_registered_line(const String &line)
-{
-    int comma = line.lastIndexOf(',');
-    if (comma < 0) return false;
-
-    String stat = line.substring(comma + 1);
-    stat.trim();
-    return (stat == "1" || stat == "5");
-}
-
-static bool wait_for_network_registration(uint32_t timeout_ms)
-{
-    uint32_t start = millis();
-
-    while (millis() - start < timeout_ms)
-    {
-        modem.sendAT("+CEREG?");
-        if (modem.waitResponse(2000, "+CEREG:") == 1)
-        {
-            String line = modem.stream.readStringUntil('\n');
-            line.trim();
-            if (is_registered_line(line))
-                return true;
-        }
-
-        modem.sendAT("+CREG?");
-        if (modem.waitResponse(2000, "+CREG:") == 1)
-        {
-            String line = modem.stream.readStringUntil('\n');
-            line.trim();
-            if (is_registered_line(line))
-                return true;
-        }
-
-        delay(1000);
-    }
-    return false;
-}
-
 #if defined(VST_BOARD_7080)
 static bool pmu_enable_modem_rails_7080()
 {
@@ -149,92 +80,111 @@ static bool pmu_enable_modem_rails_7080()
     Serial.println("✅ PMU rails OK");
     return true;
 }
+
+// Power manager: modem supply off after long idle, back on before PWRKEY
+static bool pmu_modem_rails_7080(bool on)
+{
+    bool ok = on ? PMU.enableDC3() && PMU.enableBLDO2() : PMU.disableBLDO2() && PMU.disableDC3();
+    if (on) delay(100);
+    Serial.printf("%s PMU rails %s\n", ok ? "⚡" : "❌", on ? "on" : "off");
+    return ok;
+}
 #endif
 
+static int at_port_read(uint8_t *buf, size_t n)
+{
+    size_t k = 0;
+    while (k < n && Serial1.available() > 0)
+        buf[k++] = (uint8_t)Serial1.read();
+    return (int)k;
+}
+
+static int at_port_write(const uint8_t *buf, size_t n)
+{
+    return (int)Serial1.write(buf, n);
+}
+
+AtPort modem_at_port()
+{
+    return AtPort{ at_port_read, at_port_write };
+}
+
+static void modem_task(void *)
+{
+    LinkHooks hooks{ pwrkey_pulse, g_on_time };
+    modemlink_begin(hooks);
+
+    while (modemlink_state() != LinkState::READY)
+    {
+        uint32_t wait_ms = modemlink_step();
+        vTaskDelay(pdMS_TO_TICKS(wait_ms ? wait_ms : 1));
+    }
+
+    power_init(power_default_config(), g_power);
+    if (g_on_ready) g_on_ready();
+
+    for (;;)
+    {
+        uint32_t wait_ms = power_step();
+        uint32_t sync_ms = timesync_step(power_state() == PowerState::AWAKE &&
+                                         modemlink_state() == LinkState::READY);
+        if (sync_ms < wait_ms) wait_ms = sync_ms;
+        vTaskDelay(pdMS_TO_TICKS(wait_ms ? wait_ms : 1));
+    }
+}
+
 // -----------------------------
 // Public API (modem.h)
 // -----------------------------
-bool modem_init_early()
+bool modem_start(void (*on_time)(uint32_t epoch), void (*on_ready)(), const PowerHooks &power)
 {
-    static bool done = false;
-    if (done) return true;
-    done = true;
+    static bool started = false;
+    if (started) return true;
 
 #if defined(VST_BOARD_7070)
-    Serial.println("📡 modem_init_early (7070, no PMU)...");
+    Serial.println("📡 modem_start (7070, no PMU)...");
 #elif defined(VST_BOARD_7080)
-    Serial.println("📡 modem_init_early (7080, PMU rails)...");
+    Serial.println("📡 modem_start (7080, PMU rails)...");
 #else
-    Serial.println("📡 modem_init_early (unknown board)...");
+    Serial.println("📡 modem_start (unknown board)...");
 #endif
 
 #if defined(VST_BOARD_7080)
-    // Restore the previously working 7080 PMU logic
     if (!pmu_enable_modem_rails_7080())
         return false;
 #endif
 
-    // UART bring-up
+    // UART bring-up. The larger RX buffer holds an AT+SHREAD block while
+    // the uploader task is not scheduled.
+    Serial1.setRxBufferSize(4096);
     Serial1.begin(MODEM_BAUD, SERIAL_8N1, MODEM_RXD, MODEM_TXD);
-    delay(50);
+    at_begin(modem_at_port());
+    at_pipeline(MODEM_AT_PIPELINE);
+    timesync_init(timesync_default_config(), TimeSyncHooks{});
+
+    g_on_time = on_time;
+    g_on_ready = on_ready;
+    g_power = power;
+    g_power.pwrkey = pwrkey_pulse;
+    g_power.time_set = on_time;
+#if defined(VST_BOARD_7080)
+    g_power.rails = pmu_modem_rails_7080;
+#else
+    g_power.rails = nullptr;    // 7070: no PMU, PSM only
+#endif
 
-    Serial.print("📡 Probing AT");
-    if (!wait_for_at_ready(30000))
+    // Core 0 next to the SD writer; PWRKEY pulses and AT waits stay off the
+    // capture loop
+    if (xTaskCreatePinnedToCore(modem_task, "modem", 6144, nullptr, 1, nullptr, 0) != pdPASS)
     {
-        Serial.println("\n❌ Modem not responding to AT");
+        Serial.println("❌ modem task create failed");
         return false;
     }
-    Serial.println("\n✅ Modem AT ready");
-
-    // Enable network time sync hints (best-effort)
-    modem.sendAT("+CLTS=1");
-    modem.waitResponse(2000);
-
-    modem.sendAT("+CTZR=1");
-    modem.waitResponse(2000);
-
+    started = true;
     return true;
 }
 
-bool modem_get_timestamp(char *out, size_t out_len)
+LinkState modem_state()
 {
-    if (!out || out_len < 17)
-        return false;
-
-    if (!wait_for_network_registration(60000))
-        return false;
-
-    for (int attempt = 0; attempt < 10; attempt++)
-    {
-        modem.sendAT("+CCLK?");
-        if (modem.waitResponse(3000, "+CCLK:") == 1)
-        {
-            String line = modem.stream.readStringUntil('\n');
-            line.trim();
-
-            int q1 = line.indexOf('\"');
-            int q2 = line.indexOf('\"', q1 + 1);
-            if (q1 < 0 || q2 < 0) { delay(1000); continue; }
-
-            String dt = line.substring(q1 + 1, q2);
-            if (dt.length() < 17) { delay(1000); continue; }
-
-            int year = 2000 + dt.substring(0, 2).toInt();
-            if (!is_plausible_year(year)) { delay(1000); continue; }
-
-            snprintf(out, out_len,
-                     "%04d%02d%02d_%02d%02d%02d",
-                     year,
-                     dt.substring(3,5).toInt(),
-                     dt.substring(6,8).toInt(),
-                     dt.substring(9,11).toInt(),
-                     dt.substring(12,14).toInt(),
-                     dt.substring(15,17).toInt());
-
-            return true;
-        }
-        delay(1000);
-    }
-
-    return false;
+    return modemlink_state();
 }
@@ -4,10 +4,25 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Returns true if PMU + modem AT are ready (or at least AT works).
-bool modem_init_early();
+#include "modem_at.h"
+#include "modemlink.h"
+#include "modempower.h"
+#include "timesync.h"
 
-// Tries to obtain a *plausible* modem timestamp via AT+CCLK?
-// Output format: "YYYYMMDD_HHMMSS"
-// Returns true if a plausible network time was obtained, false if fallback was used.
-bool modem_get_timestamp(char *out, size_t out_len);
+// Modem power (PMU rails on 7080) and UART, then the modem task, which
+// brings the link up (modemlink.h) while capture is already running.
+// Never blocks on the network.
+//   on_time  : called from the modem task with network time (UTC), again
+//              after every wake from PSM / rails off
+//   on_ready : called from the modem task once time is set; the uplink
+//              tasks it starts share the modem (at_lock()) while the modem
+//              task goes on as the power manager (modempower.h)
+//   power    : urgent / uplink_idle for the power manager; PWRKEY and the
+//              rails are filled in here
+// Returns false if the PMU could not be set up.
+bool modem_start(void (*on_time)(uint32_t epoch), void (*on_ready)(), const PowerHooks &power);
+
+LinkState modem_state();
+
+// Serial1 as a byte port for modem_at.h. Valid after modem_start().
+AtPort modem_at_port();
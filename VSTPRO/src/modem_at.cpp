@@ -0,0 +1,660 @@
+// src/modem_at.cpp — AT command engine (see modem_at.h)
+
+#include "modem_at.h"
+#include "vstlog.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+static inline uint32_t now_ms() { return millis(); }
+static inline void idle() { delay(1); }
+
+static SemaphoreHandle_t g_owner = nullptr;
+static void lock_create() { if (!g_owner) g_owner = xSemaphoreCreateRecursiveMutex(); }
+void at_lock()   { if (g_owner) xSemaphoreTakeRecursive(g_owner, portMAX_DELAY); }
+void at_unlock() { if (g_owner) xSemaphoreGiveRecursive(g_owner); }
+#else
+#include <mutex>
+#include <time.h>
+#include <unistd.h>
+
+static std::recursive_mutex g_owner;
+static void lock_create() {}
+void at_lock()   { g_owner.lock(); }
+void at_unlock() { g_owner.unlock(); }
+static inline uint32_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+static inline void idle() { usleep(1000); }
+#endif
+
+static constexpr size_t AT_RX_BUF  = 1024;
+static constexpr int    AT_PENDING = 4;
+
+// A queued command. Slots [0, g_sent) of the ring are written and wait
+// for their answers in order, [g_sent, g_count) wait to be written.
+struct AtJob
+{
+    char     cmd[AT_CMD_MAX];   // "AT..." for echo / response matching
+    uint16_t len;
+    uint16_t name_len;          // "+CNACT" of AT+CNACT?
+    uint16_t id;
+    bool     query;             // ? / =?: lines named like it are its response
+    bool     manual;            // at_send(): data phase follows, never overlapped
+    uint32_t timeout_ms;
+    uint32_t started;           // written, everything before it answered
+    AtDone   done;
+    void    *ctx;
+};
+
+struct AtUrcSlot
+{
+    const char *prefix;
+    size_t      len;
+    AtUrc       cb;
+    void       *ctx;
+};
+
+// A blocking call waiting for its command
+struct AtWait
+{
+    bool     done;
+    AtResult r;
+};
+
+static AtPort    g_port = {};
+static bool      g_ready = false;
+static uint8_t   g_rx[AT_RX_BUF];
+static size_t    g_rx_len = 0;
+static AtJob     g_q[AT_QUEUE];
+static int       g_head = 0;
+static int       g_count = 0;
+static int       g_sent = 0;
+static uint8_t   g_depth = 1;
+static uint16_t  g_next_id = 0;
+static AtUrcSlot g_urc[AT_URC_MAX];
+static char      g_lines[AT_LINES_MAX];     // of the command at the head
+static size_t    g_lines_len = 0;
+static char      g_last[AT_LINES_MAX];      // of the last blocking command (at_lines())
+static char      g_pending[AT_PENDING][AT_LINE_MAX];   // lines seen while waiting for another
+static int       g_pending_n = 0;
+static AtWait    g_batch = {};              // at_batch_*(): first failure in r
+static int       g_batch_left = 0;
+static AtWait    g_manual = {};             // at_send() .. at_result()
+static uint16_t  g_manual_id = 0;
+static bool      g_prompt_due = false;      // the at_send() command was written
+static AtStats   g_stats = {};
+
+/* =========================================================
+   RX BUFFER
+   ========================================================= */
+static void fill()
+{
+    if (g_rx_len >= sizeof(g_rx)) return;
+    int n = g_port.read(g_rx + g_rx_len, sizeof(g_rx) - g_rx_len);
+    if (n > 0)
+    {
+        g_rx_len += (size_t)n;
+        g_stats.rx_bytes += (uint64_t)n;
+    }
+}
+
+static void consume(size_t n)
+{
+    if (n >= g_rx_len) { g_rx_len = 0; return; }
+    memmove(g_rx, g_rx + n, g_rx_len - n);
+    g_rx_len -= n;
+}
+
+// Next complete, non-empty line (without CR/LF). False if none is buffered.
+static bool take_line(char *out, size_t out_sz)
+{
+    while (true)
+    {
+        uint8_t *nl = (uint8_t*)memchr(g_rx, '\n', g_rx_len);
+        if (!nl)
+        {
+            // A line longer than the buffer: deliver what we have
+            if (g_rx_len < sizeof(g_rx)) return false;
+            nl = g_rx + g_rx_len - 1;
+        }
+
+        size_t n = (size_t)(nl - g_rx);
+        size_t len = n;
+        while (len && (g_rx[len - 1] == '\r' || g_rx[len - 1] == '\n')) len--;
+        if (len >= out_sz) len = out_sz - 1;
+        memcpy(out, g_rx, len);
+        out[len] = 0;
+        consume(n + 1);
+
+        if (len) return true;
+    }
+}
+
+static void keep_pending(const char *line)
+{
+    if (g_pending_n == AT_PENDING)
+    {
+        memmove(g_pending[0], g_pending[1], sizeof(g_pending[0]) * (AT_PENDING - 1));
+        g_pending_n--;
+        g_stats.urcs_dropped++;
+    }
+    snprintf(g_pending[g_pending_n++], AT_LINE_MAX, "%s", line);
+}
+
+static bool take_pending(const char *prefix, char *out, size_t out_sz)
+{
+    size_t pl = strlen(prefix);
+    for (int i = 0; i < g_pending_n; i++)
+    {
+        if (strncmp(g_pending[i], prefix, pl) != 0) continue;
+        snprintf(out, out_sz, "%s", g_pending[i] + pl);
+        memmove(g_pending[i], g_pending[i + 1], sizeof(g_pending[0]) * (g_pending_n - i - 1));
+        g_pending_n--;
+        return true;
+    }
+    return false;
+}
+
+/* =========================================================
+   QUEUE
+   ========================================================= */
+static AtJob &job(int i)
+{
+    return g_q[(g_head + i) % AT_QUEUE];
+}
+
+static uint16_t submit_v(uint32_t timeout_ms, AtDone done, void *ctx, bool manual,
+                         const char *fmt, va_list ap)
+{
+    if (!g_ready || g_count == AT_QUEUE) return 0;
+
+    AtJob &j = job(g_count);
+    j.cmd[0] = 'A';
+    j.cmd[1] = 'T';
+    int n = vsnprintf(j.cmd + 2, sizeof(j.cmd) - 3, fmt, ap);
+    if (n < 0 || (size_t)n >= sizeof(j.cmd) - 3) return 0;
+    j.len = (uint16_t)(n + 2);
+
+    // "+CNACT" for AT+CNACT?: response lines, as opposed to URCs
+    j.name_len = (uint16_t)strcspn(j.cmd + 2, "=?");
+    const char *t = j.cmd + 2 + j.name_len;
+    j.query = t[0] == '?' || (t[0] == '=' && t[1] == '?');
+    j.manual = manual;
+    j.timeout_ms = timeout_ms;
+    j.started = 0;
+    j.done = done;
+    j.ctx = ctx;
+    if (!++g_next_id) g_next_id = 1;
+    j.id = g_next_id;
+
+    g_count++;
+    if (g_count > g_stats.queue_max) g_stats.queue_max = (uint16_t)g_count;
+    return j.id;
+}
+
+// The head command got its final result code (or timed out)
+static void complete(AtResult r)
+{
+    AtJob &j = job(0);
+    AtDone done = j.done;
+    void *ctx = j.ctx;
+    if (r == AtResult::ERROR) g_stats.errors++;
+    if (r == AtResult::TIMEOUT) g_stats.timeouts++;
+
+    g_head = (g_head + 1) % AT_QUEUE;
+    g_count--;
+    g_sent--;
+    if (g_sent) job(0).started = now_ms();   // the modem moves on to the next one
+
+    // The callback may queue more; lines are reset after it
+    if (done) done(r, g_lines, ctx);
+    g_lines_len = 0;
+    g_lines[0] = 0;
+}
+
+static void write_queued()
+{
+    while (g_sent < g_count)
+    {
+        AtJob &j = job(g_sent);
+        if (g_sent && (g_sent >= g_depth || j.manual || job(g_sent - 1).manual)) return;
+
+        j.cmd[j.len] = '\r';
+        bool ok = at_write(j.cmd, (size_t)j.len + 1);
+        j.cmd[j.len] = 0;
+        if (!ok)
+        {
+            if (g_sent) return;     // retried once the head is answered
+            g_sent = 1;
+            complete(AtResult::TIMEOUT);
+            continue;
+        }
+
+        if (g_sent) g_stats.pipelined++;
+        else j.started = now_ms();
+        g_sent++;
+        g_stats.commands++;
+        if (j.manual) g_prompt_due = true;
+    }
+}
+
+static void expire()
+{
+    if (!g_sent) return;
+    AtJob &j = job(0);
+    if (now_ms() - j.started < j.timeout_ms) return;
+
+    // Answers still on their way cannot be matched any more
+    int n = g_sent;
+    for (int i = 0; i < n; i++) complete(AtResult::TIMEOUT);
+}
+
+/* =========================================================
+   LINES
+   ========================================================= */
+static const AtUrcSlot *urc_for(const char *line)
+{
+    for (const AtUrcSlot &u : g_urc)
+        if (u.cb && !strncmp(line, u.prefix, u.len)) return &u;
+    return nullptr;
+}
+
+static void route_line(const char *line)
+{
+    for (int i = 0; i < g_sent; i++)
+        if (!strcmp(line, job(i).cmd)) return;     // echo (ATE1)
+
+    if (!strcmp(line, "OK"))
+    {
+        if (g_sent) complete(AtResult::OK);
+        return;
+    }
+    if (!strcmp(line, "ERROR") || !strncmp(line, "+CME ERROR", 10) || !strncmp(line, "+CMS ERROR", 10))
+    {
+        if (g_sent) complete(AtResult::ERROR);
+        return;
+    }
+
+    const AtUrcSlot *u = urc_for(line);
+    if (!g_sent)
+    {
+        if (u)
+        {
+            g_stats.urcs++;
+            u->cb(line, u->ctx);
+        }
+        else keep_pending(line);
+        return;
+    }
+
+    const AtJob &j = job(0);
+    bool named = (line[0] == '+' || line[0] == '*') && !strncmp(line, j.cmd + 2, j.name_len);
+    size_t len = strlen(line);
+    if (g_lines_len + len + 2 < sizeof(g_lines))
+    {
+        memcpy(g_lines + g_lines_len, line, len);
+        g_lines_len += len;
+        g_lines[g_lines_len++] = '\n';
+        g_lines[g_lines_len] = 0;
+    }
+
+    // "+SMSUB: ..." during AT+SMSUB=... is a message, "+CEREG: 0,1" during
+    // AT+CEREG? is not
+    if (u && !(named && j.query))
+    {
+        g_stats.urcs++;
+        u->cb(line, u->ctx);
+    }
+    // May also be a URC someone waits for next (+SHREQ, +APP PDP, ...)
+    else if (!u && line[0] == '+' && !named) keep_pending(line);
+}
+
+// Lines until *stop: what follows the answer a blocking call waited for
+// may be a binary payload for at_read()
+static void service(const bool *stop)
+{
+    if (!g_ready) return;
+    fill();
+    char line[AT_LINE_MAX];
+    while (!(stop && *stop) && take_line(line, sizeof(line))) route_line(line);
+    if (stop && *stop) return;
+    write_queued();
+    expire();
+}
+
+static void wait_done(AtResult r, const char *lines, void *ctx)
+{
+    snprintf(g_last, sizeof(g_last), "%s", lines);
+    AtWait *w = (AtWait*)ctx;
+    w->r = r;
+    w->done = true;
+}
+
+static AtResult wait_for(AtWait &w)
+{
+    while (true)
+    {
+        service(&w.done);
+        if (w.done) return w.r;
+        idle();
+    }
+}
+
+// Blocking calls wait for room rather than fail
+static void wait_room()
+{
+    while (g_ready && g_count == AT_QUEUE)
+    {
+        service(nullptr);
+        idle();
+    }
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+void at_begin(const AtPort &port)
+{
+    lock_create();
+    g_port = port;
+    g_ready = port.read && port.write;
+    g_rx_len = 0;
+    g_pending_n = 0;
+    g_head = g_count = g_sent = 0;
+    g_lines_len = 0;
+    g_lines[0] = 0;
+    g_last[0] = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+bool at_ready()
+{
+    return g_ready;
+}
+
+bool at_write(const void *data, size_t len)
+{
+    if (!g_ready) return false;
+    const uint8_t *p = (const uint8_t*)data;
+    size_t done = 0;
+    uint32_t t0 = now_ms();
+
+    while (done < len)
+    {
+        int n = g_port.write(p + done, len - done);
+        if (n > 0) { done += (size_t)n; t0 = now_ms(); continue; }
+        if (now_ms() - t0 > 2000) return false;
+        idle();
+    }
+    g_stats.tx_bytes += len;
+    return true;
+}
+
+uint16_t at_submit(uint32_t timeout_ms, AtDone done, void *ctx, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    uint16_t id = submit_v(timeout_ms, done, ctx, false, fmt, ap);
+    va_end(ap);
+    if (id) write_queued();     // on its way before the caller sleeps
+    return id;
+}
+
+void at_service()
+{
+    service(nullptr);
+}
+
+int at_pending()
+{
+    return g_count;
+}
+
+void at_pipeline(uint8_t depth)
+{
+    g_depth = depth < 1 ? 1 : depth > AT_QUEUE ? AT_QUEUE : depth;
+}
+
+bool at_on_urc(const char *prefix, AtUrc cb, void *ctx)
+{
+    AtUrcSlot *free_slot = nullptr;
+    for (AtUrcSlot &u : g_urc)
+    {
+        if (u.cb && !strcmp(u.prefix, prefix))
+        {
+            u.cb = cb;
+            u.ctx = ctx;
+            return true;
+        }
+        if (!u.cb && !free_slot) free_slot = &u;
+    }
+    if (!cb) return true;
+    if (!free_slot) return false;
+    *free_slot = AtUrcSlot{ prefix, strlen(prefix), cb, ctx };
+    return true;
+}
+
+AtResult at_cmd(uint32_t timeout_ms, const char *fmt, ...)
+{
+    wait_room();
+    AtWait w = {};
+    va_list ap;
+    va_start(ap, fmt);
+    uint16_t id = submit_v(timeout_ms, wait_done, &w, false, fmt, ap);
+    va_end(ap);
+    if (!id) return g_ready ? AtResult::TIMEOUT : AtResult::ERROR;
+    return wait_for(w);
+}
+
+static void batch_done(AtResult r, const char *, void *)
+{
+    if (r != AtResult::OK && g_batch.r == AtResult::OK) g_batch.r = r;
+    g_batch.done = --g_batch_left == 0;
+}
+
+void at_batch_begin()
+{
+    g_batch = AtWait{ false, AtResult::OK };
+    g_batch_left = 0;
+}
+
+bool at_batch_add(uint32_t timeout_ms, const char *fmt, ...)
+{
+    wait_room();
+    va_list ap;
+    va_start(ap, fmt);
+    uint16_t id = submit_v(timeout_ms, batch_done, nullptr, false, fmt, ap);
+    va_end(ap);
+    if (!id)
+    {
+        if (g_batch.r == AtResult::OK) g_batch.r = g_ready ? AtResult::TIMEOUT : AtResult::ERROR;
+        return false;
+    }
+    g_batch_left++;
+    g_batch.done = false;
+    return true;
+}
+
+AtResult at_batch_wait()
+{
+    if (g_batch_left) wait_for(g_batch);
+    return g_batch.r;
+}
+
+bool at_send(const char *fmt, ...)
+{
+    wait_room();
+    g_manual = AtWait{};
+    g_prompt_due = false;
+    va_list ap;
+    va_start(ap, fmt);
+    // No timeout until at_result() says how long the answer may take
+    g_manual_id = submit_v(UINT32_MAX, wait_done, &g_manual, true, fmt, ap);
+    va_end(ap);
+    if (!g_manual_id) return false;
+
+    while (!g_prompt_due && !g_manual.done)
+    {
+        service(&g_prompt_due);
+        if (!g_prompt_due) idle();
+    }
+    return !g_manual.done;
+}
+
+AtResult at_result(uint32_t timeout_ms)
+{
+    if (!g_manual_id) return AtResult::ERROR;
+    if (!g_manual.done && g_sent && job(0).id == g_manual_id)
+    {
+        job(0).timeout_ms = timeout_ms;
+        job(0).started = now_ms();
+    }
+    AtResult r = wait_for(g_manual);
+    g_manual_id = 0;
+    return r;
+}
+
+const char *at_lines()
+{
+    return g_last;
+}
+
+bool at_find(const char *prefix, char *out, size_t out_sz)
+{
+    return at_find_in(g_last, prefix, out, out_sz);
+}
+
+bool at_find_in(const char *lines, const char *prefix, char *out, size_t out_sz)
+{
+    size_t pl = strlen(prefix);
+    for (const char *p = lines; *p; )
+    {
+        const char *e = strchr(p, '\n');
+        size_t len = e ? (size_t)(e - p) : strlen(p);
+        if (len >= pl && !strncmp(p, prefix, pl))
+        {
+            size_t n = len - pl;
+            if (n >= out_sz) n = out_sz - 1;
+            memcpy(out, p + pl, n);
+            out[n] = 0;
+            return true;
+        }
+        if (!e) break;
+        p = e + 1;
+    }
+    return false;
+}
+
+bool at_wait_line(const char *prefix, char *out, size_t out_sz, uint32_t timeout_ms)
+{
+    if (take_pending(prefix, out, out_sz)) return true;
+
+    size_t pl = strlen(prefix);
+    char line[AT_LINE_MAX];
+    uint32_t t0 = now_ms();
+    while (now_ms() - t0 < timeout_ms)
+    {
+        fill();
+        if (!take_line(line, sizeof(line)))
+        {
+            write_queued();
+            expire();
+            idle();
+            continue;
+        }
+        if (!strncmp(line, prefix, pl))
+        {
+            snprintf(out, out_sz, "%s", line + pl);
+            return true;
+        }
+        route_line(line);
+    }
+    g_stats.timeouts++;
+    return false;
+}
+
+bool at_wait_flag(const bool *flag, uint32_t timeout_ms)
+{
+    uint32_t t0 = now_ms();
+    while (!*flag && now_ms() - t0 < timeout_ms)
+    {
+        service(flag);
+        if (!*flag) idle();
+    }
+    return *flag;
+}
+
+bool at_wait_prompt(uint32_t timeout_ms)
+{
+    return at_wait_text(">", timeout_ms);
+}
+
+bool at_wait_text(const char *text, uint32_t timeout_ms)
+{
+    size_t tl = strlen(text);
+    uint32_t t0 = now_ms();
+    while (now_ms() - t0 < timeout_ms)
+    {
+        fill();
+        uint8_t *p = (uint8_t*)memmem(g_rx, g_rx_len, text, tl);
+        if (p)
+        {
+            consume((size_t)(p - g_rx) + tl);
+            return true;
+        }
+        // Full of something else: keep only what may be the start of text
+        if (g_rx_len == sizeof(g_rx)) consume(g_rx_len - (tl - 1));
+        idle();
+    }
+    g_stats.timeouts++;
+    return false;
+}
+
+bool at_read(void *buf, size_t len, uint32_t timeout_ms)
+{
+    uint8_t *out = (uint8_t*)buf;
+    size_t got = 0;
+    uint32_t t0 = now_ms();
+
+    while (got < len)
+    {
+        fill();
+        if (g_rx_len)
+        {
+            size_t n = g_rx_len < len - got ? g_rx_len : len - got;
+            memcpy(out + got, g_rx, n);
+            consume(n);
+            got += n;
+            t0 = now_ms();
+            continue;
+        }
+        if (now_ms() - t0 > timeout_ms)
+        {
+            g_stats.timeouts++;
+            return false;
+        }
+        idle();
+    }
+    return true;
+}
+
+void at_flush_input()
+{
+    fill();
+    g_rx_len = 0;
+    g_pending_n = 0;
+}
+
+const AtStats &at_stats()
+{
+    return g_stats;
+}
@@ -0,0 +1,134 @@
+// src/modem_at.h — AT command queue, line parser and URC dispatch
+//
+// Runs on Serial1 (modem_at_port()) and on a host pseudo-terminal alike.
+// README 1.9. Tasks sharing the modem hold at_lock() around each unit of
+// work; at_submit() and at_service() need it too.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte transport. read() must not block: return what is available (0 = none).
+struct AtPort
+{
+    int (*read)(uint8_t *buf, size_t n);
+    int (*write)(const uint8_t *buf, size_t n);
+};
+
+enum class AtResult : uint8_t
+{
+    OK,
+    ERROR,      // ERROR / +CME ERROR / +CMS ERROR
+    TIMEOUT,
+};
+
+struct AtStats
+{
+    uint32_t commands;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t urcs_dropped;  // unsolicited lines nobody waited for
+    uint32_t urcs;          // dispatched to at_on_urc() handlers
+    uint32_t pipelined;     // commands written while another was in flight
+    uint16_t queue_max;     // deepest the command queue has been
+};
+
+// Final result of a queued command. lines: its intermediate lines,
+// '\n' separated (valid during the call only).
+typedef void (*AtDone)(AtResult r, const char *lines, void *ctx);
+
+// An unsolicited line (whole, e.g. "+CEREG: 1").
+typedef void (*AtUrc)(const char *line, void *ctx);
+
+static constexpr size_t AT_CMD_MAX   = 512;    // SHREQ paths carry a SAS token
+static constexpr size_t AT_LINE_MAX  = 256;
+static constexpr size_t AT_LINES_MAX = 1024;   // intermediate lines of one command
+static constexpr int    AT_QUEUE     = 8;      // commands queued or in flight
+static constexpr int    AT_URC_MAX   = 8;      // at_on_urc() handlers
+
+void at_begin(const AtPort &port);
+bool at_ready();
+
+// Modem ownership between tasks (recursive).
+void at_lock();
+void at_unlock();
+
+/* ---- Queue ---- */
+
+// Queues "AT<cmd>\r"; done (may be nullptr) gets the result from
+// at_service(). The timeout runs from when the modem is known to work on
+// the command (written, and everything before it answered). Returns an id
+// > 0, or 0 when the queue is full or the port is not set.
+uint16_t at_submit(uint32_t timeout_ms, AtDone done, void *ctx, const char *fmt, ...);
+
+// Reads what the port has, dispatches URCs, completes commands, writes
+// queued ones and expires timeouts. Never blocks. The callbacks run in
+// here: keep them short; they may at_submit() but not block.
+void at_service();
+
+// Commands queued or in flight.
+int at_pending();
+
+// Commands written before the previous one answered (1..AT_QUEUE). A
+// timeout fails every command in flight, since later answers cannot be
+// told apart any more. Data-phase commands (at_send()) never overlap.
+void at_pipeline(uint8_t depth);
+
+// Lines starting with prefix go to cb (replaces a handler for the same
+// prefix; cb = nullptr removes it). Also while a command is in flight,
+// except the response lines of a query ("+CEREG: 0,1" to AT+CEREG?).
+// prefix must stay valid (a literal). False when the table is full.
+bool at_on_urc(const char *prefix, AtUrc cb, void *ctx);
+
+/* ---- Blocking ---- */
+
+// at_submit() + at_service() until the result: OK / ERROR or timeout.
+AtResult at_cmd(uint32_t timeout_ms, const char *fmt, ...);
+
+// Commands whose answers only matter together (AT+SHCONF, AT+SHAHEAD,
+// ...): queued back to back, so with at_pipeline() > 1 they cost about
+// one round trip. at_batch_wait() returns OK, or the first failure.
+void at_batch_begin();
+bool at_batch_add(uint32_t timeout_ms, const char *fmt, ...);
+AtResult at_batch_wait();
+
+// The two halves of at_cmd(), for commands with a '>' data phase:
+// at_send(), at_wait_prompt(), at_write(), at_result().
+bool at_send(const char *fmt, ...);
+AtResult at_result(uint32_t timeout_ms);
+
+// Intermediate lines of the last at_cmd(), '\n' separated.
+const char *at_lines();
+
+// Copies what follows `prefix` on the first line of at_lines() that starts
+// with it (e.g. "+CNACT: "). False if there is none.
+bool at_find(const char *prefix, char *out, size_t out_sz);
+// The same on other lines (those an AtDone callback got).
+bool at_find_in(const char *lines, const char *prefix, char *out, size_t out_sz);
+
+// Waits for a line starting with prefix (a URC such as "+SHREQ:") and
+// copies the text after the prefix. Other lines seen meanwhile go to
+// their handler, or are kept (a few) for later waits.
+bool at_wait_line(const char *prefix, char *out, size_t out_sz, uint32_t timeout_ms);
+
+// at_service() until *flag (set by a URC handler or an AtDone callback)
+// or the timeout. Returns *flag.
+bool at_wait_flag(const bool *flag, uint32_t timeout_ms);
+
+// Waits for the '>' data prompt.
+bool at_wait_prompt(uint32_t timeout_ms);
+
+// Waits for text anywhere in the input and drops everything up to and
+// including it, for responses with binary data on the same line
+// ("+CARECV: <len>,<data>").
+bool at_wait_text(const char *text, uint32_t timeout_ms);
+
+// Raw payload after a prompt / raw payload of a response.
+bool at_write(const void *data, size_t len);
+bool at_read(void *buf, size_t len, uint32_t timeout_ms);
+
+// Drops anything buffered (after a timeout, before a resync).
+void at_flush_input();
+
+const AtStats &at_stats();
@@ -0,0 +1,360 @@
+// src/modemlink.cpp — modem bring-up state machine (see modemlink.h)
+
+#include "modemlink.h"
+#include "config.h"
+#include "modem_at.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t now_ms() { return millis(); }
+#else
+#include <time.h>
+static inline uint32_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+#endif
+
+static constexpr uint32_t LINK_AT_TIMEOUT_MS = 1000;
+static constexpr uint32_t LINK_PROBE_MS      = 200;
+static constexpr uint32_t LINK_SERVICE_MS    = 20;      // answer / URC check while waiting
+static constexpr uint32_t LINK_URC_POLL_MS   = 5000;    // +CEREG? fallback once the URC is on
+static constexpr uint8_t  LINK_LOST_AFTER    = 3;       // silent polls before re-probing
+static constexpr uint32_t LINK_WAIT_LOG_MS   = 30000;
+
+static LinkHooks g_hooks = {};
+static LinkState g_state = LinkState::PROBE;
+static LinkStats g_stats = {};
+static uint32_t  g_t0 = 0;
+static uint32_t  g_last_log = 0;
+static uint16_t  g_misses = 0;
+static uint8_t   g_config_step = 0;
+static uint32_t  g_poll_at = 0;         // last +CEREG? / +CCLK?, 0 = poll now
+static bool      g_legacy = false;      // next registration poll is +CREG?
+
+// The exchange in flight (at_submit())
+static bool        g_asked = false;
+static uintptr_t   g_ask_seq = 0;       // answers to an earlier modemlink_begin() are stale
+static bool        g_answered = false;
+static AtResult    g_answer = AtResult::OK;
+static const char *g_want = nullptr;    // line prefix to keep from the answer
+static char        g_value[48];
+
+// From URCs
+static bool g_urcs = false;             // AT+CEREG=1 accepted
+static bool g_urc_registered = false;
+static bool g_time_hint = false;        // *PSUTTZ / +CTZV: the network sent the time
+
+/* =========================================================
+   PARSING
+   ========================================================= */
+static int64_t days_from_civil(int y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+uint32_t modemlink_parse_cclk(const char *v)
+{
+    // "26/06/01,12:30:05+08"
+    int yy, mo, dd, hh, mi, ss, tz = 0;
+    char sign = '+';
+    const char *p = strchr(v, '"');
+    p = p ? p + 1 : v;
+    int n = sscanf(p, "%d/%d/%d,%d:%d:%d%c%d", &yy, &mo, &dd, &hh, &mi, &ss, &sign, &tz);
+    if (n < 6) return 0;
+
+    int year = 2000 + yy;
+    if (year < 2020 || year > 2099 || mo < 1 || mo > 12 || dd < 1 || dd > 31 ||
+        hh > 23 || mi > 59 || ss > 60)
+        return 0;
+
+    // +CCLK is local time; the zone is in quarter hours
+    int64_t t = days_from_civil(year, (unsigned)mo, (unsigned)dd) * 86400 + hh * 3600 + mi * 60 + ss;
+    if (n == 8) t -= (sign == '-' ? -tz : tz) * 900;
+    return (uint32_t)t;
+}
+
+// "+CEREG: 0,1" / "+CEREG: 2,5,\"1A2B\",..." -> registered (home / roaming)
+static bool registered(const char *v)
+{
+    const char *c = strchr(v, ',');
+    if (!c) return false;
+    int stat = atoi(c + 1);
+    return stat == 1 || stat == 5;
+}
+
+/* =========================================================
+   URCs
+   ========================================================= */
+// "+CEREG: 1" (mode 1) / "+CEREG: 5,"1A2B",..." (modes 2 and 4): the
+// status comes first, unlike the answer to +CEREG?
+static void on_cereg(const char *line, void *)
+{
+    int stat = atoi(line + 8);
+    g_urc_registered = stat == 1 || stat == 5;
+}
+
+static void on_time_urc(const char *, void *)
+{
+    g_time_hint = true;
+}
+
+/* =========================================================
+   EXCHANGES
+   ========================================================= */
+static void answered(AtResult r, const char *lines, void *ctx)
+{
+    if ((uintptr_t)ctx != g_ask_seq) return;
+    g_answer = r;
+    g_value[0] = 0;
+    if (r == AtResult::OK && g_want) at_find_in(lines, g_want, g_value, sizeof(g_value));
+    g_answered = true;
+}
+
+// Queues one command; the answer is looked at on a later step
+static uint32_t ask(const char *cmd, const char *want = nullptr)
+{
+    g_want = want;
+    g_answered = false;
+    g_asked = at_submit(LINK_AT_TIMEOUT_MS, answered, (void*)++g_ask_seq, "%s", cmd) != 0;
+    if (!g_asked) return LINK_PROBE_MS;     // queue full: try again
+    g_stats.polls++;
+    return LINK_SERVICE_MS;
+}
+
+/* =========================================================
+   STATES
+   ========================================================= */
+static void enter(LinkState s)
+{
+    uint32_t t = now_ms() - g_t0;
+    VST_LOG("📡 modem: %s -> %s (%lu ms)\n", modemlink_state_name(g_state), modemlink_state_name(s),
+            (unsigned long)t);
+    g_state = s;
+    g_misses = 0;
+    g_last_log = now_ms();
+    g_config_step = 0;
+    g_poll_at = 0;
+    g_legacy = false;
+}
+
+// A poll that got no answer at all: after a few, the modem is gone
+static uint32_t missed(uint32_t retry_ms)
+{
+    if (++g_misses >= LINK_LOST_AFTER)
+    {
+        VST_LOG("⚠️ modem stopped answering, probing again\n");
+        enter(LinkState::PROBE);
+        return LINK_PROBE_MS;
+    }
+    return retry_ms;
+}
+
+static void log_waiting(const char *what)
+{
+    if (now_ms() - g_last_log < LINK_WAIT_LOG_MS) return;
+    g_last_log = now_ms();
+    VST_LOG("⏳ modem: still waiting for %s (%lu s)\n", what, (unsigned long)((now_ms() - g_t0) / 1000));
+}
+
+// Polls are due every interval; in between the step only looks at URCs
+static bool poll_due(uint32_t interval_ms)
+{
+    if (g_poll_at && now_ms() - g_poll_at < interval_ms) return false;
+    g_poll_at = now_ms();
+    return true;
+}
+
+static uint32_t wait_ms(uint32_t interval_ms)
+{
+    return g_urcs ? LINK_SERVICE_MS * 5 : interval_ms;
+}
+
+/* ---- PROBE ---- */
+static uint32_t probe_answer()
+{
+    if (g_answer == AtResult::OK)
+    {
+        if (!g_stats.at_ms) g_stats.at_ms = now_ms() - g_t0;
+        enter(LinkState::CONFIG);
+        return 0;
+    }
+
+    if (++g_misses % MODEM_PULSE_EVERY == 0 && g_hooks.pwrkey)
+    {
+        VST_LOG("⚠ AT not ready → PWRKEY pulse\n");
+        g_hooks.pwrkey();
+        g_stats.pwrkey_pulses++;
+    }
+    return LINK_PROBE_MS;
+}
+
+/* ---- CONFIG ---- */
+// Echo off first: the uplink parser expects it. Time sync hints and the
+// registration URC are best effort, as before.
+static const char *const CONFIG_CMDS[] = { "E0", "+CLTS=1", "+CTZR=1", "+CEREG=1" };
+static constexpr uint8_t CONFIG_N = sizeof(CONFIG_CMDS) / sizeof(CONFIG_CMDS[0]);
+
+static uint32_t config_answer()
+{
+    if (g_answer == AtResult::TIMEOUT) return missed(LINK_PROBE_MS);
+    if (g_config_step == CONFIG_N - 1) g_urcs = g_answer == AtResult::OK;
+
+    if (++g_config_step == CONFIG_N)
+        enter(LinkState::REGISTER);
+    return 0;
+}
+
+/* ---- REGISTER ---- */
+static uint32_t reg_done()
+{
+    g_stats.reg_ms = now_ms() - g_t0;
+    enter(LinkState::CLOCK);
+    return 0;
+}
+
+static uint32_t register_step()
+{
+    if (g_urc_registered) return reg_done();
+    if (!poll_due(g_urcs ? LINK_URC_POLL_MS : MODEM_POLL_MS))
+    {
+        log_waiting("network registration");
+        return wait_ms(MODEM_POLL_MS);
+    }
+    // Alternate LTE (+CEREG) and the legacy registration (+CREG)
+    bool legacy = g_legacy;
+    g_legacy = !g_legacy;
+    return ask(legacy ? "+CREG?" : "+CEREG?", legacy ? "+CREG: " : "+CEREG: ");
+}
+
+static uint32_t register_answer()
+{
+    if (g_answer == AtResult::TIMEOUT) return missed(MODEM_POLL_MS);
+    g_misses = 0;
+    if (g_answer == AtResult::OK && g_value[0] && registered(g_value)) return reg_done();
+    log_waiting("network registration");
+    return wait_ms(MODEM_POLL_MS);
+}
+
+/* ---- CLOCK ---- */
+static uint32_t clock_step()
+{
+    bool hint = g_time_hint;
+    g_time_hint = false;
+    if (!poll_due(MODEM_POLL_MS) && !hint) return wait_ms(MODEM_POLL_MS);
+    return ask("+CCLK?", "+CCLK: ");
+}
+
+static uint32_t clock_answer()
+{
+    if (g_answer == AtResult::TIMEOUT) return missed(MODEM_POLL_MS);
+    g_misses = 0;
+
+    uint32_t epoch = 0;
+    if (g_answer == AtResult::OK && g_value[0])
+    {
+        epoch = modemlink_parse_cclk(g_value);
+        if (!epoch) g_stats.clock_rejects++;
+    }
+    if (!epoch)
+    {
+        log_waiting("network time");
+        return wait_ms(MODEM_POLL_MS);
+    }
+
+    g_stats.time_ms = now_ms() - g_t0;
+    enter(LinkState::READY);
+    VST_LOG("🕒 network time %lu (AT %lu ms, registered %lu ms, time %lu ms)\n",
+            (unsigned long)epoch, (unsigned long)g_stats.at_ms,
+            (unsigned long)g_stats.reg_ms, (unsigned long)g_stats.time_ms);
+    if (g_hooks.time_set) g_hooks.time_set(epoch);
+    return 0;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+void modemlink_begin(const LinkHooks &hooks)
+{
+    g_hooks = hooks;
+    g_state = LinkState::PROBE;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_t0 = now_ms();
+    g_last_log = g_t0;
+    g_misses = 0;
+    g_config_step = 0;
+    g_poll_at = 0;
+    g_asked = false;
+    g_ask_seq++;
+    g_urcs = g_urc_registered = g_time_hint = false;
+    at_on_urc("+CEREG: ", on_cereg, nullptr);
+    at_on_urc("*PSUTTZ: ", on_time_urc, nullptr);
+    at_on_urc("+CTZV: ", on_time_urc, nullptr);
+}
+
+uint32_t modemlink_step()
+{
+    at_service();
+    if (g_state == LinkState::READY) return MODEM_POLL_MS;
+
+    if (g_asked)
+    {
+        if (!g_answered) return LINK_SERVICE_MS;
+        g_asked = false;
+        uint32_t wait = MODEM_POLL_MS;
+        switch (g_state)
+        {
+        case LinkState::PROBE:    wait = probe_answer(); break;
+        case LinkState::CONFIG:   wait = config_answer(); break;
+        case LinkState::REGISTER: wait = register_answer(); break;
+        case LinkState::CLOCK:    wait = clock_answer(); break;
+        default:                  break;
+        }
+        // Next command at once when nothing to wait for
+        if (wait || g_state == LinkState::READY) return wait;
+    }
+
+    switch (g_state)
+    {
+    case LinkState::PROBE:    return ask("");
+    case LinkState::CONFIG:   return ask(CONFIG_CMDS[g_config_step]);
+    case LinkState::REGISTER: return register_step();
+    case LinkState::CLOCK:    return clock_step();
+    default:                  return MODEM_POLL_MS;
+    }
+}
+
+LinkState modemlink_state()
+{
+    return g_state;
+}
+
+const char *modemlink_state_name(LinkState s)
+{
+    switch (s)
+    {
+    case LinkState::PROBE:    return "PROBE";
+    case LinkState::CONFIG:   return "CONFIG";
+    case LinkState::REGISTER: return "REGISTER";
+    case LinkState::CLOCK:    return "CLOCK";
+    case LinkState::READY:    return "READY";
+    }
+    return "?";
+}
+
+const LinkStats &modemlink_stats()
+{
+    return g_stats;
+}
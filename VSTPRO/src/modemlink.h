@@ -0,0 +1,44 @@
+// src/modemlink.h — non-blocking modem bring-up (PROBE → CONFIG → REGISTER → CLOCK → READY)
+//
+// Each step queues one command or handles its answer or a URC. README 1.1.
+#pragma once
+#include <stdint.h>
+
+enum class LinkState : uint8_t
+{
+    PROBE,
+    CONFIG,
+    REGISTER,
+    CLOCK,
+    READY,
+};
+
+struct LinkHooks
+{
+    void (*pwrkey)();                   // toggle PWRKEY; nullptr on the host
+    void (*time_set)(uint32_t epoch);   // network time arrived (UTC seconds)
+};
+
+struct LinkStats
+{
+    uint32_t at_ms;         // since modemlink_begin(), 0 = not yet
+    uint32_t reg_ms;
+    uint32_t time_ms;
+    uint32_t polls;         // AT commands
+    uint16_t pwrkey_pulses;
+    uint16_t clock_rejects; // +CCLK? answers with an implausible year
+};
+
+// The AT port must be set (at_begin). Starts at PROBE.
+void modemlink_begin(const LinkHooks &hooks);
+
+// Runs one step; returns the delay (ms) before the next call is useful.
+uint32_t modemlink_step();
+
+LinkState modemlink_state();
+const char *modemlink_state_name(LinkState s);
+const LinkStats &modemlink_stats();
+
+// "+CCLK: " payload ("26/06/01,12:30:05+08", local time and quarter
+// hours of zone offset) to UTC seconds; 0 if implausible.
+uint32_t modemlink_parse_cclk(const char *v);
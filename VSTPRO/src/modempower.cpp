@@ -0,0 +1,522 @@
+// src/modempower.cpp — modem power scheduling (see modempower.h)
+
+#include "modempower.h"
+#include "config.h"
+#include "modem_at.h"
+#include "mqttlink.h"
+#include "simhttp.h"
+#include "simnet.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+static SemaphoreHandle_t g_mux = nullptr;
+static inline void q_lock()   { if (g_mux) xSemaphoreTake(g_mux, portMAX_DELAY); }
+static inline void q_unlock() { if (g_mux) xSemaphoreGive(g_mux); }
+#else
+#include <mutex>
+static std::mutex g_mux;
+static inline void q_lock()   { g_mux.lock(); }
+static inline void q_unlock() { g_mux.unlock(); }
+#endif
+
+static constexpr uint32_t PWR_AWAKE_POLL_MS = 1000;
+static constexpr uint32_t PWR_SLEEP_POLL_MS = 250;     // no AT while asleep, only the hooks
+static constexpr uint32_t PWR_PROBE_MS      = 300;     // AT before deciding on a PWRKEY pulse
+static constexpr uint32_t PWR_AT_MS         = 1000;
+
+static PowerConfig    g_cfg = {};
+static PowerHooks     g_hooks = {};
+static PowerStats     g_stats = {};
+static PowerState     g_state = PowerState::AWAKE;
+static bool           g_running = false;
+static volatile bool  g_awake = true;
+static bool           g_negotiate = true;  // timers not asked for since the modem booted
+static bool           g_cold = false;      // this wake started from OFF
+static uint32_t       g_queued = 0;        // under q_lock()
+static uint32_t       g_data_at = 0;       // last time there was anything to send (q_lock())
+static uint32_t       g_busy_at = 0;
+static uint32_t       g_sleep_at = 0;
+static uint32_t       g_wake_at = 0;
+static uint32_t       g_tick_at = 0;
+static uint32_t       g_log_at = 0;
+static uint64_t       g_tx_mark = 0;
+static uint64_t       g_tx_seen = 0;
+static uint32_t       g_traffic_at = 0;
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+/* =========================================================
+   TIMER CODING (TS 24.008 10.5.7.4a / 10.5.7.3, 10.5.5.32)
+   ========================================================= */
+struct TimerUnit
+{
+    uint8_t  bits;      // bits 8..6 of the octet
+    uint32_t s;
+};
+
+// Ascending, so the first unit that fits is the finest one
+static const TimerUnit TAU_UNITS[] = {
+    { 3, 2 }, { 4, 30 }, { 5, 60 }, { 0, 600 }, { 1, 3600 }, { 2, 36000 }, { 6, 1152000 },
+};
+static const TimerUnit ACTIVE_UNITS[] = { { 0, 2 }, { 1, 60 }, { 2, 360 } };
+
+static const uint32_t EDRX_MS[16] = {
+    5120, 10240, 20480, 40960, 61440, 81920, 102400, 122880,
+    143360, 163840, 327680, 655360, 1310720, 2621440, 5242880, 10485760,
+};
+
+static void bits_out(uint8_t v, int n, char *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = (v >> (n - 1 - i)) & 1 ? '1' : '0';
+    out[n] = 0;
+}
+
+// Rounds up: the modem gets at least the time asked for
+static void encode(uint32_t s, const TimerUnit *units, size_t n, char out[9])
+{
+    uint8_t octet = 0xE0;   // unit 111: deactivated
+    for (size_t i = 0; s && i < n; i++)
+    {
+        uint32_t v = (s + units[i].s - 1) / units[i].s;
+        if (v <= 31)
+        {
+            octet = (uint8_t)(units[i].bits << 5 | v);
+            break;
+        }
+    }
+    bits_out(octet, 8, out);
+}
+
+static uint32_t decode(const char *bits, const TimerUnit *units, size_t n)
+{
+    if (!bits || strlen(bits) < 8) return 0;
+    uint8_t octet = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        if (bits[i] != '0' && bits[i] != '1') return 0;
+        octet = (uint8_t)(octet << 1 | (bits[i] - '0'));
+    }
+    for (size_t i = 0; i < n; i++)
+        if (units[i].bits == octet >> 5) return units[i].s * (octet & 31);
+    return 0;
+}
+
+void power_encode_tau(uint32_t s, char out[9])
+{
+    encode(s, TAU_UNITS, sizeof(TAU_UNITS) / sizeof(TAU_UNITS[0]), out);
+}
+
+void power_encode_active(uint32_t s, char out[9])
+{
+    encode(s, ACTIVE_UNITS, sizeof(ACTIVE_UNITS) / sizeof(ACTIVE_UNITS[0]), out);
+}
+
+uint32_t power_decode_tau(const char *bits)
+{
+    return decode(bits, TAU_UNITS, sizeof(TAU_UNITS) / sizeof(TAU_UNITS[0]));
+}
+
+uint32_t power_decode_active(const char *bits)
+{
+    return decode(bits, ACTIVE_UNITS, sizeof(ACTIVE_UNITS) / sizeof(ACTIVE_UNITS[0]));
+}
+
+uint32_t power_edrx_ms(uint8_t code)
+{
+    return EDRX_MS[code & 15];
+}
+
+// 4,1,"1A2B","01A2D101",7,,,"00000101","00100001"
+//   n, stat, tac, ci, AcT, cause type, reject cause, active time, periodic TAU
+bool power_parse_cereg(const char *v, uint32_t *active_s, uint32_t *tau_s)
+{
+    char field[9][12] = {};
+    int n = 0;
+    size_t k = 0;
+    for (const char *c = v; *c && n < 9; c++)
+    {
+        if (*c == ',') { n++; k = 0; continue; }
+        if (*c != '"' && *c != ' ' && k + 1 < sizeof(field[0])) field[n][k++] = *c;
+    }
+    if (n < 8) return false;
+
+    // An active time of 0 is valid: PSM right after the RRC release
+    *active_s = power_decode_active(field[7]);
+    *tau_s = power_decode_tau(field[8]);
+    return *tau_s && (*active_s || !strcmp(field[7], "00000000"));
+}
+
+/* =========================================================
+   ACCOUNTING
+   ========================================================= */
+static void account(uint32_t now)
+{
+    uint32_t dt = now - g_tick_at;
+    g_tick_at = now;
+    uint64_t tx = at_stats().tx_bytes;
+    if (tx != g_tx_seen)
+    {
+        g_tx_seen = tx;
+        g_traffic_at = now;
+    }
+    g_stats.tx_bytes = tx - g_tx_mark;
+
+    switch (g_state)
+    {
+    case PowerState::WAKING:
+        g_stats.connected_ms += dt;     // boot, registration
+        break;
+    case PowerState::AWAKE:
+        if (now - g_traffic_at < g_cfg.rrc_ms) g_stats.connected_ms += dt;
+        else g_stats.idle_ms += dt;
+        break;
+    case PowerState::OFF:
+        g_stats.off_ms += dt;
+        break;
+    case PowerState::SLEEP:
+    {
+        // eDRX / idle until the active time runs out, PSM after that
+        uint32_t slept = now - g_sleep_at;
+        uint32_t active_ms = g_stats.psm_granted ? g_stats.active_s * 1000 : UINT32_MAX;
+        uint32_t start = slept - dt;
+        uint32_t idle = start >= active_ms ? 0 : (slept <= active_ms ? dt : active_ms - start);
+        g_stats.idle_ms += idle;
+        g_stats.psm_ms += dt - idle;
+        break;
+    }
+    }
+}
+
+double power_energy_mj()
+{
+    // mV x mA x ms = nJ
+    double nj = (double)g_cfg.mv * ((double)g_cfg.awake_ma * (double)g_stats.connected_ms +
+                                    (double)g_cfg.idle_ma * (double)g_stats.idle_ms +
+                                    (double)g_cfg.psm_ua / 1000.0 * (double)g_stats.psm_ms);
+    return nj / 1e6;
+}
+
+void power_log_stats()
+{
+    const PowerStats &s = g_stats;
+    double mj = power_energy_mj();
+    VST_LOG("⚡ power: connected %lu s, idle %lu s, PSM %lu s, off %lu s; %lu wakes (%lu alert/batch, "
+            "%lu queue, %lu timer), rails off %lu x\n",
+            (unsigned long)(s.connected_ms / 1000), (unsigned long)(s.idle_ms / 1000),
+            (unsigned long)(s.psm_ms / 1000), (unsigned long)(s.off_ms / 1000),
+            (unsigned long)s.wakes, (unsigned long)s.urgent_wakes, (unsigned long)s.queue_wakes,
+            (unsigned long)s.timer_wakes, (unsigned long)s.rails_off);
+    VST_LOG("⚡ power: %.1f KB uploaded, %.0f mJ, %.2f uJ per uploaded byte\n",
+            s.tx_bytes / 1024.0, mj, s.tx_bytes ? mj * 1000.0 / (double)s.tx_bytes : 0.0);
+}
+
+/* =========================================================
+   STATES
+   ========================================================= */
+static void enter(PowerState s)
+{
+    VST_LOG("⚡ power: %s -> %s\n", power_state_name(g_state), power_state_name(s));
+    g_state = s;
+}
+
+static uint32_t queued(uint32_t *data_at = nullptr)
+{
+    q_lock();
+    uint32_t q = g_queued;
+    if (data_at) *data_at = g_data_at;
+    q_unlock();
+    return q;
+}
+
+// Once per modem boot; the modem keeps the values across PSM
+static void negotiate()
+{
+    char tau[9], act[9], edrx[5];
+    if (g_cfg.psm)
+    {
+        power_encode_tau(g_cfg.tau_s, tau);
+        power_encode_active(g_cfg.active_s, act);
+        at_cmd(PWR_AT_MS, "+CPSMS=1,,,\"%s\",\"%s\"", tau, act);
+    }
+    else
+        at_cmd(PWR_AT_MS, "+CPSMS=0");
+
+    if (g_cfg.edrx)
+    {
+        bits_out(g_cfg.edrx_code & 15, 4, edrx);
+        at_cmd(PWR_AT_MS, "+CEDRXS=1,4,\"%s\"", edrx);
+    }
+    else
+        at_cmd(PWR_AT_MS, "+CEDRXS=0");
+
+    // Mode 4 adds the granted timers to +CEREG
+    char v[96];
+    uint32_t active_s = 0, tau_s = 0;
+    g_stats.psm_granted = false;
+    if (at_cmd(PWR_AT_MS, "+CEREG=4") == AtResult::OK && at_cmd(PWR_AT_MS, "+CEREG?") == AtResult::OK &&
+        at_find("+CEREG: ", v, sizeof(v)))
+        g_stats.psm_granted = g_cfg.psm && power_parse_cereg(v, &active_s, &tau_s);
+    g_stats.active_s = g_stats.psm_granted ? active_s : 0;
+    g_stats.tau_s = g_stats.psm_granted ? tau_s : 0;
+
+    if (g_stats.psm_granted)
+        VST_LOG("⚡ power: PSM granted, TAU %lu s, active %lu s (asked %lu / %lu)\n",
+                (unsigned long)tau_s, (unsigned long)active_s,
+                (unsigned long)g_cfg.tau_s, (unsigned long)g_cfg.active_s);
+    else if (g_cfg.psm)
+        VST_LOG("⚠️ power: no PSM from the network, idle in %s between wakes\n",
+                g_cfg.edrx ? "eDRX" : "DRX");
+    if (g_cfg.edrx)
+        VST_LOG("⚡ power: eDRX %lu ms asked\n", (unsigned long)power_edrx_ms(g_cfg.edrx_code));
+    g_negotiate = false;
+}
+
+static void go_sleep(uint32_t now)
+{
+    // Uplink tasks check power_awake() under at_lock(): once we hold it
+    // no step is running and none starts
+    g_awake = false;
+    at_lock();
+    mqtt_close();
+    if (simhttp_connected()) simhttp_disconnect();
+    if (simnet_is_up()) simnet_down();
+    at_unlock();
+
+    q_lock();
+    g_queued = 0;
+    q_unlock();
+    g_sleep_at = now;
+    enter(PowerState::SLEEP);
+    power_log_stats();
+}
+
+static void wake(uint32_t now, const char *why)
+{
+    bool from_off = g_state == PowerState::OFF;
+    VST_LOG("⚡ power: wake (%s) after %lu s\n", why, (unsigned long)((now - g_sleep_at) / 1000));
+    g_stats.wakes++;
+    enter(PowerState::WAKING);
+    g_wake_at = now;
+    g_cold = from_off;
+
+    if (from_off && g_hooks.rails) g_hooks.rails(true);
+
+    // Still in idle / eDRX it answers; in PSM or without power it needs
+    // PWRKEY. A pulse to a modem that is on would switch it off.
+    at_lock();
+    bool answers = !from_off && at_cmd(PWR_PROBE_MS, "") == AtResult::OK;
+    if (!answers && !from_off) answers = at_cmd(PWR_PROBE_MS, "") == AtResult::OK;
+    if (!answers && g_hooks.pwrkey) g_hooks.pwrkey();
+    at_unlock();
+
+    modemlink_begin(LinkHooks{ g_hooks.pwrkey, g_hooks.time_set });
+}
+
+static uint32_t step_awake(uint32_t now)
+{
+    if (g_negotiate)
+    {
+        at_lock();
+        negotiate();
+        at_unlock();
+    }
+
+    bool idle = !g_hooks.uplink_idle || g_hooks.uplink_idle();
+    bool urgent = g_hooks.urgent && g_hooks.urgent();
+    if (!idle || urgent)
+    {
+        g_busy_at = now;
+        q_lock();
+        g_data_at = now;
+        q_unlock();
+        return PWR_AWAKE_POLL_MS;
+    }
+    if (now - g_busy_at < g_cfg.linger_ms) return PWR_AWAKE_POLL_MS;
+
+    go_sleep(now);
+    return PWR_SLEEP_POLL_MS;
+}
+
+static uint32_t step_asleep(uint32_t now)
+{
+    uint32_t data_at = 0;
+    uint32_t q = queued(&data_at);
+
+    if (g_hooks.urgent && g_hooks.urgent())
+    {
+        g_stats.urgent_wakes++;
+        wake(now, "alert / batch due");
+        return 0;
+    }
+    if (q >= g_cfg.wake_bytes)
+    {
+        g_stats.queue_wakes++;
+        wake(now, "queue");
+        return 0;
+    }
+    if (now - g_sleep_at >= g_cfg.max_sleep_ms)
+    {
+        g_stats.timer_wakes++;
+        wake(now, "timer");
+        return 0;
+    }
+
+    if (g_state == PowerState::SLEEP && g_hooks.rails && !q && now - data_at >= g_cfg.rails_off_ms)
+    {
+        VST_LOG("⚡ power: nothing to send for %lu s, rails off\n", (unsigned long)((now - data_at) / 1000));
+        g_hooks.rails(false);
+        g_stats.rails_off++;
+        g_negotiate = true;     // ask for the timers again after the cold boot
+        enter(PowerState::OFF);
+    }
+    return PWR_SLEEP_POLL_MS;
+}
+
+static uint32_t step_waking(uint32_t now)
+{
+    at_lock();
+    uint32_t wait_ms = modemlink_step();
+    at_unlock();
+    if (modemlink_state() != LinkState::READY) return wait_ms;
+
+    g_stats.wake_ms_last = now - g_wake_at;
+    if (g_stats.wake_ms_last > g_stats.wake_ms_max) g_stats.wake_ms_max = g_stats.wake_ms_last;
+    VST_LOG("⚡ power: awake in %lu ms%s\n", (unsigned long)g_stats.wake_ms_last,
+            g_cold ? " (cold boot)" : "");
+    g_busy_at = now;
+    enter(PowerState::AWAKE);
+    g_awake = true;
+    return 0;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+PowerConfig power_default_config()
+{
+    PowerConfig c{};
+    c.managed = POWER_MANAGED;
+    c.psm = POWER_PSM;
+    c.tau_s = POWER_TAU_S;
+    c.active_s = POWER_ACTIVE_S;
+    c.edrx = POWER_EDRX;
+    c.edrx_code = POWER_EDRX_CODE;
+    c.wake_bytes = POWER_WAKE_BYTES;
+    c.max_sleep_ms = POWER_MAX_SLEEP_MS;
+    c.linger_ms = POWER_LINGER_MS;
+    c.rails_off_ms = POWER_RAILS_OFF_MS;
+    c.log_ms = POWER_LOG_MS;
+    c.rrc_ms = POWER_RRC_MS;
+    c.mv = POWER_MV;
+    c.awake_ma = POWER_AWAKE_MA;
+    c.idle_ma = POWER_IDLE_MA;
+    c.psm_ua = POWER_PSM_UA;
+    return c;
+}
+
+void power_init(const PowerConfig &cfg, const PowerHooks &hooks)
+{
+#if defined(ARDUINO)
+    if (!g_mux) g_mux = xSemaphoreCreateMutex();
+#endif
+    g_cfg = cfg;
+    g_hooks = hooks;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_state = PowerState::AWAKE;
+    g_awake = true;
+    g_negotiate = cfg.managed;
+    g_cold = false;
+    uint32_t now = mono_ms();
+    q_lock();
+    g_queued = 0;
+    g_data_at = now;
+    q_unlock();
+    g_busy_at = g_sleep_at = g_wake_at = g_tick_at = g_log_at = now;
+    g_tx_mark = g_tx_seen = at_stats().tx_bytes;
+    g_traffic_at = now;
+    g_running = true;
+
+    if (cfg.managed)
+        VST_LOG("⚡ power: wake at %lu KB queued or every %lu s, rails off after %lu s idle\n",
+                (unsigned long)(cfg.wake_bytes / 1024), (unsigned long)(cfg.max_sleep_ms / 1000),
+                (unsigned long)(cfg.rails_off_ms / 1000));
+    else
+        VST_LOG("⚡ power: modem always awake (accounting only)\n");
+}
+
+uint32_t power_step()
+{
+    if (!g_running) return PWR_AWAKE_POLL_MS;
+
+    // URCs that arrive between uplink runs (+SMSUB commands, +CEREG)
+    at_lock();
+    at_service();
+    at_unlock();
+
+    uint32_t now = mono_ms();
+    account(now);
+    if (g_cfg.log_ms && now - g_log_at >= g_cfg.log_ms)
+    {
+        g_log_at = now;
+        power_log_stats();
+    }
+    if (!g_cfg.managed) return PWR_AWAKE_POLL_MS;
+
+    switch (g_state)
+    {
+    case PowerState::AWAKE:  return step_awake(now);
+    case PowerState::SLEEP:
+    case PowerState::OFF:    return step_asleep(now);
+    case PowerState::WAKING: return step_waking(now);
+    }
+    return PWR_AWAKE_POLL_MS;
+}
+
+bool power_awake()
+{
+    return g_awake;
+}
+
+void power_note_queued(uint32_t bytes)
+{
+    q_lock();
+    g_queued += bytes;
+    g_data_at = mono_ms();
+    q_unlock();
+}
+
+PowerState power_state()
+{
+    return g_state;
+}
+
+const char *power_state_name(PowerState s)
+{
+    switch (s)
+    {
+    case PowerState::AWAKE:  return "AWAKE";
+    case PowerState::SLEEP:  return "SLEEP";
+    case PowerState::OFF:    return "OFF";
+    case PowerState::WAKING: return "WAKING";
+    }
+    return "?";
+}
+
+const PowerStats &power_stats()
+{
+    return g_stats;
+}
@@ -0,0 +1,103 @@
+// src/modempower.h — modem sleep / PSM / rails-off scheduling and energy estimate
+//
+// AWAKE -> SLEEP -> OFF, WAKING back to AWAKE when the uplink has work.
+// States, timers and the energy model: README 1.8.
+#pragma once
+#include <stdint.h>
+
+#include "modemlink.h"
+
+enum class PowerState : uint8_t
+{
+    AWAKE,
+    SLEEP,
+    OFF,
+    WAKING,
+};
+
+struct PowerConfig
+{
+    bool     managed;       // false = always awake, accounting only
+    bool     psm;           // ask for PSM (AT+CPSMS)
+    uint32_t tau_s;         // periodic TAU (T3412)
+    uint32_t active_s;      // active time before PSM (T3324)
+    bool     edrx;          // ask for eDRX (AT+CEDRXS, LTE-M)
+    uint8_t  edrx_code;     // 24.008 eDRX value 0..15: 5.12 s x 2^n (LTE-M table)
+    uint32_t wake_bytes;    // queued uplink bytes that wake the modem
+    uint32_t max_sleep_ms;  // wake at least this often
+    uint32_t linger_ms;     // uplink idle this long before sleeping
+    uint32_t rails_off_ms;  // nothing to send this long -> rails off
+    uint32_t log_ms;        // power_log_stats() interval, 0 = on sleep only
+    // Energy model
+    uint32_t rrc_ms;        // connected after the last UART traffic
+    uint16_t mv;
+    uint16_t awake_ma;      // connected, transfers
+    uint16_t idle_ma;       // registered idle / eDRX, before PSM
+    uint16_t psm_ua;
+};
+
+struct PowerHooks
+{
+    void (*pwrkey)();               // toggle PWRKEY; nullptr = cannot wake from PSM / OFF
+    bool (*rails)(bool on);         // modem supply; nullptr = not switchable (no OFF)
+    void (*time_set)(uint32_t);     // passed on to modemlink.h on every wake
+    bool (*urgent)();               // alert / telemetry batch due: wake now
+    bool (*uplink_idle)();          // nothing left for the uplink tasks
+};
+
+struct PowerStats
+{
+    uint32_t wakes;
+    uint32_t urgent_wakes;
+    uint32_t queue_wakes;
+    uint32_t timer_wakes;
+    uint32_t rails_off;             // times the rails were cut
+    uint32_t wake_ms_last;          // WAKING -> AWAKE
+    uint32_t wake_ms_max;
+    uint64_t connected_ms;
+    uint64_t idle_ms;               // registered, radio idle (DRX / eDRX)
+    uint64_t psm_ms;
+    uint64_t off_ms;
+    uint64_t tx_bytes;              // modem UART, since power_init()
+    uint32_t tau_s;                 // granted by the network, 0 = unknown
+    uint32_t active_s;
+    bool     psm_granted;
+};
+
+PowerConfig power_default_config();
+
+// After modemlink.h reached READY, from the task that drives the modem.
+void power_init(const PowerConfig &cfg, const PowerHooks &hooks);
+
+// One step; returns the delay (ms) before the next call is useful. Takes
+// the modem (at_lock()) itself.
+uint32_t power_step();
+
+// Uplink tasks check this before they take the modem. True when the
+// manager is not running.
+bool power_awake();
+
+// Bytes the uplink will send later (stored frames, thumbnails); counted
+// against wake_bytes, cleared when the modem goes to sleep with the
+// uplink idle.
+void power_note_queued(uint32_t bytes);
+
+PowerState power_state();
+const char *power_state_name(PowerState s);
+const PowerStats &power_stats();
+
+// Estimated modem energy since power_init(), millijoules
+double power_energy_mj();
+void power_log_stats();
+
+// TS 24.008 timer coding, as AT+CPSMS / +CEREG write them ("00100001")
+void power_encode_tau(uint32_t s, char out[9]);     // GPRS timer 3 (T3412 extended)
+void power_encode_active(uint32_t s, char out[9]);  // GPRS timer 2 (T3324)
+uint32_t power_decode_tau(const char *bits);        // 0 = deactivated / malformed
+uint32_t power_decode_active(const char *bits);
+// LTE-M eDRX cycle of a 4-bit value, milliseconds
+uint32_t power_edrx_ms(uint8_t code);
+
+// "+CEREG: " payload in mode 4 -> granted active time and TAU; false when
+// the network granted no PSM
+bool power_parse_cereg(const char *v, uint32_t *active_s, uint32_t *tau_s);
@@ -0,0 +1,392 @@
+// src/mqttlink.cpp — MQTT session on the SIM7080 (see mqttlink.h)
+
+#include "mqttlink.h"
+#include "config.h"
+#include "modem_at.h"
+#include "simhttp.h"
+#include "simnet.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr uint8_t  MQTT_PARTS_MAX = 16;
+static constexpr uint8_t  MQTT_OUTCOMES  = 8;       // recent confirm / lose boundaries
+static constexpr uint32_t MQTT_CONN_MS   = 30000;   // AT+SMCONN (TCP + CONNECT)
+
+// A confirm or a lose resolves every sequence number up to `upto`
+struct Outcome
+{
+    uint32_t upto;
+    bool     lost;
+};
+
+static MqttConfig g_cfg = {};
+static bool       g_ready = false;
+static bool       g_open = false;
+static bool       g_shared = false;         // bearer was up before the session
+static bool       g_subscribed = false;     // persistent session holds them
+static uint32_t   g_seq = 0;                // last message published
+static uint32_t   g_resolved = 0;           // last message confirmed or lost
+static uint32_t   g_unconf_bytes = 0;
+static uint32_t   g_sync = 0;
+static uint32_t   g_last_use_ms = 0;
+static Outcome    g_outcomes[MQTT_OUTCOMES];
+static uint8_t    g_outcome_n = 0;
+static char       g_sync_topic[MQTT_TOPIC_MAX];
+static char       g_cmd_topic[MQTT_TOPIC_MAX];
+static void     (*g_cb)(const char *topic, const char *payload) = nullptr;
+static MqttStats  g_stats = {};
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+/* =========================================================
+   DELIVERY BOOKKEEPING
+   ========================================================= */
+static void resolve(bool lost)
+{
+    if (g_seq == g_resolved) return;
+    uint32_t n = g_seq - g_resolved;
+    if (lost)
+    {
+        g_stats.lost += n;
+        VST_LOG("⚠️ mqtt: %lu message(s) not confirmed, session dropped\n", (unsigned long)n);
+    }
+    else
+    {
+        g_stats.messages += n;
+        g_stats.bytes += g_unconf_bytes;
+    }
+
+    if (g_outcome_n == MQTT_OUTCOMES)
+    {
+        memmove(&g_outcomes[0], &g_outcomes[1], sizeof(g_outcomes[0]) * (MQTT_OUTCOMES - 1));
+        g_outcome_n--;
+    }
+    g_outcomes[g_outcome_n++] = Outcome{ g_seq, lost };
+    g_resolved = g_seq;
+    g_unconf_bytes = 0;
+}
+
+MqttDelivery mqtt_delivery(uint32_t seq)
+{
+    if (!seq) return MqttDelivery::LOST;
+    if ((int32_t)(seq - g_resolved) > 0) return MqttDelivery::PENDING;
+    for (uint8_t i = 0; i < g_outcome_n; i++)
+        if ((int32_t)(seq - g_outcomes[i].upto) <= 0)
+            return g_outcomes[i].lost ? MqttDelivery::LOST : MqttDelivery::CONFIRMED;
+    return MqttDelivery::CONFIRMED;     // older than the history: long since settled
+}
+
+uint32_t mqtt_unconfirmed()
+{
+    return g_seq - g_resolved;
+}
+
+/* =========================================================
+   URCs
+   ========================================================= */
+static void drop_session();
+
+static bool g_broker_closed = false;    // +SMSTATE: 0, not acted on yet
+static bool g_marker_back = false;      // the sync marker mqtt_flush() waits for
+static bool g_urc_event = false;        // wakes mqtt_flush()
+static char g_want[12];
+
+// "+SMSUB: "topic","payload""  /  "+SMSTATE: 0", from at_service(). No AT
+// commands in here: a closed session is dropped by the next mqtt_* call.
+static void on_urc(const char *urc, void *)
+{
+    g_urc_event = true;
+    if (!strncmp(urc, "+SMSTATE: ", 10))
+    {
+        if (urc[10] == '0' && g_open) g_broker_closed = true;
+        return;
+    }
+    if (strncmp(urc, "+SMSUB: \"", 9) != 0) return;
+
+    char line[AT_LINE_MAX];
+    snprintf(line, sizeof(line), "%s", urc + 9);
+    char *topic = line;
+    char *q = strchr(topic, '"');
+    if (!q) return;
+    *q = 0;
+    char *payload = strchr(q + 1, '"');
+    if (!payload) return;
+    payload++;
+    char *end = strrchr(payload, '"');
+    if (end) *end = 0;
+
+    if (!strcmp(topic, g_sync_topic))
+    {
+        if (g_want[0] && !strcmp(payload, g_want)) g_marker_back = true;
+        return;                                     // else a late marker
+    }
+    g_stats.received++;
+    VST_LOG("📩 mqtt: %s '%s'\n", topic, payload);
+    if (g_cb) g_cb(topic, payload);
+}
+
+// Acts on a +SMSTATE: 0 seen since the last call
+static bool broker_closed()
+{
+    at_service();
+    if (!g_broker_closed) return false;
+    g_broker_closed = false;
+    if (!g_open) return false;
+    VST_LOG("⚠️ mqtt: broker closed the connection\n");
+    drop_session();
+    return true;
+}
+
+/* =========================================================
+   SESSION
+   ========================================================= */
+// Down only if the session brought it up and no HTTP transfer (uploader)
+// has started on it since
+static void release_bearer()
+{
+    if (!g_shared && !simhttp_connected()) simnet_down();
+}
+
+static void drop_session()
+{
+    resolve(true);
+    if (g_open) at_cmd(5000, "+SMDISC");
+    g_open = false;
+    g_subscribed = false;       // the broker may have lost the session too
+    release_bearer();
+}
+
+// Messages the broker held for the session may arrive during AT+SMSUB;
+// modem_at.h hands them to on_urc() like any other
+static bool subscribe(const char *topic)
+{
+    return at_cmd(10000, "+SMSUB=\"%s\",1", topic) == AtResult::OK;
+}
+
+bool mqtt_is_open()
+{
+    return g_open && !g_broker_closed;
+}
+
+bool mqtt_open()
+{
+    if (!g_ready) return false;
+    if (g_open) return true;
+    broker_closed();            // a +SMSTATE: 0 left from the last session
+
+    g_shared = simnet_is_up();
+    if (!simnet_up(g_cfg.apn, 60000))
+    {
+        g_stats.connect_failures++;
+        return false;
+    }
+    g_stats.sessions += !g_shared;
+
+    at_batch_begin();
+    at_batch_add(3000, "+SMCONF=\"URL\",\"%s\",%u", g_cfg.host, g_cfg.port);
+    at_batch_add(3000, "+SMCONF=\"CLIENTID\",\"%s\"", g_cfg.client_id);
+    at_batch_add(3000, "+SMCONF=\"KEEPTIME\",%u", g_cfg.keepalive_s);
+    at_batch_add(3000, "+SMCONF=\"CLEANSS\",%u", g_cfg.clean_session ? 1 : 0);
+    at_batch_add(3000, "+SMCONF=\"ASYNCMODE\",1");
+    if (g_cfg.user && g_cfg.user[0])
+    {
+        at_batch_add(3000, "+SMCONF=\"USERNAME\",\"%s\"", g_cfg.user);
+        at_batch_add(3000, "+SMCONF=\"PASSWORD\",\"%s\"", g_cfg.pass ? g_cfg.pass : "");
+    }
+    at_batch_wait();
+
+    uint32_t t0 = mono_ms();
+    if (at_cmd(MQTT_CONN_MS, "+SMCONN") != AtResult::OK)
+    {
+        g_stats.connect_failures++;
+        VST_LOG("❌ mqtt: SMCONN %s:%u failed\n", g_cfg.host, g_cfg.port);
+        release_bearer();
+        return false;
+    }
+    uint32_t ms = mono_ms() - t0;
+    g_stats.connects++;
+    g_stats.connect_ms += ms;
+    g_open = true;
+
+    // Persistent session: the broker still has them from the last cycle
+    if (!g_subscribed || g_cfg.clean_session)
+    {
+        if (!subscribe(g_sync_topic) || !subscribe(g_cmd_topic))
+        {
+            VST_LOG("❌ mqtt: SMSUB failed\n");
+            drop_session();
+            return false;
+        }
+        g_subscribed = true;
+    }
+
+    g_last_use_ms = mono_ms();
+    VST_LOG("🔌 mqtt: session open to %s:%u in %lu ms\n", g_cfg.host, g_cfg.port, (unsigned long)ms);
+    return true;
+}
+
+static bool publish_part(const char *topic, const void *data, size_t len)
+{
+    if (!at_send("+SMPUB=\"%s\",%u,1,0", topic, (unsigned)len) || !at_wait_prompt(5000))
+        return false;
+    if (!at_write(data, len)) return false;
+    if (at_result(g_cfg.ack_ms + 5000) != AtResult::OK) return false;
+    g_stats.parts++;
+    return true;
+}
+
+uint32_t mqtt_publish(const char *topic, const void *data, size_t len)
+{
+    if (!len || len > MQTT_PUB_MAX * MQTT_PARTS_MAX || strlen(topic) + 8 >= MQTT_TOPIC_MAX) return 0;
+    if (!mqtt_open()) return 0;
+
+    const uint8_t *p = (const uint8_t*)data;
+    uint32_t parts = len ? (uint32_t)((len + MQTT_PUB_MAX - 1) / MQTT_PUB_MAX) : 1;
+    for (uint32_t i = 0; i < parts; i++)
+    {
+        char name[MQTT_TOPIC_MAX];
+        if (parts == 1) snprintf(name, sizeof(name), "%s", topic);
+        else snprintf(name, sizeof(name), "%s/%lu/%lu", topic, (unsigned long)i, (unsigned long)parts);
+        size_t n = len - i * MQTT_PUB_MAX < MQTT_PUB_MAX ? len - i * MQTT_PUB_MAX : MQTT_PUB_MAX;
+        if (!publish_part(name, p + i * MQTT_PUB_MAX, n))
+        {
+            g_seq++;            // this one is lost with the rest
+            drop_session();
+            return 0;
+        }
+    }
+
+    uint32_t seq = ++g_seq;
+    g_unconf_bytes += (uint32_t)len;
+    g_last_use_ms = mono_ms();
+    if (mqtt_unconfirmed() >= g_cfg.window) mqtt_flush();
+    return seq;
+}
+
+bool mqtt_flush()
+{
+    if (!mqtt_unconfirmed()) return true;
+    if (!g_open) return false;
+
+    char marker[12];
+    int n = snprintf(marker, sizeof(marker), "%lu", (unsigned long)++g_sync);
+    if (!publish_part(g_sync_topic, marker, (size_t)n))
+    {
+        drop_session();
+        return false;
+    }
+
+    // The marker comes back through the broker behind every earlier message
+    snprintf(g_want, sizeof(g_want), "%s", marker);
+    g_marker_back = false;
+    uint32_t t0 = mono_ms();
+    while (!g_marker_back && !g_broker_closed && mono_ms() - t0 < g_cfg.ack_ms)
+    {
+        g_urc_event = false;
+        at_wait_flag(&g_urc_event, g_cfg.ack_ms - (mono_ms() - t0));
+    }
+    g_want[0] = 0;
+    if (g_marker_back)
+    {
+        resolve(false);
+        g_stats.flushes++;
+        g_last_use_ms = mono_ms();
+        return true;
+    }
+    if (!broker_closed() && g_open) drop_session();
+    return false;
+}
+
+void mqtt_close()
+{
+    if (!g_open) return;
+    mqtt_flush();
+    if (!g_open || broker_closed()) return;
+    at_cmd(5000, "+SMDISC");
+    g_open = false;
+    release_bearer();
+    VST_LOG("🔌 mqtt: session closed\n");
+}
+
+void mqtt_service()
+{
+    if (!g_ready || !g_open || broker_closed()) return;
+    if (g_open && mono_ms() - g_last_use_ms >= g_cfg.idle_ms) mqtt_close();
+}
+
+/* =========================================================
+   INIT
+   ========================================================= */
+MqttConfig mqtt_default_config()
+{
+    MqttConfig c{};
+    c.apn = MODEM_APN;
+    c.host = MQTT_HOST;
+    c.port = MQTT_PORT;
+    c.client_id = DEVICE_ID;
+    c.user = MQTT_USER;
+    c.pass = MQTT_PASS;
+    c.keepalive_s = MQTT_KEEPALIVE_S;
+    c.clean_session = false;
+    c.window = MQTT_WINDOW;
+    c.ack_ms = 10000;
+    c.idle_ms = MQTT_IDLE_MS;
+    return c;
+}
+
+bool mqtt_init(const MqttConfig &cfg)
+{
+    g_cfg = cfg;
+    if (!g_cfg.host || !g_cfg.host[0] || !g_cfg.client_id || !g_cfg.client_id[0] ||
+        strlen(g_cfg.client_id) + 16 >= MQTT_TOPIC_MAX)
+    {
+        VST_LOG("❌ mqtt: broker or client id missing\n");
+        return false;
+    }
+    if (!g_cfg.window) g_cfg.window = 1;
+    if (!g_cfg.ack_ms) g_cfg.ack_ms = 10000;
+    snprintf(g_sync_topic, sizeof(g_sync_topic), "%s/sync", g_cfg.client_id);
+    snprintf(g_cmd_topic, sizeof(g_cmd_topic), "%s/cmd", g_cfg.client_id);
+
+    g_open = g_subscribed = g_broker_closed = false;
+    at_on_urc("+SMSUB: ", on_urc, nullptr);
+    at_on_urc("+SMSTATE: ", on_urc, nullptr);
+    g_seq = g_resolved = g_unconf_bytes = 0;
+    g_outcome_n = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_ready = true;
+
+    VST_LOG("🔌 mqtt: %s:%u as %s, %s session, keep-alive %u s, window %u\n",
+            g_cfg.host, g_cfg.port, g_cfg.client_id, g_cfg.clean_session ? "clean" : "persistent",
+            g_cfg.keepalive_s, g_cfg.window);
+    return true;
+}
+
+void mqtt_on_message(void (*cb)(const char *topic, const char *payload))
+{
+    g_cb = cb;
+}
+
+const MqttStats &mqtt_stats()
+{
+    return g_stats;
+}
+
+void mqtt_log_stats()
+{
+    const MqttStats &s = g_stats;
+    VST_LOG("📊 mqtt: connects=%lu (avg %lu ms, %lu failed) messages=%lu in %lu parts, %.1f KB, "
+            "flushes=%lu lost=%lu received=%lu\n",
+            (unsigned long)s.connects, (unsigned long)(s.connects ? s.connect_ms / s.connects : 0),
+            (unsigned long)s.connect_failures, (unsigned long)s.messages, (unsigned long)s.parts,
+            s.bytes / 1024.0, (unsigned long)s.flushes, (unsigned long)s.lost, (unsigned long)s.received);
+}
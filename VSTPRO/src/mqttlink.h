@@ -0,0 +1,75 @@
+// src/mqttlink.h — persistent MQTT session on the SIM7080 built-in client
+//
+// QoS1 publishes pipelined and confirmed by a marker on <client>/sync;
+// commands arrive on <client>/cmd. README 1.7. All calls need the modem
+// (at_lock()).
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr size_t MQTT_PUB_MAX   = 1024;   // AT+SMPUB content limit
+static constexpr size_t MQTT_TOPIC_MAX = 96;
+
+struct MqttConfig
+{
+    const char *apn;
+    const char *host;
+    uint16_t    port;
+    const char *client_id;      // also the topic prefix
+    const char *user;           // "" = none
+    const char *pass;
+    uint16_t    keepalive_s;
+    bool        clean_session;  // false = persistent session
+    uint8_t     window;         // unconfirmed QoS1 messages before a flush (1 = every message)
+    uint32_t    ack_ms;         // flush round trip timeout
+    uint32_t    idle_ms;        // mqtt_service() closes the session after this
+};
+
+struct MqttStats
+{
+    uint32_t connects;
+    uint32_t connect_failures;
+    uint32_t connect_ms;        // total SMCONN time
+    uint32_t messages;          // mqtt_publish() calls confirmed
+    uint32_t parts;             // AT+SMPUB sent
+    uint64_t bytes;             // payload bytes confirmed
+    uint32_t flushes;
+    uint32_t lost;              // messages dropped with a failed session
+    uint32_t received;          // +SMSUB messages handed to the callback
+    uint32_t sessions;          // bearer brought up for a session
+};
+
+enum class MqttDelivery : uint8_t { CONFIRMED, PENDING, LOST };
+
+MqttConfig mqtt_default_config();
+
+bool mqtt_init(const MqttConfig &cfg);
+
+// Called for every message on <client>/cmd, from whichever task runs
+// at_service() (under at_lock()), so it must be short.
+void mqtt_on_message(void (*cb)(const char *topic, const char *payload));
+
+// Bearer, SMCONF, SMCONN and the subscriptions. No-op when open.
+bool mqtt_open();
+bool mqtt_is_open();
+
+// QoS1 publish of 1 to MQTT_PUB_MAX * 16 bytes. Returns a sequence
+// number for mqtt_delivery(), 0 if the session failed (then everything
+// unconfirmed is LOST).
+uint32_t mqtt_publish(const char *topic, const void *data, size_t len);
+
+// Confirms everything published so far (one round trip).
+bool mqtt_flush();
+
+MqttDelivery mqtt_delivery(uint32_t seq);
+uint32_t mqtt_unconfirmed();
+
+// Flushes, disconnects and takes the bearer down if this brought it up.
+void mqtt_close();
+
+// Task loop: picks up +SMSUB / +SMSTATE URCs, flushes what is left
+// unconfirmed and closes the session after idle_ms.
+void mqtt_service();
+
+const MqttStats &mqtt_stats();
+void mqtt_log_stats();
@@ -0,0 +1,428 @@
+// src/retention.cpp — watermark retention for the SD store (see retention.h)
+
+#include "retention.h"
+#include "frameindex.h"
+#include "sdlayout.h"
+#include "vstlog.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// FIFO of segment numbers, oldest at head
+struct SeqRing
+{
+    uint32_t *v = nullptr;
+    uint16_t cap = 0;
+    uint16_t head = 0;
+    uint16_t count = 0;
+};
+
+static char      g_root[32] = {0};
+static RetConfig g_cfg = {};
+static SeqRing   g_ring[SEG_STREAMS];
+static uint32_t  g_last_seq[SEG_STREAMS] = {0};
+static RetStats  g_stats = {};
+static bool      g_ready = false;
+
+// PER_FILE: frames come from the frame index, empty ones (pass 0) before
+// detections (pass 1). Each pass keeps a cursor past the records it is done
+// with, dated days first, then NOTIME.VIX.
+struct PfCursor
+{
+    int32_t  day;
+    uint32_t next;
+    uint32_t notime;
+};
+
+struct PfFrame
+{
+    int32_t   day;
+    uint32_t  n;
+    IdxRecord rec;
+};
+
+static constexpr uint8_t PF_BATCH = 32;
+static PfCursor  g_pf_cur[2];
+static PfFrame   g_pf[PF_BATCH];
+static uint8_t   g_pf_count = 0;
+static uint8_t   g_pf_next = 0;
+static uint8_t   g_pf_pass = 0;
+static int32_t   g_pf_last_day = -1;
+static char      g_pf_dir[64] = {0};    // directory of the last deleted frame
+
+/* =========================================================
+   UTIL
+   ========================================================= */
+static uint64_t mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static inline uint32_t ring_at(const SeqRing &r, uint16_t i)
+{
+    return r.v[(r.head + i) % r.cap];
+}
+
+static inline bool ring_push(SeqRing &r, uint32_t seq)
+{
+    if (r.count == r.cap) return false;
+    r.v[(r.head + r.count) % r.cap] = seq;
+    r.count++;
+    return true;
+}
+
+static inline void ring_pop(SeqRing &r)
+{
+    r.head = (r.head + 1) % r.cap;
+    r.count--;
+}
+
+static inline uint64_t pct_of(uint64_t total, uint8_t pct)
+{
+    return total / 100 * pct;
+}
+
+static inline uint64_t on_card(uint64_t bytes)
+{
+    uint32_t c = g_cfg.cluster_bytes;
+    return c ? (bytes + c - 1) / c * c : bytes;
+}
+
+static inline void count_freed(uint64_t size)
+{
+    g_stats.used_bytes = g_stats.used_bytes > size ? g_stats.used_bytes - size : 0;
+    g_stats.freed_bytes += size;
+}
+
+// Deletes the oldest segment of stream s unless it is still open.
+static bool evict_oldest(SegStream s)
+{
+    SeqRing &r = g_ring[s];
+    if (!r.count) return false;
+
+    uint32_t seq = ring_at(r, 0);
+    if (seq == segstore_open_seq(s)) return false;
+
+    char path[64];
+    segstore_path(s, seq, path, sizeof(path));
+
+    struct stat st;
+    uint64_t size = (stat(path, &st) == 0) ? (uint64_t)st.st_size : 0;
+
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        VST_LOG("❌ retention: cannot delete %s (errno=%d)\n", path, errno);
+        return false;
+    }
+
+    ring_pop(r);
+    frameindex_set_floor(s, seq + 1);
+
+    count_freed(size);
+    g_stats.evicted[s]++;
+    g_stats.live[s] = r.count;
+
+    VST_LOG("🧹 retention: deleted %s (%lu KB)\n", path, (unsigned long)(size / 1024));
+    return true;
+}
+
+/* =========================================================
+   PER_FILE
+   ========================================================= */
+static inline bool is_detection(const IdxRecord &r)
+{
+    return r.box_count || (r.flags & IDX_F_TRIGGER);
+}
+
+struct PfScan
+{
+    uint8_t pass;
+    int32_t day;
+};
+
+static bool collect(const IdxRecord &rec, uint32_t n, void *ctx)
+{
+    const PfScan &sc = *(const PfScan*)ctx;
+    if (rec.seq || (rec.flags & IDX_F_EVICTED) || is_detection(rec) != (sc.pass == 1)) return true;
+    if (g_pf_count == PF_BATCH) return false;
+    g_pf[g_pf_count++] = PfFrame{ sc.day, n, rec };
+    return true;
+}
+
+// Next batch of pass: the oldest frames of its kind still on the card.
+// The cursor only moves over records the pass is done with, so each
+// record is read once per boot.
+static bool refill_pass(uint8_t pass)
+{
+    PfCursor &c = g_pf_cur[pass];
+    int32_t today = frameindex_append_day();
+    if (today > g_pf_last_day) g_pf_last_day = today;
+    if (c.day < 0 && g_pf_last_day >= 0) c.day = frameindex_first_day();
+
+    g_pf_count = g_pf_next = 0;
+    g_pf_pass = pass;
+    while (c.day >= 0 && c.day <= g_pf_last_day)
+    {
+        PfScan sc{ pass, c.day };
+        c.next = frameindex_scan(c.day, c.next, collect, &sc);
+        if (g_pf_count == PF_BATCH || c.day == g_pf_last_day) break;
+        c.day++;
+        c.next = 0;
+    }
+
+    // Undated frames only once every dated one of this kind is gone
+    if (!g_pf_count)
+    {
+        PfScan sc{ pass, -1 };
+        c.notime = frameindex_scan(-1, c.notime, collect, &sc);
+    }
+    return g_pf_count != 0;
+}
+
+static bool refill_batch()
+{
+    return refill_pass(0) || refill_pass(1);
+}
+
+// Gives the unused rest of a detection batch back to its cursor, so empty
+// frames stored since go first.
+static void drop_detections()
+{
+    if (g_pf_pass != 1 || g_pf_next >= g_pf_count) return;
+
+    const PfFrame &f = g_pf[g_pf_next];
+    PfCursor &c = g_pf_cur[1];
+    if (f.day < 0) c.notime = f.n;
+    else
+    {
+        c.day = f.day;
+        c.next = f.n;
+    }
+    g_pf_count = g_pf_next = 0;
+}
+
+// An emptied hour directory (and its day) goes once eviction moves on from
+// it. sdlayout caches the one being written: it is made again on the next
+// frame.
+static void leave_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    size_t len = slash ? (size_t)(slash - path) : 0;
+    if (len < sizeof(g_pf_dir) && strlen(g_pf_dir) == len && !strncmp(g_pf_dir, path, len)) return;
+
+    if (g_cfg.layout == SdLayout::DATE_HOUR && strlen(g_pf_dir) > strlen(g_root) &&
+        rmdir(g_pf_dir) == 0)
+    {
+        char *hour = strrchr(g_pf_dir, '/');
+        if (hour) *hour = 0;
+        rmdir(g_pf_dir);
+        sdlayout_reset();
+    }
+    snprintf(g_pf_dir, sizeof(g_pf_dir), "%.*s", (int)len, path);
+}
+
+static bool evict_oldest_file()
+{
+    if (g_pf_next >= g_pf_count && !refill_batch()) return false;
+
+    const PfFrame &f = g_pf[g_pf_next++];
+    char path[112];
+    sdlayout_frame_name(g_root, g_cfg.layout, (time_t)f.rec.epoch, !(f.rec.flags & IDX_F_REBASED),
+                        f.rec.boot, f.rec.frame_id, path, sizeof(path));
+
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        VST_LOG("❌ retention: cannot delete %s (errno=%d)\n", path, errno);
+        return false;
+    }
+    frameindex_set_flags(f.day, f.n, IDX_F_EVICTED);
+    leave_dir(path);
+
+    count_freed(on_card(f.rec.size));
+    g_stats.evicted[is_detection(f.rec) ? SEG_STREAM_DETECT : SEG_STREAM_EMPTY]++;
+    g_stats.evicted_files++;
+    return true;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+bool retention_init(const char *root, const RetConfig &cfg,
+                    uint64_t total_bytes, uint64_t used_bytes)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_cfg = cfg;
+    if (g_cfg.low_pct >= g_cfg.high_pct) g_cfg.low_pct = g_cfg.high_pct ? g_cfg.high_pct - 1 : 0;
+    if (!g_cfg.max_deletes) g_cfg.max_deletes = 1;
+
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.total_bytes = total_bytes > g_cfg.reserve_bytes ? total_bytes - g_cfg.reserve_bytes : 0;
+    g_stats.used_bytes = used_bytes;
+    g_pf_count = g_pf_next = 0;
+
+    if (g_cfg.mode == SdStorageMode::PER_FILE)
+    {
+        if (!g_cfg.file_deletes) g_cfg.file_deletes = 1;
+        g_pf_last_day = frameindex_last_day();
+        int32_t first = frameindex_first_day();
+        for (PfCursor &c : g_pf_cur) c = PfCursor{ first, 0, 0 };
+        g_pf_dir[0] = 0;
+        g_ready = true;
+        VST_LOG("🧹 retention ready: %llu / %llu MB used, watermark %u%% -> %u%%, per-file frames\n",
+                (unsigned long long)(used_bytes >> 20),
+                (unsigned long long)(g_stats.total_bytes >> 20),
+                (unsigned)g_cfg.high_pct, (unsigned)g_cfg.low_pct);
+        return true;
+    }
+
+    for (int s = 0; s < SEG_STREAMS; s++)
+    {
+        SeqRing &r = g_ring[s];
+        if (!r.v)
+        {
+            r.v = (uint32_t*)malloc(sizeof(uint32_t) * g_cfg.max_segments);
+            if (!r.v)
+            {
+                VST_LOG("❌ retention: no memory for %u segments\n", (unsigned)g_cfg.max_segments);
+                return false;
+            }
+            r.cap = g_cfg.max_segments;
+        }
+        r.head = 0;
+        r.count = 0;
+        g_last_seq[s] = 0;
+    }
+
+    char dir[48];
+    snprintf(dir, sizeof(dir), "%s/seg", g_root);
+    DIR *d = opendir(dir);
+    if (d)
+    {
+        struct dirent *e;
+        while ((e = readdir(d)) != nullptr)
+        {
+            SegStream s;
+            uint32_t seq;
+            if (segstore_parse_name(e->d_name, &s, &seq) && !ring_push(g_ring[s], seq))
+                VST_LOG("⚠️ retention: more than %u segments in stream %d, %s not tracked\n",
+                        (unsigned)g_cfg.max_segments, (int)s, e->d_name);
+        }
+        closedir(d);
+    }
+
+    // Directory order is not creation order: sort once, then FIFO
+    for (int s = 0; s < SEG_STREAMS; s++)
+    {
+        SeqRing &r = g_ring[s];
+        std::sort(r.v, r.v + r.count);
+        if (r.count)
+        {
+            g_last_seq[s] = r.v[r.count - 1];
+            frameindex_set_floor((SegStream)s, r.v[0]);
+        }
+        g_stats.live[s] = r.count;
+    }
+
+    g_ready = true;
+    VST_LOG("🧹 retention ready: %llu / %llu MB used, watermark %u%% -> %u%%, segments SEG=%u EMP=%u\n",
+            (unsigned long long)(used_bytes >> 20),
+            (unsigned long long)(g_stats.total_bytes >> 20),
+            (unsigned)g_cfg.high_pct, (unsigned)g_cfg.low_pct,
+            (unsigned)g_stats.live[SEG_STREAM_DETECT],
+            (unsigned)g_stats.live[SEG_STREAM_EMPTY]);
+    return true;
+}
+
+void retention_on_write(const SegLocation *loc, uint32_t jpeg_bytes, uint32_t side_bytes)
+{
+    if (!g_ready) return;
+    g_stats.used_bytes += (loc ? jpeg_bytes : on_card(jpeg_bytes)) + side_bytes;
+    if (!loc || loc->stream >= SEG_STREAMS) return;
+
+    SegStream s = loc->stream;
+    if (loc->seq == g_last_seq[s]) return;
+
+    // A new segment: make room in the FIFO by evicting the oldest one if
+    // it is full (the card is bigger than max_segments x SEG_MAX_BYTES).
+    if (g_ring[s].count == g_ring[s].cap) evict_oldest(s);
+    if (ring_push(g_ring[s], loc->seq)) g_last_seq[s] = loc->seq;
+    g_stats.live[s] = g_ring[s].count;
+}
+
+uint32_t retention_service()
+{
+    if (!g_ready || !g_stats.total_bytes) return 0;
+
+    uint64_t high = pct_of(g_stats.total_bytes, g_cfg.high_pct);
+    uint64_t low  = pct_of(g_stats.total_bytes, g_cfg.low_pct);
+
+    if (!g_stats.evicting && g_stats.used_bytes < high) return 0;
+    g_stats.evicting = true;
+
+    uint64_t t0 = mono_us();
+    uint32_t deleted = 0;
+
+    if (g_cfg.mode == SdStorageMode::PER_FILE)
+    {
+        drop_detections();
+        while (deleted < g_cfg.file_deletes && g_stats.used_bytes >= low && evict_oldest_file())
+            deleted++;
+    }
+    else
+    {
+        while (deleted < g_cfg.max_deletes && g_stats.used_bytes >= low)
+        {
+            // Empty frames go first; detections only when nothing else is left
+            if (!evict_oldest(SEG_STREAM_EMPTY) && !evict_oldest(SEG_STREAM_DETECT))
+                break;
+            deleted++;
+        }
+    }
+
+    if (g_stats.used_bytes < low) g_stats.evicting = false;
+
+    if (deleted)
+    {
+        uint32_t dt = (uint32_t)(mono_us() - t0);
+        if (dt > g_stats.service_us_max) g_stats.service_us_max = dt;
+    }
+    else if (g_stats.evicting)
+    {
+        static uint32_t warned = 0;
+        if (!warned++)
+            VST_LOG("⚠️ retention: card above %u%% and nothing left to evict\n",
+                    (unsigned)g_cfg.high_pct);
+    }
+    return deleted;
+}
+
+const RetStats &retention_stats()
+{
+    return g_stats;
+}
+
+void retention_log_stats()
+{
+    const RetStats &s = g_stats;
+    VST_LOG("📊 retention: used=%llu/%llu MB (%s) live SEG=%lu EMP=%lu evicted SEG=%lu EMP=%lu files=%lu "
+            "freed=%llu MB service_max=%.1f ms\n",
+            (unsigned long long)(s.used_bytes >> 20),
+            (unsigned long long)(s.total_bytes >> 20),
+            s.evicting ? "evicting" : "ok",
+            (unsigned long)s.live[SEG_STREAM_DETECT],
+            (unsigned long)s.live[SEG_STREAM_EMPTY],
+            (unsigned long)s.evicted[SEG_STREAM_DETECT],
+            (unsigned long)s.evicted[SEG_STREAM_EMPTY],
+            (unsigned long)s.evicted_files,
+            (unsigned long long)(s.freed_bytes >> 20),
+            s.service_us_max / 1000.0);
+}
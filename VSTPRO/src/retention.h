@@ -0,0 +1,55 @@
+// src/retention.h — keep the SD card below a fill watermark
+//
+// Tracks usage from writes and deletes and evicts oldest-first, EMP_
+// segments before SEG_, per-file frames from the frame index, empty ones
+// before detections. README 1.3.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "segstore.h"
+
+struct RetConfig
+{
+    uint8_t  high_pct;      // start evicting above this fill level
+    uint8_t  low_pct;       // stop once below this
+    uint8_t  max_deletes;   // segments per retention_service() call
+    uint16_t max_segments;  // FIFO capacity per stream
+    uint8_t  file_deletes;  // PER_FILE: frames per retention_service() call
+    uint32_t cluster_bytes; // PER_FILE: allocation unit of a JPEG
+    uint32_t reserve_bytes;
+    SdStorageMode mode;     // set by sdstore_init()
+    SdLayout      layout;
+};
+
+struct RetStats
+{
+    uint64_t total_bytes;
+    uint64_t used_bytes;
+    uint32_t live[SEG_STREAMS];     // segments tracked per stream
+    uint32_t evicted[SEG_STREAMS];  // segments, or PER_FILE frames, of each kind
+    uint32_t evicted_files;         // PER_FILE
+    uint64_t freed_bytes;
+    uint32_t service_us_max;        // slowest retention_service() that deleted something
+    bool     evicting;
+};
+
+// Lists <root>/seg once (SEGMENT) or finds the oldest index day file
+// (PER_FILE; call after frameindex_init()). total/used come from the
+// mounted filesystem.
+bool retention_init(const char *root, const RetConfig &cfg,
+                    uint64_t total_bytes, uint64_t used_bytes);
+
+// Called after every stored frame: registers a new segment the first time
+// loc.seq is seen and adds bytes (the frame and its side-file lines) to the
+// usage estimate. loc == nullptr for PER_FILE frames, whose jpeg_bytes are
+// rounded up to whole clusters.
+void retention_on_write(const SegLocation *loc, uint32_t jpeg_bytes, uint32_t side_bytes);
+
+// Deletes up to max_deletes segments (file_deletes frames in PER_FILE)
+// if usage is above the watermark. Returns the number of files deleted.
+uint32_t retention_service();
+
+const RetStats &retention_stats();
+void retention_log_stats();
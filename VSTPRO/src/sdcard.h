@@ -3,11 +3,16 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "framemeta.h"
+
 bool sdcard_init();
 bool sdcard_available();
 
 // Set by main after modem time is applied
 void sdcard_set_time_valid(bool valid);
 
-// Save JPEG (frame_id used for suffix)
-bool sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len);
+// Save JPEG (frame_id used for suffix). meta is stored alongside the
+// image in SEGMENT mode; in both modes its per-class scores go into the
+// frame index (frameindex.h).
+bool sdcard_save_jpeg(uint32_t frame_id, const uint8_t *data, size_t len,
+                      const FrameMeta *meta = nullptr);
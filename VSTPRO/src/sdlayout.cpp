@@ -0,0 +1,131 @@
+// src/sdlayout.cpp — file naming for PER_FILE storage (see sdlayout.h)
+//
+// The FAT VFS gives us no persistent directory handle to open files
+// relative to, so the "handle" we cache is the knowledge that the current
+// day/hour directory exists: mkdir() runs once per hour instead of once
+// per frame, and the path lookup only ever walks short directories.
+
+#include "sdlayout.h"
+#include "vstlog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static char g_shard_dir[48] = {0};   // "<root>/YYYYMMDD/HH" known to exist
+static char g_day_dir[40]   = {0};   // "<root>/YYYYMMDD" known to exist
+
+static bool ensure_dir(const char *path)
+{
+    if (mkdir(path, 0775) == 0)
+        return true;
+    if (errno == EEXIST)
+        return true;
+
+    VST_LOG("❌ mkdir %s failed (errno=%d)\n", path, errno);
+    return false;
+}
+
+static bool ensure_shard(const char *root, const struct tm &tm)
+{
+    char day[sizeof(g_day_dir)];
+    char shard[sizeof(g_shard_dir)];
+
+    snprintf(day, sizeof(day), "%s/%04d%02d%02d",
+             root, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    snprintf(shard, sizeof(shard), "%s/%02d", day, tm.tm_hour);
+
+    if (strcmp(shard, g_shard_dir) == 0)
+        return true;
+
+    if (strcmp(day, g_day_dir) != 0)
+    {
+        if (!ensure_dir(day)) return false;
+        snprintf(g_day_dir, sizeof(g_day_dir), "%s", day);
+    }
+
+    if (!ensure_dir(shard)) return false;
+    snprintf(g_shard_dir, sizeof(g_shard_dir), "%s", shard);
+
+    VST_LOG("📁 shard ready: %s\n", g_shard_dir);
+    return true;
+}
+
+// Resolves the time; false in tm_valid keeps the undated name
+static bool frame_tm(time_t t, bool time_valid, struct tm *tm)
+{
+    if (!time_valid) return false;
+    localtime_r(&t, tm);
+    return tm->tm_year + 1900 >= 2020;
+}
+
+static void frame_name(const char *dir, const struct tm &tm, uint32_t frame_id, char *out, size_t out_sz)
+{
+    char ts[32];                     // 15 chars; room for what %d can print
+    snprintf(ts, sizeof(ts), "%04d%02d%02d_%02d%02d%02d",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    snprintf(out, out_sz, "%s/%s_frame_%06lu.jpg", dir, ts, (unsigned long)frame_id);
+}
+
+bool sdlayout_frame_path(const char *root,
+                         SdLayout layout,
+                         time_t t,
+                         bool time_valid,
+                         uint16_t boot,
+                         uint32_t frame_id,
+                         char *out,
+                         size_t out_sz)
+{
+    if (!root || !out || out_sz == 0) return false;
+
+    struct tm tm{};
+    if (!frame_tm(t, time_valid, &tm) || layout != SdLayout::DATE_HOUR)
+        return sdlayout_frame_name(root, layout, t, time_valid, boot, frame_id, out, out_sz);
+
+    if (!ensure_shard(root, tm)) return false;
+    frame_name(g_shard_dir, tm, frame_id, out, out_sz);
+    return true;
+}
+
+bool sdlayout_frame_name(const char *root,
+                         SdLayout layout,
+                         time_t t,
+                         bool time_valid,
+                         uint16_t boot,
+                         uint32_t frame_id,
+                         char *out,
+                         size_t out_sz)
+{
+    if (!root || !out || out_sz == 0) return false;
+
+    struct tm tm{};
+    if (!frame_tm(t, time_valid, &tm))
+    {
+        if (boot)
+            snprintf(out, out_sz, "%s/B%05u_frame_%06lu.jpg", root, (unsigned)boot, (unsigned long)frame_id);
+        else
+            snprintf(out, out_sz, "%s/frame_%06lu.jpg", root, (unsigned long)frame_id);
+        return true;
+    }
+
+    if (layout == SdLayout::DATE_HOUR)
+    {
+        char dir[64];
+        snprintf(dir, sizeof(dir), "%s/%04d%02d%02d/%02d",
+                 root, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
+        frame_name(dir, tm, frame_id, out, out_sz);
+    }
+    else
+    {
+        frame_name(root, tm, frame_id, out, out_sz);
+    }
+    return true;
+}
+
+void sdlayout_reset()
+{
+    g_shard_dir[0] = 0;
+    g_day_dir[0] = 0;
+}
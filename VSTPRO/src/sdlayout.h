@@ -0,0 +1,36 @@
+// src/sdlayout.h — file naming for PER_FILE storage (FLAT / DATE_HOUR, README 1.3)
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "config.h"
+
+// Builds "<root>[/YYYYMMDD/HH]/<YYYYMMDD_HHMMSS>_frame_<id>.jpg" for time t
+// and creates missing shard directories on first use of each hour.
+// Without time_valid the name is "<root>/B<boot>_frame_<id>.jpg", boot
+// being frameindex_boot() (frame ids restart every boot); boot 0 is the
+// older "<root>/frame_<id>.jpg".
+// root is the VFS mount point ("/sdcard", "/sd" or a host directory).
+bool sdlayout_frame_path(const char *root,
+                         SdLayout layout,
+                         time_t t,
+                         bool time_valid,
+                         uint16_t boot,
+                         uint32_t frame_id,
+                         char *out,
+                         size_t out_sz);
+
+// The same name without creating or caching directories, for readers of
+// frames that are already on the card (the uploader).
+bool sdlayout_frame_name(const char *root,
+                         SdLayout layout,
+                         time_t t,
+                         bool time_valid,
+                         uint16_t boot,
+                         uint32_t frame_id,
+                         char *out,
+                         size_t out_sz);
+
+// Forget the cached shard (e.g. after the card was remounted).
+void sdlayout_reset();
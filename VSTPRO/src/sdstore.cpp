@@ -0,0 +1,390 @@
+// src/sdstore.cpp — storage path behind sdcard_save_jpeg() (see sdstore.h)
+
+#include "sdstore.h"
+#include "chunkwriter.h"
+#include "frameindex.h"
+#include "metalog.h"
+#include "sdlayout.h"
+#include "sdwriter.h"
+#include "vstlog.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static char          g_root[32] = {0};
+static SdStoreConfig g_cfg = {};
+static volatile bool g_time_valid = false;
+static volatile bool g_rebase_pending = false;  // network time arrived, NOTIME not re-dated yet
+static bool          g_offset_known = false;    // writer side: g_time_offset applies
+static int64_t       g_time_offset = 0;         // wall seconds - monotonic seconds
+static bool          g_async = false;
+static ChunkWriter   g_file_cw;         // PER_FILE staging buffer
+static char          g_tmp_path[48];    // PER_FILE frames are written here, then renamed
+static SdStoreStats  g_stats = {};
+
+static uint64_t mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static int64_t mono_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec;
+}
+
+// When the image was taken, not when it is saved: inference and the JPEG
+// transfer come in between. The network-synced stamp if VisionAI set one,
+// else the system clock (or seconds since boot) minus the frame's age.
+static time_t capture_time(const FrameMeta *meta, bool tv)
+{
+    if (tv && meta && meta->capture_ms > 0) return (time_t)(meta->capture_ms / 1000);
+    uint64_t now = mono_us();
+    uint64_t at = meta && meta->capture_us && meta->capture_us <= now ? meta->capture_us : now;
+    if (!tv) return (time_t)(at / 1000000ULL);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 - (int64_t)((now - at) / 1000);
+    return (time_t)(ms / 1000);
+}
+
+static const char *mode_name()
+{
+    return g_cfg.mode == SdStorageMode::SEGMENT ? "SEGMENT" : "PER_FILE";
+}
+
+/* =========================================================
+   WRITE PATH
+   ========================================================= */
+static bool save_per_file(uint32_t frame_id, time_t t, bool tv, const uint8_t *data, size_t len,
+                          const FrameMeta *meta)
+{
+    char path[96];
+    if (!sdlayout_frame_path(g_root, g_cfg.layout, t, tv, frameindex_boot(), frame_id, path, sizeof(path)))
+        return false;
+
+    int fd = open(g_tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0)
+    {
+        VST_LOG("❌ Failed to open %s\n", g_tmp_path);
+        return false;
+    }
+
+    chunk_attach(g_file_cw, fd, 0);
+    bool ok = chunk_write(g_file_cw, data, len) && chunk_flush(g_file_cw);
+    if (ok) fsync(fd);
+    close(fd);
+
+    // Only a complete JPEG ever appears under its final name
+    if (ok && rename(g_tmp_path, path) != 0)
+    {
+        unlink(path);
+        ok = rename(g_tmp_path, path) == 0;
+    }
+
+    if (!ok)
+    {
+        VST_LOG("❌ SD write incomplete (%s, %u bytes)\n", path, (unsigned)len);
+        unlink(g_tmp_path);
+        return false;
+    }
+
+    uint32_t epoch = (uint32_t)t;
+    frameindex_append(frameindex_make(frame_id, epoch, nullptr, (uint32_t)len, meta));
+    uint32_t side = IDX_REC_LEN;
+    if (g_cfg.meta_log)
+        side += (uint32_t)metalog_append(frame_id, epoch, meta, path + strlen(g_root) + 1);
+    retention_on_write(nullptr, (uint32_t)len, side);
+    g_stats.store_bytes += len + side;
+
+    if (g_cfg.log_frames)
+        VST_LOG("💾 JPEG saved: %s (%u bytes)\n", path, (unsigned)len);
+    return true;
+}
+
+// t is wall time, or seconds since boot before network time
+static bool save_segment(uint32_t frame_id, time_t t, const uint8_t *data, size_t len,
+                         const FrameMeta *meta)
+{
+    uint32_t epoch = (uint32_t)t;
+    SegStream stream = (meta && framemeta_detected(*meta)) ? SEG_STREAM_DETECT : SEG_STREAM_EMPTY;
+
+    SegLocation loc{};
+    if (!segstore_append(frame_id, epoch, meta, data, len, &loc, stream))
+        return false;
+
+    frameindex_append(frameindex_make(frame_id, epoch, &loc, (uint32_t)len, meta));
+    segstore_set_tag(frameindex_tag());
+    uint32_t side = IDX_REC_LEN;
+    if (g_cfg.meta_log)
+    {
+        char ref[32];
+        snprintf(ref, sizeof(ref), "%s_%06lu@%lu", stream == SEG_STREAM_DETECT ? "SEG" : "EMP",
+                 (unsigned long)loc.seq, (unsigned long)loc.offset);
+        side += (uint32_t)metalog_append(frame_id, epoch, meta, ref);
+    }
+    retention_on_write(&loc, loc.size, side);
+    g_stats.store_bytes += loc.size + side;
+
+    if (g_cfg.log_frames)
+        VST_LOG("💾 JPEG saved: %s_%06lu.VSG @%lu (%u bytes)\n",
+                stream == SEG_STREAM_DETECT ? "SEG" : "EMP",
+                (unsigned long)loc.seq, (unsigned long)loc.offset, (unsigned)len);
+    return true;
+}
+
+static void log_store_stats()
+{
+    if (!g_cfg.stats_every || !g_stats.frames || g_stats.frames % g_cfg.stats_every) return;
+
+    double avg_ms = (double)g_stats.store_us / 1000.0 / g_stats.frames;
+    VST_LOG("📊 SD store [%s]: frames=%lu bytes=%llu avg_write=%.1f ms -> %.1f frames/s sustained\n",
+            mode_name(),
+            (unsigned long)g_stats.frames,
+            (unsigned long long)g_stats.jpeg_bytes,
+            avg_ms,
+            avg_ms > 0 ? 1000.0 / avg_ms : 0.0);
+
+    if (g_async) sdwriter_log_stats();
+    if (g_cfg.meta_log)
+    {
+        const MetaStats &m = metalog_stats();
+        VST_LOG("📊 SD meta log: lines=%lu bytes=%llu writes=%lu errors=%lu\n",
+                (unsigned long)m.lines, (unsigned long long)m.bytes,
+                (unsigned long)m.flushes, (unsigned long)m.errors);
+    }
+    retention_log_stats();
+}
+
+// Frames stored before network time carry monotonic seconds. Once the
+// offset is known their index records and CSV lines move to the day files
+// (segment record headers keep the boot-relative time).
+static void rebase_presync()
+{
+    g_rebase_pending = false;
+    g_offset_known = true;
+
+    uint32_t idx = frameindex_rebase(g_time_offset);
+    uint32_t csv = g_cfg.meta_log ? metalog_rebase(g_time_offset) : 0;
+    if (idx || csv)
+        VST_LOG("🕒 Re-dated %lu frames saved before network time (%lu CSV lines, offset %lld s)\n",
+                (unsigned long)idx, (unsigned long)csv, (long long)g_time_offset);
+}
+
+// Runs on the sdwriter task in write-behind mode, inline otherwise
+static bool write_job(const SdJob &job)
+{
+    if (g_rebase_pending) rebase_presync();
+
+    uint64_t t0 = mono_us();
+    const FrameMeta *meta = job.has_meta ? &job.meta : nullptr;
+
+    // Captured before the time arrived, written after: correct it here
+    time_t t = job.t;
+    bool tv = job.time_valid;
+    if (!tv && g_offset_known)
+    {
+        t = (time_t)(job.t + g_time_offset);
+        tv = true;
+    }
+
+    bool ok = (g_cfg.mode == SdStorageMode::SEGMENT)
+                  ? save_segment(job.frame_id, t, job.data, job.len, meta)
+                  : save_per_file(job.frame_id, t, tv, job.data, job.len, meta);
+
+    if (ok)
+    {
+        g_stats.store_us += mono_us() - t0;
+        g_stats.jpeg_bytes += job.len;
+        g_stats.frames++;
+        log_store_stats();
+    }
+    else
+    {
+        g_stats.failed++;
+    }
+
+    // Bounded (ret.max_deletes) and off the capture loop in write-behind mode
+    retention_service();
+    return ok;
+}
+
+/* =========================================================
+   INIT / RECOVERY
+   ========================================================= */
+static bool index_intact(const IdxRecord &r)
+{
+    SegStream s = (r.flags & IDX_F_EMPTY_STREAM) ? SEG_STREAM_EMPTY : SEG_STREAM_DETECT;
+    return segstore_record_intact(s, r.seq, r.offset, r.size);
+}
+
+static void log_recovery(uint32_t ms, uint32_t dropped)
+{
+    const SegRecovery &r = segstore_recovery();
+    VST_LOG("🩺 SD recovery: %lu ms (budget %lu) checkpoint=%s tails=%lu records=%lu "
+            "scanned=%llu KB truncated=%llu B removed=%lu index_dropped=%lu\n",
+            (unsigned long)ms, (unsigned long)g_cfg.recovery_budget_ms,
+            r.head_valid ? "yes" : "no",
+            (unsigned long)r.segments, (unsigned long)r.records,
+            (unsigned long long)(r.scanned / 1024),
+            (unsigned long long)r.truncated,
+            (unsigned long)r.removed, (unsigned long)dropped);
+    if (g_cfg.recovery_budget_ms && ms > g_cfg.recovery_budget_ms)
+        VST_LOG("⚠️ SD recovery over budget (lower SEG_SYNC_EVERY?)\n");
+}
+
+SdStoreConfig sdstore_default_config()
+{
+    SdStoreConfig c{};
+    c.mode = SD_STORAGE_MODE;
+    c.layout = SD_LAYOUT;
+    c.write_behind = SD_WRITE_BEHIND;
+    c.ring_bytes = SDW_RING_BYTES;
+    c.seg = SegConfig{ SEG_MAX_BYTES, SEG_MAX_AGE_S, SEG_SYNC_EVERY, SEG_CHUNK_BYTES };
+    c.chunk_bytes = SEG_CHUNK_BYTES;
+    c.idx_flush_every = IDX_FLUSH_EVERY;
+    c.meta_log = SD_META_LOG;
+    c.meta_flush_bytes = META_FLUSH_BYTES;
+    c.meta_flush_ms = META_FLUSH_MS;
+    c.ret = RetConfig{ RET_HIGH_PCT, RET_LOW_PCT, RET_MAX_DELETES, RET_MAX_SEGMENTS,
+                       RET_FILE_DELETES, RET_CLUSTER_BYTES, RET_RESERVE_BYTES,
+                       SD_STORAGE_MODE, SD_LAYOUT };
+    c.stats_every = SD_STATS_EVERY;
+    c.recovery_budget_ms = SD_RECOVERY_BUDGET_MS;
+    c.log_frames = true;
+    return c;
+}
+
+bool sdstore_init(const char *root, const SdStoreConfig &cfg)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_cfg = cfg;
+    memset(&g_stats, 0, sizeof(g_stats));
+    sdlayout_reset();
+
+    uint64_t t_rec = mono_us();
+
+    if (g_cfg.mode == SdStorageMode::SEGMENT)
+    {
+        if (!segstore_init(g_root, g_cfg.seg))
+        {
+            VST_LOG("❌ Segment store init failed\n");
+            return false;
+        }
+    }
+    else
+    {
+        // A frame that was being written when power went: drop it
+        snprintf(g_tmp_path, sizeof(g_tmp_path), "%s/FRAME.TMP", g_root);
+        if (unlink(g_tmp_path) == 0)
+            VST_LOG("🩺 Removed torn FRAME.TMP\n");
+
+        if (!g_file_cw.buf)
+            g_file_cw.buf = chunk_alloc(g_cfg.chunk_bytes, &g_file_cw.cap);
+        if (!g_file_cw.buf)
+        {
+            VST_LOG("❌ No memory for SD chunk buffer\n");
+            return false;
+        }
+    }
+
+    if (!frameindex_init(g_root, g_cfg.idx_flush_every))
+        VST_LOG("⚠️ Frame index unavailable, frames are stored without it\n");
+
+    if (g_cfg.meta_log && !metalog_init(g_root, g_cfg.meta_flush_bytes, g_cfg.meta_flush_ms))
+        g_cfg.meta_log = false;
+
+    if (g_cfg.mode == SdStorageMode::SEGMENT)
+    {
+        uint32_t dropped = frameindex_recover(segstore_boot_tag(), index_intact);
+        g_stats.recovery_ms = (uint32_t)((mono_us() - t_rec) / 1000);
+        log_recovery(g_stats.recovery_ms, dropped);
+    }
+
+    g_cfg.ret.mode = g_cfg.mode;
+    g_cfg.ret.layout = g_cfg.layout;
+    if (!retention_init(g_root, g_cfg.ret, g_cfg.total_bytes, g_cfg.used_bytes))
+        VST_LOG("⚠️ Retention unavailable, the card can fill up\n");
+
+    // Without the ring (no PSRAM) frames are written inline as before
+    g_async = g_cfg.write_behind && sdwriter_begin(g_cfg.ring_bytes, write_job);
+
+    VST_LOG("💾 SD storage mode: %s (%s)\n", mode_name(), g_async ? "write-behind" : "inline");
+    return true;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+void sdstore_set_time_valid(bool valid)
+{
+    if (valid && !g_time_valid)
+    {
+        // The system clock was just set: wall = monotonic + offset
+        g_time_offset = (int64_t)time(nullptr) - mono_s();
+        g_rebase_pending = true;
+    }
+    g_time_valid = valid;
+}
+
+bool sdstore_save(uint32_t frame_id, const uint8_t *data, size_t len, const FrameMeta *meta)
+{
+    if (!g_root[0] || !data || !len) return false;
+
+    // Time is taken now, not when the task gets to the frame. Without
+    // network time: seconds since boot, corrected when the time arrives.
+    bool tv = g_time_valid;
+    time_t t = capture_time(meta, tv);
+
+    if (g_async)
+    {
+        if (!sdwriter_enqueue(frame_id, t, tv, meta, data, len))
+        {
+            VST_LOG("⚠️ SD queue full, frame %lu dropped\n", (unsigned long)frame_id);
+            return false;
+        }
+        return true;
+    }
+
+    SdJob job{};
+    job.frame_id = frame_id;
+    job.t = t;
+    job.time_valid = tv;
+    job.has_meta = meta != nullptr;
+    if (meta) job.meta = *meta;
+    job.data = data;
+    job.len = len;
+    return write_job(job);
+}
+
+bool sdstore_flush(uint32_t timeout_ms)
+{
+    bool drained = !g_async || sdwriter_drain(timeout_ms);
+    if (!g_async && g_rebase_pending) rebase_presync();
+    if (g_cfg.mode == SdStorageMode::SEGMENT) segstore_sync();
+    frameindex_flush();
+    if (g_cfg.meta_log) metalog_flush(true);
+    return drained;
+}
+
+void sdstore_close()
+{
+    sdstore_flush(60000);
+    if (g_cfg.mode == SdStorageMode::SEGMENT) segstore_close();
+}
+
+SdStoreStats sdstore_stats()
+{
+    return g_stats;
+}
+
+bool sdstore_write_behind()
+{
+    return g_async;
+}
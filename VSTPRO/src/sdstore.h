@@ -0,0 +1,62 @@
+// src/sdstore.h — the storage path behind sdcard_save_jpeg()
+//
+// Storage modes, write-behind, index, metadata log, retention and boot
+// recovery over plain POSIX calls (README 1.3). sdcard.cpp mounts the
+// card and fills SdStoreConfig from config.h.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "framemeta.h"
+#include "retention.h"
+#include "segstore.h"
+
+struct SdStoreConfig
+{
+    SdStorageMode mode;
+    SdLayout      layout;           // PER_FILE naming
+    bool          write_behind;     // queue frames for the sdwriter task
+    uint32_t      ring_bytes;       // write-behind ring
+    SegConfig     seg;
+    uint32_t      chunk_bytes;      // PER_FILE staging buffer
+    uint16_t      idx_flush_every;
+    bool          meta_log;         // per-frame CSV (metalog.h)
+    uint32_t      meta_flush_bytes;
+    uint32_t      meta_flush_ms;
+    RetConfig     ret;
+    uint64_t      total_bytes;      // filesystem size / usage at mount time
+    uint64_t      used_bytes;
+    uint32_t      stats_every;      // frames between stats logs (0 = never)
+    uint32_t      recovery_budget_ms;
+    bool          log_frames;       // one log line per saved frame
+};
+
+struct SdStoreStats
+{
+    uint32_t frames;        // written (not just queued)
+    uint32_t failed;
+    uint64_t jpeg_bytes;    // payload handed to us
+    uint64_t store_bytes;   // bytes we wrote: records / files + index + meta log
+    uint64_t store_us;      // time in the write path
+    uint32_t recovery_ms;   // boot recovery (SEGMENT)
+};
+
+// Config from the config.h constants; the caller adds filesystem usage.
+SdStoreConfig sdstore_default_config();
+
+bool sdstore_init(const char *root, const SdStoreConfig &cfg);
+
+void sdstore_set_time_valid(bool valid);
+
+// Stores (or queues) one frame. meta may be nullptr.
+bool sdstore_save(uint32_t frame_id, const uint8_t *data, size_t len, const FrameMeta *meta);
+
+// Waits for the write-behind queue, then syncs segments and index.
+bool sdstore_flush(uint32_t timeout_ms);
+
+// Flushes and closes open files (host benchmarks, before unmounting).
+void sdstore_close();
+
+SdStoreStats sdstore_stats();
+bool sdstore_write_behind();
@@ -0,0 +1,345 @@
+// src/sdwriter.cpp — asynchronous write-behind queue (see sdwriter.h)
+//
+// Ring layout: each job is [Entry][data padded to 8 B]. When a job does not
+// fit before the end of the ring, a WRAP entry is written and the job starts
+// at offset 0. The producer only moves tail, the writer task only moves head
+// (after the write finished), so the data pointer handed to the callback
+// stays valid without copying it a second time.
+
+#include "sdwriter.h"
+#include "vstlog.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+static constexpr uint32_t SDW_JOB  = 0x4A574453;    // "SDWJ"
+static constexpr uint32_t SDW_WRAP = 0x57574453;    // "SDWW"
+static constexpr size_t   SDW_LAT_SAMPLES = 256;
+
+struct Entry
+{
+    uint32_t kind;
+    uint32_t total;         // entry + padded data
+    SdJob    job;
+};
+
+static uint8_t      *g_ring = nullptr;
+static size_t        g_cap = 0;
+static size_t        g_head = 0;        // next entry to write (writer task)
+static size_t        g_tail = 0;        // next free byte (producer)
+static size_t        g_used = 0;        // bytes between head and tail, incl. wrap gaps
+static SdJobWriter   g_fn = nullptr;
+static SdWriterStats g_stats = {};
+
+static uint32_t g_lat_us[SDW_LAT_SAMPLES];
+static uint32_t g_lat_n = 0;
+
+/* =========================================================
+   PLATFORM
+   ========================================================= */
+#if defined(ARDUINO)
+
+static SemaphoreHandle_t g_mux = nullptr;
+static TaskHandle_t      g_task = nullptr;
+
+static inline void q_lock()   { xSemaphoreTake(g_mux, portMAX_DELAY); }
+static inline void q_unlock() { xSemaphoreGive(g_mux); }
+static inline void q_notify() { if (g_task) xTaskNotifyGive(g_task); }
+static inline void q_wait()   { ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)); }
+static inline void q_sleep_ms(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+static inline uint64_t now_us() { return (uint64_t)esp_timer_get_time(); }
+
+static bool g_in_psram = false;
+
+static uint8_t *ring_alloc(size_t n)
+{
+    void *p = heap_caps_malloc(n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    g_in_psram = p != nullptr;
+    if (!p) p = heap_caps_malloc(n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return (uint8_t*)p;
+}
+
+#else
+
+static std::mutex              g_mux;
+static std::condition_variable g_cv;
+static bool                    g_kick = false;
+
+static inline void q_lock()   { g_mux.lock(); }
+static inline void q_unlock() { g_mux.unlock(); }
+static inline void q_notify()
+{
+    { std::lock_guard<std::mutex> l(g_mux); g_kick = true; }
+    g_cv.notify_one();
+}
+static inline void q_wait()
+{
+    std::unique_lock<std::mutex> l(g_mux);
+    g_cv.wait_for(l, std::chrono::seconds(1), [] { return g_kick; });
+    g_kick = false;
+}
+static inline void q_sleep_ms(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+static inline uint64_t now_us()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t *ring_alloc(size_t n) { return (uint8_t*)malloc(n); }
+
+#endif
+
+/* =========================================================
+   RING
+   ========================================================= */
+static inline size_t pad8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// Reserves total contiguous bytes at the tail. Called with the lock held.
+static uint8_t *reserve(size_t total)
+{
+    size_t end_room = g_cap - g_tail;
+    size_t need = total;
+    bool wrap = false;
+
+    if (end_room < total)
+    {
+        // Skip the end of the ring (and leave a WRAP marker if it fits)
+        need = end_room + total;
+        wrap = true;
+    }
+    if (g_used + need > g_cap) return nullptr;
+
+    if (wrap)
+    {
+        if (end_room >= sizeof(uint32_t))
+        {
+            uint32_t k = SDW_WRAP;
+            memcpy(g_ring + g_tail, &k, sizeof(k));
+        }
+        g_used += end_room;
+        g_tail = 0;
+    }
+
+    uint8_t *p = g_ring + g_tail;
+    g_tail = (g_tail + total) % g_cap;
+    g_used += total;
+    return p;
+}
+
+static void record_latency(uint32_t us)
+{
+    g_lat_us[g_lat_n % SDW_LAT_SAMPLES] = us;
+    g_lat_n++;
+}
+
+static float percentile_ms(uint32_t *v, size_t n, unsigned pct)
+{
+    size_t k = (n * pct) / 100;
+    if (k >= n) k = n - 1;
+    std::nth_element(v, v + k, v + n);
+    return v[k] / 1000.0f;
+}
+
+/* =========================================================
+   WRITER TASK
+   ========================================================= */
+static bool write_one()
+{
+    q_lock();
+    if (g_stats.depth == 0)
+    {
+        q_unlock();
+        return false;
+    }
+
+    size_t end_room = g_cap - g_head;
+    uint32_t kind = 0;
+    if (end_room >= sizeof(uint32_t)) memcpy(&kind, g_ring + g_head, sizeof(kind));
+    if (end_room < sizeof(Entry) || kind == SDW_WRAP)
+    {
+        g_used -= end_room;
+        g_head = 0;
+    }
+    Entry *e = (Entry*)(g_ring + g_head);
+    q_unlock();
+
+    // The entry is ours until head moves past it: no lock while writing.
+    e->job.data = (const uint8_t*)(e + 1);
+    uint64_t t0 = now_us();
+    bool ok = g_fn ? g_fn(e->job) : false;
+    uint32_t dt = (uint32_t)(now_us() - t0);
+
+    q_lock();
+    g_head = (g_head + e->total) % g_cap;
+    g_used -= e->total;
+    g_stats.depth--;
+    if (ok) g_stats.written++;
+    else    g_stats.failed++;
+    record_latency(dt);
+    q_unlock();
+    return true;
+}
+
+#if defined(ARDUINO)
+static void writer_task(void *)
+{
+    for (;;)
+    {
+        while (write_one()) {}
+        q_wait();
+    }
+}
+#else
+static void writer_task()
+{
+    for (;;)
+    {
+        while (write_one()) {}
+        q_wait();
+    }
+}
+#endif
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+bool sdwriter_begin(size_t ring_bytes, SdJobWriter fn)
+{
+    if (g_ring) return true;
+
+    g_cap = ring_bytes & ~(size_t)7;
+    g_ring = ring_alloc(g_cap);
+    if (!g_ring)
+    {
+        VST_LOG("❌ sdwriter: cannot allocate %u KB ring\n", (unsigned)(g_cap / 1024));
+        return false;
+    }
+    g_fn = fn;
+    g_stats.ring_bytes = g_cap;
+
+#if defined(ARDUINO)
+    g_mux = xSemaphoreCreateMutex();
+    // Core 0 next to the WiFi/modem stack; the capture loop runs on core 1.
+    if (xTaskCreatePinnedToCore(writer_task, "sdwriter", 6144, nullptr, 2, &g_task, 0) != pdPASS)
+    {
+        VST_LOG("❌ sdwriter: task create failed\n");
+        return false;
+    }
+    VST_LOG("💾 sdwriter ready: %u KB ring in %s\n",
+            (unsigned)(g_cap / 1024),
+            g_in_psram ? "PSRAM" : "internal RAM");
+#else
+    std::thread(writer_task).detach();
+    VST_LOG("💾 sdwriter ready: %u KB ring\n", (unsigned)(g_cap / 1024));
+#endif
+    return true;
+}
+
+bool sdwriter_enqueue(uint32_t frame_id, time_t t, bool time_valid,
+                      const FrameMeta *meta, const uint8_t *data, size_t len)
+{
+    if (!g_ring || !data || !len) return false;
+
+    size_t total = sizeof(Entry) + pad8(len);
+
+    q_lock();
+    uint8_t *p = (total <= g_cap) ? reserve(total) : nullptr;
+    if (!p)
+    {
+        g_stats.dropped++;
+        q_unlock();
+        return false;
+    }
+    q_unlock();
+
+    // Only the producer touches the reserved bytes until depth is bumped.
+    Entry *e = (Entry*)p;
+    e->kind = SDW_JOB;
+    e->total = (uint32_t)total;
+    e->job.frame_id = frame_id;
+    e->job.t = t;
+    e->job.time_valid = time_valid;
+    e->job.has_meta = meta != nullptr;
+    if (meta) e->job.meta = *meta;
+    e->job.data = nullptr;
+    e->job.len = len;
+    memcpy(e + 1, data, len);
+
+    q_lock();
+    g_stats.queued++;
+    g_stats.depth++;
+    if (g_stats.depth > g_stats.depth_high) g_stats.depth_high = g_stats.depth;
+    if (g_used > g_stats.bytes_high) g_stats.bytes_high = g_used;
+    q_unlock();
+
+    q_notify();
+    return true;
+}
+
+bool sdwriter_drain(uint32_t timeout_ms)
+{
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000ULL;
+    for (;;)
+    {
+        q_lock();
+        uint32_t depth = g_stats.depth;
+        q_unlock();
+
+        if (depth == 0) return true;
+        if (now_us() >= deadline) return false;
+        q_notify();
+        q_sleep_ms(5);
+    }
+}
+
+SdWriterStats sdwriter_stats()
+{
+    static uint32_t tmp[SDW_LAT_SAMPLES];
+
+    q_lock();
+    SdWriterStats s = g_stats;
+    size_t n = std::min<size_t>(g_lat_n, SDW_LAT_SAMPLES);
+    memcpy(tmp, g_lat_us, n * sizeof(uint32_t));
+    q_unlock();
+
+    if (n)
+    {
+        s.write_p50_ms = percentile_ms(tmp, n, 50);
+        s.write_p99_ms = percentile_ms(tmp, n, 99);
+        s.write_max_ms = *std::max_element(tmp, tmp + n) / 1000.0f;
+    }
+    return s;
+}
+
+void sdwriter_log_stats()
+{
+    SdWriterStats s = sdwriter_stats();
+    VST_LOG("📊 sdwriter: queued=%lu written=%lu failed=%lu dropped=%lu "
+            "depth=%lu (max %lu) ring_max=%u/%u KB write p50=%.1f p99=%.1f max=%.1f ms\n",
+            (unsigned long)s.queued,
+            (unsigned long)s.written,
+            (unsigned long)s.failed,
+            (unsigned long)s.dropped,
+            (unsigned long)s.depth,
+            (unsigned long)s.depth_high,
+            (unsigned)(s.bytes_high / 1024),
+            (unsigned)(s.ring_bytes / 1024),
+            s.write_p50_ms,
+            s.write_p99_ms,
+            s.write_max_ms);
+}
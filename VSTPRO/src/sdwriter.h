@@ -0,0 +1,53 @@
+// src/sdwriter.h — write-behind ring for SD frames (README 1.3)
+//
+// Capture copies the frame in and never waits; a full ring drops it.
+// Jobs are written by a callback, so the queue is storage-mode agnostic.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "framemeta.h"
+
+struct SdJob
+{
+    uint32_t  frame_id;
+    time_t    t;            // wall time at capture, seconds since boot if !time_valid
+    bool      time_valid;
+    bool      has_meta;
+    FrameMeta meta;
+    const uint8_t *data;    // points into the ring, valid during the callback
+    size_t    len;
+};
+
+typedef bool (*SdJobWriter)(const SdJob &job);
+
+struct SdWriterStats
+{
+    uint32_t queued;
+    uint32_t written;
+    uint32_t failed;
+    uint32_t dropped;           // ring full
+    uint32_t depth;             // jobs waiting now
+    uint32_t depth_high;        // high-water mark (jobs)
+    size_t   bytes_high;        // high-water mark (ring bytes)
+    size_t   ring_bytes;        // ring capacity
+    float    write_p50_ms;      // per-job write latency, last SDW_LAT_SAMPLES jobs
+    float    write_p99_ms;
+    float    write_max_ms;
+};
+
+// Allocates the ring (ring_bytes, PSRAM when available) and starts the
+// writer task. fn performs the actual write for each job.
+bool sdwriter_begin(size_t ring_bytes, SdJobWriter fn);
+
+// Copies the frame into the ring. Never blocks on the card; returns false
+// (and counts a drop) when the ring is full.
+bool sdwriter_enqueue(uint32_t frame_id, time_t t, bool time_valid,
+                      const FrameMeta *meta, const uint8_t *data, size_t len);
+
+// Blocks until the queue is empty or timeout_ms passes. True if empty.
+bool sdwriter_drain(uint32_t timeout_ms);
+
+SdWriterStats sdwriter_stats();
+void sdwriter_log_stats();
@@ -0,0 +1,177 @@
+// src/simhttp.cpp — HTTP(S) client over AT+SH* (see simhttp.h)
+
+#include "simhttp.h"
+#include "modem_at.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr uint32_t SH_CONN_TIMEOUT_MS = 30000;
+static constexpr uint32_t SH_REQ_TIMEOUT_MS  = 60000;
+static constexpr size_t   SH_READ_CHUNK      = 2048;
+
+static const char *const SH_METHOD[] = { "", "GET", "PUT", "POST", "PATCH", "HEAD" };
+
+static bool         g_connected = false;
+static SimHttpStats g_stats = {};
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+/* =========================================================
+   CONNECTION
+   ========================================================= */
+bool simhttp_connect(const char *base_url)
+{
+    if (g_connected) simhttp_disconnect();
+
+    bool tls = !strncmp(base_url, "https://", 8);
+    at_batch_begin();
+    at_batch_add(2000, "+SHCONF=\"URL\",\"%s\"", base_url);
+    at_batch_add(2000, "+SHCONF=\"BODYLEN\",%u", (unsigned)SH_BODY_MAX);
+    at_batch_add(2000, "+SHCONF=\"HEADERLEN\",%u", (unsigned)SH_HEADER_MAX);
+    if (at_batch_wait() != AtResult::OK)
+    {
+        VST_LOG("❌ simhttp: SHCONF rejected\n");
+        return false;
+    }
+
+    if (tls)
+    {
+        // TLS 1.2, no certificate check (no CA store on the modem yet)
+        at_cmd(2000, "+CSSLCFG=\"sslversion\",1,3");
+        at_cmd(2000, "+SHSSL=1,\"\"");
+    }
+
+    if (at_cmd(SH_CONN_TIMEOUT_MS, "+SHCONN") != AtResult::OK)
+    {
+        VST_LOG("❌ simhttp: cannot connect to %s\n", base_url);
+        return false;
+    }
+
+    char v[8];
+    g_connected = at_cmd(2000, "+SHSTATE?") == AtResult::OK &&
+                  at_find("+SHSTATE: ", v, sizeof(v)) && v[0] == '1';
+    if (g_connected)
+    {
+        g_stats.connects++;
+        VST_LOG("🌐 HTTP connected: %s\n", base_url);
+    }
+    return g_connected;
+}
+
+bool simhttp_connected()
+{
+    return g_connected;
+}
+
+void simhttp_disconnect()
+{
+    at_cmd(5000, "+SHDISC");
+    g_connected = false;
+}
+
+/* =========================================================
+   REQUEST
+   ========================================================= */
+static bool send_body(const void *body, size_t len)
+{
+    if (!at_send("+SHBOD=%u,10000", (unsigned)len)) return false;
+    if (!at_wait_prompt(5000)) return false;
+    if (!at_write(body, len)) return false;
+    return at_result(15000) == AtResult::OK;
+}
+
+static bool read_body(uint32_t len, uint8_t *resp, size_t cap, size_t *resp_len)
+{
+    uint32_t want = len < cap ? len : (uint32_t)cap;
+    uint32_t got = 0;
+
+    while (got < want)
+    {
+        uint32_t n = want - got;
+        if (n > SH_READ_CHUNK) n = SH_READ_CHUNK;
+        if (at_cmd(5000, "+SHREAD=%lu,%lu", (unsigned long)got, (unsigned long)n) != AtResult::OK)
+            return false;
+
+        char v[16];
+        if (!at_wait_line("+SHREAD: ", v, sizeof(v), 10000)) return false;
+        uint32_t k = (uint32_t)strtoul(v, nullptr, 10);
+        if (!k || k > n || !at_read(resp + got, k, 10000)) return false;
+        got += k;
+    }
+
+    g_stats.resp_bytes += got;
+    if (resp_len) *resp_len = got;
+    return true;
+}
+
+int simhttp_request(SimHttpMethod method, const char *path,
+                    const SimHttpHeader *headers, size_t header_count,
+                    const void *body, size_t body_len,
+                    uint8_t *resp, size_t resp_cap, size_t *resp_len)
+{
+    if (resp_len) *resp_len = 0;
+    if (!g_connected || body_len > SH_BODY_MAX) return -1;
+
+    uint32_t t0 = mono_ms();
+    g_stats.requests++;
+
+    at_batch_begin();
+    at_batch_add(2000, "+SHCHEAD");
+    for (size_t i = 0; i < header_count; i++)
+        at_batch_add(2000, "+SHAHEAD=\"%s\",\"%s\"", headers[i].name, headers[i].value);
+    bool ok = at_batch_wait() == AtResult::OK;
+
+    if (ok && body_len)
+    {
+        ok = send_body(body, body_len);
+        if (ok) g_stats.body_bytes += body_len;
+    }
+
+    // +SHREQ: "PUT",201,0
+    char urc[64];
+    ok = ok && at_cmd(5000, "+SHREQ=\"%s\",%u", path, (unsigned)method) == AtResult::OK &&
+         at_wait_line("+SHREQ: ", urc, sizeof(urc), SH_REQ_TIMEOUT_MS);
+
+    int status = -1;
+    uint32_t len = 0;
+    if (ok)
+    {
+        const char *c1 = strchr(urc, ',');
+        const char *c2 = c1 ? strchr(c1 + 1, ',') : nullptr;
+        if (c2)
+        {
+            status = atoi(c1 + 1);
+            len = (uint32_t)strtoul(c2 + 1, nullptr, 10);
+        }
+        // 6xx: the modem's own codes for DNS / connect / timeout errors
+        if (status >= 600) status = -1;
+    }
+
+    if (status > 0 && len && resp && resp_cap && !read_body(len, resp, resp_cap, resp_len))
+        status = -1;
+
+    if (status < 0)
+    {
+        g_stats.failures++;
+        VST_LOG("⚠️ simhttp: %s failed (%s)\n", SH_METHOD[(int)method], ok ? urc : "no response");
+        at_flush_input();
+        simhttp_disconnect();
+    }
+
+    g_stats.last_ms = mono_ms() - t0;
+    return status;
+}
+
+const SimHttpStats &simhttp_stats()
+{
+    return g_stats;
+}
@@ -0,0 +1,43 @@
+// src/simhttp.h — HTTP(S) client on the SIM7080 built-in stack (AT+SH*)
+//
+// One connection at a time; bodies of at most SH_BODY_MAX bytes.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr size_t SH_BODY_MAX   = 4096;   // AT+SHCONF="BODYLEN" limit
+static constexpr size_t SH_HEADER_MAX = 350;    // AT+SHCONF="HEADERLEN" limit
+static constexpr size_t SH_PATH_MAX   = 440;    // path + query, fits AT_CMD_MAX
+
+enum class SimHttpMethod : uint8_t { GET = 1, PUT = 2, POST = 3, PATCH = 4, HEAD = 5 };
+
+struct SimHttpHeader
+{
+    const char *name;
+    const char *value;
+};
+
+struct SimHttpStats
+{
+    uint32_t connects;
+    uint32_t requests;
+    uint32_t failures;      // no HTTP status (modem / link error)
+    uint64_t body_bytes;    // sent
+    uint64_t resp_bytes;    // read back
+    uint32_t last_ms;       // duration of the last request
+};
+
+// base_url is "http://host[:port]" or "https://host[:port]" (no path).
+bool simhttp_connect(const char *base_url);
+bool simhttp_connected();
+void simhttp_disconnect();
+
+// Sends one request on the open connection. Returns the HTTP status, or
+// -1 when the modem or the link failed (the connection is then closed).
+// Up to resp_cap bytes of the response body are copied to resp.
+int simhttp_request(SimHttpMethod method, const char *path,
+                    const SimHttpHeader *headers, size_t header_count,
+                    const void *body, size_t body_len,
+                    uint8_t *resp = nullptr, size_t resp_cap = 0, size_t *resp_len = nullptr);
+
+const SimHttpStats &simhttp_stats();
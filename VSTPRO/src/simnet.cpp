@@ -0,0 +1,68 @@
+// src/simnet.cpp — data bearer on the SIM7080 (see simnet.h)
+
+#include "simnet.h"
+#include "modem_at.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool simnet_is_up(char *ip, unsigned ip_sz)
+{
+    if (at_cmd(3000, "+CNACT?") != AtResult::OK) return false;
+
+    // +CNACT: 0,1,"10.64.12.7"  (one line per context)
+    char v[64];
+    if (!at_find("+CNACT: 0,", v, sizeof(v)) || v[0] != '1') return false;
+
+    if (ip && ip_sz)
+    {
+        const char *q1 = strchr(v, '"');
+        const char *q2 = q1 ? strchr(q1 + 1, '"') : nullptr;
+        ip[0] = 0;
+        if (q2) snprintf(ip, ip_sz, "%.*s", (int)(q2 - q1 - 1), q1 + 1);
+    }
+    return true;
+}
+
+bool simnet_up(const char *apn, uint32_t timeout_ms)
+{
+    char ip[24] = {0};
+    if (simnet_is_up(ip, sizeof(ip))) return true;
+
+    if (apn && apn[0])
+        at_cmd(3000, "+CNCFG=0,1,\"%s\"", apn);
+
+    if (at_cmd(timeout_ms, "+CNACT=0,1") != AtResult::OK)
+    {
+        VST_LOG("❌ simnet: CNACT failed\n");
+        return false;
+    }
+
+    // A DEACTIVE still queued from a simnet_down() just before is skipped
+    char urc[32];
+    bool active = false;
+    while (!active && at_wait_line("+APP PDP: 0,", urc, sizeof(urc), timeout_ms))
+        active = strncmp(urc, "ACTIVE", 6) == 0;
+    if (!active)
+    {
+        // Some firmware skips the URC; ask instead
+        if (!simnet_is_up(ip, sizeof(ip)))
+        {
+            VST_LOG("❌ simnet: PDP context did not come up\n");
+            return false;
+        }
+    }
+    else
+    {
+        simnet_is_up(ip, sizeof(ip));
+    }
+
+    VST_LOG("📶 Data bearer up (ip %s)\n", ip);
+    return true;
+}
+
+void simnet_down()
+{
+    at_cmd(5000, "+CNACT=0,0");
+}
@@ -0,0 +1,11 @@
+// src/simnet.h — data bearer (PDP context 0, AT+CNCFG / AT+CNACT) on the SIM7080
+#pragma once
+#include <stdint.h>
+
+// Registers the APN and activates context 0 if it is not already up.
+bool simnet_up(const char *apn, uint32_t timeout_ms);
+
+// Asks the modem (AT+CNACT?); copies the local IP when up and ip is given.
+bool simnet_is_up(char *ip = nullptr, unsigned ip_sz = 0);
+
+void simnet_down();
@@ -0,0 +1,492 @@
+// src/sscmalink.cpp — SSCMA AT protocol over the library's byte transport (see sscmalink.h)
+
+#include "sscmalink.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t now_ms() { return millis(); }
+static inline void sleep_ms(uint32_t ms) { delay(ms); }
+#else
+#include <time.h>
+#include <unistd.h>
+static uint32_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+static void sleep_ms(uint32_t ms) { usleep(ms * 1000); }
+#endif
+
+static constexpr int SSCMA_RESPONSE = 0;    // "type" of a command's answer
+static constexpr int SSCMA_EVENT    = 1;    // results of INVOKE / SAMPLE
+static constexpr int SSCMA_OK       = 0;
+static constexpr int SSCMA_BUSY     = 3;
+
+struct Reply
+{
+    int         type;
+    int         code;
+    char        name[16];
+    const char *data;           // after "data":, nullptr if none
+};
+
+static SscmaPort   g_port = {};
+static SscmaConfig g_cfg = {};
+static char       *g_buf = nullptr;
+static size_t      g_cap = 0;           // buffer size less the terminator
+static size_t      g_len = 0;
+static size_t      g_used = 0;          // bytes of the reply handed out last
+static size_t      g_scan = 0;          // searched for the end of a reply up to here
+static bool        g_streaming = false;
+static uint32_t    g_backoff = 0;
+static uint32_t    g_image_ms = 0;      // last image fetched
+static SscmaStats  g_stats = {};
+
+SscmaConfig sscma_default_config()
+{
+    SscmaConfig c{};
+    c.mode = SscmaMode::CONTINUOUS;
+    c.poll_ms = 5;
+    c.result_timeout_ms = 5000;
+    c.backoff_min_ms = 30;
+    c.backoff_max_ms = 1200;
+    c.invoke_deadline_ms = 25000;
+    c.idle_ms = 10;
+    c.result_only = false;
+    for (uint8_t &m : c.image_min_score) m = 50;
+    c.image_every_ms = 60000;
+    c.image_retries = 1;
+    return c;
+}
+
+bool sscma_begin(const SscmaPort &port, const SscmaConfig &cfg, char *buf, size_t buf_len)
+{
+    if (!port.available || !port.read || !port.write || !buf || buf_len < 256) return false;
+    g_port = port;
+    g_cfg = cfg;
+    if (!g_cfg.result_timeout_ms) g_cfg.result_timeout_ms = 5000;
+    if (!g_cfg.backoff_min_ms) g_cfg.backoff_min_ms = 30;
+    if (g_cfg.backoff_max_ms < g_cfg.backoff_min_ms) g_cfg.backoff_max_ms = g_cfg.backoff_min_ms;
+    g_buf = buf;
+    g_cap = buf_len - 1;
+    g_len = g_used = g_scan = 0;
+    g_streaming = false;
+    g_backoff = g_cfg.backoff_min_ms;
+    g_image_ms = now_ms();
+    return true;
+}
+
+const SscmaStats &sscma_stats()
+{
+    return g_stats;
+}
+
+/* =========================================================
+   REPLIES
+   ========================================================= */
+static void command(const char *cmd)
+{
+    g_port.write(cmd, (int)strlen(cmd));
+}
+
+static void compact()
+{
+    if (!g_used) return;
+    memmove(g_buf, g_buf + g_used, g_len - g_used);
+    g_len -= g_used;
+    g_scan = g_scan > g_used ? g_scan - g_used : 0;
+    g_used = 0;
+}
+
+// Reads what the module has; false if nothing came
+static bool pump()
+{
+    compact();
+    g_stats.polls++;
+    int n = g_port.available();
+    if (n <= 0)
+    {
+        g_stats.empty_polls++;
+        return false;
+    }
+    if (g_len >= g_cap)
+    {
+        // One reply larger than the buffer: its tail is dropped as junk
+        // before the next "\r{"
+        g_stats.errors++;
+        VST_LOG("⚠️ sscma: reply over %u B dropped\n", (unsigned)g_cap);
+        g_len = g_scan = 0;
+    }
+    size_t room = g_cap - g_len;
+    int got = g_port.read(g_buf + g_len, (size_t)n < room ? n : (int)room);
+    if (got <= 0) return false;
+    g_len += (size_t)got;
+    g_stats.rx_bytes += (uint64_t)got;
+    return true;
+}
+
+static const char *after(const char *s, const char *key)
+{
+    const char *p = strstr(s, key);
+    if (!p) return nullptr;
+    p += strlen(key);
+    while (*p == ' ') p++;
+    return p;
+}
+
+// The next whole reply in the buffer, if there is one. It stays in the
+// buffer (and its image valid) until the following call.
+static bool take(Reply *r)
+{
+    compact();
+    g_buf[g_len] = 0;
+
+    char *start = strstr(g_buf, "\r{");
+    if (!start)
+    {
+        // Keep a trailing '\r' that may start the next reply
+        g_used = g_len && g_buf[g_len - 1] == '\r' ? g_len - 1 : g_len;
+        g_scan = 0;
+        return false;
+    }
+    if (start != g_buf)
+    {
+        g_used = (size_t)(start - g_buf);
+        g_scan = 0;
+        compact();
+        start = g_buf;
+    }
+    // Only the new bytes (and the one before) can hold the end
+    char *end = strstr(g_buf + (g_scan ? g_scan - 1 : 0), "}\n");
+    if (!end)
+    {
+        g_scan = g_len;
+        return false;
+    }
+    end[1] = 0;
+    g_used = (size_t)(end + 2 - g_buf);
+    g_scan = 0;
+
+    const char *p = after(start, "\"type\":");
+    const char *c = after(start, "\"code\":");
+    const char *n = after(start, "\"name\":");
+    r->type = p ? atoi(p) : -1;
+    r->code = c ? atoi(c) : -1;
+    r->name[0] = 0;
+    if (n && *n == '"')
+    {
+        size_t k = 0;
+        for (n++; *n && *n != '"' && k + 1 < sizeof(r->name); n++)
+            r->name[k++] = *n;
+        r->name[k] = 0;
+    }
+    r->data = after(start, "\"data\":");
+    return true;
+}
+
+// Waits for a reply; polls without sleeping when sleep is false (like
+// the library's own wait())
+static bool next_reply(Reply *r, uint32_t timeout_ms, bool sleep)
+{
+    uint32_t t0 = now_ms();
+    for (;;)
+    {
+        if (take(r)) return true;
+        if (pump()) continue;
+        if (now_ms() - t0 >= timeout_ms) return false;
+        if (sleep && g_cfg.poll_ms) sleep_ms(g_cfg.poll_ms);
+    }
+}
+
+static bool wait_for(Reply *r, int type, const char *name, uint32_t timeout_ms, bool sleep)
+{
+    uint32_t t0 = now_ms();
+    for (;;)
+    {
+        uint32_t spent = now_ms() - t0;
+        if (spent >= timeout_ms || !next_reply(r, timeout_ms - spent, sleep)) return false;
+        if (r->type == type && !strcmp(r->name, name)) return true;
+    }
+}
+
+// "[a, b, c]" -> values, returns what follows the ']'
+static const char *numbers(const char *p, long *v, int n)
+{
+    if (!p || *p != '[') return nullptr;
+    p++;
+    for (int i = 0; i < n; i++)
+    {
+        char *e;
+        v[i] = strtol(p, &e, 10);
+        if (e == p) return nullptr;
+        p = e;
+        while (*p == ' ' || *p == ',') p++;
+    }
+    while (*p && *p != ']') p++;
+    return *p ? p + 1 : nullptr;
+}
+
+static bool parse_result(const Reply &r, SscmaFrame *f)
+{
+    memset(f, 0, sizeof(*f));
+    f->ready_ms = now_ms();
+    if (!r.data) return false;
+
+    const char *p = after(r.data, "\"count\":");
+    if (p) f->seq = (uint32_t)strtoul(p, nullptr, 10);
+
+    long v[6];
+    if (numbers(after(r.data, "\"perf\":"), v, 3))
+    {
+        f->perf.preprocess = (uint16_t)v[0];
+        f->perf.inference = (uint16_t)v[1];
+        f->perf.postprocess = (uint16_t)v[2];
+    }
+
+    // "boxes": [[x, y, w, h, score, target], ...]
+    p = after(r.data, "\"boxes\":");
+    if (p && *p == '[')
+    {
+        for (p++; *p == ' ' || *p == ','; p++) {}
+        while (*p == '[')
+        {
+            p = numbers(p, v, 6);
+            if (!p) return false;
+            if (f->box_count < FRAME_META_MAX_BOXES)
+            {
+                FrameBox &b = f->boxes[f->box_count++];
+                b.x = (uint16_t)v[0];
+                b.y = (uint16_t)v[1];
+                b.w = (uint16_t)v[2];
+                b.h = (uint16_t)v[3];
+                b.score = (uint8_t)v[4];
+                b.target = (uint8_t)v[5];
+            }
+            else
+            {
+                f->boxes_dropped++;
+            }
+            while (*p == ' ' || *p == ',') p++;
+        }
+    }
+
+    // The image stays in the buffer, terminated in place
+    p = after(r.data, "\"image\":");
+    if (p && *p == '"')
+    {
+        char *img = (char*)p + 1;
+        char *q = strchr(img, '"');
+        if (q)
+        {
+            *q = 0;
+            f->image = img;
+            f->image_len = (size_t)(q - img);
+        }
+    }
+    return true;
+}
+
+/* =========================================================
+   SINGLE
+   ========================================================= */
+static void backoff()
+{
+    sleep_ms(g_backoff);
+    g_stats.backoff_ms += g_backoff;
+    uint32_t next = g_backoff * 3 / 2;
+    g_backoff = next > g_cfg.backoff_max_ms ? g_cfg.backoff_max_ms : next;
+}
+
+static bool next_single(SscmaFrame *f, bool result_only)
+{
+    uint32_t t0 = now_ms();
+    uint32_t last_log = 0;
+    Reply r;
+    for (;;)
+    {
+        if (now_ms() - t0 > g_cfg.invoke_deadline_ms)
+        {
+            g_stats.stalls++;
+            VST_LOG("⚠️ sscma: invoke deadline exceeded (%lu ms), busy x%lu\n",
+                    (unsigned long)g_cfg.invoke_deadline_ms, (unsigned long)g_stats.busy);
+            return false;
+        }
+
+        command(result_only ? "AT+INVOKE=1,0,1\r\n" : "AT+INVOKE=1,0,0\r\n");
+        g_stats.invokes++;
+        if (!wait_for(&r, SSCMA_RESPONSE, "INVOKE", g_cfg.result_timeout_ms, false))
+        {
+            g_stats.stalls++;
+            return false;
+        }
+        if (r.code == SSCMA_BUSY)
+        {
+            g_stats.busy++;
+            if (now_ms() - last_log > 2000)
+            {
+                VST_LOG("⏳ sscma: busy x%lu, backoff=%lums\n", (unsigned long)g_stats.busy,
+                        (unsigned long)g_backoff);
+                last_log = now_ms();
+            }
+            backoff();
+            continue;
+        }
+        if (r.code != SSCMA_OK)
+        {
+            g_stats.errors++;
+            VST_LOG("❌ sscma: invoke failed rc=%d (backoff=%lums)\n", r.code, (unsigned long)g_backoff);
+            backoff();
+            continue;
+        }
+
+        if (!wait_for(&r, SSCMA_EVENT, "INVOKE", g_cfg.result_timeout_ms, false))
+        {
+            g_stats.stalls++;
+            return false;
+        }
+        if (r.code != SSCMA_OK || !parse_result(r, f))
+        {
+            g_stats.errors++;
+            backoff();
+            continue;
+        }
+        g_backoff = g_cfg.backoff_min_ms;
+        if (g_cfg.idle_ms) sleep_ms(g_cfg.idle_ms);
+        return true;
+    }
+}
+
+/* =========================================================
+   CONTINUOUS
+   ========================================================= */
+static bool stream_start()
+{
+    Reply r;
+    command(g_cfg.result_only ? "AT+INVOKE=-1,0,1\r\n" : "AT+INVOKE=-1,0,0\r\n");
+    g_stats.invokes++;
+    if (!wait_for(&r, SSCMA_RESPONSE, "INVOKE", g_cfg.result_timeout_ms, true))
+    {
+        g_stats.stalls++;
+        return false;
+    }
+    if (r.code != SSCMA_OK)
+    {
+        g_stats.errors++;
+        VST_LOG("❌ sscma: continuous invoke refused rc=%d\n", r.code);
+        command("AT+BREAK\r\n");
+        return false;
+    }
+    g_streaming = true;
+    VST_LOG("▶️ sscma: continuous invoke running\n");
+    return true;
+}
+
+static bool next_stream(SscmaFrame *f)
+{
+    if (!g_streaming && !stream_start()) return false;
+
+    Reply r;
+    for (;;)
+    {
+        if (!wait_for(&r, SSCMA_EVENT, "INVOKE", g_cfg.result_timeout_ms, true))
+        {
+            g_stats.stalls++;
+            g_streaming = false;
+            VST_LOG("⚠️ sscma: no result for %lu ms\n", (unsigned long)g_cfg.result_timeout_ms);
+            return false;
+        }
+        if (r.code == SSCMA_OK && parse_result(r, f)) return true;
+        g_stats.errors++;
+    }
+}
+
+bool sscma_next(SscmaFrame *f)
+{
+    if (!g_buf) return false;
+    bool ok = g_cfg.mode == SscmaMode::CONTINUOUS ? next_stream(f) : next_single(f, g_cfg.result_only);
+    if (ok) g_stats.frames++;
+    return ok;
+}
+
+/* =========================================================
+   TWO-PHASE
+   ========================================================= */
+// The score clause of the image policy
+static bool detection(const FrameBox *boxes, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint8_t t = boxes[i].target;
+        if (t < sizeof(g_cfg.image_min_score) && boxes[i].score >= g_cfg.image_min_score[t])
+            return true;
+    }
+    return false;
+}
+
+bool sscma_want_image(const FrameBox *boxes, uint8_t n)
+{
+    if (!g_cfg.result_only) return false;
+    if (detection(boxes, n)) return true;
+    return g_cfg.image_every_ms && now_ms() - g_image_ms >= g_cfg.image_every_ms;
+}
+
+bool sscma_image(SscmaFrame *f, const FrameBox *trigger, uint8_t n)
+{
+    if (!g_buf) return false;
+    if (g_streaming)
+    {
+        // Results queued behind the break are dropped with it
+        Reply r;
+        command("AT+BREAK\r\n");
+        g_streaming = false;
+        if (!wait_for(&r, SSCMA_RESPONSE, "BREAK", g_cfg.result_timeout_ms, false))
+        {
+            g_stats.stalls++;
+            return false;
+        }
+    }
+    // The image is a new capture: the hornet may have left the frame
+    bool need = detection(trigger, n);
+    for (uint8_t attempt = 0;; attempt++)
+    {
+        if (!next_single(f, false)) return false;
+        f->confirmed = !need || detection(f->boxes, f->box_count);
+        if (f->confirmed || attempt >= g_cfg.image_retries) break;
+        g_stats.image_retries++;
+    }
+    if (!f->confirmed)
+    {
+        g_stats.image_misses++;
+        VST_LOG("⚠️ sscma: detection gone from the image capture after %u retries\n",
+                (unsigned)g_cfg.image_retries);
+    }
+    g_stats.images++;
+    g_image_ms = now_ms();
+    return true;
+}
+
+int sscma_ping(uint32_t timeout_ms)
+{
+    if (!g_buf) return 0;
+    if (g_streaming) sscma_stop();
+
+    Reply r;
+    uint32_t errors = g_stats.errors;
+    command("AT+ID?\r\n");
+    if (wait_for(&r, SSCMA_RESPONSE, "ID?", timeout_ms, false))
+        return r.code == SSCMA_OK ? 1 : -1;
+    return g_stats.errors != errors ? -1 : 0;
+}
+
+void sscma_stop()
+{
+    if (g_streaming) command("AT+BREAK\r\n");
+    g_streaming = false;
+    g_len = g_used = g_scan = 0;
+}
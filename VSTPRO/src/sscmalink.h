@@ -0,0 +1,97 @@
+// src/sscmalink.h — Grove Vision AI V2 results over the SSCMA AT protocol
+//
+// AT+INVOKE / AT+BREAK and the INVOKE event parser on top of the SSCMA
+// library's byte transport. Modes and measurements: README 1.10 / 1.11.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+
+// Byte transport to the module. read() must not block.
+struct SscmaPort
+{
+    int (*available)();                     // bytes the module has for us
+    int (*read)(char *buf, int n);
+    int (*write)(const char *buf, int n);
+};
+
+enum class SscmaMode : uint8_t { SINGLE, CONTINUOUS };
+
+struct SscmaConfig
+{
+    SscmaMode mode;
+    uint16_t  poll_ms;              // CONTINUOUS: sleep between empty available() polls
+    uint32_t  result_timeout_ms;    // no event for this long: stalled
+    uint32_t  backoff_min_ms;       // SINGLE: first wait after a busy answer
+    uint32_t  backoff_max_ms;
+    uint32_t  invoke_deadline_ms;   // SINGLE: busy for this long: stalled
+    uint32_t  idle_ms;              // SINGLE: pause after each result
+    bool      result_only;          // two-phase: results without the image
+    uint8_t   image_min_score[4];   // per target: a box this good wants the image (> 100: never)
+    uint32_t  image_every_ms;       // and any result this long after the last image (0: never)
+    uint8_t   image_retries;        // captures sscma_image() adds while a detection is not confirmed
+};
+
+struct SscmaFrame
+{
+    FramePerf   perf;
+    uint8_t     box_count;
+    uint8_t     boxes_dropped;
+    FrameBox    boxes[FRAME_META_MAX_BOXES];
+    const char *image;              // Base64 JPEG inside the sscma_begin() buffer; valid
+                                    // until the next sscma_* call, nullptr without one
+    size_t      image_len;
+    uint32_t    ready_ms;           // when the event was complete here
+    uint32_t    seq;                // the module's invoke count
+    bool        confirmed;          // sscma_image(): the capture passes the trigger's score policy
+};
+
+struct SscmaStats
+{
+    uint32_t frames;
+    uint32_t invokes;               // AT+INVOKE written
+    uint32_t busy;                  // answered busy (SINGLE)
+    uint32_t backoff_ms;            // slept in backoff (SINGLE)
+    uint32_t images;                // sscma_image() fetches
+    uint32_t image_retries;         // captures added because the detection was gone
+    uint32_t image_misses;          // images stored with the detection still gone
+    uint32_t errors;                // error codes, unparsable or oversized replies
+    uint32_t stalls;
+    uint32_t polls;                 // available() calls
+    uint32_t empty_polls;
+    uint64_t rx_bytes;
+};
+
+SscmaConfig sscma_default_config();
+
+// buf holds one reply (a Base64 image: AI_RX_BUF, at least 256 B). It
+// stays the caller's and must outlive the link. Can be called again
+// after a reinit; the stream is not running afterwards.
+bool sscma_begin(const SscmaPort &port, const SscmaConfig &cfg, char *buf, size_t buf_len);
+
+// Next result in the configured mode. CONTINUOUS starts the stream on
+// the first call. False when the module stalled (no event for
+// result_timeout_ms, or SINGLE busy past invoke_deadline_ms): reinit
+// the bus, the next call starts over.
+bool sscma_next(SscmaFrame *f);
+
+// Two-phase: whether these boxes (or the time since the last image) call
+// for the image. Always false without result_only.
+bool sscma_want_image(const FrameBox *boxes, uint8_t n);
+
+// Two-phase: one invoke with the image, perf and boxes of that capture;
+// the stream resumes on the next sscma_next(). When the trigger boxes
+// passed the score policy, the capture must too: up to image_retries
+// more captures, then f->confirmed stays false. A timed image is always
+// confirmed.
+bool sscma_image(SscmaFrame *f, const FrameBox *trigger, uint8_t n);
+
+// AT+ID? round trip, for i2cbus.h probes; ends a running stream.
+// 1 answered, 0 no answer, -1 an answer that did not parse
+int sscma_ping(uint32_t timeout_ms);
+
+// Ends a continuous invoke (AT+BREAK) and drops what is buffered
+void sscma_stop();
+
+const SscmaStats &sscma_stats();
@@ -0,0 +1,435 @@
+// src/telemetry.cpp — batched detection telemetry (see telemetry.h)
+
+#include "telemetry.h"
+#include "config.h"
+#include "modem_at.h"
+#include "modempower.h"
+#include "mqttlink.h"
+#include "simnet.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+static SemaphoreHandle_t g_mux = nullptr;
+static inline void r_lock()   { if (g_mux) xSemaphoreTake(g_mux, portMAX_DELAY); }
+static inline void r_unlock() { if (g_mux) xSemaphoreGive(g_mux); }
+#else
+#include <mutex>
+static std::mutex g_mux;
+static inline void r_lock()   { g_mux.lock(); }
+static inline void r_unlock() { g_mux.unlock(); }
+#endif
+
+static constexpr uint32_t TELEM_EPOCH_MIN = 1577836800;  // 2020-01-01, as frameindex
+static constexpr size_t TELEM_HEADER_MAX = 4 + 4 * 5;    // magic + 4 varints
+static constexpr size_t TELEM_RECORD_MAX = 5 + 5 + 1 + TELEM_BOXES_MAX * (2 + 4 * 3);
+
+static TelemConfig g_cfg = {};
+static bool        g_ready = false;
+static TelemRecord g_recs[TELEM_RING];      // oldest first
+static uint16_t    g_count = 0;
+static uint32_t    g_frames = 0;            // seen since the last batch
+static size_t      g_est_bytes = 0;         // payload estimate of the queue
+static bool        g_urgent = false;
+static bool        g_force = false;
+static uint32_t    g_last_urgent_ms = 0;
+static bool        g_container_ok = false;
+static uint32_t    g_backoff_ms = 0;
+static uint32_t    g_retry_at = 0;
+static TelemStats  g_stats = {};
+static uint8_t     g_payload[SH_BODY_MAX];
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+/* =========================================================
+   ENCODING
+   ========================================================= */
+static size_t put_varint(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static size_t record_estimate(uint8_t boxes)
+{
+    return 3 + (size_t)boxes * 8;
+}
+
+// wall = UTC now, mono = mono_ms() now: a record's epoch is wall minus its age
+static uint32_t record_epoch(const TelemRecord &r, uint32_t wall, uint32_t mono)
+{
+    return wall - (mono - r.mono_ms) / 1000;
+}
+
+size_t telemetry_encode(const TelemRecord *recs, uint32_t n, uint32_t frames,
+                        uint32_t wall, uint32_t mono,
+                        uint8_t *out, size_t cap, uint32_t *encoded)
+{
+    *encoded = 0;
+    if (!n || cap < TELEM_HEADER_MAX + TELEM_RECORD_MAX) return 0;
+
+    // The record count goes in the header: encode the body first, behind
+    // room for the largest header, then move it up.
+    uint8_t *body = out + TELEM_HEADER_MAX;
+    size_t room = cap - TELEM_HEADER_MAX, len = 0;
+    uint32_t prev_id = recs[0].frame_id;
+    uint32_t prev_t = record_epoch(recs[0], wall, mono);
+    uint32_t done = 0;
+
+    for (; done < n && room - len >= TELEM_RECORD_MAX; done++)
+    {
+        const TelemRecord &r = recs[done];
+        uint32_t t = record_epoch(r, wall, mono);
+        len += put_varint(body + len, r.frame_id - prev_id);
+        len += put_varint(body + len, zigzag((int32_t)(t - prev_t)));
+        body[len++] = r.box_count;
+        for (uint8_t b = 0; b < r.box_count; b++)
+        {
+            const FrameBox &x = r.boxes[b];
+            body[len++] = x.target;
+            body[len++] = x.score;
+            len += put_varint(body + len, x.x);
+            len += put_varint(body + len, x.y);
+            len += put_varint(body + len, x.w);
+            len += put_varint(body + len, x.h);
+        }
+        prev_id = r.frame_id;
+        prev_t = t;
+    }
+
+    uint8_t hdr[TELEM_HEADER_MAX];
+    size_t h = 0;
+    memcpy(hdr, "VTB1", 4);
+    h = 4;
+    h += put_varint(hdr + h, frames);
+    h += put_varint(hdr + h, done);
+    h += put_varint(hdr + h, recs[0].frame_id);
+    h += put_varint(hdr + h, record_epoch(recs[0], wall, mono));
+
+    memmove(out + h, body, len);
+    memcpy(out, hdr, h);
+    *encoded = done;
+    return h + len;
+}
+
+/* =========================================================
+   QUEUE (capture side)
+   ========================================================= */
+void telemetry_add(uint32_t frame_id, const FrameMeta *meta)
+{
+    if (!g_ready || !meta || !meta->valid) return;
+
+    r_lock();
+    g_frames++;
+    g_stats.frames++;
+
+    if (meta->box_count)
+    {
+        if (g_count == TELEM_RING)
+        {
+            // Link down for long: keep the newest
+            g_est_bytes -= record_estimate(g_recs[0].box_count);
+            memmove(&g_recs[0], &g_recs[1], sizeof(g_recs[0]) * (TELEM_RING - 1));
+            g_count--;
+            g_stats.dropped++;
+        }
+
+        TelemRecord &r = g_recs[g_count++];
+        r.frame_id = frame_id;
+        r.mono_ms = mono_ms();
+        r.box_count = 0;
+
+        // Best boxes first (the model output is not sorted)
+        for (uint8_t i = 0; i < meta->box_count && i < FRAME_META_MAX_BOXES; i++)
+        {
+            const FrameBox &b = meta->boxes[i];
+            uint8_t at = r.box_count < TELEM_BOXES_MAX ? r.box_count++ : TELEM_BOXES_MAX;
+            while (at > 0 && r.boxes[at - 1].score < b.score)
+            {
+                if (at < TELEM_BOXES_MAX) r.boxes[at] = r.boxes[at - 1];
+                at--;
+            }
+            if (at < TELEM_BOXES_MAX) r.boxes[at] = b;
+
+            if (b.target == g_cfg.urgent_target && b.score >= g_cfg.urgent_score)
+                g_urgent = true;
+        }
+
+        g_est_bytes += record_estimate(r.box_count);
+        g_stats.records++;
+    }
+    r_unlock();
+}
+
+bool telemetry_due()
+{
+    if (!g_ready) return false;
+    uint32_t now = mono_ms();
+    if (g_retry_at && (int32_t)(now - g_retry_at) < 0) return false;
+    if ((uint32_t)time(nullptr) < TELEM_EPOCH_MIN) return false;   // no date for the records yet
+
+    r_lock();
+    bool due = g_count > 0 &&
+               (g_force ||
+                g_count >= g_cfg.max_records ||
+                g_est_bytes + TELEM_HEADER_MAX + TELEM_RECORD_MAX > SH_BODY_MAX ||
+                now - g_recs[0].mono_ms >= g_cfg.flush_ms ||
+                (g_urgent && (!g_last_urgent_ms || now - g_last_urgent_ms >= g_cfg.urgent_hold_ms)));
+    r_unlock();
+    return due;
+}
+
+void telemetry_flush_now()
+{
+    g_force = true;
+}
+
+/* =========================================================
+   SENDING
+   ========================================================= */
+static UpState fail(const char *what, int status)
+{
+    g_stats.failures++;
+    g_backoff_ms = g_backoff_ms ? g_backoff_ms * 2 : g_cfg.retry_ms;
+    if (g_backoff_ms > g_cfg.retry_ms * 16) g_backoff_ms = g_cfg.retry_ms * 16;
+    g_retry_at = mono_ms() + g_backoff_ms;
+    VST_LOG("⚠️ telemetry: %s failed (%d), retry in %lu ms\n", what, status, (unsigned long)g_backoff_ms);
+    return UpState::BACKOFF;
+}
+
+// Blob named after the first record, so a retried batch overwrites itself
+static void blob_name(uint32_t epoch, uint32_t frame_id, char *out, size_t out_sz)
+{
+    time_t t = (time_t)epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(out, out_sz, "%s/telemetry/%04d%02d%02d/%02d%02d%02d_%06lu.vtb",
+             g_cfg.device_id,
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned long)frame_id);
+}
+
+UpState telemetry_step()
+{
+    if (!telemetry_due()) return UpState::IDLE;
+    g_retry_at = 0;
+
+    // Snapshot under the lock; capture keeps appending behind it
+    uint32_t wall = (uint32_t)time(nullptr), mono = mono_ms();
+    r_lock();
+    uint32_t frames = g_frames, n = 0;
+    bool urgent = g_urgent && !g_force && g_count < g_cfg.max_records &&
+                  mono - g_recs[0].mono_ms < g_cfg.flush_ms;
+    uint32_t take = g_count < g_cfg.max_records ? g_count : g_cfg.max_records;
+    size_t len = telemetry_encode(g_recs, take, frames, wall, mono, g_payload, sizeof(g_payload), &n);
+    uint32_t first_id = g_recs[0].frame_id;
+    uint32_t first_t = record_epoch(g_recs[0], wall, mono);
+    uint32_t boxes = 0;
+    for (uint32_t i = 0; i < n; i++) boxes += g_recs[i].box_count;
+    r_unlock();
+    if (!len) return UpState::IDLE;
+
+    char blob[80];
+    blob_name(first_t, first_id, blob, sizeof(blob));
+
+    // Radio session: the bearer only comes up for the batch, unless the
+    // uploader (or keep_link) already holds it
+    const AtStats &as = at_stats();
+    uint64_t wire0 = as.tx_bytes + as.rx_bytes;
+    uint32_t t0 = mono_ms();
+    bool shared = simnet_is_up();
+
+    int st = -1;
+    const char *what = "connect";
+    if (g_cfg.mqtt)
+    {
+        // One PUBLISH on the open session (or the one this opens); the
+        // session closes itself after its idle time (mqtt_service())
+        uint32_t sessions = mqtt_stats().sessions;
+        what = "MQTT publish";
+        uint32_t seq = mqtt_publish(blob, g_payload, len);
+        if (seq && mqtt_flush() && mqtt_delivery(seq) == MqttDelivery::CONFIRMED) st = 201;
+        shared = mqtt_stats().sessions == sessions;
+    }
+    else
+    {
+        if (simnet_up(g_cfg.apn, 60000) && (simhttp_connected() || azblob_connect()))
+        {
+            if (!g_container_ok) g_container_ok = azblob_ensure_container();
+            what = "Put Blob";
+            if (g_container_ok) st = azblob_put_blob(blob, g_payload, len, "application/octet-stream");
+        }
+
+        if (!shared && !g_cfg.keep_link)
+        {
+            simhttp_disconnect();
+            simnet_down();
+        }
+    }
+
+    uint32_t ms = mono_ms() - t0;
+    g_stats.radio_ms += ms;
+    g_stats.sessions += !shared;
+    g_stats.wire_bytes += as.tx_bytes + as.rx_bytes - wire0;
+    if (st != 201) return fail(what, st);
+
+    // Drop what was sent; records added meanwhile stay queued
+    r_lock();
+    memmove(&g_recs[0], &g_recs[n], sizeof(g_recs[0]) * (g_count - n));
+    g_count -= n;
+    g_frames -= frames;
+    g_est_bytes = 0;
+    bool still_urgent = false;
+    for (uint16_t i = 0; i < g_count; i++)
+    {
+        g_est_bytes += record_estimate(g_recs[i].box_count);
+        for (uint8_t b = 0; b < g_recs[i].box_count; b++)
+            still_urgent |= g_recs[i].boxes[b].target == g_cfg.urgent_target &&
+                            g_recs[i].boxes[b].score >= g_cfg.urgent_score;
+    }
+    g_urgent = still_urgent;
+    if (!g_count) g_force = false;
+    r_unlock();
+
+    if (urgent)
+    {
+        g_last_urgent_ms = mono;
+        g_stats.urgent++;
+    }
+    g_stats.batches++;
+    g_stats.sent_records += n;
+    g_stats.sent_detections += boxes;
+    g_stats.payload_bytes += len;
+    g_stats.last_batch_ms = ms;
+    g_backoff_ms = 0;
+
+    VST_LOG("📨 telemetry: %s%s (%lu records, %lu detections, %lu B) in %lu ms\n",
+            blob, urgent ? " [velutina]" : "", (unsigned long)n, (unsigned long)boxes,
+            (unsigned long)len, (unsigned long)ms);
+    return UpState::BUSY;
+}
+
+/* =========================================================
+   INIT / TASK
+   ========================================================= */
+TelemConfig telemetry_default_config()
+{
+    TelemConfig c{};
+    c.apn = MODEM_APN;
+    c.az = AzConfig{ AZ_ENDPOINT, AZ_CONTAINER, AZ_SAS };
+    c.device_id = DEVICE_ID;
+    c.flush_ms = TELEM_FLUSH_MS;
+    c.max_records = TELEM_MAX_RECORDS;
+    c.urgent_target = TELEM_URGENT_TARGET;
+    c.urgent_score = TELEM_URGENT_SCORE;
+    c.urgent_hold_ms = TELEM_URGENT_HOLD_MS;
+    c.keep_link = TELEM_KEEP_LINK;
+    c.retry_ms = UP_RETRY_MS;
+    c.mqtt = MQTT_ENABLED;
+    return c;
+}
+
+bool telemetry_init(const TelemConfig &cfg)
+{
+    g_cfg = cfg;
+    if (!g_cfg.max_records || g_cfg.max_records > TELEM_RING) g_cfg.max_records = TELEM_RING;
+    if (!g_cfg.retry_ms) g_cfg.retry_ms = 1000;
+#if defined(ARDUINO)
+    if (!g_mux) g_mux = xSemaphoreCreateMutex();
+#endif
+
+    if (!azblob_begin(g_cfg.az))
+    {
+        VST_LOG("❌ telemetry: bad endpoint '%s'\n", g_cfg.az.endpoint ? g_cfg.az.endpoint : "");
+        return false;
+    }
+
+    r_lock();
+    g_count = 0;
+    g_frames = 0;
+    g_est_bytes = 0;
+    g_urgent = g_force = false;
+    memset(&g_stats, 0, sizeof(g_stats));
+    r_unlock();
+    g_last_urgent_ms = 0;
+    g_container_ok = false;
+    g_backoff_ms = g_retry_at = 0;
+    g_ready = true;
+
+    VST_LOG("📨 telemetry: batches every %lu s or %u records, velutina >= %u%% early\n",
+            (unsigned long)(g_cfg.flush_ms / 1000), g_cfg.max_records, g_cfg.urgent_score);
+    return true;
+}
+
+#if defined(ARDUINO)
+static void telemetry_task(void *)
+{
+    for (;;)
+    {
+        UpState s = UpState::IDLE;
+        if (telemetry_due())
+        {
+            at_lock();
+            if (power_awake()) s = telemetry_step();
+            at_unlock();
+        }
+        if (g_cfg.mqtt)
+        {
+            at_lock();
+            if (power_awake()) mqtt_service();
+            at_unlock();
+        }
+        vTaskDelay(pdMS_TO_TICKS(s == UpState::BUSY ? 1 : 250));
+    }
+}
+
+void telemetry_start_task()
+{
+    // Next to the uploader; the two take turns on the modem (at_lock)
+    xTaskCreatePinnedToCore(telemetry_task, "telemetry", 6144, nullptr, 1, nullptr, 0);
+}
+#else
+void telemetry_start_task()
+{
+}
+#endif
+
+const TelemStats &telemetry_stats()
+{
+    return g_stats;
+}
+
+void telemetry_log_stats()
+{
+    const TelemStats &s = g_stats;
+    double per = s.sent_detections ? 1.0 / s.sent_detections : 0;
+    VST_LOG("📊 telemetry: frames=%lu records=%lu batches=%lu (urgent %lu) failures=%lu dropped=%lu | "
+            "radio-on %.1f s in %lu sessions | %.1f B payload, %.1f B on the wire per detection\n",
+            (unsigned long)s.frames, (unsigned long)s.records, (unsigned long)s.batches,
+            (unsigned long)s.urgent, (unsigned long)s.failures, (unsigned long)s.dropped,
+            s.radio_ms / 1000.0, (unsigned long)s.sessions,
+            s.payload_bytes * per, s.wire_bytes * per);
+}
@@ -0,0 +1,82 @@
+// src/telemetry.h — batched detection telemetry over LTE-M
+//
+// Detections queue in a RAM ring and go out as one VTB1 blob (or MQTT
+// message) per flush. Flush rules: README 1.5; payload: README 1.13.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+#include "uploader.h"
+
+static constexpr uint16_t TELEM_RING      = 256;    // records held in RAM
+static constexpr uint8_t  TELEM_BOXES_MAX = 4;      // boxes kept per record (best first)
+
+struct TelemConfig
+{
+    const char *apn;
+    AzConfig    az;
+    const char *device_id;
+    uint32_t    flush_ms;           // N
+    uint16_t    max_records;        // M (<= TELEM_RING)
+    uint8_t     urgent_target;      // model target that forces an early flush
+    uint8_t     urgent_score;
+    uint32_t    urgent_hold_ms;
+    bool        keep_link;          // leave the bearer up between batches
+    uint32_t    retry_ms;
+    bool        mqtt;               // publish over mqttlink.h, not Put Blob
+};
+
+struct TelemStats
+{
+    uint32_t frames;            // frames seen
+    uint32_t records;           // frames with detections queued
+    uint32_t dropped;           // records lost to a full ring
+    uint32_t batches;
+    uint32_t urgent;            // batches sent early for velutina
+    uint32_t failures;
+    uint32_t sent_records;
+    uint32_t sent_detections;   // boxes
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;        // modem UART bytes of the sessions (AT + body)
+    uint32_t sessions;          // bearer brought up for a batch
+    uint32_t radio_ms;          // bearer up -> down (or request time on a shared link)
+    uint32_t last_batch_ms;
+};
+
+TelemConfig telemetry_default_config();
+
+bool telemetry_init(const TelemConfig &cfg);
+
+// Capture side: one call per inferred frame. Never touches the modem.
+void telemetry_add(uint32_t frame_id, const FrameMeta *meta);
+
+// A flush condition is met (and the retry backoff has passed).
+bool telemetry_due();
+
+// Sends one batch when due. Caller holds the modem (at_lock()).
+UpState telemetry_step();
+
+// Forces the next telemetry_step() to send what is queued.
+void telemetry_flush_now();
+
+// ESP32: task that runs telemetry_step() under at_lock().
+void telemetry_start_task();
+
+const TelemStats &telemetry_stats();
+void telemetry_log_stats();
+
+struct TelemRecord
+{
+    uint32_t frame_id;
+    uint32_t mono_ms;           // capture time, monotonic
+    uint8_t  box_count;
+    FrameBox boxes[TELEM_BOXES_MAX];
+};
+
+// Encodes as many of recs as fit cap into a VTB1 payload; *encoded is how
+// many. wall / mono are the UTC and monotonic clocks now, which date the
+// records. Returns the payload length.
+size_t telemetry_encode(const TelemRecord *recs, uint32_t n, uint32_t frames,
+                        uint32_t wall, uint32_t mono,
+                        uint8_t *out, size_t cap, uint32_t *encoded);
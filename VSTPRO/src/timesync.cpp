@@ -0,0 +1,385 @@
+// src/timesync.cpp — network time resync and clock model (see timesync.h)
+
+#include "timesync.h"
+#include "config.h"
+#include "modem_at.h"
+#include "modemlink.h"
+#include "vstlog.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <sys/time.h>
+static SemaphoreHandle_t g_mux = nullptr;
+static inline void m_lock()   { if (g_mux) xSemaphoreTake(g_mux, portMAX_DELAY); }
+static inline void m_unlock() { if (g_mux) xSemaphoreGive(g_mux); }
+static uint64_t sys_mono_us() { return (uint64_t)esp_timer_get_time(); }
+
+// The system clock runs off the same crystal as esp_timer
+static int64_t sys_clock_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void sys_clock_step(int64_t ms)
+{
+    struct timeval tv{};
+    tv.tv_sec = (time_t)(ms / 1000);
+    tv.tv_usec = (suseconds_t)(ms % 1000) * 1000;
+    settimeofday(&tv, nullptr);
+}
+
+static void sys_clock_slew(int32_t ms)
+{
+    struct timeval d{};
+    d.tv_sec = ms / 1000;
+    d.tv_usec = (ms % 1000) * 1000;
+    adjtime(&d, nullptr);
+}
+#else
+#include <mutex>
+static std::mutex g_mux;
+static inline void m_lock()   { g_mux.lock(); }
+static inline void m_unlock() { g_mux.unlock(); }
+static uint64_t sys_mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+#endif
+
+static constexpr uint32_t TS_AT_MS   = 1000;
+static constexpr uint32_t TS_IDLE_MS = 60000;   // nothing due: check again in a minute at most
+
+enum class Phase : uint8_t
+{
+    IDLE,
+    COARSE,     // +CCLK? every coarse_ms until the second changes
+    FINE,       // back to back from just before the next tick
+};
+
+static TimeSyncConfig g_cfg = {};
+static TimeSyncHooks  g_hooks = {};
+static TimeSyncStats  g_stats = {};
+
+// Clock model, under m_lock(): wall_ms = base_wall + (mono - base_mono) x (1 + ppm)
+static bool     g_valid = false;
+static int64_t  g_base_wall = 0;
+static uint64_t g_base_mono = 0;
+static double   g_rate = 0.0;           // ppm / 1e6
+static int64_t  g_anchor_wall = 0;      // rate: the sample drift_min_ms ago
+static uint64_t g_anchor_mono = 0;
+static int64_t  g_last_wall = 0;        // stamps never go backwards
+static uint64_t g_last_mono = 0;
+
+// Edge search (modem task only)
+static Phase    g_phase = Phase::IDLE;
+static bool     g_due = true;
+static uint64_t g_sync_at = 0;          // last search started
+static uint64_t g_trim_at = 0;
+static uint64_t g_fine_at = 0;          // FINE: first poll not before
+static uint32_t g_prev_s = 0;           // second in the last answer, 0 = none
+static uint64_t g_prev_sent = 0;        // when the command for it went out
+static uint8_t  g_polls = 0;            // this search
+
+/* =========================================================
+   CLOCK MODEL
+   ========================================================= */
+uint64_t timesync_mono_us()
+{
+    return g_hooks.mono_us ? g_hooks.mono_us() : sys_mono_us();
+}
+
+static int64_t model_ms(uint64_t mono_us)
+{
+    double d = (double)(int64_t)(mono_us - g_base_mono);
+    return g_base_wall + (int64_t)llround(d * (1.0 + g_rate) / 1000.0);
+}
+
+int64_t timesync_wall_ms(uint64_t mono_us)
+{
+    m_lock();
+    int64_t w = 0;
+    if (g_valid)
+    {
+        w = model_ms(mono_us);
+        // A resync that found the model ahead must not reorder stamps
+        if (mono_us >= g_last_mono)
+        {
+            if (w < g_last_wall) w = g_last_wall;
+            g_last_wall = w;
+            g_last_mono = mono_us;
+        }
+    }
+    m_unlock();
+    return w;
+}
+
+int64_t timesync_now_ms()
+{
+    return timesync_wall_ms(timesync_mono_us());
+}
+
+bool timesync_valid()
+{
+    return g_valid;
+}
+
+// System clock against the model: stepped when far off, slewed otherwise
+static void correct_clock()
+{
+    if (!g_hooks.clock_ms || !g_hooks.clock_step) return;
+    m_lock();
+    int64_t want = model_ms(timesync_mono_us());
+    m_unlock();
+    int64_t err = want - g_hooks.clock_ms();
+    g_stats.clock_error_ms = (int32_t)err;
+    if (llabs(err) > (int64_t)g_cfg.step_ms || !g_hooks.clock_slew)
+    {
+        g_hooks.clock_step(want);
+        g_stats.steps++;
+    }
+    else if (err)
+    {
+        g_hooks.clock_slew((int32_t)err);
+        g_stats.slews++;
+    }
+    g_trim_at = timesync_mono_us();
+}
+
+void timesync_sample(int64_t wall_ms, uint64_t mono_us, uint16_t window_ms)
+{
+    m_lock();
+    if (!g_valid)
+    {
+        g_anchor_wall = wall_ms;
+        g_anchor_mono = mono_us;
+        g_stats.error_ms = 0;
+    }
+    else
+    {
+        int64_t err = wall_ms - model_ms(mono_us);
+        g_stats.error_ms = (int32_t)err;
+        if (llabs(err) > llabs(g_stats.error_max_ms)) g_stats.error_max_ms = (int32_t)err;
+
+        // Rate over a long enough span that the tick window hardly counts
+        uint64_t span = mono_us - g_anchor_mono;
+        if (span >= (uint64_t)g_cfg.drift_min_ms * 1000ULL)
+        {
+            double rate = ((double)(wall_ms - g_anchor_wall) * 1000.0 - (double)span) / (double)span;
+            if (fabs(rate) * 1e6 <= g_cfg.max_ppm)
+            {
+                g_rate = g_stats.rate_samples ? (g_rate + rate) / 2 : rate;
+                g_stats.rate_samples++;
+            }
+            else
+                VST_LOG("⚠️ timesync: %.0f ppm ignored (clock set by hand?)\n", rate * 1e6);
+            g_anchor_wall = wall_ms;
+            g_anchor_mono = mono_us;
+        }
+    }
+    g_base_wall = wall_ms;
+    g_base_mono = mono_us;
+    g_valid = true;
+    g_stats.ppm = (float)(g_rate * 1e6);
+    g_stats.window_ms = window_ms;
+    if (window_ms > g_stats.window_max_ms) g_stats.window_max_ms = window_ms;
+    m_unlock();
+
+    correct_clock();
+}
+
+/* =========================================================
+   EDGE SEARCH
+   ========================================================= */
+// One +CCLK? exchange: the second it reads, and when it was sent and
+// answered. 0 = no (plausible) answer.
+static uint32_t poll(uint64_t *sent, uint64_t *answered)
+{
+    char v[40];
+    at_lock();
+    *sent = timesync_mono_us();
+    bool ok = at_cmd(TS_AT_MS, "+CCLK?") == AtResult::OK && at_find("+CCLK: ", v, sizeof(v));
+    *answered = timesync_mono_us();
+    at_unlock();
+    g_polls++;
+    g_stats.polls++;
+    return ok ? modemlink_parse_cclk(v) : 0;
+}
+
+static uint32_t give_up(const char *why)
+{
+    g_stats.failed++;
+    g_phase = Phase::IDLE;
+    VST_LOG("⚠️ timesync: %s after %u polls, next try in %lu s\n", why, (unsigned)g_polls,
+            (unsigned long)(g_cfg.resync_ms / 1000));
+    return TS_IDLE_MS;
+}
+
+// The second changed from g_prev_s to s between the command sent at
+// g_prev_sent and the answer at answered
+static uint32_t tick_found(uint32_t s, uint64_t answered)
+{
+    uint64_t mid = g_prev_sent + (answered - g_prev_sent) / 2;
+    uint16_t window = (uint16_t)((answered - g_prev_sent) / 2000);
+    timesync_sample((int64_t)s * 1000, mid, window);
+    g_stats.syncs++;
+    g_phase = Phase::IDLE;
+    VST_LOG("🕒 timesync: tick +/-%u ms after %u polls, error %ld ms, clock %ld ms, %.2f ppm\n",
+            (unsigned)window, (unsigned)g_polls, (long)g_stats.error_ms,
+            (long)g_stats.clock_error_ms, (double)g_stats.ppm);
+    return TS_IDLE_MS;
+}
+
+static uint32_t step_coarse()
+{
+    uint64_t sent, answered;
+    uint32_t s = poll(&sent, &answered);
+    if (!s) return give_up("no time from the modem");
+
+    if (g_prev_s && s == g_prev_s + 1)
+    {
+        // Tight enough already (the tick fell between two quick polls)?
+        if (answered - g_prev_sent <= 3 * (answered - sent)) return tick_found(s, answered);
+        // The next tick is one second after this one: start just before
+        g_fine_at = g_prev_sent + 1000000ULL - (uint64_t)g_cfg.guard_ms * 1000ULL;
+        g_phase = Phase::FINE;
+        g_prev_s = s;
+        g_prev_sent = sent;
+        uint64_t now = timesync_mono_us();
+        return g_fine_at > now ? (uint32_t)((g_fine_at - now) / 1000) : 0;
+    }
+    if (g_polls >= g_cfg.max_polls) return give_up("no tick");
+    g_prev_s = s;           // first answer, or a gap (the modem was busy): look again
+    g_prev_sent = sent;
+    return g_cfg.coarse_ms;
+}
+
+static uint32_t step_fine()
+{
+    uint64_t now = timesync_mono_us();
+    if (now < g_fine_at) return (uint32_t)((g_fine_at - now) / 1000);
+
+    uint64_t sent, answered;
+    uint32_t s = poll(&sent, &answered);
+    if (!s) return give_up("no time from the modem");
+    if (s == g_prev_s + 1) return tick_found(s, answered);
+    if (s != g_prev_s)
+    {
+        // Missed it (the uploader held the modem): one more coarse round
+        g_phase = Phase::COARSE;
+        g_prev_s = s;
+        g_prev_sent = sent;
+        return g_cfg.coarse_ms;
+    }
+    if (g_polls >= g_cfg.max_polls) return give_up("no tick");
+    g_prev_sent = sent;
+    return 0;               // back to back
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+TimeSyncConfig timesync_default_config()
+{
+    TimeSyncConfig c{};
+    c.resync_ms = TIME_RESYNC_MS;
+    c.coarse_ms = TIME_COARSE_MS;
+    c.guard_ms = TIME_GUARD_MS;
+    c.max_polls = TIME_MAX_POLLS;
+    c.drift_min_ms = TIME_DRIFT_MIN_MS;
+    c.max_ppm = TIME_MAX_PPM;
+    c.step_ms = TIME_STEP_MS;
+    c.trim_ms = TIME_TRIM_MS;
+    return c;
+}
+
+void timesync_init(const TimeSyncConfig &cfg, const TimeSyncHooks &hooks)
+{
+#if defined(ARDUINO)
+    if (!g_mux) g_mux = xSemaphoreCreateMutex();
+#endif
+    g_cfg = cfg;
+    if (!g_cfg.coarse_ms) g_cfg.coarse_ms = 100;
+    if (!g_cfg.max_polls) g_cfg.max_polls = 60;
+    g_hooks = hooks;
+#if defined(ARDUINO)
+    if (!g_hooks.clock_ms) g_hooks.clock_ms = sys_clock_ms;
+    if (!g_hooks.clock_step) g_hooks.clock_step = sys_clock_step;
+    if (!g_hooks.clock_slew) g_hooks.clock_slew = sys_clock_slew;
+#endif
+    memset(&g_stats, 0, sizeof(g_stats));
+    m_lock();
+    g_valid = false;
+    g_rate = 0.0;
+    g_last_wall = 0;
+    g_last_mono = 0;
+    m_unlock();
+    g_phase = Phase::IDLE;
+    g_due = true;
+    g_sync_at = g_trim_at = timesync_mono_us();
+}
+
+void timesync_request()
+{
+    g_due = true;
+}
+
+uint32_t timesync_step(bool modem_ok)
+{
+    uint64_t now = timesync_mono_us();
+
+    if (g_phase == Phase::IDLE)
+    {
+        // Predicted drift slewed in while there is no new sample
+        if (g_valid && g_stats.rate_samples && g_cfg.trim_ms &&
+            now - g_trim_at >= (uint64_t)g_cfg.trim_ms * 1000ULL)
+            correct_clock();
+
+        if (now - g_sync_at >= (uint64_t)g_cfg.resync_ms * 1000ULL) g_due = true;
+        if (!g_due || !modem_ok)
+        {
+            uint64_t left = g_due ? 0 : (uint64_t)g_cfg.resync_ms * 1000ULL - (now - g_sync_at);
+            return left && left < TS_IDLE_MS * 1000ULL ? (uint32_t)(left / 1000) : TS_IDLE_MS;
+        }
+        g_due = false;
+        g_sync_at = now;
+        g_phase = Phase::COARSE;
+        g_prev_s = 0;
+        g_polls = 0;
+    }
+    if (!modem_ok)
+    {
+        // The modem went to sleep mid-search: again on the next wake
+        g_phase = Phase::IDLE;
+        g_due = true;
+        return TS_IDLE_MS;
+    }
+    return g_phase == Phase::COARSE ? step_coarse() : step_fine();
+}
+
+const TimeSyncStats &timesync_stats()
+{
+    return g_stats;
+}
+
+void timesync_log_stats()
+{
+    VST_LOG("📊 timesync: syncs=%lu failed=%lu polls=%lu window=+/-%u ms (max %u) "
+            "error=%ld ms (max %ld) clock=%ld ms steps=%lu slews=%lu drift=%.2f ppm (%lu)\n",
+            (unsigned long)g_stats.syncs, (unsigned long)g_stats.failed, (unsigned long)g_stats.polls,
+            (unsigned)g_stats.window_ms, (unsigned)g_stats.window_max_ms,
+            (long)g_stats.error_ms, (long)g_stats.error_max_ms, (long)g_stats.clock_error_ms,
+            (unsigned long)g_stats.steps, (unsigned long)g_stats.slews,
+            (double)g_stats.ppm, (unsigned long)g_stats.rate_samples);
+}
@@ -0,0 +1,80 @@
+// src/timesync.h — network time resync, drift estimate, capture timestamps
+//
+// Times the +CCLK? second tick to about one command round trip, models
+// the ESP32 clock rate against it and steps or slews the system clock.
+// Method and measurements: README 6.1.
+#pragma once
+#include <stdint.h>
+
+struct TimeSyncConfig
+{
+    uint32_t resync_ms;     // between +CCLK? edge searches
+    uint32_t coarse_ms;     // +CCLK? interval until the first tick is seen
+    uint32_t guard_ms;      // back to back polls start this long before the next tick
+    uint8_t  max_polls;     // give up (until the next resync) after this many
+    uint32_t drift_min_ms;  // samples at least this far apart give a rate
+    uint16_t max_ppm;       // larger rate estimates are ignored (clock stepped by hand?)
+    uint32_t step_ms;       // system clock errors above this are stepped, not slewed
+    uint32_t trim_ms;       // predicted drift slewed in this often, 0 = only on resync
+};
+
+// nullptr clock hooks: the system clock on the ESP32 (gettimeofday /
+// settimeofday / adjtime), left alone on the host
+struct TimeSyncHooks
+{
+    uint64_t (*mono_us)();              // nullptr = esp_timer / CLOCK_MONOTONIC
+    int64_t  (*clock_ms)();             // system clock now, UTC ms
+    void     (*clock_step)(int64_t ms); // settimeofday()
+    void     (*clock_slew)(int32_t ms); // adjtime(); nullptr = step
+};
+
+struct TimeSyncStats
+{
+    uint32_t syncs;             // edge searches that found a tick
+    uint32_t failed;            // searches given up (no answer, no tick within max_polls)
+    uint32_t polls;             // +CCLK? commands, all searches
+    uint32_t steps;             // system clock stepped
+    uint32_t slews;             // adjtime() calls, resync and trim
+    uint16_t window_ms;         // last sample: uncertainty of the tick (+/-)
+    uint16_t window_max_ms;
+    int32_t  error_ms;          // last sample against the model before it (0 on the first)
+    int32_t  error_max_ms;      // largest |error_ms|
+    int32_t  clock_error_ms;    // last sample against the system clock
+    float    ppm;               // oscillator rate against the network, + = ours is slow
+    uint32_t rate_samples;      // samples that went into ppm
+};
+
+TimeSyncConfig timesync_default_config();
+
+// Before the modem task starts; hooks are copied
+void timesync_init(const TimeSyncConfig &cfg, const TimeSyncHooks &hooks);
+
+// The modem task, with the modem awake: runs the edge search when a
+// resync is due (takes at_lock() per command) and the drift trim.
+// Returns the delay (ms) before the next call is useful. modem_ok = false
+// (asleep, not READY) only trims.
+uint32_t timesync_step(bool modem_ok);
+
+// Resync on the next timesync_step() (first network time of the boot)
+void timesync_request();
+
+// One reference: the network clock read wall_ms at mono_us (+/- window_ms).
+// timesync_step() feeds its edges here; exposed for other time sources.
+void timesync_sample(int64_t wall_ms, uint64_t mono_us, uint16_t window_ms);
+
+// True once a sample was taken
+bool timesync_valid();
+
+// esp_timer / CLOCK_MONOTONIC now, microseconds
+uint64_t timesync_mono_us();
+
+// UTC milliseconds at mono_us through the model; 0 before the first
+// sample. A later mono_us never gets an earlier time than one returned
+// before, even when a resync moved the model back.
+int64_t timesync_wall_ms(uint64_t mono_us);
+
+// Same for now
+int64_t timesync_now_ms();
+
+const TimeSyncStats &timesync_stats();
+void timesync_log_stats();
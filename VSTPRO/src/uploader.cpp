@@ -0,0 +1,1417 @@
+// src/uploader.cpp — background frame upload (see uploader.h)
+
+#include "uploader.h"
+#include "crc32.h"
+#include "jpegthumb.h"
+#include "modem_at.h"
+#include "modempower.h"
+#include "mqttlink.h"
+#include "sdlayout.h"
+#include "segstore.h"
+#include "simnet.h"
+#include "upsync.h"
+#include "vstlog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// Cursor slot: u32 magic 'VUP3'  u32 counter  i32 day  u32 rec
+//              u32 frame_id  u32 blocks  u32 req_off  i32 lead_day[0]
+//              u32 lead_rec[0]  u32 flags  i32 lead_day[1]  u32 lead_rec[1]
+//              u32 reserved  u32 crc (bytes 0..51)
+// With the velutina lead only: 48 B slots, magic 'VUP2', crc at 44.
+// Before the lead: 32 B slots, magic 'VUPC', crc at 28.
+static constexpr uint32_t UP_CURSOR_MAGIC = 0x33505556; // "VUP3"
+static constexpr size_t   UP_CURSOR_SLOT  = 56;
+static constexpr uint32_t UP_CURSOR_MAGIC_V2 = 0x32505556; // "VUP2"
+static constexpr size_t   UP_CURSOR_SLOT_V2  = 48;
+static constexpr uint32_t UP_CURSOR_MAGIC_V1 = 0x43505556; // "VUPC"
+static constexpr size_t   UP_CURSOR_SLOT_V1  = 32;
+static constexpr uint32_t UP_CURSOR_F_LEAD = 0x03;      // saved blocks are lead n-1's frame
+static constexpr uint8_t  UP_LEADS = UP_TIERS - 1;      // tiers with a lead, the last is the cursor's
+static constexpr uint32_t UP_SCAN_PER_STEP = 64;        // index records looked at per step
+static constexpr uint8_t  UP_REQ_MAX      = 8;          // requests queued from one read
+static constexpr uint32_t UP_REQ_READ     = 1024;       // requests.txt bytes per read
+static const char         UP_DAYS_HEADER[] =
+    "day,thumbs,thumb_bytes,fulls,full_bytes,requested,full_equiv_bytes,modem_bytes\n";
+
+struct Cursor
+{
+    int32_t  day;           // -1 = not started
+    uint32_t rec;           // next record in the day file
+    uint32_t frame_id;      // frame the saved blocks belong to
+    uint32_t blocks;        // blocks of it the server has
+    uint32_t req_off;       // requests.txt bytes already served
+    int32_t  lead_day[UP_LEADS];    // frames of tier t before here are sent
+    uint32_t lead_rec[UP_LEADS];
+    uint8_t  lead_blocks;   // frame_id / blocks belong to lead n-1, 0 = the cursor
+};
+
+// What the data plan lets a frame send
+enum class UpMode : uint8_t
+{
+    FULL,       // as the policy wants (thumbnail and / or full frame)
+    THUMB,      // thumbnail only
+    META,       // nothing: the index, CSV and telemetry have its detections
+};
+
+// A full frame the server asked for
+struct Request
+{
+    uint32_t epoch;
+    uint32_t frame_id;
+    uint32_t end;           // requests.txt offset after its line, 0 = not from there
+};
+
+// The frame being uploaded
+struct Job
+{
+    bool      active = false;
+    IdxRecord rec = {};
+    int       fd = -1;
+    uint32_t  off = 0;
+    uint32_t  len = 0;
+    uint32_t  blocks = 0;   // total
+    uint32_t  next = 0;     // next block to send
+    uint32_t  t0_ms = 0;
+    bool      requested = false;    // server asked: cursor untouched
+    bool      thumb_done = false;
+    uint8_t   lead = 0;             // found by lead n-1, 0 = by the cursor
+    uint8_t   tier = 0;
+    UpMode    mode = UpMode::FULL;
+    char      blob[64] = {0};
+};
+
+static char      g_root[32] = {0};
+static UpConfig  g_cfg = {};
+static Cursor    g_cur = { -1, 0, 0, 0, 0, { -1, -1 }, { 0, 0 }, 0 };
+static Cursor    g_cur_saved = { -1, 0, 0, 0, 0, { -1, -1 }, { 0, 0 }, 0 };  // as on the card
+static uint32_t  g_mq_seq = 0;      // last MQTT thumbnail not known confirmed
+static Job       g_job;
+static int       g_cur_fd = -1;
+static uint32_t  g_cur_counter = 0;
+static uint8_t  *g_block = nullptr;
+static bool      g_online = false;
+static bool      g_container_ok = false;
+static uint32_t  g_backoff_ms = 0;
+static uint32_t  g_retry_at = 0;
+static UpStats   g_stats = {};
+static Request   g_req[UP_REQ_MAX];
+static uint8_t   g_req_count = 0;
+static uint8_t   g_req_head = 0;
+static uint32_t  g_req_poll_at = 0;
+static UpDay     g_day = { -1, 0, 0, 0, 0, 0, 0, 0 };
+static int       g_day_fd = -1;
+static off_t     g_day_off = 0;     // where today's line starts
+static uint64_t  g_wire_mark = 0;
+static uint64_t  g_month_used = 0;  // modem bytes of the month before today
+static UpMode    g_tier_mode[UP_TIERS] = {};
+static uint32_t  g_sync_at = 0;     // next backlog check / retry
+static bool      g_scan_more = false;   // step ran out of records to look at, not of frames
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* =========================================================
+   CURSOR
+   ========================================================= */
+static bool cursor_open()
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/up", g_root);
+    if (mkdir(path, 0775) != 0 && errno != EEXIST) return false;
+
+    snprintf(path, sizeof(path), "%s/up/CURSOR.VUC", g_root);
+    g_cur_fd = open(path, O_RDWR | O_CREAT, 0664);
+    if (g_cur_fd < 0) return false;
+
+    // Newest valid slot wins; a lead an older cursor did not have starts
+    // where the cursor is
+    static const uint32_t magic[3] = { UP_CURSOR_MAGIC, UP_CURSOR_MAGIC_V2, UP_CURSOR_MAGIC_V1 };
+    static const size_t   slots[3] = { UP_CURSOR_SLOT, UP_CURSOR_SLOT_V2, UP_CURSOR_SLOT_V1 };
+    uint8_t b[UP_CURSOR_SLOT * 2];
+    ssize_t n = pread(g_cur_fd, b, sizeof(b), 0);
+    bool found = false;
+    for (int v = 0; v < 3 && !found; v++)
+    {
+        size_t slot = slots[v];
+        size_t crc_at = slot - 4;
+        for (int i = 0; i < 2 && n >= (ssize_t)(slot * (i + 1)); i++)
+        {
+            const uint8_t *s = b + i * slot;
+            if (get_u32(s) != magic[v] || get_u32(s + crc_at) != crc32_update(0, s, crc_at))
+                continue;
+            uint32_t counter = get_u32(s + 4);
+            if (found && counter < g_cur_counter) continue;
+
+            found = true;
+            g_cur_counter = counter;
+            g_cur.day = (int32_t)get_u32(s + 8);
+            g_cur.rec = get_u32(s + 12);
+            g_cur.frame_id = get_u32(s + 16);
+            g_cur.blocks = get_u32(s + 20);
+            g_cur.req_off = get_u32(s + 24);
+            for (uint8_t t = 0; t < UP_LEADS; t++)
+            {
+                bool had = (t == 0 && v < 2) || v == 0;
+                g_cur.lead_day[t] = had ? (int32_t)get_u32(s + (t ? 40 : 28)) : g_cur.day;
+                g_cur.lead_rec[t] = had ? get_u32(s + (t ? 44 : 32)) : g_cur.rec;
+            }
+            g_cur.lead_blocks = v < 2 ? (uint8_t)(get_u32(s + 36) & UP_CURSOR_F_LEAD) : 0;
+        }
+    }
+    g_cur_saved = g_cur;
+    return true;
+}
+
+static bool mq_settle(bool flush);
+
+static void cursor_save()
+{
+    if (g_cur_fd < 0) return;
+    if (g_mq_seq)
+    {
+        // MQTT thumbnails in flight: moving past them waits for the broker,
+        // block progress of a full frame does not
+        if (!g_cur.blocks) return;
+        if (!mq_settle(true)) return;
+    }
+
+    uint8_t s[UP_CURSOR_SLOT] = {0};
+    g_cur_counter++;
+    put_u32(s + 0, UP_CURSOR_MAGIC);
+    put_u32(s + 4, g_cur_counter);
+    put_u32(s + 8, (uint32_t)g_cur.day);
+    put_u32(s + 12, g_cur.rec);
+    put_u32(s + 16, g_cur.frame_id);
+    put_u32(s + 20, g_cur.blocks);
+    put_u32(s + 24, g_cur.req_off);
+    put_u32(s + 28, (uint32_t)g_cur.lead_day[0]);
+    put_u32(s + 32, g_cur.lead_rec[0]);
+    put_u32(s + 36, g_cur.lead_blocks & UP_CURSOR_F_LEAD);
+    put_u32(s + 40, (uint32_t)g_cur.lead_day[1]);
+    put_u32(s + 44, g_cur.lead_rec[1]);
+    put_u32(s + 52, crc32_update(0, s, 52));
+
+    off_t at = (off_t)(g_cur_counter & 1) * UP_CURSOR_SLOT;
+    if (pwrite(g_cur_fd, s, sizeof(s), at) == (ssize_t)sizeof(s))
+        fsync(g_cur_fd);
+    g_cur_saved = g_cur;
+}
+
+/* =========================================================
+   FRAME SOURCE
+   ========================================================= */
+void uploader_blob_name(const IdxRecord &rec, char *out, size_t out_sz, bool thumb)
+{
+    time_t t = (time_t)rec.epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(out, out_sz, "%s/%04d%02d%02d/%02d%02d%02d_%06lu%s.jpg",
+             g_cfg.device_id,
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned long)rec.frame_id, thumb ? "_t" : "");
+}
+
+// Saved before network time: the file kept its undated name
+static void per_file_path(const IdxRecord &rec, char *out, size_t out_sz)
+{
+    sdlayout_frame_name(g_root, g_cfg.layout, (time_t)rec.epoch, !(rec.flags & IDX_F_REBASED),
+                        rec.boot, rec.frame_id, out, out_sz);
+}
+
+bool uploader_open_frame(const IdxRecord &rec, int *fd, uint32_t *off, uint32_t *len)
+{
+    char path[96];
+    if (rec.seq)
+        segstore_path((rec.flags & IDX_F_EMPTY_STREAM) ? SEG_STREAM_EMPTY : SEG_STREAM_DETECT,
+                      rec.seq, path, sizeof(path));
+    else
+        per_file_path(rec, path, sizeof(path));
+
+    *fd = open(path, O_RDONLY);
+    if (*fd < 0) return false;
+
+    bool ok;
+    if (rec.seq)
+    {
+        uint32_t frame_id = 0;
+        ok = segstore_locate_jpeg(*fd, rec.offset, &frame_id, off, len) &&
+             frame_id == rec.frame_id && *len > 0;
+    }
+    else
+    {
+        struct stat st;
+        ok = fstat(*fd, &st) == 0 && st.st_size > 0;
+        *off = 0;
+        *len = ok ? (uint32_t)st.st_size : 0;
+    }
+
+    if (!ok)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+    return ok;
+}
+
+static void job_close()
+{
+    if (g_job.fd >= 0) close(g_job.fd);
+    g_job.fd = -1;
+    g_job.active = false;
+}
+
+// Image priority: 0 Vespa velutina, 1 Vespa crabro, 2 the rest (Apis,
+// empty). Model targets as in UP_FULL_MIN_SCORE.
+static uint8_t tier_of(const IdxRecord &rec)
+{
+    if (rec.score[3]) return 0;
+    if (rec.score[1]) return 1;
+    return 2;
+}
+
+static UpMode budget_mode(uint8_t tier);
+static UpMode budget_level(uint8_t tier, uint32_t extra);
+
+// Moves the cursor past the current record (frame done or skipped).
+static void advance(bool save)
+{
+    g_cur.rec++;
+    if (!g_cur.lead_blocks)
+    {
+        g_cur.frame_id = 0;
+        g_cur.blocks = 0;
+    }
+    if (save) cursor_save();
+}
+
+// Same for the lead of tier t
+static void lead_advance(uint8_t t, bool save)
+{
+    g_cur.lead_rec[t]++;
+    if (g_cur.lead_blocks == t + 1)
+    {
+        g_cur.frame_id = 0;
+        g_cur.blocks = 0;
+        g_cur.lead_blocks = 0;
+    }
+    if (save) cursor_save();
+}
+
+static bool before_lead(uint8_t t, int32_t day, uint32_t rec)
+{
+    return day < g_cur.lead_day[t] || (day == g_cur.lead_day[t] && rec < g_cur.lead_rec[t]);
+}
+
+// Opens rec as the job: 1 = opened, 0 = not on the card yet (try again
+// later), -1 = gone or unusable (skip it).
+static int open_job(const IdxRecord &rec, uint8_t lead, UpMode mode)
+{
+    Job &j = g_job;
+    j = Job{};
+    j.rec = rec;
+    if (!uploader_open_frame(rec, &j.fd, &j.off, &j.len))
+    {
+        SegStream stream = (rec.flags & IDX_F_EMPTY_STREAM) ? SEG_STREAM_EMPTY : SEG_STREAM_DETECT;
+        if (rec.seq && rec.seq == segstore_open_seq(stream))
+            return 0;               // still staged in the writer
+
+        g_stats.skipped++;          // evicted by retention, or damaged
+        return -1;
+    }
+
+    j.blocks = (j.len + g_cfg.block_bytes - 1) / g_cfg.block_bytes;
+    if (j.blocks > AZ_MAX_BLOCKS)
+    {
+        VST_LOG("⚠️ uploader: frame %lu too large (%lu B), skipped\n",
+                (unsigned long)rec.frame_id, (unsigned long)j.len);
+        job_close();
+        g_stats.skipped++;
+        return -1;
+    }
+
+    // A full frame that would take its tier past the full share: the
+    // thumbnail instead
+    if (mode == UpMode::FULL && (g_cfg.budget_month || g_cfg.budget_day) &&
+        budget_level(tier_of(rec), j.len) != UpMode::FULL)
+        mode = UpMode::THUMB;
+
+    // Same frame as the saved blocks: carry on where the cursor stopped
+    if (g_cur.lead_blocks == lead && g_cur.frame_id == rec.frame_id && g_cur.blocks &&
+        g_cur.blocks <= j.blocks)
+    {
+        j.next = g_cur.blocks;
+        g_stats.resumed++;
+        g_stats.resumed_blocks += j.next;
+        VST_LOG("⏯ uploader: resuming frame %lu at block %lu/%lu\n",
+                (unsigned long)rec.frame_id, (unsigned long)j.next, (unsigned long)j.blocks);
+    }
+    else
+    {
+        g_cur.frame_id = rec.frame_id;
+        g_cur.blocks = 0;
+        g_cur.lead_blocks = lead;
+    }
+
+    uploader_blob_name(rec, j.blob, sizeof(j.blob));
+    j.t0_ms = mono_ms();
+    j.lead = lead;
+    j.tier = tier_of(rec);
+    j.mode = mode;
+    j.active = true;
+    return 1;
+}
+
+// Finds the next frame to upload and opens it. False when there is nothing
+// (yet): end of the index, or the record's data is not on the card yet.
+static bool next_job()
+{
+    if (g_cur.day < 0)
+    {
+        g_cur.day = frameindex_first_day();
+        g_cur.rec = 0;
+        if (g_cur.day < 0) return false;
+    }
+
+    bool moved = false;
+    uint32_t scanned = 0;
+    for (; scanned < UP_SCAN_PER_STEP; scanned++)
+    {
+        IdxRecord rec;
+        if (g_cur.rec >= frameindex_count(g_cur.day))
+        {
+            int32_t last = frameindex_last_day();
+            if (g_cur.day >= last) break;
+            g_cur.day++;
+            g_cur.rec = 0;
+            moved = true;
+            continue;
+        }
+
+        if (!frameindex_read(g_cur.day, g_cur.rec, rec))
+        {
+            g_stats.skipped++;      // bad CRC: recovery will drop it
+            advance(false);
+            moved = true;
+            continue;
+        }
+
+        // Deleted by retention, or empty and not wanted
+        if ((rec.flags & IDX_F_EVICTED) ||
+            (!g_cfg.upload_empty && rec.box_count == 0 && !(rec.flags & IDX_F_TRIGGER)))
+        {
+            g_stats.skipped++;
+            advance(false);
+            moved = true;
+            continue;
+        }
+
+        // On the server already (delta sync)
+        if (upsync_covers(g_cur.day, g_cur.rec) && !upsync_missing(rec))
+        {
+            g_stats.synced++;
+            advance(false);
+            moved = true;
+            continue;
+        }
+
+        // Frames the lead of their tier has passed are done
+        uint8_t tier = tier_of(rec);
+        if (g_cfg.velutina_first && tier < UP_LEADS && before_lead(tier, g_cur.day, g_cur.rec))
+        {
+            advance(false);
+            moved = true;
+            continue;
+        }
+
+        UpMode mode = budget_mode(tier);
+        if (mode == UpMode::META)
+        {
+            g_stats.tier_meta[tier]++;
+            g_stats.budget_cut++;
+            advance(false);
+            moved = true;
+            continue;
+        }
+
+        int r = open_job(rec, 0, mode);
+        if (r == 0) break;
+        if (r < 0)
+        {
+            advance(false);
+            moved = true;
+            continue;
+        }
+        if (moved) cursor_save();
+        return g_job.active;    // false if that found lost MQTT thumbnails
+    }
+
+    if (scanned >= UP_SCAN_PER_STEP) g_scan_more = true;
+    if (moved) cursor_save();
+    return false;
+}
+
+// velutina_first: the lead of tier t walks the index from the cursor on
+// and takes only frames of that tier, so velutina and then crabro frames
+// go out before the backlog in front of them; the cursor then passes over
+// them.
+static bool lead_job(uint8_t t)
+{
+    if (!g_cfg.velutina_first) return false;
+    if (g_cur.day < 0)
+    {
+        g_cur.day = frameindex_first_day();
+        g_cur.rec = 0;
+        if (g_cur.day < 0) return false;
+    }
+    int32_t &day = g_cur.lead_day[t];
+    uint32_t &at = g_cur.lead_rec[t];
+    if (day < g_cur.day || (day == g_cur.day && at < g_cur.rec))
+    {
+        day = g_cur.day;
+        at = g_cur.rec;
+    }
+
+    bool moved = false;
+    uint32_t scanned = 0;
+    for (; scanned < UP_SCAN_PER_STEP; scanned++)
+    {
+        IdxRecord rec;
+        if (at >= frameindex_count(day))
+        {
+            if (day >= frameindex_last_day()) break;
+            day++;
+            at = 0;
+            moved = true;
+            continue;
+        }
+
+        // Another tier, unreadable, evicted or on the server: left to the cursor
+        if (!frameindex_read(day, at, rec) || tier_of(rec) != t || (rec.flags & IDX_F_EVICTED) ||
+            (upsync_covers(day, at) && !upsync_missing(rec)))
+        {
+            lead_advance(t, false);
+            moved = true;
+            continue;
+        }
+
+        UpMode mode = budget_mode(t);
+        if (mode == UpMode::META)
+        {
+            g_stats.tier_meta[t]++;
+            g_stats.budget_cut++;
+            lead_advance(t, false);
+            moved = true;
+            continue;
+        }
+
+        int r = open_job(rec, t + 1, mode);
+        if (r == 0) break;
+        if (r < 0)
+        {
+            lead_advance(t, false);
+            moved = true;
+            continue;
+        }
+        if (moved) cursor_save();
+        return g_job.active;
+    }
+
+    if (scanned >= UP_SCAN_PER_STEP) g_scan_more = true;
+    if (moved) cursor_save();
+    return false;
+}
+
+/* =========================================================
+   DAILY BYTES
+   ========================================================= */
+static uint32_t g_day_len = 0;      // length of today's line in the file
+
+static int64_t days_from_civil(int y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int *y, unsigned *m, unsigned *d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+// Day number of the 1st of the month of day
+static int32_t month_first(int32_t day)
+{
+    int y;
+    unsigned m, d;
+    civil_from_days(day, &y, &m, &d);
+    return day - (int32_t)(d - 1);
+}
+
+// Modem bytes of the earlier days of this month, from DAYS.CSV
+static void month_load(int32_t today)
+{
+    g_month_used = 0;
+    char path[64];
+    snprintf(path, sizeof(path), "%s/up/DAYS.CSV", g_root);
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    int32_t first = month_first(today);
+    char line[128];
+    while (fgets(line, sizeof(line), f))
+    {
+        long day;
+        unsigned long v[7];
+        if (sscanf(line, "%ld,%lu,%lu,%lu,%lu,%lu,%lu,%lu", &day,
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) == 8 &&
+            day >= first && day < today)
+            g_month_used += v[6];
+    }
+    fclose(f);
+}
+
+static void day_write()
+{
+    if (g_day_fd < 0) return;
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%ld,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                     (long)g_day.day, (unsigned long)g_day.thumbs, (unsigned long)g_day.thumb_bytes,
+                     (unsigned long)g_day.fulls, (unsigned long)g_day.full_bytes,
+                     (unsigned long)g_day.requested, (unsigned long)g_day.full_equiv,
+                     (unsigned long)g_day.wire_bytes);
+    if (pwrite(g_day_fd, line, (size_t)n, g_day_off) == n && (uint32_t)n < g_day_len)
+        (void)!ftruncate(g_day_fd, g_day_off + n);
+    g_day_len = (uint32_t)n;
+}
+
+// Today's line carries on after a reboot; older days stay as they are
+static void day_read()
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/up/DAYS.CSV", g_root);
+    if (g_day_fd >= 0) close(g_day_fd);
+    g_day_fd = open(path, O_RDWR | O_CREAT, 0664);
+    g_day = UpDay{ -1, 0, 0, 0, 0, 0, 0, 0 };
+    g_day_len = 0;
+    if (g_day_fd < 0) return;
+
+    off_t size = lseek(g_day_fd, 0, SEEK_END);
+    if (size <= 0)
+    {
+        (void)!write(g_day_fd, UP_DAYS_HEADER, sizeof(UP_DAYS_HEADER) - 1);
+        g_day_off = (off_t)sizeof(UP_DAYS_HEADER) - 1;
+        return;
+    }
+    g_day_off = size;
+
+    char tail[128];
+    off_t at = size > (off_t)sizeof(tail) - 1 ? size - (off_t)sizeof(tail) + 1 : 0;
+    ssize_t n = pread(g_day_fd, tail, sizeof(tail) - 1, at);
+    if (n <= 1 || tail[n - 1] != '\n') return;
+    tail[n - 1] = 0;
+    char *line = strrchr(tail, '\n');
+    line = line ? line + 1 : tail;
+
+    long day;
+    unsigned long v[7];
+    if (sscanf(line, "%ld,%lu,%lu,%lu,%lu,%lu,%lu,%lu", &day,
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 8 ||
+        day != (long)(time(nullptr) / 86400))
+        return;
+
+    g_day = UpDay{ (int32_t)day, (uint32_t)v[0], (uint32_t)v[1], (uint32_t)v[2], (uint32_t)v[3],
+                   (uint32_t)v[4], (uint32_t)v[5], (uint32_t)v[6] };
+    g_day_off = at + (line - tail);
+    g_day_len = (uint32_t)(n - (line - tail));
+}
+
+static void day_open()
+{
+    day_read();
+    month_load((int32_t)(time(nullptr) / 86400));
+}
+
+static void day_roll(int32_t today)
+{
+    if (today == g_day.day) return;
+    if (g_day.day >= 0) g_day_off += g_day_len;
+    if (g_day.day >= 0 && month_first(g_day.day) == month_first(today))
+        g_month_used += g_day.wire_bytes;
+    else
+        month_load(today);  // new month, or the clock was set since
+    g_day = UpDay{ today, 0, 0, 0, 0, 0, 0, 0 };
+    g_day_len = 0;
+}
+
+static void account(uint32_t thumb_bytes, uint32_t full_bytes, uint32_t full_equiv, bool requested)
+{
+    day_roll((int32_t)(time(nullptr) / 86400));
+
+    const AtStats &a = at_stats();
+    g_day.wire_bytes += (uint32_t)(a.tx_bytes + a.rx_bytes - g_wire_mark);
+    g_wire_mark = a.tx_bytes + a.rx_bytes;
+
+    g_day.thumbs += thumb_bytes ? 1 : 0;
+    g_day.thumb_bytes += thumb_bytes;
+    g_day.fulls += full_bytes ? 1 : 0;
+    g_day.full_bytes += full_bytes;
+    g_day.requested += requested ? 1 : 0;
+    g_day.full_equiv += full_equiv;
+    day_write();
+}
+
+/* =========================================================
+   BUDGET
+   ========================================================= */
+static const char *const UP_TIER_NAME[UP_TIERS] = { "velutina", "crabro", "other" };
+static const char *const UP_MODE_NAME[] = { "full", "thumbnails only", "metadata only" };
+
+// Modem bytes today, including what went since the last account()
+static uint32_t used_today()
+{
+    const AtStats &a = at_stats();
+    return g_day.wire_bytes + (uint32_t)(a.tx_bytes + a.rx_bytes - g_wire_mark);
+}
+
+// Today's share: what is left of the month over the days left in it
+// (so a quiet day leaves more for the next), capped at budget_day
+static uint32_t day_share(int32_t today)
+{
+    uint64_t share = UINT32_MAX;
+    if (g_cfg.budget_month)
+    {
+        int y;
+        unsigned m, d;
+        civil_from_days(today, &y, &m, &d);
+        int64_t next = m == 12 ? days_from_civil(y + 1, 1, 1) : days_from_civil(y, m + 1, 1);
+        uint64_t left = g_month_used < g_cfg.budget_month ? g_cfg.budget_month - g_month_used : 0;
+        share = left / (uint64_t)(next - today);
+    }
+    if (g_cfg.budget_day && g_cfg.budget_day < share) share = g_cfg.budget_day;
+    return (uint32_t)share;
+}
+
+// What the plan lets a frame of this tier send with extra more bytes
+static UpMode budget_level(uint8_t tier, uint32_t extra)
+{
+    int32_t today = (int32_t)(time(nullptr) / 86400);
+    day_roll(today);
+
+    uint64_t used = (uint64_t)used_today() + extra;
+    uint32_t share = day_share(today);
+    if (g_cfg.budget_month && g_month_used + used >= g_cfg.budget_month) return UpMode::META;
+    uint64_t pct = share ? used * 100 / share : UINT32_MAX;
+    if (pct < g_cfg.budget_full_pct[tier]) return UpMode::FULL;
+    if (pct < g_cfg.budget_thumb_pct[tier]) return UpMode::THUMB;
+    return UpMode::META;
+}
+
+// Same right now, logged when a tier changes level
+static UpMode budget_mode(uint8_t tier)
+{
+    if (!g_cfg.budget_month && !g_cfg.budget_day) return UpMode::FULL;
+    UpMode m = budget_level(tier, 0);
+    if (m != g_tier_mode[tier])
+    {
+        uint32_t used = used_today();
+        uint32_t share = day_share(g_day.day);
+        VST_LOG("💸 uploader: %s frames %s (%lu of %lu B today, %llu this month)\n",
+                UP_TIER_NAME[tier], UP_MODE_NAME[(int)m], (unsigned long)used, (unsigned long)share,
+                (unsigned long long)(g_month_used + used));
+        g_tier_mode[tier] = m;
+    }
+    return m;
+}
+
+void uploader_budget(uint32_t *share, uint32_t *used)
+{
+    int32_t today = (int32_t)(time(nullptr) / 86400);
+    day_roll(today);
+    *share = g_cfg.budget_month || g_cfg.budget_day ? day_share(today) : 0;
+    *used = used_today();
+}
+
+/* =========================================================
+   THUMBNAILS
+   ========================================================= */
+struct FrameSrc
+{
+    int      fd;
+    uint32_t off;
+    uint32_t left;
+};
+
+static size_t read_frame(void *ctx, uint8_t *buf, size_t len)
+{
+    FrameSrc &s = *(FrameSrc*)ctx;
+    if (len > s.left) len = s.left;
+    ssize_t n = len ? pread(s.fd, buf, len, (off_t)s.off) : 0;
+    if (n <= 0) return 0;
+    s.off += (uint32_t)n;
+    s.left -= (uint32_t)n;
+    return (size_t)n;
+}
+
+static bool wants_full(const IdxRecord &rec)
+{
+    for (uint8_t c = 0; c < IDX_CLASSES; c++)
+        if (rec.score[c] && rec.score[c] >= g_cfg.full_min_score[c]) return true;
+    return false;
+}
+
+// Returns the HTTP status of the Put Blob, -1 on link failure, 0 if the
+// JPEG could not be made into a thumbnail.
+static int send_thumb(const Job &j)
+{
+    uint32_t t0 = mono_ms();
+    FrameSrc src = { j.fd, j.off, j.len };
+    ThumbInfo ti = {};
+    size_t n = 0;
+    if (!jpegthumb_make(ThumbReader{ read_frame, &src }, g_cfg.thumb_side, g_cfg.thumb_quality,
+                        g_block, g_cfg.block_bytes, &n, &ti))
+    {
+        g_stats.thumb_failed++;
+        VST_LOG("⚠️ uploader: no thumbnail for frame %lu\n", (unsigned long)j.rec.frame_id);
+        return 0;
+    }
+
+    char blob[64];
+    uploader_blob_name(j.rec, blob, sizeof(blob), true);
+    int st = 201;
+    if (g_cfg.thumb_mqtt)
+    {
+        uint32_t seq = mqtt_publish(blob, g_block, n);
+        if (!seq) return -1;
+        g_mq_seq = seq;
+    }
+    else
+    {
+        st = azblob_put_blob(blob, g_block, n, "image/jpeg");
+        if (st != 201) return st;
+    }
+
+    g_stats.thumbs++;
+    g_stats.thumb_bytes += n;
+    g_stats.thumbed_bytes += j.len;
+    account((uint32_t)n, 0, j.len, false);
+    VST_LOG("🖼 Thumbnail %s (%ux%u q%u, %u B of %lu, %lu ms)\n", blob, ti.w, ti.h, ti.quality,
+            (unsigned)n, (unsigned long)j.len, (unsigned long)(mono_ms() - t0));
+    return st;
+}
+
+/* =========================================================
+   REQUESTS (full frames the server asked for)
+   ========================================================= */
+// "20260601/120455_001042" anywhere in the line (a full blob or thumbnail
+// name works too). False for anything else.
+static bool parse_request(const char *line, size_t len, Request &r)
+{
+    for (size_t i = 8; i + 8 < len; i++)
+    {
+        if (line[i] != '/') continue;
+        char tmp[40];
+        size_t n = len - (i - 8) < sizeof(tmp) - 1 ? len - (i - 8) : sizeof(tmp) - 1;
+        memcpy(tmp, line + i - 8, n);
+        tmp[n] = 0;
+
+        int y, mo, d, h, mi, sec;
+        unsigned long frame;
+        if (sscanf(tmp, "%4d%2d%2d/%2d%2d%2d_%lu", &y, &mo, &d, &h, &mi, &sec, &frame) != 7) continue;
+        if (y < 2020 || mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60) continue;
+        r.epoch = (uint32_t)(days_from_civil(y, (unsigned)mo, (unsigned)d) * 86400 + h * 3600 + mi * 60 + sec);
+        r.frame_id = (uint32_t)frame;
+        return true;
+    }
+    return false;
+}
+
+static bool request_poll_due()
+{
+    if (!g_cfg.thumb_first || !g_cfg.request_poll_ms || g_req_count) return false;
+    return !g_req_poll_at || (int32_t)(mono_ms() - g_req_poll_at) >= 0;
+}
+
+// Thumbnails published since the saved cursor: true once the broker has
+// them all. If the session dropped first, the cursor goes back to the
+// saved one and they are sent again (the daily counts then include them
+// twice).
+static bool mq_settle(bool flush)
+{
+    if (!g_mq_seq) return true;
+    MqttDelivery d = mqtt_delivery(g_mq_seq);
+    if (d == MqttDelivery::PENDING && flush)
+    {
+        mqtt_flush();
+        d = mqtt_delivery(g_mq_seq);
+    }
+    if (d == MqttDelivery::PENDING) return false;
+    g_mq_seq = 0;
+    if (d == MqttDelivery::CONFIRMED) return true;
+
+    VST_LOG("⚠️ uploader: MQTT thumbnails lost, back to record %lu\n", (unsigned long)g_cur_saved.rec);
+    job_close();
+    uint32_t req_off = g_cur.req_off;
+    g_cur = g_cur_saved;
+    g_cur.req_off = req_off;
+    return false;
+}
+
+// Reads what was appended to requests.txt since the saved offset; whole
+// lines only. Needs the link.
+static void poll_requests()
+{
+    g_req_poll_at = mono_ms() + g_cfg.request_poll_ms;
+    g_stats.request_polls++;
+
+    char blob[48];
+    snprintf(blob, sizeof(blob), "%s/requests.txt", g_cfg.device_id);
+    uint32_t want = g_cfg.block_bytes < UP_REQ_READ ? g_cfg.block_bytes : UP_REQ_READ;
+    size_t n = 0;
+    int st = azblob_get_range(blob, g_cur.req_off, want, g_block, &n);
+    if (st != 206) return;          // 404: none yet, 416: nothing new
+
+    const char *buf = (const char*)g_block;
+    uint32_t at = 0;
+    g_req_head = 0;
+    while (g_req_count < UP_REQ_MAX)
+    {
+        const char *nl = (const char*)memchr(buf + at, '\n', n - at);
+        if (!nl) break;
+        uint32_t end = (uint32_t)(nl - buf) + 1;
+
+        Request r = { 0, 0, g_cur.req_off + end };
+        if (!parse_request(buf + at, end - 1 - at, r) && end - 1 > at)
+            VST_LOG("⚠️ uploader: bad request line '%.*s'\n", (int)(end - 1 - at), buf + at);
+        g_req[g_req_count++] = r;   // epoch 0: only moves the offset
+        at = end;
+    }
+    if (g_req_count)
+        VST_LOG("📥 uploader: %u full frame request(s)\n", g_req_count);
+}
+
+static bool find_visit(const IdxRecord &rec, void *ctx)
+{
+    IdxRecord *want = (IdxRecord*)ctx;
+    if (rec.frame_id != want->frame_id) return true;
+    *want = rec;
+    return false;
+}
+
+static bool find_frame(uint32_t epoch, uint32_t frame_id, IdxRecord &rec)
+{
+    rec = IdxRecord{};
+    rec.frame_id = frame_id;
+    IdxQuery q = { epoch, epoch, -1, 0, 0 };
+    return frameindex_query(q, find_visit, &rec) > 0 && rec.epoch == epoch;
+}
+
+static void request_done()
+{
+    if (g_req[g_req_head].end) g_cur.req_off = g_req[g_req_head].end;
+    g_req_head++;
+    g_req_count--;
+    cursor_save();
+}
+
+bool uploader_request(const char *line)
+{
+    Request r = { 0, 0, 0 };
+    if (!g_root[0] || !parse_request(line, strlen(line), r)) return false;
+    if (!g_req_count) g_req_head = 0;
+    if (g_req_head + g_req_count >= UP_REQ_MAX)
+    {
+        VST_LOG("⚠️ uploader: request queue full, '%s' dropped\n", line);
+        return false;
+    }
+    g_req[g_req_head + g_req_count++] = r;
+    VST_LOG("📥 uploader: full frame %lu requested\n", (unsigned long)r.frame_id);
+    return true;
+}
+
+// Opens the next requested frame as the job; false when none is left, or
+// while the plan has nothing left for velutina frames either.
+static bool start_request()
+{
+    if (g_req_count && budget_mode(0) == UpMode::META) return false;
+    while (g_req_count)
+    {
+        const Request &r = g_req[g_req_head];
+        IdxRecord rec;
+        if (!r.epoch)
+        {
+            request_done();
+            continue;
+        }
+
+        Job &j = g_job;
+        j = Job{};
+        if (find_frame(r.epoch, r.frame_id, rec) && uploader_open_frame(rec, &j.fd, &j.off, &j.len))
+        {
+            j.blocks = (j.len + g_cfg.block_bytes - 1) / g_cfg.block_bytes;
+            if (j.blocks <= AZ_MAX_BLOCKS)
+            {
+                j.rec = rec;
+                j.requested = true;
+                j.thumb_done = true;
+                uploader_blob_name(rec, j.blob, sizeof(j.blob));
+                j.t0_ms = mono_ms();
+                j.active = true;
+                return true;
+            }
+            job_close();
+        }
+
+        VST_LOG("⚠️ uploader: requested frame %lu not on the card\n", (unsigned long)r.frame_id);
+        g_stats.skipped++;
+        request_done();
+    }
+    return false;
+}
+
+/* =========================================================
+   DELTA SYNC
+   ========================================================= */
+// Frames between the cursor and the newest record, counting up to limit
+static uint32_t backlog(uint32_t limit)
+{
+    if (g_cur.day < 0) return frameindex_first_day() < 0 ? 0 : limit;
+    uint32_t n = 0;
+    for (int32_t d = g_cur.day, last = frameindex_last_day(); d <= last && n < limit; d++)
+    {
+        uint32_t c = frameindex_count(d);
+        uint32_t from = d == g_cur.day ? g_cur.rec : 0;
+        if (c > from) n += c - from;
+    }
+    return n;
+}
+
+// Far enough behind, and the stretch ahead not synced yet: one manifest
+// round. Needs the link; leaves the modem's HTTP client disconnected.
+static void sync_check()
+{
+    if (!upsync_enabled() || (g_cur.day >= 0 && upsync_covers(g_cur.day, g_cur.rec))) return;
+    if (g_sync_at && (int32_t)(mono_ms() - g_sync_at) < 0) return;
+    g_sync_at = mono_ms() + 60000;      // backlog counted at most once a minute
+    if (backlog(g_cfg.sync_backlog) < g_cfg.sync_backlog) return;
+
+    if (g_cur.day < 0)
+    {
+        g_cur.day = frameindex_first_day();
+        g_cur.rec = 0;
+    }
+    if (!simnet_up(g_cfg.apn, 60000))
+    {
+        g_sync_at = mono_ms() + g_cfg.sync_retry_ms;
+        return;
+    }
+    g_online = false;                   // the HTTP client moves to the sync host
+    int st = upsync_round(g_cur.day, g_cur.rec);
+    if (st == 200) g_sync_at = 0;       // the next stretch may follow right away
+    else if (st != 0) g_sync_at = mono_ms() + g_cfg.sync_retry_ms;
+}
+
+/* =========================================================
+   STEP
+   ========================================================= */
+// Requests first, then velutina and crabro frames ahead of the cursor,
+// then the cursor's own; a frame with blocks on the server carries on
+// first. A lead that ran out of records to look at holds back the tiers
+// below it until its next step.
+static bool start_job()
+{
+    g_scan_more = false;
+    if (start_request()) return true;
+    sync_check();
+    if (g_cur.blocks)
+    {
+        bool resumed = g_cur.lead_blocks ? lead_job(g_cur.lead_blocks - 1) : next_job();
+        if (resumed || g_scan_more) return resumed;
+    }
+    for (uint8_t t = 0; t < UP_LEADS; t++)
+    {
+        if (lead_job(t)) return true;
+        if (g_scan_more) return false;
+    }
+    return next_job();
+}
+
+// Moves whatever found the job past it (frame done or given up on)
+static void finish(const Job &j)
+{
+    if (j.requested) request_done();
+    else if (j.lead) lead_advance(j.lead - 1, true);
+    else advance(true);
+}
+
+static UpState fail(const char *what, int status)
+{
+    g_stats.failures++;
+    g_backoff_ms = g_backoff_ms ? g_backoff_ms * 2 : g_cfg.retry_ms;
+    if (g_backoff_ms > g_cfg.retry_ms * 16) g_backoff_ms = g_cfg.retry_ms * 16;
+    g_retry_at = mono_ms() + g_backoff_ms;
+
+    if (status < 0) g_online = false;   // link gone: reconnect first
+    VST_LOG("⚠️ uploader: %s failed (%d), retry in %lu ms\n", what, status, (unsigned long)g_backoff_ms);
+    return UpState::BACKOFF;
+}
+
+static bool go_online()
+{
+    if (!simnet_up(g_cfg.apn, 60000) || !azblob_connect()) return false;
+    if (!g_container_ok) g_container_ok = azblob_ensure_container();
+    g_online = g_container_ok;
+    return g_online;
+}
+
+UpState uploader_step()
+{
+    if (!g_root[0] || !g_block) return UpState::IDLE;
+    if (g_retry_at && (int32_t)(mono_ms() - g_retry_at) < 0) return UpState::BACKOFF;
+    g_retry_at = 0;
+
+    // Between frames: anything new in requests.txt?
+    if (!g_job.active && request_poll_due())
+    {
+        if ((!g_online || !simhttp_connected()) && !go_online()) return fail("connect", -1);
+        poll_requests();
+    }
+
+    // MQTT thumbnails confirmed (or lost) since the last step
+    if (g_mq_seq && mqtt_delivery(g_mq_seq) != MqttDelivery::PENDING)
+    {
+        if (!mq_settle(false)) return fail("MQTT thumbnails", -1);
+        cursor_save();
+    }
+
+    if (!g_job.active && !start_job())
+    {
+        if (g_scan_more) return UpState::BUSY;     // a long run of frames passed over
+        // Out of frames: confirm what is in flight before going idle
+        if (g_mq_seq)
+        {
+            if (!mq_settle(true)) return fail("MQTT thumbnails", -1);
+            cursor_save();
+        }
+        return UpState::IDLE;
+    }
+
+    Job &j = g_job;
+    bool thumbs = g_cfg.thumb_first || j.mode == UpMode::THUMB;
+    bool thumb_only_link = thumbs && g_cfg.thumb_mqtt && !j.thumb_done;
+    if (!thumb_only_link && (!g_online || !simhttp_connected()))
+    {
+        if (!go_online()) return fail("connect", -1);
+    }
+
+    if (thumbs && !j.thumb_done)
+    {
+        // Blocks already on the server: the thumbnail went out before
+        if (!j.next)
+        {
+            int st = send_thumb(j);
+            if (st != 0 && st != 201) return fail("thumbnail", st);
+        }
+        j.thumb_done = true;
+
+        if (j.mode == UpMode::THUMB || !wants_full(j.rec))
+        {
+            g_stats.tier_thumb[j.tier]++;
+            if (j.mode == UpMode::THUMB && (!g_cfg.thumb_first || wants_full(j.rec))) g_stats.budget_cut++;
+            if (j.lead) g_stats.ahead++;
+            job_close();
+            finish(j);
+            return UpState::BUSY;
+        }
+        if (g_cfg.thumb_mqtt && (!g_online || !simhttp_connected()) && !go_online())
+            return fail("connect", -1);
+    }
+
+    if (j.next < j.blocks)
+    {
+        uint32_t at = j.next * g_cfg.block_bytes;
+        uint32_t n = j.len - at < g_cfg.block_bytes ? j.len - at : g_cfg.block_bytes;
+        if (pread(j.fd, g_block, n, (off_t)(j.off + at)) != (ssize_t)n)
+        {
+            // Segment shrank under us (evicted / repaired): give up on the frame
+            job_close();
+            g_stats.skipped++;
+            finish(j);
+            return UpState::BUSY;
+        }
+
+        int st = azblob_put_block(j.blob, j.next, g_block, n);
+        if (st != 201) return fail("Put Block", st);
+
+        j.next++;
+        if (!j.requested)
+        {
+            g_cur.blocks = j.next;
+            cursor_save();
+        }
+        g_stats.blocks++;
+        g_stats.bytes += n;
+        g_backoff_ms = 0;
+        return UpState::BUSY;
+    }
+
+    int st = azblob_put_block_list(j.blob, j.blocks, "image/jpeg");
+    if (st == 400)
+    {
+        // Blocks expired or never arrived: send the frame again
+        VST_LOG("⚠️ uploader: block list rejected for %s, restarting it\n", j.blob);
+        j.next = 0;
+        if (!j.requested)
+        {
+            g_cur.blocks = 0;
+            cursor_save();
+        }
+        g_stats.restarts++;
+        return UpState::BUSY;
+    }
+    if (st != 201) return fail("Put Block List", st);
+
+    g_stats.frames++;
+    g_stats.last_frame_ms = mono_ms() - j.t0_ms;
+    g_backoff_ms = 0;
+    VST_LOG("☁️ Uploaded %s (%lu B, %lu blocks, %lu ms)%s\n", j.blob,
+            (unsigned long)j.len, (unsigned long)j.blocks, (unsigned long)g_stats.last_frame_ms,
+            j.requested ? " on request" : "");
+    account(0, j.len, g_cfg.thumb_first ? 0 : j.len, j.requested);
+
+    job_close();
+    if (j.requested) g_stats.requested++;
+    else g_stats.tier_full[j.tier]++;
+    if (j.lead) g_stats.ahead++;
+    finish(j);
+    return UpState::BUSY;
+}
+
+/* =========================================================
+   INIT / TASK
+   ========================================================= */
+UpConfig uploader_default_config()
+{
+    UpConfig c{};
+    c.apn = MODEM_APN;
+    c.az = AzConfig{ AZ_ENDPOINT, AZ_CONTAINER, AZ_SAS };
+    c.device_id = DEVICE_ID;
+    c.layout = SD_LAYOUT;
+    c.block_bytes = UP_BLOCK_BYTES;
+    c.upload_empty = UP_UPLOAD_EMPTY;
+    c.retry_ms = UP_RETRY_MS;
+    c.thumb_first = UP_THUMB_FIRST;
+    c.thumb_side = UP_THUMB_SIDE;
+    c.thumb_quality = UP_THUMB_QUALITY;
+    memcpy(c.full_min_score, UP_FULL_MIN_SCORE, sizeof(c.full_min_score));
+    c.request_poll_ms = UP_REQUEST_POLL_MS;
+    c.thumb_mqtt = MQTT_ENABLED;
+    c.budget_month = UP_BUDGET_MONTH;
+    c.budget_day = UP_BUDGET_DAY;
+    memcpy(c.budget_full_pct, UP_BUDGET_FULL_PCT, sizeof(c.budget_full_pct));
+    memcpy(c.budget_thumb_pct, UP_BUDGET_THUMB_PCT, sizeof(c.budget_thumb_pct));
+    c.velutina_first = UP_VELUTINA_FIRST;
+    c.sync_url = UP_SYNC_URL;
+    c.sync_backlog = UP_SYNC_BACKLOG;
+    c.sync_retry_ms = UP_SYNC_RETRY_MS;
+    return c;
+}
+
+bool uploader_init(const char *root, const UpConfig &cfg)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_cfg = cfg;
+    if (!g_cfg.block_bytes || g_cfg.block_bytes > SH_BODY_MAX) g_cfg.block_bytes = SH_BODY_MAX;
+    if (!g_cfg.retry_ms) g_cfg.retry_ms = 1000;
+    if (!g_cfg.thumb_side) g_cfg.thumb_side = 128;
+    if (!g_cfg.thumb_quality) g_cfg.thumb_quality = 60;
+    memset(&g_stats, 0, sizeof(g_stats));
+    job_close();
+    g_req_count = g_req_head = 0;
+    g_req_poll_at = 0;
+    g_mq_seq = 0;
+    memset(g_tier_mode, 0, sizeof(g_tier_mode));
+    g_sync_at = 0;
+    if (!g_cfg.sync_backlog) g_cfg.sync_backlog = 1;
+    if (!g_cfg.sync_retry_ms) g_cfg.sync_retry_ms = 60000;
+
+    if (!azblob_begin(g_cfg.az))
+    {
+        VST_LOG("❌ uploader: bad endpoint '%s'\n", g_cfg.az.endpoint ? g_cfg.az.endpoint : "");
+        g_root[0] = 0;
+        return false;
+    }
+
+    if (!g_block) g_block = (uint8_t*)malloc(g_cfg.block_bytes);
+    if (!g_block || !cursor_open())
+    {
+        VST_LOG("❌ uploader: init failed\n");
+        g_root[0] = 0;
+        return false;
+    }
+    day_open();
+    g_wire_mark = at_stats().tx_bytes + at_stats().rx_bytes;
+    if (g_cfg.sync_url && g_cfg.sync_url[0] &&
+        !upsync_begin(SyncConfig{ g_cfg.sync_url, g_cfg.device_id, g_cfg.thumb_first, g_cfg.upload_empty,
+                                  0, 0, 0 }, g_block, g_cfg.block_bytes))
+        VST_LOG("⚠️ uploader: bad sync URL '%s'\n", g_cfg.sync_url);
+
+    VST_LOG("☁️ uploader ready: %s/%s, cursor day=%ld rec=%lu (frame %lu, %lu blocks sent)\n",
+            g_cfg.az.endpoint, g_cfg.az.container,
+            (long)g_cur.day, (unsigned long)g_cur.rec,
+            (unsigned long)g_cur.frame_id, (unsigned long)g_cur.blocks);
+    if (g_cfg.thumb_first)
+        VST_LOG("🖼 uploader: thumbnails first (%u px), full frames at scores %u/%u/%u/%u, requests every %lu s\n",
+                g_cfg.thumb_side, g_cfg.full_min_score[0], g_cfg.full_min_score[1],
+                g_cfg.full_min_score[2], g_cfg.full_min_score[3],
+                (unsigned long)(g_cfg.request_poll_ms / 1000));
+    if (g_cfg.budget_month || g_cfg.budget_day)
+        VST_LOG("💸 uploader: plan %lu B/month, %lu B/day max, %llu B used this month before today\n",
+                (unsigned long)g_cfg.budget_month, (unsigned long)g_cfg.budget_day,
+                (unsigned long long)g_month_used);
+    return true;
+}
+
+#if defined(ARDUINO)
+static volatile bool g_task_busy = false;
+
+static void uploader_task(void *)
+{
+    for (;;)
+    {
+        // The power manager (modempower.h) puts the modem to sleep in between
+        UpState s = UpState::IDLE;
+        at_lock();
+        if (power_awake())
+        {
+            s = uploader_step();
+            if (g_cfg.thumb_mqtt) mqtt_service();
+            g_task_busy = s != UpState::IDLE;
+        }
+        at_unlock();
+        vTaskDelay(pdMS_TO_TICKS(s == UpState::BUSY ? 1 : 1000));
+    }
+}
+
+bool uploader_busy()
+{
+    return g_task_busy;
+}
+
+void uploader_start_task()
+{
+    // Core 0 next to the modem UART; below the SD writer (priority 2)
+    xTaskCreatePinnedToCore(uploader_task, "uploader", 8192, nullptr, 1, nullptr, 0);
+}
+#else
+void uploader_start_task()
+{
+}
+
+bool uploader_busy()
+{
+    return false;
+}
+#endif
+
+const UpStats &uploader_stats()
+{
+    return g_stats;
+}
+
+void uploader_log_stats()
+{
+    VST_LOG("📊 uploader: frames=%lu blocks=%lu bytes=%llu resumed=%lu (%lu blocks saved) "
+            "restarts=%lu skipped=%lu failures=%lu\n",
+            (unsigned long)g_stats.frames, (unsigned long)g_stats.blocks,
+            (unsigned long long)g_stats.bytes,
+            (unsigned long)g_stats.resumed, (unsigned long)g_stats.resumed_blocks,
+            (unsigned long)g_stats.restarts, (unsigned long)g_stats.skipped,
+            (unsigned long)g_stats.failures);
+    if (g_cfg.thumb_first)
+        VST_LOG("📊 uploader: thumbs=%lu (%llu B for %llu B of frames) no-thumb=%lu requested=%lu polls=%lu\n",
+                (unsigned long)g_stats.thumbs, (unsigned long long)g_stats.thumb_bytes,
+                (unsigned long long)g_stats.thumbed_bytes, (unsigned long)g_stats.thumb_failed,
+                (unsigned long)g_stats.requested, (unsigned long)g_stats.request_polls);
+    if (upsync_enabled())
+    {
+        const SyncStats &y = upsync_stats();
+        VST_LOG("📊 uploader sync: %lu rounds (%lu failed), %lu frames in %lu chunks, %lu complete, %lu split, "
+                "%lu missing ranges, %lu frames passed over, %lu B out, %lu B back\n",
+                (unsigned long)y.rounds, (unsigned long)y.failed, (unsigned long)y.listed,
+                (unsigned long)y.chunks, (unsigned long)y.chunks_complete, (unsigned long)y.refined,
+                (unsigned long)y.ranges,
+                (unsigned long)g_stats.synced, (unsigned long)y.manifest_bytes, (unsigned long)y.reply_bytes);
+    }
+    if (g_day.day >= 0)
+    {
+        uint32_t sent = g_day.thumb_bytes + g_day.full_bytes;
+        VST_LOG("📊 uploader today: %lu B sent (%lu thumbs, %lu full) vs %lu B as full frames (%.0f%%), modem %lu B\n",
+                (unsigned long)sent, (unsigned long)g_day.thumbs, (unsigned long)g_day.fulls,
+                (unsigned long)g_day.full_equiv,
+                g_day.full_equiv ? 100.0 * sent / g_day.full_equiv : 0.0,
+                (unsigned long)g_day.wire_bytes);
+    }
+    if (g_cfg.budget_month || g_cfg.budget_day || g_stats.ahead)
+    {
+        uint32_t share, used;
+        uploader_budget(&share, &used);
+        char of[24] = "no plan";
+        if (share) snprintf(of, sizeof(of), "%lu B", (unsigned long)share);
+        VST_LOG("📊 uploader budget: %lu B today of %s; full/thumb/meta velutina %lu/%lu/%lu "
+                "crabro %lu/%lu/%lu other %lu/%lu/%lu; %lu cut, %lu velutina ahead\n",
+                (unsigned long)used, of,
+                (unsigned long)g_stats.tier_full[0], (unsigned long)g_stats.tier_thumb[0],
+                (unsigned long)g_stats.tier_meta[0], (unsigned long)g_stats.tier_full[1],
+                (unsigned long)g_stats.tier_thumb[1], (unsigned long)g_stats.tier_meta[1],
+                (unsigned long)g_stats.tier_full[2], (unsigned long)g_stats.tier_thumb[2],
+                (unsigned long)g_stats.tier_meta[2], (unsigned long)g_stats.budget_cut,
+                (unsigned long)g_stats.ahead);
+    }
+}
+
+const UpDay &uploader_today()
+{
+    return g_day;
+}
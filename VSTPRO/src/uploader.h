@@ -0,0 +1,115 @@
+// src/uploader.h — background upload of stored frames to Azure Blob Storage
+//
+// Walks the frame index and sends each frame as a block blob, resuming
+// from <root>/up/CURSOR.VUC. Naming, thumbnails, data plan and delta
+// sync: README 1.4.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "azblob.h"
+#include "config.h"
+#include "frameindex.h"
+
+static constexpr uint8_t UP_TIERS = 3;     // velutina, crabro, the rest
+
+struct UpConfig
+{
+    const char *apn;            // "" = use the modem's default
+    AzConfig    az;
+    const char *device_id;      // first path element of every blob
+    SdLayout    layout;         // PER_FILE naming (records with seq 0)
+    uint32_t    block_bytes;    // <= SH_BODY_MAX
+    bool        upload_empty;   // frames without detections too
+    uint32_t    retry_ms;       // first backoff after a failure, doubles up to 16x
+    bool        thumb_first;
+    uint16_t    thumb_side;     // longest thumbnail side (px)
+    uint8_t     thumb_quality;  // start quality, lowered until it fits one request
+    uint8_t     full_min_score[IDX_CLASSES];    // send the full frame too; > 100 = never
+    uint32_t    request_poll_ms;                // 0 = never read requests.txt
+    bool        thumb_mqtt;                     // thumbnails over mqttlink.h
+    uint32_t    budget_month;                   // modem bytes per calendar month, 0 = no plan
+    uint32_t    budget_day;                     // at most this per day, 0 = month share only
+    uint8_t     budget_full_pct[UP_TIERS];      // of today's share: full frames below
+    uint8_t     budget_thumb_pct[UP_TIERS];     // thumbnails below, metadata only above
+    bool        velutina_first;                 // leads send velutina, then crabro frames ahead
+    const char *sync_url;                       // upsync.h service, "" = never
+    uint32_t    sync_backlog;                   // frames behind before a manifest is sent
+    uint32_t    sync_retry_ms;                  // after a failed round
+};
+
+enum class UpState : uint8_t
+{
+    IDLE,       // nothing to upload right now
+    BUSY,       // made progress, call again
+    BACKOFF,    // link or server error, waiting before the next try
+};
+
+struct UpStats
+{
+    uint32_t frames;        // committed blobs
+    uint32_t blocks;        // Put Block accepted
+    uint64_t bytes;         // JPEG bytes sent
+    uint32_t resumed;       // frames continued from a saved block
+    uint32_t resumed_blocks;// blocks not re-sent thanks to the cursor
+    uint32_t restarts;      // frames restarted at block 0 (block list rejected)
+    uint32_t skipped;       // filtered, evicted or too large
+    uint32_t failures;      // failed requests / connects
+    uint32_t last_frame_ms; // upload time of the last frame
+    uint32_t thumbs;        // thumbnails sent
+    uint64_t thumb_bytes;
+    uint64_t thumbed_bytes; // full JPEG size of the frames behind them
+    uint32_t thumb_failed;  // JPEG not readable (progressive, damaged)
+    uint32_t requested;     // full frames sent because the server asked
+    uint32_t request_polls;
+    uint32_t tier_full[UP_TIERS];   // frames sent in full, by tier
+    uint32_t tier_thumb[UP_TIERS];  // thumbnail only
+    uint32_t tier_meta[UP_TIERS];   // image held back by the budget
+    uint32_t budget_cut;            // frames the budget sent less of than the policy
+    uint32_t ahead;                 // velutina / crabro frames sent ahead of the cursor
+    uint32_t synced;                // passed over: the server has them (upsync.h)
+};
+
+// One line of up/DAYS.CSV
+struct UpDay
+{
+    int32_t  day;           // UTC day number, -1 = none yet
+    uint32_t thumbs;
+    uint32_t thumb_bytes;
+    uint32_t fulls;
+    uint32_t full_bytes;
+    uint32_t requested;     // of fulls
+    uint32_t full_equiv;    // full JPEG bytes of every frame handled
+    uint32_t wire_bytes;    // modem UART, both directions
+};
+
+UpConfig uploader_default_config();
+
+// Loads the cursor from <root>/up. The modem port must be set (at_begin).
+// cfg is copied; its strings are kept by pointer and must outlive the uploader.
+bool uploader_init(const char *root, const UpConfig &cfg);
+
+// One bounded unit of work (a block, a thumbnail, a commit, a poll).
+// Caller holds the modem (at_lock()).
+UpState uploader_step();
+
+// ESP32: runs uploader_step() on its own task (core 0, low priority).
+void uploader_start_task();
+// ESP32: true while the task's last step had work (for modempower.h);
+// the task does not step while the modem sleeps
+bool uploader_busy();
+
+// Queues a full frame named as in requests.txt (e.g. from an MQTT
+// command). Caller holds the modem (at_lock()), like uploader_step().
+bool uploader_request(const char *line);
+
+const UpStats &uploader_stats();
+const UpDay &uploader_today();
+// Today's share of the data plan and what was used of it (modem bytes);
+// share 0 = no plan
+void uploader_budget(uint32_t *share, uint32_t *used);
+void uploader_log_stats();
+
+// Shared with the host harness (verification).
+void uploader_blob_name(const IdxRecord &rec, char *out, size_t out_sz, bool thumb = false);
+bool uploader_open_frame(const IdxRecord &rec, int *fd, uint32_t *off, uint32_t *len);
@@ -0,0 +1,434 @@
+// src/upsync.cpp — manifest exchange with the sync service (see upsync.h)
+
+#include "upsync.h"
+#include "crc32.h"
+#include "simhttp.h"
+#include "vstlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// A chunk of the manifest and where its first frame is in the index
+struct Chunk
+{
+    uint32_t e0, e1;
+    uint32_t id0, id1;
+    int32_t  day;
+    uint32_t rec;
+    uint16_t n;
+};
+
+struct Range
+{
+    uint32_t e0, e1;
+    uint32_t id0, id1;
+};
+
+static SyncConfig g_cfg = {};
+static uint8_t   *g_buf = nullptr;
+static size_t     g_buf_len = 0;
+static char       g_base[96] = {0};     // http://host:port
+static char       g_path[96] = {0};     // /path
+static Chunk      g_chunk[UPSYNC_CHUNKS_MAX];
+static uint8_t    g_chunks = 0;
+static Range      g_miss[UPSYNC_MISSING_MAX];
+static uint8_t    g_miss_n = 0;
+static int32_t    g_from_day = -1;      // covered: from <= position < until
+static uint32_t   g_from_rec = 0;
+static int32_t    g_until_day = -1;
+static uint32_t   g_until_rec = 0;
+static SyncStats  g_stats = {};
+
+static uint32_t mono_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+static bool before(int32_t d1, uint32_t r1, int32_t d2, uint32_t r2)
+{
+    return d1 < d2 || (d1 == d2 && r1 < r2);
+}
+
+bool upsync_begin(const SyncConfig &cfg, uint8_t *buf, size_t buf_len)
+{
+    g_cfg = cfg;
+    g_buf = buf;
+    g_buf_len = buf_len < SH_BODY_MAX ? buf_len : SH_BODY_MAX;
+    g_base[0] = g_path[0] = 0;
+    g_until_day = -1;
+    memset(&g_stats, 0, sizeof(g_stats));
+    if (!g_cfg.chunk) g_cfg.chunk = 64;
+    if (!g_cfg.max_chunks || g_cfg.max_chunks > UPSYNC_CHUNKS_MAX) g_cfg.max_chunks = UPSYNC_CHUNKS_MAX;
+    if (!g_cfg.max_scan) g_cfg.max_scan = 4096;
+
+    // "http://host:port/path" -> base + path
+    const char *url = cfg.url ? cfg.url : "";
+    const char *host = strstr(url, "://");
+    if (!host || !g_buf) return false;
+    const char *slash = strchr(host + 3, '/');
+    size_t base_len = slash ? (size_t)(slash - url) : strlen(url);
+    if (base_len >= sizeof(g_base)) return false;
+    memcpy(g_base, url, base_len);
+    g_base[base_len] = 0;
+    snprintf(g_path, sizeof(g_path), "%s", slash ? slash : "/");
+    return true;
+}
+
+bool upsync_enabled()
+{
+    return g_base[0] != 0;
+}
+
+static uint32_t frame_hash(const IdxRecord &r)
+{
+    uint8_t b[8];
+    for (int i = 0; i < 4; i++)
+    {
+        b[i] = (uint8_t)(r.frame_id >> (8 * i));
+        b[4 + i] = (uint8_t)(r.epoch >> (8 * i));
+    }
+    return crc32_update(0, b, sizeof(b));
+}
+
+static bool listed(const IdxRecord &x)
+{
+    return g_cfg.upload_empty || x.box_count || (x.flags & IDX_F_TRIGGER);
+}
+
+static size_t manifest_head()
+{
+    return (size_t)snprintf((char*)g_buf, g_buf_len, "VSM1 %s %c\n", g_cfg.device_id, g_cfg.thumbs ? 't' : 'f');
+}
+
+// Appends the chunk's line; false when the body or the chunk table is full
+static bool emit(const Chunk &c, uint32_t hash, size_t *len, uint8_t max)
+{
+    if (g_chunks >= max) return false;
+    char line[64];
+    int k = snprintf(line, sizeof(line), "%lu-%lu %lu-%lu %u %08lx\n",
+                     (unsigned long)c.e0, (unsigned long)c.e1, (unsigned long)c.id0,
+                     (unsigned long)c.id1, (unsigned)c.n, (unsigned long)hash);
+    if (*len + (size_t)k > g_buf_len) return false;
+    memcpy(g_buf + *len, line, (size_t)k);
+    *len += (size_t)k;
+    g_chunk[g_chunks++] = c;
+    g_stats.chunks++;
+    return true;
+}
+
+static bool same(const Range &r, const Chunk &c)
+{
+    return r.e0 == c.e0 && r.e1 == c.e1 && r.id0 == c.id0 && r.id1 == c.id1;
+}
+
+// Index of the chunk from `from` on that holds r, g_chunks if none
+static uint8_t chunk_of(const Range &r, uint8_t from)
+{
+    for (uint8_t i = from; i < g_chunks; i++)
+    {
+        const Chunk &c = g_chunk[i];
+        if (r.e0 >= c.e0 && r.e1 <= c.e1 && r.id0 >= c.id0 && r.id1 <= c.id1) return i;
+    }
+    return g_chunks;
+}
+
+static int exchange(size_t len, size_t *rlen)
+{
+    static const SimHttpHeader hdr = { "Content-Type", "text/plain" };
+    g_stats.manifest_bytes += (uint32_t)len;
+    *rlen = 0;
+    int st = simhttp_request(SimHttpMethod::POST, g_path, &hdr, 1, g_buf, len, g_buf, g_buf_len - 1, rlen);
+    if (st != 200)
+    {
+        g_stats.failed++;
+        VST_LOG("⚠️ sync: manifest not answered (%d)\n", st);
+        return st;
+    }
+    g_stats.reply_bytes += (uint32_t)*rlen;
+    return st;
+}
+
+// Reply lines -> out[], each inside a chunk of g_chunk. whole[i]: chunk i
+// came back entire. Returns the first chunk not known in full: the table
+// ran out, or the last line may be cut.
+static uint8_t parse_reply(size_t rlen, Range *out, uint8_t *n, uint8_t cap, bool *seen, bool *whole)
+{
+    bool truncated = rlen >= g_buf_len - 1;
+    g_buf[rlen] = 0;
+    uint8_t ci = 0;
+    uint8_t horizon = g_chunks;
+    char *save = nullptr;
+    for (char *line = strtok_r((char*)g_buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save))
+    {
+        unsigned long e0, e1, a, b;
+        if (sscanf(line, "%lu-%lu %lu-%lu", &e0, &e1, &a, &b) != 4) continue;
+        Range m = { (uint32_t)e0, (uint32_t)e1, (uint32_t)a, (uint32_t)b };
+        uint8_t i = chunk_of(m, ci);
+        if (i >= g_chunks)
+        {
+            VST_LOG("⚠️ sync: range %s outside the manifest, ignored\n", line);
+            continue;
+        }
+        ci = i;
+        if (*n >= cap)
+        {
+            horizon = i;
+            break;
+        }
+        out[(*n)++] = m;
+        seen[i] = true;
+        whole[i] = whole[i] || same(m, g_chunk[i]);
+        g_stats.ranges++;
+    }
+    if (truncated && ci < horizon) horizon = ci;
+    return horizon;
+}
+
+// Splits p into UPSYNC_SPLIT chunks (fewer frames each) in the manifest;
+// false, with nothing added, when they do not fit
+static bool split(const Chunk &p, size_t *len)
+{
+    uint8_t chunks0 = g_chunks;
+    size_t len0 = *len;
+    uint16_t size = (uint16_t)((p.n + UPSYNC_SPLIT - 1) / UPSYNC_SPLIT);
+    uint32_t count = frameindex_count(p.day), hash = 0;
+    uint16_t got = 0;
+    Chunk cur = {};
+    for (uint32_t r = p.rec; r < count && got < p.n; r++)
+    {
+        IdxRecord x;
+        if (!frameindex_read(p.day, r, x) || !listed(x)) continue;
+        if (!cur.n) cur = Chunk{ x.epoch, x.epoch, x.frame_id, x.frame_id, p.day, r, 0 };
+        cur.e1 = x.epoch;
+        cur.id1 = x.frame_id;
+        cur.n++;
+        hash += frame_hash(x);
+        got++;
+        if (cur.n == size || got == p.n)
+        {
+            if (!emit(cur, hash, len, UPSYNC_CHUNKS_MAX)) break;
+            cur.n = 0;
+            hash = 0;
+        }
+    }
+    if (got == p.n && !cur.n) return true;
+    g_chunks = chunks0;
+    *len = len0;
+    return false;
+}
+
+int upsync_round(int32_t day, uint32_t rec)
+{
+    if (!upsync_enabled() || day < 0) return -1;
+    uint32_t t0 = mono_ms();
+    uint32_t bytes0 = g_stats.manifest_bytes;
+    g_chunks = 0;
+    g_miss_n = 0;
+    g_until_day = -1;
+
+    /* ---- manifest from the index ---- */
+    size_t len = manifest_head();
+    int32_t last = frameindex_last_day();
+    int32_t d = day, end_d;
+    uint32_t r = rec, end_r;
+    uint32_t scanned = 0, hash = 0;
+    Chunk cur = {};
+    bool open = false, full = false;
+
+    while (scanned < g_cfg.max_scan)
+    {
+        if (r >= frameindex_count(d))
+        {
+            if (d >= last) break;
+            d++;
+            r = 0;
+            continue;
+        }
+
+        IdxRecord x;
+        scanned++;
+        if (!frameindex_read(d, r, x) || !listed(x))
+        {
+            r++;
+            continue;
+        }
+
+        // Same day, same boot, room left: the chunk grows
+        if (!open || d != cur.day || cur.n >= g_cfg.chunk || x.epoch < cur.e1 || x.frame_id <= cur.id1)
+        {
+            if (open && !emit(cur, hash, &len, g_cfg.max_chunks))
+            {
+                full = true;
+                break;
+            }
+            cur = Chunk{ x.epoch, x.epoch, x.frame_id, x.frame_id, d, r, 0 };
+            hash = 0;
+            open = true;
+        }
+        cur.e1 = x.epoch;
+        cur.id1 = x.frame_id;
+        cur.n++;
+        hash += frame_hash(x);
+        r++;
+    }
+
+    // Horizon: where the walk stopped, or the first chunk that did not fit
+    end_d = d;
+    end_r = r;
+    if (open && (full || !emit(cur, hash, &len, g_cfg.max_chunks)))
+    {
+        end_d = cur.day;
+        end_r = cur.rec;
+    }
+    for (uint8_t i = 0; i < g_chunks; i++)
+        g_stats.listed += g_chunk[i].n;
+
+    g_from_day = day;
+    g_from_rec = rec;
+    if (!g_chunks)
+    {
+        // Nothing the uploader would send in there
+        if (before(day, rec, end_d, end_r))
+        {
+            g_until_day = end_d;
+            g_until_rec = end_r;
+        }
+        return 0;
+    }
+
+    /* ---- exchange ---- */
+    g_stats.rounds++;
+    if (!simhttp_connect(g_base))
+    {
+        g_stats.failed++;
+        return -1;
+    }
+    size_t rlen = 0;
+    int st = exchange(len, &rlen);
+    if (st != 200)
+    {
+        if (st > 0) simhttp_disconnect();
+        return st;
+    }
+
+    bool seen[UPSYNC_CHUNKS_MAX] = {};
+    bool whole[UPSYNC_CHUNKS_MAX] = {};
+    uint8_t horizon = parse_reply(rlen, g_miss, &g_miss_n, UPSYNC_MISSING_MAX, seen, whole);
+    if (horizon < g_chunks)
+    {
+        end_d = g_chunk[horizon].day;
+        end_r = g_chunk[horizon].rec;
+    }
+    uint32_t complete = 0;
+    for (uint8_t i = 0; i < horizon; i++)
+        complete += seen[i] ? 0 : 1;
+    uint8_t sent = horizon;
+
+    /* ---- bisection ---- */
+    // A chunk that came back whole differs somewhere (or is not there at
+    // all): its parts are described again, down to single frames, so a
+    // few lost frames cost a few lines rather than the chunk.
+    for (;;)
+    {
+        Chunk par[UPSYNC_CHUNKS_MAX];
+        uint8_t np = 0;
+        for (uint8_t i = 0; i < horizon; i++)
+            if (whole[i] && g_chunk[i].n > 1) par[np++] = g_chunk[i];
+        if (!np) break;
+
+        // Parts of as many of them as fit, each part's parent in owner[]
+        uint8_t owner[UPSYNC_CHUNKS_MAX];
+        uint8_t done = 0;
+        g_chunks = 0;
+        len = manifest_head();
+        while (done < np)
+        {
+            uint8_t c0 = g_chunks;
+            if (!split(par[done], &len)) break;
+            for (uint8_t i = c0; i < g_chunks; i++)
+                owner[i] = done;
+            done++;
+        }
+        if (!done || exchange(len, &rlen) != 200) break;
+        g_stats.refined += done;
+
+        Range sub[UPSYNC_MISSING_MAX];
+        uint8_t ns = 0;
+        memset(seen, 0, sizeof(seen));
+        memset(whole, 0, sizeof(whole));
+        horizon = parse_reply(rlen, sub, &ns, UPSYNC_MISSING_MAX, seen, whole);
+        uint8_t known = horizon < g_chunks ? owner[horizon] : done;     // parents answered in full
+        uint8_t kept = known;
+
+        // Their parts replace them in the list
+        uint8_t k = 0;
+        for (uint8_t i = 0; i < g_miss_n; i++)
+        {
+            bool replaced = false;
+            for (uint8_t j = 0; j < known && !replaced; j++)
+                replaced = same(g_miss[i], par[j]);
+            if (!replaced) g_miss[k++] = g_miss[i];
+        }
+        g_miss_n = k;
+        for (uint8_t i = 0; i < ns; i++)
+        {
+            uint8_t o = owner[chunk_of(sub[i], 0)];
+            if (o >= kept) continue;
+            if (g_miss_n >= UPSYNC_MISSING_MAX)
+            {
+                kept = o;
+                // No room for this parent's answer: coverage ends before it
+                if (before(par[o].day, par[o].rec, end_d, end_r))
+                {
+                    end_d = par[o].day;
+                    end_r = par[o].rec;
+                }
+                break;
+            }
+            g_miss[g_miss_n++] = sub[i];
+        }
+        for (uint8_t i = 0; i < g_chunks && owner[i] < kept; i++)
+            complete += seen[i] ? 0 : 1;
+        horizon = 0;
+        while (horizon < g_chunks && owner[horizon] < kept) horizon++;
+    }
+    simhttp_disconnect();
+
+    g_stats.chunks_complete += complete;
+    if (before(day, rec, end_d, end_r))
+    {
+        g_until_day = end_d;
+        g_until_rec = end_r;
+    }
+
+    g_stats.last_ms = mono_ms() - t0;
+    VST_LOG("🔁 sync: %u chunks, %u complete, %u missing range(s), %lu B of manifests, %lu ms\n",
+            (unsigned)sent, (unsigned)complete, (unsigned)g_miss_n,
+            (unsigned long)(g_stats.manifest_bytes - bytes0), (unsigned long)g_stats.last_ms);
+    return st;
+}
+bool upsync_covers(int32_t day, uint32_t rec)
+{
+    return g_until_day >= 0 && !before(day, rec, g_from_day, g_from_rec) &&
+           before(day, rec, g_until_day, g_until_rec);
+}
+
+bool upsync_missing(const IdxRecord &rec)
+{
+    for (uint8_t i = 0; i < g_miss_n; i++)
+    {
+        const Range &m = g_miss[i];
+        if (rec.epoch >= m.e0 && rec.epoch <= m.e1 && rec.frame_id >= m.id0 && rec.frame_id <= m.id1)
+            return true;
+    }
+    return false;
+}
+
+const SyncStats &upsync_stats()
+{
+    return g_stats;
+}
@@ -0,0 +1,57 @@
+// src/upsync.h — manifest exchange: which stored frames the cloud is missing
+//
+// Describes a stretch of the frame index (records only, no JPEG) and
+// keeps the missing ranges the server answers. README 1.4 (delta sync),
+// manifest format: README 1.13.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frameindex.h"
+
+static constexpr uint8_t UPSYNC_CHUNKS_MAX  = 64;     // chunks per round
+static constexpr uint8_t UPSYNC_MISSING_MAX = 96;     // missing ranges held
+static constexpr uint8_t UPSYNC_SPLIT       = 8;      // parts of a chunk that differs
+
+struct SyncConfig
+{
+    const char *url;            // "http://host[:port]/path" of the sync service
+    const char *device_id;
+    bool        thumbs;         // frames are on the server as thumbnails (_t)
+    bool        upload_empty;   // frames without detections are sent too
+    uint16_t    chunk;          // frames per chunk
+    uint8_t     max_chunks;     // per round (<= UPSYNC_CHUNKS_MAX, and what fits a body)
+    uint32_t    max_scan;       // index records read per round
+};
+
+struct SyncStats
+{
+    uint32_t rounds;
+    uint32_t failed;            // no answer from the service
+    uint32_t chunks;            // sent, all rounds
+    uint32_t listed;            // frames described
+    uint32_t chunks_complete;   // chunks (and parts) the server had in full
+    uint32_t refined;           // chunks split and described again
+    uint32_t ranges;            // missing ranges received
+    uint32_t manifest_bytes;
+    uint32_t reply_bytes;
+    uint32_t last_ms;           // duration of the last round
+};
+
+bool upsync_begin(const SyncConfig &cfg, uint8_t *buf, size_t buf_len);
+bool upsync_enabled();
+
+// One round from index position (day, rec): builds the manifest, POSTs
+// it and the parts of chunks that differ (connects to the sync host and
+// disconnects again, so the caller reconnects to the blob host) and
+// keeps the answer. Returns the HTTP
+// status, -1 on link failure, 0 if there was nothing to describe.
+int upsync_round(int32_t day, uint32_t rec);
+
+// Position inside the stretch the last round covered
+bool upsync_covers(int32_t day, uint32_t rec);
+
+// Covered record the server does not have (or not as described)
+bool upsync_missing(const IdxRecord &rec);
+
+const SyncStats &upsync_stats();
@@ -7,6 +7,9 @@
 #include "mbedtls/base64.h"
 
 #include "config.h"
+#include "i2cbus.h"
+#include "sscmalink.h"
+#include "timesync.h"
 
 /* =========================================================
    SSCMA I2C (Wire1) — DO NOT TOUCH global Wire (PMU uses it)
@@ -15,14 +18,11 @@ static TwoWire WireAI(1);
 static SSCMA AI;
 
 /* =========================================================
-   INVOKE / BACKOFF
+   INVOKE / BACKOFF (sscmalink.h)
    ========================================================= */
-static constexpr int RC_BUSY = 3;
 static constexpr uint32_t INVOKE_DEADLINE_MS = 25000;
 
 static constexpr uint32_t BACKOFF_MAX_MS   = 1200;
-static constexpr uint8_t  BACKOFF_MULT_NUM = 3;   // *1.5
-static constexpr uint8_t  BACKOFF_MULT_DEN = 2;
 static constexpr uint32_t BACKOFF_RESET_MS = 30;
 
 static constexpr uint32_t POST_SUCCESS_IDLE_MS = 10;
@@ -39,7 +39,8 @@ static constexpr size_t IMAGE_HEX_PREVIEW_BYTES = 64;
    ========================================================= */
 static uint32_t frame_id = 0;
 static uint32_t last_frame_ms = 0;
-static uint32_t backoff_ms = BACKOFF_RESET_MS;
+static char    *rx_buf = nullptr;      // one SSCMA reply (Base64 image), PSRAM when there is some
+static uint32_t last_bus_report_ms = 0;
 
 /* =========================================================
    UTIL
@@ -74,7 +75,7 @@ static bool jpeg_sanity_check(const uint8_t *buf, size_t len)
     return found_sos && found_eoi;
 }
 
-static bool decode_base64_to_jpeg(const String &b64, uint8_t **out_buf, size_t *out_len)
+static bool decode_base64_to_jpeg(const char *b64, size_t b64_len, uint8_t **out_buf, size_t *out_len)
 {
     if (!out_buf || !out_len) return false;
     *out_buf = nullptr;
@@ -83,8 +84,8 @@ static bool decode_base64_to_jpeg(const String &b64, uint8_t **out_buf, size_t *
     size_t decoded_len = 0;
     int rc = mbedtls_base64_decode(
         nullptr, 0, &decoded_len,
-        (const unsigned char*)b64.c_str(),
-        b64.length()
+        (const unsigned char*)b64,
+        b64_len
     );
 
     if (rc != MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL || decoded_len == 0)
@@ -95,8 +96,8 @@ static bool decode_base64_to_jpeg(const String &b64, uint8_t **out_buf, size_t *
 
     rc = mbedtls_base64_decode(
         buf, decoded_len, out_len,
-        (const unsigned char*)b64.c_str(),
-        b64.length()
+        (const unsigned char*)b64,
+        b64_len
     );
 
     if (rc != 0 || *out_len == 0) {
@@ -109,63 +110,97 @@ static bool decode_base64_to_jpeg(const String &b64, uint8_t **out_buf, size_t *
 }
 
 /* =========================================================
-   INVOKE with backoff
+   SSCMA LINK (bytes through the library, protocol in sscmalink)
    ========================================================= */
-static bool invoke_with_backoff()
+static int port_available() { return AI.available(); }
+
+static int port_read(char *buf, int n)
 {
-    uint32_t start = millis();
-    uint32_t last_busy_log_ms = 0;
-    uint32_t busy_count = 0;
+    uint32_t t = micros();
+    int got = AI.read(buf, n);
+    if (got > 0) i2cbus_transfer((uint32_t)got, micros() - t);
+    return got;
+}
 
-    while (true)
-    {
-        int rc = AI.invoke(1, false, false);
+static int port_write(const char *buf, int n)
+{
+    uint32_t t = micros();
+    int put = AI.write(buf, n);
+    if (put > 0) i2cbus_transfer((uint32_t)put, micros() - t);
+    return put;
+}
 
-        if (rc == CMD_OK)
+static bool link_begin()
+{
+    if (!rx_buf)
+    {
+        rx_buf = (char*)heap_caps_malloc(AI_RX_BUF, psramFound() ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT);
+        if (!rx_buf)
         {
-            backoff_ms = BACKOFF_RESET_MS;
-            return true;
+            Serial.println("❌ SSCMA: no memory for the reply buffer");
+            return false;
         }
+    }
 
-        if (rc == RC_BUSY)
-        {
-            busy_count++;
-
-            uint32_t now = millis();
-            if (now - last_busy_log_ms > 2000)
-            {
-                Serial.printf("⏳ BUSY (rc=%d) x%lu, backoff=%lums\n",
-                              rc, (unsigned long)busy_count, (unsigned long)backoff_ms);
-                last_busy_log_ms = now;
-            }
-
-            delay(backoff_ms);
-
-            uint32_t next = (backoff_ms * BACKOFF_MULT_NUM) / BACKOFF_MULT_DEN;
-            backoff_ms = (next > BACKOFF_MAX_MS) ? BACKOFF_MAX_MS : next;
-
-            if ((millis() - start) > INVOKE_DEADLINE_MS)
-            {
-                Serial.printf("⚠️ Invoke deadline exceeded (%lums). Busy loops=%lu\n",
-                              (unsigned long)INVOKE_DEADLINE_MS,
-                              (unsigned long)busy_count);
-                return false;
-            }
-            continue;
-        }
+    SscmaConfig c = sscma_default_config();
+    c.mode = AI_CONTINUOUS ? SscmaMode::CONTINUOUS : SscmaMode::SINGLE;
+    c.poll_ms = AI_POLL_MS;
+    c.result_timeout_ms = AI_RESULT_TIMEOUT_MS;
+    c.backoff_min_ms = BACKOFF_RESET_MS;
+    c.backoff_max_ms = BACKOFF_MAX_MS;
+    c.invoke_deadline_ms = INVOKE_DEADLINE_MS;
+    c.idle_ms = POST_SUCCESS_IDLE_MS;
+    c.result_only = AI_TWO_PHASE;
+    for (size_t t = 0; t < sizeof(c.image_min_score); t++)
+        c.image_min_score[t] = AI_IMAGE_MIN_SCORE[t];
+    c.image_every_ms = AI_IMAGE_EVERY_MS;
+    c.image_retries = AI_IMAGE_RETRIES;
+    return sscma_begin(SscmaPort{ port_available, port_read, port_write }, c, rx_buf, AI_RX_BUF);
+}
 
-        Serial.printf("❌ AI.invoke failed rc=%d (backoff=%lums)\n", rc, (unsigned long)backoff_ms);
-        delay(backoff_ms);
+/* =========================================================
+   BUS CLOCK (i2cbus.h)
+   ========================================================= */
+static void bus_set_clock(uint32_t hz) { WireAI.setClock(hz); }
 
-        uint32_t next = (backoff_ms * BACKOFF_MULT_NUM) / BACKOFF_MULT_DEN;
-        backoff_ms = (next > BACKOFF_MAX_MS) ? BACKOFF_MAX_MS : next;
+// Address ACK, then an AT+ID? round trip through the library
+static I2cFault bus_probe()
+{
+    WireAI.beginTransmission(AI_I2C_ADDR);
+    uint8_t rc = WireAI.endTransmission();
+    if (rc == 5) return I2cFault::TIMEOUT;
+    if (rc != 0) return I2cFault::NACK;
+
+    int ping = sscma_ping(500);
+    if (ping > 0) return I2cFault::NONE;
+    return ping < 0 ? I2cFault::CRC : I2cFault::TIMEOUT;
+}
 
-        if ((millis() - start) > INVOKE_DEADLINE_MS)
-        {
-            Serial.printf("⚠️ Invoke deadline exceeded after rc=%d\n", rc);
-            return false;
-        }
-    }
+static void bus_begin()
+{
+    I2cBusConfig c = i2cbus_default_config();
+    c.n_clocks = 0;
+    for (uint32_t hz : AI_I2C_CLOCKS)
+        if (c.n_clocks < I2CBUS_MAX_CLOCKS) c.clocks[c.n_clocks++] = hz;
+    c.max_errors = AI_I2C_MAX_ERRORS;
+    c.window_ms = AI_I2C_WINDOW_MS;
+    c.clean_ms = AI_I2C_CLEAN_MS;
+    if (!i2cbus_begin(I2cBusPort{ bus_set_clock, bus_probe }, c))
+        Serial.println("⚠️ SSCMA: no clock passed its probes");
+    last_bus_report_ms = millis();
+}
+
+// Link errors go to the clock manager: stalls as timeouts, replies
+// that did not parse as CRC
+template <typename Call>
+static bool counted(Call call)
+{
+    SscmaStats before = sscma_stats();
+    bool ok = call();
+    const SscmaStats &after = sscma_stats();
+    for (uint32_t i = before.errors; i != after.errors; i++) i2cbus_fault(I2cFault::CRC);
+    if (after.stalls != before.stalls) i2cbus_fault(I2cFault::TIMEOUT);
+    return ok;
 }
 
 namespace VisionAI {
@@ -182,8 +217,10 @@ bool begin()
         return false;
     }
 
-    Serial.println("✅ SSCMA initialized over Wire1");
-    backoff_ms = BACKOFF_RESET_MS;
+    if (!link_begin()) return false;
+    bus_begin();
+    Serial.printf("✅ SSCMA initialized over Wire1 (%s invoke, %lu kHz)\n",
+                  AI_CONTINUOUS ? "continuous" : "single", (unsigned long)(i2cbus_hz() / 1000));
     frame_id = 0;
     last_frame_ms = 0;
     return true;
@@ -192,71 +229,72 @@ bool begin()
 bool reinit()
 {
     Serial.println("♻️ Re-initializing SSCMA over Wire1...");
+    sscma_stop();
     delay(STALL_REINIT_COOLDOWN_MS);
 
     WireAI.end();
     delay(25);
 
     WireAI.begin(AI_I2C_SDA, AI_I2C_SCL);
-    WireAI.setClock(AI_I2C_HZ);
+    WireAI.setClock(i2cbus_hz());
 
     if (!AI.begin(&WireAI))
     {
         Serial.println("❌ SSCMA re-init failed");
+        i2cbus_fault(I2cFault::NACK);
         return false;
     }
+    WireAI.setClock(i2cbus_hz());       // the library sets its own in begin()
 
     Serial.println("✅ SSCMA re-initialized");
-    backoff_ms = BACKOFF_RESET_MS;
-    return true;
+    return link_begin();
 }
 
-LoopResult loop_once()
+// perf, boxes and capture time of a result
+static void fill_meta(LoopResult &out, const SscmaFrame &f)
 {
-    LoopResult out;
-
-    if (!invoke_with_backoff())
-    {
-        out.ok = false;
-        return out;
-    }
-
-    uint32_t now_ms = millis();
-    uint32_t dt_ms = (last_frame_ms == 0) ? 0 : (now_ms - last_frame_ms);
-    last_frame_ms = now_ms;
-
-    frame_id++;
-    out.frame_id = frame_id;
-
-    Serial.println("=======================================");
-    Serial.printf("🧠 FRAME %lu", (unsigned long)frame_id);
-    if (dt_ms) Serial.printf(" (dt=%lums)", (unsigned long)dt_ms);
-    Serial.println();
-
-    Serial.printf("boxes: %u\n", (unsigned)AI.boxes().size());
+    Serial.printf("boxes: %u\n", (unsigned)(f.box_count + f.boxes_dropped));
     Serial.printf("perf: preprocess=%u inference=%u postprocess=%u\n",
-                  (unsigned)AI.perf().prepocess,
-                  (unsigned)AI.perf().inference,
-                  (unsigned)AI.perf().postprocess);
-
-    out.box_count = 0;
-    for (size_t i = 0; i < AI.boxes().size() && i < 16; i++)
+                  (unsigned)f.perf.preprocess,
+                  (unsigned)f.perf.inference,
+                  (unsigned)f.perf.postprocess);
+
+    out.meta = {};
+    out.meta.valid = true;
+    out.meta.frame = frame_id;
+    out.meta.perf = f.perf;
+
+    // The image was taken before preprocessing started: the event is
+    // complete after postprocess and the result transfer. In continuous
+    // mode a result may also have waited behind the previous one.
+    uint32_t pipeline_ms = (uint32_t)out.meta.perf.preprocess + out.meta.perf.inference +
+                           out.meta.perf.postprocess;
+    out.meta.capture_us = timesync_mono_us() - (uint64_t)pipeline_ms * 1000ULL;
+    out.meta.capture_ms = timesync_wall_ms(out.meta.capture_us);
+
+    for (size_t i = 0; i < f.box_count; i++)
     {
-        auto &b = AI.boxes()[i];
+        const FrameBox &b = f.boxes[i];
         Serial.printf("  [%u] target=%u score=%u x=%u y=%u w=%u h=%u\n",
                       (unsigned)i, b.target, b.score, b.x, b.y, b.w, b.h);
-
-        out.targets[out.box_count++] = (uint8_t)b.target;
+        out.meta.boxes[out.meta.box_count++] = b;
     }
+    out.meta.boxes_dropped = f.boxes_dropped;
+}
+
+// Base64 image -> JPEG in out.jpeg. Without one (two-phase) there is
+// nothing to do; the Base64 stays in the link's buffer until its next call.
+static void take_image(LoopResult &out, const SscmaFrame &f)
+{
+    if (!f.image_len) return;
 
-    // Base64 image
-    String b64 = AI.last_image();
-    size_t b64_len = b64.length();
-    uint32_t b64_crc = esp_crc32_le(0, (const uint8_t*)b64.c_str(), b64_len);
+    const char *b64 = f.image;
+    size_t b64_len = f.image_len;
+    uint32_t b64_crc = esp_crc32_le(0, (const uint8_t*)b64, b64_len);
 
     Serial.printf("📷 image: bytes=%u crc=%08lx\n", (unsigned)b64_len, (unsigned long)b64_crc);
 
-    if (PRINT_IMAGE_HEX_PREVIEW && b64_len > 0)
+    if (PRINT_IMAGE_HEX_PREVIEW)
     {
         Serial.printf("📷 image hex preview (first %u bytes):\n", (unsigned)IMAGE_HEX_PREVIEW_BYTES);
         size_t n = (b64_len < IMAGE_HEX_PREVIEW_BYTES) ? b64_len : IMAGE_HEX_PREVIEW_BYTES;
@@ -270,28 +308,93 @@ LoopResult loop_once()
     }
 
     // Convert base64 -> jpeg (malloc) (caller frees)
-    if (b64_len > 0)
+    uint8_t *jpeg = nullptr;
+    size_t jpeg_len = 0;
+
+    if (decode_base64_to_jpeg(b64, b64_len, &jpeg, &jpeg_len) &&
+        jpeg_sanity_check(jpeg, jpeg_len))
+    {
+        out.jpeg = jpeg;
+        out.jpeg_len = jpeg_len;
+    }
+    else
     {
-        uint8_t *jpeg = nullptr;
-        size_t jpeg_len = 0;
+        if (jpeg) free(jpeg);
+        i2cbus_fault(I2cFault::CRC);
+    }
+}
 
-        if (decode_base64_to_jpeg(b64, &jpeg, &jpeg_len) &&
-            jpeg_sanity_check(jpeg, jpeg_len))
-        {
-            out.jpeg = jpeg;
-            out.jpeg_len = jpeg_len;
-        }
-        else
-        {
-            if (jpeg) free(jpeg);
-        }
+LoopResult loop_once()
+{
+    LoopResult out;
+    SscmaFrame f;
+
+    i2cbus_step();
+    if (AI_I2C_REPORT_MS && millis() - last_bus_report_ms >= AI_I2C_REPORT_MS)
+    {
+        i2cbus_report();
+        last_bus_report_ms = millis();
+    }
+
+    if (!counted([&] { return sscma_next(&f); }))
+    {
+        out.ok = false;
+        return out;
     }
 
+    uint32_t now_ms = millis();
+    uint32_t dt_ms = (last_frame_ms == 0) ? 0 : (now_ms - last_frame_ms);
+    last_frame_ms = now_ms;
+
+    frame_id++;
+    out.frame_id = frame_id;
+
+    Serial.println("=======================================");
+    Serial.printf("🧠 FRAME %lu", (unsigned long)frame_id);
+    if (dt_ms) Serial.printf(" (dt=%lums)", (unsigned long)dt_ms);
+    Serial.println();
+
+    fill_meta(out, f);
+    take_image(out, f);
+
     log_memory();
-    if (POST_SUCCESS_IDLE_MS) delay(POST_SUCCESS_IDLE_MS);
 
     out.ok = true;
     return out;
 }
 
+bool wants_image(const LoopResult &r)
+{
+    return r.ok && !r.jpeg && sscma_want_image(r.meta.boxes, r.meta.box_count);
+}
+
+bool fetch_image(LoopResult &r)
+{
+    SscmaFrame f;
+    if (!counted([&] { return sscma_image(&f, r.meta.boxes, r.meta.box_count); }))
+    {
+        Serial.println("⚠️ SSCMA: image fetch failed");
+        return false;
+    }
+
+    // The image is a new capture: its boxes and time go in the meta, the
+    // result that asked for it stays as the trigger
+    FrameTrigger trig{};
+    trig.valid = true;
+    trig.confirmed = f.confirmed;
+    trig.box_count = r.meta.box_count;
+    int best = framemeta_best_box(r.meta);
+    if (best >= 0) trig.best = r.meta.boxes[best];
+    uint64_t trigger_us = r.meta.capture_us;
+
+    Serial.printf("📷 FRAME %lu image (seq %lu)%s\n", (unsigned long)r.frame_id, (unsigned long)f.seq,
+                  f.confirmed ? "" : " ⚠️ detection not confirmed");
+    fill_meta(r, f);
+    r.meta.frame = r.frame_id;
+    if (r.meta.capture_us > trigger_us) trig.lag_ms = (uint32_t)((r.meta.capture_us - trigger_us) / 1000ULL);
+    r.meta.trigger = trig;
+    take_image(r, f);
+    return r.jpeg != nullptr;
+}
+
 } // namespace VisionAI
@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "framemeta.h"
+
 namespace VisionAI {
 
 struct LoopResult
@@ -12,9 +14,8 @@ struct LoopResult
 
     uint32_t frame_id = 0;
 
-    // detections summary (targets only, to let main pulse actuators)
-    size_t box_count = 0;
-    uint8_t targets[16] = {0}; // cap to avoid dynamic alloc
+    // detections + perf (fixed size, no dynamic alloc)
+    FrameMeta meta = {};
 
     // JPEG buffer (malloc'd). Caller must free().
     uint8_t *jpeg = nullptr;
@@ -27,8 +28,18 @@ bool begin();
 
 // Runs one inference cycle and returns results.
 // If ok==false, caller may call reinit().
+// With AI_TWO_PHASE the result comes without the JPEG: act on the boxes
+// first, then fetch_image() if wants_image().
 LoopResult loop_once();
 
+// Two-phase: the image policy (AI_IMAGE_MIN_SCORE, AI_IMAGE_EVERY_MS)
+bool wants_image(const LoopResult &r);
+
+// Two-phase: a JPEG of a new capture into r.jpeg. Its boxes replace
+// r.meta; the result's own go to r.meta.trigger (confirmed: the capture
+// still passes AI_IMAGE_MIN_SCORE, retried AI_IMAGE_RETRIES times)
+bool fetch_image(LoopResult &r);
+
 // Reinitialize SSCMA on Wire1 only.
 bool reinit();
 
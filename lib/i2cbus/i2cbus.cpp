@@ -0,0 +1,215 @@
+// lib/i2cbus/i2cbus.cpp — clock manager for a Vision AI I2C link (see i2cbus.h)
+
+#include "i2cbus.h"
+#include "vstlog.h"
+
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t now_ms() { return millis(); }
+#else
+#include <time.h>
+static uint32_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+#endif
+
+static constexpr uint8_t MAX_HOLDOFF = 8;   // x clean_ms before retrying a failed rung
+
+static I2cBusPort   g_port = {};
+static I2cBusConfig g_cfg = {};
+static I2cBusStats  g_stats = {};
+static uint8_t      g_rung = 0;
+static uint8_t      g_top = 0;              // fastest rung that passed at begin
+static uint8_t      g_holdoff[I2CBUS_MAX_CLOCKS];
+static uint32_t     g_window_ms = 0;        // start of the error window
+static uint8_t      g_window_errors = 0;
+static uint32_t     g_clean_since = 0;      // last fault or clock change
+static uint32_t     g_rung_since = 0;
+
+I2cBusConfig i2cbus_default_config()
+{
+    I2cBusConfig c{};
+    c.clocks[0] = 100000;
+    c.clocks[1] = 400000;
+    c.clocks[2] = 1000000;
+    c.n_clocks = 3;
+    c.probes = 5;
+    c.max_errors = 3;
+    c.window_ms = 30000;
+    c.clean_ms = 10UL * 60UL * 1000UL;
+    return c;
+}
+
+/* =========================================================
+   CLOCK
+   ========================================================= */
+static void set_rung(uint8_t r)
+{
+    uint32_t now = now_ms();
+    g_stats.clock[g_rung].active_ms += now - g_rung_since;
+    g_rung_since = now;
+    g_rung = r;
+    g_port.set_clock(g_cfg.clocks[r]);
+}
+
+static void count(I2cFault f)
+{
+    I2cClockStats &c = g_stats.clock[g_rung];
+    if (f == I2cFault::NACK) c.nack++;
+    else if (f == I2cFault::TIMEOUT) c.timeout++;
+    else if (f == I2cFault::CRC) c.crc++;
+}
+
+// probes clean probes in a row at the current clock
+static bool probe_rung()
+{
+    for (uint8_t i = 0; i < g_cfg.probes; i++)
+    {
+        I2cFault f = g_port.probe();
+        if (f != I2cFault::NONE)
+        {
+            count(f);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool i2cbus_begin(const I2cBusPort &port, const I2cBusConfig &cfg)
+{
+    if (!port.set_clock || !port.probe || !cfg.n_clocks || cfg.n_clocks > I2CBUS_MAX_CLOCKS) return false;
+    g_port = port;
+    g_cfg = cfg;
+    if (!g_cfg.probes) g_cfg.probes = 1;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.n_clocks = g_cfg.n_clocks;
+    for (uint8_t i = 0; i < g_cfg.n_clocks; i++)
+    {
+        g_stats.clock[i].hz = g_cfg.clocks[i];
+        g_holdoff[i] = 1;
+    }
+    g_rung_since = now_ms();
+
+    for (int r = g_cfg.n_clocks - 1; r >= 0; r--)
+    {
+        g_rung = (uint8_t)r;
+        g_port.set_clock(g_cfg.clocks[r]);
+        if (probe_rung())
+        {
+            g_top = (uint8_t)r;
+            g_window_ms = g_clean_since = now_ms();
+            g_window_errors = 0;
+            VST_LOG("🔌 i2c: %lu kHz\n", (unsigned long)(g_cfg.clocks[r] / 1000));
+            return true;
+        }
+        VST_LOG("🔌 i2c: %lu kHz failed its probes\n", (unsigned long)(g_cfg.clocks[r] / 1000));
+    }
+    g_top = g_rung = 0;
+    g_window_ms = g_clean_since = now_ms();
+    g_window_errors = 0;
+    return false;
+}
+
+/* =========================================================
+   RUNTIME
+   ========================================================= */
+void i2cbus_transfer(uint32_t bytes, uint32_t us)
+{
+    I2cClockStats &c = g_stats.clock[g_rung];
+    c.bytes += bytes;
+    c.us += us;
+    c.transfers++;
+}
+
+void i2cbus_fault(I2cFault f)
+{
+    if (f == I2cFault::NONE) return;
+    count(f);
+    uint32_t now = now_ms();
+    if (now - g_window_ms > g_cfg.window_ms)
+    {
+        g_window_ms = now;
+        g_window_errors = 0;
+    }
+    if (g_window_errors < 255) g_window_errors++;
+    g_clean_since = now;
+}
+
+bool i2cbus_step()
+{
+    if (!g_port.set_clock) return false;
+    uint32_t now = now_ms();
+
+    if (g_window_errors >= g_cfg.max_errors && g_rung > 0)
+    {
+        uint8_t from = g_rung;
+        if (g_holdoff[from] < MAX_HOLDOFF) g_holdoff[from] *= 2;
+        set_rung(from - 1);
+        g_stats.downs++;
+        g_window_ms = g_clean_since = now;
+        g_window_errors = 0;
+        VST_LOG("🔌 i2c: %u errors, %lu -> %lu kHz\n", (unsigned)g_cfg.max_errors,
+                (unsigned long)(g_cfg.clocks[from] / 1000), (unsigned long)(g_cfg.clocks[g_rung] / 1000));
+        return true;
+    }
+
+    // A rung that held for a while has earned its holdoff back
+    if (g_holdoff[g_rung] > 1 && now - g_clean_since >= g_cfg.clean_ms)
+        g_holdoff[g_rung] = 1;
+
+    if (g_rung < g_top && now - g_clean_since >= g_cfg.clean_ms * g_holdoff[g_rung + 1])
+    {
+        uint8_t from = g_rung;
+        set_rung(from + 1);
+        if (!probe_rung())
+        {
+            if (g_holdoff[g_rung] < MAX_HOLDOFF) g_holdoff[g_rung] *= 2;
+            set_rung(from);
+            g_stats.failed_ups++;
+            g_clean_since = now_ms();
+            VST_LOG("🔌 i2c: %lu kHz failed its probes, staying at %lu kHz\n",
+                    (unsigned long)(g_cfg.clocks[from + 1] / 1000), (unsigned long)(g_cfg.clocks[from] / 1000));
+            return false;
+        }
+        g_stats.ups++;
+        g_window_ms = g_clean_since = now_ms();
+        g_window_errors = 0;
+        VST_LOG("🔌 i2c: clean for %lu s, %lu -> %lu kHz\n", (unsigned long)((now - g_rung_since) / 1000),
+                (unsigned long)(g_cfg.clocks[from] / 1000), (unsigned long)(g_cfg.clocks[g_rung] / 1000));
+        return true;
+    }
+    return false;
+}
+
+uint32_t i2cbus_hz()
+{
+    return g_cfg.n_clocks ? g_cfg.clocks[g_rung] : 0;
+}
+
+const I2cBusStats &i2cbus_stats()
+{
+    g_stats.clock[g_rung].active_ms += now_ms() - g_rung_since;
+    g_rung_since = now_ms();
+    return g_stats;
+}
+
+void i2cbus_report()
+{
+    const I2cBusStats &s = i2cbus_stats();
+    for (uint8_t i = 0; i < s.n_clocks; i++)
+    {
+        const I2cClockStats &c = s.clock[i];
+        if (!c.transfers && !c.nack && !c.timeout && !c.crc) continue;
+        VST_LOG("🔌 i2c %4lu kHz: %6.1f s, %7.1f KB in %lu transfers -> %5.1f KB/s, nack %lu timeout %lu crc %lu\n",
+                (unsigned long)(c.hz / 1000), c.active_ms / 1000.0, c.bytes / 1024.0, (unsigned long)c.transfers,
+                c.us ? c.bytes * 1e6 / 1024.0 / (double)c.us : 0.0,
+                (unsigned long)c.nack, (unsigned long)c.timeout, (unsigned long)c.crc);
+    }
+    VST_LOG("🔌 i2c: %lu down, %lu up, %lu failed up, now %lu kHz\n", (unsigned long)s.downs,
+            (unsigned long)s.ups, (unsigned long)s.failed_ups, (unsigned long)(i2cbus_hz() / 1000));
+}
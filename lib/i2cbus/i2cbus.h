@@ -0,0 +1,66 @@
+// lib/i2cbus/i2cbus.h — clock manager for a Vision AI I2C link
+//
+// Picks the fastest clock that passes its probes, steps down on faults
+// and back up after a clean period. VSTPRO/README.md 1.12.
+#pragma once
+#include <stdint.h>
+
+static constexpr uint8_t I2CBUS_MAX_CLOCKS = 4;
+
+// NACK: address or data not acknowledged. TIMEOUT: no reply in time.
+// CRC: a reply or image that does not parse or check out.
+enum class I2cFault : uint8_t { NONE, NACK, TIMEOUT, CRC };
+
+struct I2cBusPort
+{
+    void     (*set_clock)(uint32_t hz);
+    I2cFault (*probe)();                // one probe at the current clock
+};
+
+struct I2cBusConfig
+{
+    uint32_t clocks[I2CBUS_MAX_CLOCKS]; // ascending
+    uint8_t  n_clocks;
+    uint8_t  probes;                    // clean probes to accept a clock
+    uint8_t  max_errors;                // within window_ms: one rung down
+    uint32_t window_ms;
+    uint32_t clean_ms;                  // without errors: one rung up
+};
+
+struct I2cClockStats
+{
+    uint32_t hz;
+    uint64_t bytes;
+    uint64_t us;                        // spent in those transfers
+    uint32_t transfers;
+    uint32_t nack, timeout, crc;
+    uint32_t active_ms;                 // time at this clock
+};
+
+struct I2cBusStats
+{
+    I2cClockStats clock[I2CBUS_MAX_CLOCKS];
+    uint8_t  n_clocks;
+    uint32_t downs, ups, failed_ups;
+};
+
+I2cBusConfig i2cbus_default_config();
+
+// Probes from the fastest clock down; false if none passed (the slowest
+// stays set)
+bool i2cbus_begin(const I2cBusPort &port, const I2cBusConfig &cfg);
+
+// A read or write that moved bytes in us microseconds
+void i2cbus_transfer(uint32_t bytes, uint32_t us);
+
+void i2cbus_fault(I2cFault f);
+
+// Between frames: steps the clock when due. True if it changed.
+bool i2cbus_step();
+
+uint32_t i2cbus_hz();
+
+const I2cBusStats &i2cbus_stats();
+
+// One line per clock used: KB/s and errors
+void i2cbus_report();
@@ -0,0 +1,93 @@
+// lib/segstore/chunkwriter.cpp — coalesce file writes into aligned chunks
+
+#include "chunkwriter.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(ARDUINO)
+#include <esp_heap_caps.h>
+#endif
+
+uint8_t *chunk_alloc(size_t size, size_t *got)
+{
+    for (size_t s = size; s >= 4096; s /= 2)
+    {
+#if defined(ARDUINO)
+        void *p = heap_caps_aligned_alloc(4, s, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+#else
+        void *p = aligned_alloc(512, s);
+#endif
+        if (p)
+        {
+            if (got) *got = s;
+            return (uint8_t*)p;
+        }
+    }
+    if (got) *got = 0;
+    return nullptr;
+}
+
+void chunk_free(uint8_t *buf)
+{
+#if defined(ARDUINO)
+    heap_caps_free(buf);
+#else
+    free(buf);
+#endif
+}
+
+void chunk_attach(ChunkWriter &w, int fd, uint64_t off)
+{
+    w.fd = fd;
+    w.off = off;
+    w.fill = 0;
+}
+
+static bool write_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n)
+    {
+        ssize_t r = write(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+bool chunk_flush(ChunkWriter &w)
+{
+    if (!w.fill) return true;
+    if (!write_all(w.fd, w.buf, w.fill)) return false;
+
+    w.off += w.fill;
+    w.fill = 0;
+    w.chunks++;
+    return true;
+}
+
+bool chunk_write(ChunkWriter &w, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t*)data;
+
+    while (len)
+    {
+        // The staged window ends on the next chunk boundary of the file.
+        size_t window = w.cap - (size_t)(w.off % w.cap);
+        size_t n = window - w.fill;
+        if (n > len) n = len;
+
+        memcpy(w.buf + w.fill, p, n);
+        w.fill += n;
+        p += n;
+        len -= n;
+
+        if (w.fill == window && !chunk_flush(w))
+            return false;
+    }
+    return true;
+}
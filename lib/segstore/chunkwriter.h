@@ -0,0 +1,32 @@
+// lib/segstore/chunkwriter.h — coalesce file writes into aligned chunks
+//
+// Stages bytes in a DMA-capable buffer and writes whole multiples of the
+// chunk size, so FatFs transfers sectors straight from it.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+struct ChunkWriter
+{
+    int      fd = -1;
+    uint8_t *buf = nullptr;
+    size_t   cap = 0;       // chunk size, multiple of 512
+    size_t   fill = 0;      // staged bytes
+    uint64_t off = 0;       // file offset of buf[0]
+    uint32_t chunks = 0;    // write() calls issued (stats)
+};
+
+// Allocates a chunk buffer (internal DMA-capable RAM on the ESP32).
+// Tries size, then halves down to 4 KB. Returns nullptr on failure.
+uint8_t *chunk_alloc(size_t size, size_t *got);
+void chunk_free(uint8_t *buf);
+
+// Starts writing fd at file offset off (the fd must already be positioned there).
+void chunk_attach(ChunkWriter &w, int fd, uint64_t off);
+
+bool chunk_write(ChunkWriter &w, const void *data, size_t len);
+
+// Writes any staged bytes (a partial chunk). The next chunk_write()
+// first fills up to the following chunk boundary again. False on a write
+// error; w.off is then still where the failed write began.
+bool chunk_flush(ChunkWriter &w);
@@ -0,0 +1,685 @@
+// lib/segstore/segstore.cpp — append-only segment container (see segstore.h)
+
+#include "segstore.h"
+#include "chunkwriter.h"
+#include "crc32.h"
+#include "vstlog.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// One open segment per stream. Both share the chunk buffer; it is flushed
+// when the next record goes to the other stream.
+struct Stream
+{
+    int      fd = -1;
+    uint32_t seq = 0;
+    uint32_t size = 0;
+    uint32_t opened_s = 0;
+    uint16_t unsynced = 0;
+};
+
+static const char *const SEG_PREFIX[SEG_STREAMS] = { "SEG", "EMP" };
+
+static char        g_root[32] = {0};
+static SegConfig   g_cfg = {};
+static Stream      g_st[SEG_STREAMS];
+static int         g_cw_stream = -1;    // stream currently staged in g_cw
+static ChunkWriter g_cw;
+static uint32_t    g_seq = 0;           // highest seq used, shared by all streams
+static SegStats    g_stats = {};
+
+// HEAD checkpoint: two 32 B slots written alternately, so a torn write
+// always leaves the previous checkpoint readable.
+//   u32 magic 'VHED'  u32 counter  u32 seq[2]  u32 size[2]  u32 tag  u32 crc
+static constexpr uint32_t SEG_HEAD_MAGIC = 0x44454856; // "VHED"
+static constexpr size_t   SEG_HEAD_SLOT  = 32;
+static constexpr int      SEG_RECOVERED_MAX = 8;
+
+struct Recovered
+{
+    SegStream stream;
+    uint32_t  seq;
+    uint32_t  end;          // first byte past the last good record (0 = removed)
+};
+
+static int         g_head_fd = -1;
+static uint32_t    g_head_counter = 0;
+static uint32_t    g_tag = 0;
+static uint32_t    g_boot_tag = 0;
+static Recovered   g_recovered[SEG_RECOVERED_MAX];
+static int         g_recovered_n = 0;
+static SegRecovery g_recovery = {};
+
+/* =========================================================
+   UTIL
+   ========================================================= */
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t mono_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec;
+}
+
+static uint64_t mono_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+void segstore_path(SegStream stream, uint32_t seq, char *out, size_t out_sz)
+{
+    snprintf(out, out_sz, "%s/seg/%s_%06lu.VSG", g_root, SEG_PREFIX[stream], (unsigned long)seq);
+}
+
+// Writes what is staged for the current stream. On failure that stream
+// is closed at the bytes that reached the card, so the checkpoint does
+// not vouch for the rest and the next record opens a new segment.
+static bool flush_staged()
+{
+    if (g_cw_stream < 0 || chunk_flush(g_cw)) return true;
+
+    Stream &st = g_st[g_cw_stream];
+    VST_LOG("❌ segstore: flush failed in segment %lu (errno=%d)\n", (unsigned long)st.seq, errno);
+    g_stats.errors++;
+    st.size = (uint32_t)g_cw.off;
+    close(st.fd);
+    st.fd = -1;
+    st.unsynced = 0;
+    g_cw.fill = 0;
+    g_cw_stream = -1;
+    return false;
+}
+
+// Points the shared chunk buffer at stream s (flushing the other one).
+// False if the other stream's staged bytes could not be written.
+static bool stage(SegStream s)
+{
+    if (g_cw_stream == (int)s) return true;
+    bool ok = flush_staged();
+    chunk_attach(g_cw, g_st[s].fd, g_st[s].size);
+    g_cw_stream = s;
+    return ok;
+}
+
+static bool open_next_segment(SegStream s, uint32_t epoch)
+{
+    char path[64];
+    segstore_path(s, g_seq + 1, path, sizeof(path));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0)
+    {
+        VST_LOG("❌ segstore: cannot create %s (errno=%d)\n", path, errno);
+        return false;
+    }
+
+    uint8_t hdr[SEG_HDR_LEN] = {0};
+    put_u32(hdr + 0, SEG_FILE_MAGIC);
+    put_u16(hdr + 4, SEG_VERSION);
+    put_u16(hdr + 6, (uint16_t)SEG_HDR_LEN);
+    put_u32(hdr + 8, g_seq + 1);
+    put_u32(hdr + 12, epoch);
+    hdr[16] = (uint8_t)s;
+    put_u32(hdr + 28, crc32_update(0, hdr, 28));
+
+    if (!flush_staged())
+    {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    chunk_attach(g_cw, fd, 0);
+    g_cw_stream = s;
+    if (!chunk_write(g_cw, hdr, sizeof(hdr)))
+    {
+        VST_LOG("❌ segstore: header write failed for %s\n", path);
+        close(fd);
+        g_cw_stream = -1;
+        return false;
+    }
+
+    Stream &st = g_st[s];
+    st.fd = fd;
+    st.seq = ++g_seq;
+    st.size = SEG_HDR_LEN;
+    st.opened_s = mono_s();
+    st.unsynced = 0;
+    g_stats.seq = g_seq;
+
+    VST_LOG("🗂 segment open: %s\n", path);
+    return true;
+}
+
+/* =========================================================
+   CHECKPOINT / RECOVERY
+   ========================================================= */
+static void write_head()
+{
+    if (g_head_fd < 0) return;
+
+    uint8_t b[SEG_HEAD_SLOT] = {0};
+    g_head_counter++;
+    put_u32(b + 0, SEG_HEAD_MAGIC);
+    put_u32(b + 4, g_head_counter);
+    for (int i = 0; i < SEG_STREAMS; i++)
+    {
+        put_u32(b + 8 + 4 * i, g_st[i].seq);
+        put_u32(b + 16 + 4 * i, g_st[i].size);
+    }
+    put_u32(b + 24, g_tag);
+    put_u32(b + 28, crc32_update(0, b, 28));
+
+    off_t at = (off_t)(g_head_counter & 1) * SEG_HEAD_SLOT;
+    if (pwrite(g_head_fd, b, sizeof(b), at) == (ssize_t)sizeof(b))
+        fsync(g_head_fd);
+}
+
+// Loads the newest valid slot. False on first boot or if both slots are bad.
+static bool read_head(uint32_t seq[SEG_STREAMS], uint32_t size[SEG_STREAMS], uint32_t &tag)
+{
+    uint8_t b[2 * SEG_HEAD_SLOT];
+    ssize_t n = pread(g_head_fd, b, sizeof(b), 0);
+    const uint8_t *best = nullptr;
+
+    for (int k = 0; k < 2; k++)
+    {
+        const uint8_t *p = b + k * SEG_HEAD_SLOT;
+        if (n < (ssize_t)((k + 1) * SEG_HEAD_SLOT)) break;
+        if (get_u32(p) != SEG_HEAD_MAGIC || get_u32(p + 28) != crc32_update(0, p, 28)) continue;
+        if (!best || get_u32(p + 4) > get_u32(best + 4)) best = p;
+    }
+    if (!best) return false;
+
+    g_head_counter = get_u32(best + 4);
+    for (int i = 0; i < SEG_STREAMS; i++)
+    {
+        seq[i] = get_u32(best + 8 + 4 * i);
+        size[i] = get_u32(best + 16 + 4 * i);
+    }
+    tag = get_u32(best + 24);
+    return true;
+}
+
+static void note_recovered(SegStream s, uint32_t seq, uint32_t end)
+{
+    if (g_recovered_n < SEG_RECOVERED_MAX)
+        g_recovered[g_recovered_n++] = Recovered{ s, seq, end };
+}
+
+// Validates records from offset from (0 = including the segment header)
+// and truncates the file at the first bad one. Only the part written after
+// the last checkpoint is ever scanned.
+static void scan_tail(SegStream s, uint32_t seq, uint32_t from)
+{
+    char path[64];
+    segstore_path(s, seq, path, sizeof(path));
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return;
+
+    struct stat st;
+    uint32_t len = (fstat(fd, &st) == 0) ? (uint32_t)st.st_size : 0;
+    g_recovery.segments++;
+
+    if (from == 0)
+    {
+        uint8_t h[SEG_HDR_LEN];
+        if (pread(fd, h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+            get_u32(h) != SEG_FILE_MAGIC || get_u32(h + 28) != crc32_update(0, h, 28))
+        {
+            // Created but the header never made it: nothing to keep
+            close(fd);
+            unlink(path);
+            g_recovery.removed++;
+            g_recovery.truncated += len;
+            note_recovered(s, seq, 0);
+            VST_LOG("🩺 segstore: removed torn segment %s\n", path);
+            return;
+        }
+        from = SEG_HDR_LEN;
+    }
+
+    uint32_t off = from;
+    while (off + SEG_REC_HDR_LEN <= len)
+    {
+        uint8_t h[SEG_REC_HDR_LEN];
+        if (pread(fd, h, sizeof(h), off) != (ssize_t)sizeof(h)) break;
+        if (get_u32(h) != SEG_REC_MAGIC || get_u32(h + 28) != crc32_update(0, h, 28)) break;
+
+        uint32_t body = get_u32(h + 16) + get_u32(h + 20);
+        uint32_t hdr_len = get_u16(h + 4);
+        if (hdr_len < SEG_REC_HDR_LEN || body > len - off - hdr_len) break;
+
+        // CRC the body through the (otherwise idle) chunk buffer
+        uint32_t crc = 0, pos = off + hdr_len, left = body;
+        bool ok = true;
+        while (left)
+        {
+            size_t n = left < g_cw.cap ? left : g_cw.cap;
+            if (pread(fd, g_cw.buf, n, pos) != (ssize_t)n) { ok = false; break; }
+            crc = crc32_update(crc, g_cw.buf, n);
+            pos += n;
+            left -= n;
+        }
+        g_recovery.scanned += hdr_len + body;
+        if (!ok || crc != get_u32(h + 24)) break;
+
+        off += hdr_len + body;
+        g_recovery.records++;
+    }
+
+    if (off < len)
+    {
+        if (ftruncate(fd, off) == 0) fsync(fd);
+        g_recovery.truncated += len - off;
+        VST_LOG("🩺 segstore: %s truncated %lu -> %lu bytes\n",
+                path, (unsigned long)len, (unsigned long)off);
+    }
+    note_recovered(s, seq, off < len ? off : len);
+    close(fd);
+}
+
+static bool segment_exists(uint32_t seq, SegStream *s)
+{
+    for (int i = 0; i < SEG_STREAMS; i++)
+    {
+        char path[64];
+        struct stat st;
+        segstore_path((SegStream)i, seq, path, sizeof(path));
+        if (stat(path, &st) == 0)
+        {
+            *s = (SegStream)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Boot without a checkpoint (new card or older firmware): list the
+// directory once to find the highest seq. Old segments are not scanned;
+// readers already stop at a torn record.
+static bool find_last_seq(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        VST_LOG("❌ segstore: opendir %s failed\n", dir);
+        return false;
+    }
+
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr)
+    {
+        SegStream s;
+        uint32_t seq;
+        if (segstore_parse_name(e->d_name, &s, &seq) && seq > g_seq)
+            g_seq = seq;
+    }
+    closedir(d);
+    return true;
+}
+
+static bool recover(const char *dir)
+{
+    uint64_t t0 = mono_us();
+    uint32_t seq[SEG_STREAMS], size[SEG_STREAMS];
+
+    g_recovery.head_valid = read_head(seq, size, g_boot_tag);
+    if (!g_recovery.head_valid)
+    {
+        bool ok = find_last_seq(dir);
+        g_recovery.us = (uint32_t)(mono_us() - t0);
+        return ok;
+    }
+
+    // Tails of the segments that were open at the last checkpoint
+    for (int i = 0; i < SEG_STREAMS; i++)
+    {
+        if (seq[i]) scan_tail((SegStream)i, seq[i], size[i]);
+        if (seq[i] > g_seq) g_seq = seq[i];
+    }
+
+    // Segments opened after it: seq numbers are consecutive, probe upward
+    SegStream s;
+    while (segment_exists(g_seq + 1, &s))
+    {
+        g_seq++;
+        scan_tail(s, g_seq, 0);
+    }
+
+    g_tag = g_boot_tag;
+    g_recovery.us = (uint32_t)(mono_us() - t0);
+    return true;
+}
+
+static void sync_stream(SegStream s)
+{
+    Stream &st = g_st[s];
+    if (st.fd < 0) return;
+    if (g_cw_stream == (int)s && !flush_staged()) return;
+    fsync(st.fd);
+    st.unsynced = 0;
+}
+
+/* =========================================================
+   PUBLIC API
+   ========================================================= */
+bool segstore_init(const char *root, const SegConfig &cfg)
+{
+    snprintf(g_root, sizeof(g_root), "%s", root ? root : "");
+    g_cfg = cfg;
+    for (Stream &st : g_st) st = Stream();
+    g_cw_stream = -1;
+    g_seq = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+    memset(&g_recovery, 0, sizeof(g_recovery));
+    g_recovered_n = 0;
+    g_head_counter = 0;
+    g_tag = g_boot_tag = 0;
+    if (g_head_fd >= 0) close(g_head_fd);
+    g_head_fd = -1;
+
+    if (!g_cw.buf)
+    {
+        g_cw.buf = chunk_alloc(g_cfg.chunk_bytes ? g_cfg.chunk_bytes : 32768, &g_cw.cap);
+        if (!g_cw.buf)
+        {
+            VST_LOG("❌ segstore: no memory for chunk buffer\n");
+            return false;
+        }
+    }
+
+    char dir[48];
+    snprintf(dir, sizeof(dir), "%s/seg", g_root);
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+    {
+        VST_LOG("❌ segstore: mkdir %s failed (errno=%d)\n", dir, errno);
+        return false;
+    }
+
+    // Never append to a segment from a previous boot: start a new one after
+    // repairing the tail the last boot may have left torn.
+    char head[64];
+    snprintf(head, sizeof(head), "%s/HEAD.VSH", dir);
+    g_head_fd = open(head, O_RDWR | O_CREAT, 0664);
+    if (g_head_fd < 0)
+        VST_LOG("⚠️ segstore: cannot open %s, running without checkpoints\n", head);
+
+    if (!recover(dir)) return false;
+
+    g_stats.seq = g_seq;
+    VST_LOG("🗂 segstore ready: %s (last segment %lu, max %lu KB / %lu s, chunk %u KB)\n",
+            dir,
+            (unsigned long)g_seq,
+            (unsigned long)(g_cfg.max_bytes / 1024),
+            (unsigned long)g_cfg.max_age_s,
+            (unsigned)(g_cw.cap / 1024));
+    return true;
+}
+
+size_t segstore_encode_meta(const FrameMeta &meta, uint8_t *out, size_t cap)
+{
+    size_t need = 12 + (size_t)meta.box_count * 10 + (meta.trigger.valid ? 18 : 0);
+    if (!out || cap < need) return 0;
+
+    put_u32(out + 0, meta.frame);
+    put_u16(out + 4, meta.perf.preprocess);
+    put_u16(out + 6, meta.perf.inference);
+    put_u16(out + 8, meta.perf.postprocess);
+    out[10] = meta.box_count;
+    out[11] = meta.boxes_dropped;
+
+    uint8_t *p = out + 12;
+    for (uint8_t i = 0; i < meta.box_count; i++)
+    {
+        const FrameBox &b = meta.boxes[i];
+        p[0] = b.target;
+        p[1] = b.score;
+        put_u16(p + 2, b.x);
+        put_u16(p + 4, b.y);
+        put_u16(p + 6, b.w);
+        put_u16(p + 8, b.h);
+        p += 10;
+    }
+
+    // Readers stop after box_count boxes, so v1 readers skip this
+    if (meta.trigger.valid)
+    {
+        const FrameTrigger &t = meta.trigger;
+        p[0] = 'T';
+        p[1] = t.confirmed ? 1 : 0;
+        p[2] = t.box_count;
+        p[3] = 0;
+        put_u32(p + 4, t.lag_ms);
+        p[8] = t.best.target;
+        p[9] = t.best.score;
+        put_u16(p + 10, t.best.x);
+        put_u16(p + 12, t.best.y);
+        put_u16(p + 14, t.best.w);
+        put_u16(p + 16, t.best.h);
+    }
+    return need;
+}
+
+bool segstore_append(uint32_t frame_id,
+                     uint32_t epoch,
+                     const FrameMeta *meta,
+                     const uint8_t *jpeg,
+                     size_t jpeg_len,
+                     SegLocation *loc,
+                     SegStream stream)
+{
+    if (!g_root[0] || !jpeg || !jpeg_len) return false;
+
+    uint64_t t0 = mono_us();
+
+    uint8_t meta_buf[SEG_META_MAX];
+    size_t meta_len = meta ? segstore_encode_meta(*meta, meta_buf, sizeof(meta_buf)) : 0;
+    uint32_t rec_len = (uint32_t)(SEG_REC_HDR_LEN + meta_len + jpeg_len);
+
+    if (stream >= SEG_STREAMS) stream = SEG_STREAM_DETECT;
+    Stream &st = g_st[stream];
+
+    if (st.fd >= 0)
+    {
+        bool full = (st.size > SEG_HDR_LEN) && (st.size + rec_len > g_cfg.max_bytes);
+        bool old  = g_cfg.max_age_s && (mono_s() - st.opened_s >= g_cfg.max_age_s);
+        if (full || old)
+        {
+            segstore_close(stream);
+            g_stats.rollovers++;
+        }
+    }
+
+    if (st.fd < 0 && !open_next_segment(stream, epoch))
+    {
+        g_stats.errors++;
+        return false;
+    }
+    if (!stage(stream))
+        return false;
+
+    uint32_t data_crc = crc32_update(0, meta_buf, meta_len);
+    data_crc = crc32_update(data_crc, jpeg, jpeg_len);
+
+    uint8_t hdr[SEG_REC_HDR_LEN];
+    put_u32(hdr + 0, SEG_REC_MAGIC);
+    put_u16(hdr + 4, (uint16_t)SEG_REC_HDR_LEN);
+    hdr[6] = SEG_REC_FRAME;
+    hdr[7] = 0;
+    put_u32(hdr + 8, frame_id);
+    put_u32(hdr + 12, epoch);
+    put_u32(hdr + 16, (uint32_t)meta_len);
+    put_u32(hdr + 20, (uint32_t)jpeg_len);
+    put_u32(hdr + 24, data_crc);
+    put_u32(hdr + 28, crc32_update(0, hdr, 28));
+
+    // Staged, not flushed: the chunk writer hands FatFs aligned chunks.
+    bool ok = chunk_write(g_cw, hdr, sizeof(hdr));
+    if (ok && meta_len) ok = chunk_write(g_cw, meta_buf, meta_len);
+    if (ok) ok = chunk_write(g_cw, jpeg, jpeg_len);
+
+    if (!ok)
+    {
+        // The torn record fails its CRC and ends the segment for readers.
+        VST_LOG("❌ segstore: write failed in segment %lu\n", (unsigned long)st.seq);
+        g_stats.errors++;
+        segstore_close(stream);
+        return false;
+    }
+
+    if (loc)
+    {
+        loc->seq = st.seq;
+        loc->offset = st.size;
+        loc->size = rec_len;
+        loc->stream = stream;
+    }
+
+    st.size += rec_len;
+
+    if (g_cfg.sync_every && ++st.unsynced >= g_cfg.sync_every)
+        segstore_sync();
+
+    g_stats.records++;
+    g_stats.bytes += rec_len;
+    g_stats.write_us += mono_us() - t0;
+    g_stats.chunks = g_cw.chunks;
+    return true;
+}
+
+void segstore_sync()
+{
+    for (int s = 0; s < SEG_STREAMS; s++)
+        sync_stream((SegStream)s);
+
+    // Data first, then the checkpoint that vouches for it
+    write_head();
+}
+
+void segstore_close(SegStream stream)
+{
+    Stream &st = g_st[stream];
+    if (st.fd < 0) return;
+    if (g_cw_stream == (int)stream)
+    {
+        if (!flush_staged()) return;
+        g_cw_stream = -1;
+    }
+    fsync(st.fd);
+    close(st.fd);
+    st.fd = -1;
+    st.unsynced = 0;
+}
+
+void segstore_close()
+{
+    for (int s = 0; s < SEG_STREAMS; s++)
+        segstore_close((SegStream)s);
+}
+
+uint32_t segstore_open_seq(SegStream stream)
+{
+    return g_st[stream].fd >= 0 ? g_st[stream].seq : 0;
+}
+
+bool segstore_parse_name(const char *name, SegStream *stream, uint32_t *seq)
+{
+    for (int s = 0; s < SEG_STREAMS; s++)
+    {
+        size_t n = strlen(SEG_PREFIX[s]);
+        unsigned long v = 0;
+        char ext[4] = {0};
+        if (strncmp(name, SEG_PREFIX[s], n) == 0 && name[n] == '_' &&
+            sscanf(name + n + 1, "%06lu.%3s", &v, ext) == 2 && strcasecmp(ext, "VSG") == 0)
+        {
+            if (stream) *stream = (SegStream)s;
+            if (seq) *seq = (uint32_t)v;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool segstore_locate_jpeg(int fd, uint32_t offset, uint32_t *frame_id,
+                          uint32_t *jpeg_off, uint32_t *jpeg_len)
+{
+    uint8_t h[SEG_REC_HDR_LEN];
+    if (pread(fd, h, sizeof(h), offset) != (ssize_t)sizeof(h)) return false;
+    if (get_u32(h) != SEG_REC_MAGIC || get_u32(h + 28) != crc32_update(0, h, 28)) return false;
+
+    uint32_t start = offset + get_u16(h + 4) + get_u32(h + 16);
+    uint32_t len = get_u32(h + 20);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < (uint64_t)start + len) return false;
+
+    if (frame_id) *frame_id = get_u32(h + 8);
+    *jpeg_off = start;
+    *jpeg_len = len;
+    return true;
+}
+
+void segstore_set_tag(uint32_t tag)
+{
+    g_tag = tag;
+}
+
+uint32_t segstore_boot_tag()
+{
+    return g_boot_tag;
+}
+
+bool segstore_record_intact(SegStream stream, uint32_t seq, uint32_t offset, uint32_t size)
+{
+    for (int i = 0; i < g_recovered_n; i++)
+    {
+        const Recovered &r = g_recovered[i];
+        if (r.stream == stream && r.seq == seq)
+            return r.end && (uint64_t)offset + size <= r.end;
+    }
+    return true;
+}
+
+const SegRecovery &segstore_recovery()
+{
+    return g_recovery;
+}
+
+const SegStats &segstore_stats()
+{
+    return g_stats;
+}
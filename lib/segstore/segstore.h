@@ -0,0 +1,113 @@
+// lib/segstore/segstore.h — append-only segment container for frames
+//
+// SEG_/EMP_ streams under <root>/seg, checkpointed in HEAD.VSH. File and
+// record layout: lib/README.md.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framemeta.h"
+
+static constexpr uint32_t SEG_FILE_MAGIC   = 0x47455356; // "VSEG"
+static constexpr uint32_t SEG_REC_MAGIC    = 0x43455256; // "VREC"
+static constexpr uint16_t SEG_VERSION      = 1;
+static constexpr size_t   SEG_HDR_LEN      = 32;
+static constexpr size_t   SEG_REC_HDR_LEN  = 32;
+static constexpr uint8_t  SEG_REC_FRAME    = 1;
+
+enum SegStream : uint8_t
+{
+    SEG_STREAM_DETECT = 0,  // SEG_nnnnnn.VSG
+    SEG_STREAM_EMPTY  = 1,  // EMP_nnnnnn.VSG
+};
+static constexpr int SEG_STREAMS = 2;
+
+struct SegConfig
+{
+    uint32_t max_bytes;     // roll over when the segment would exceed this
+    uint32_t max_age_s;     // roll over when the segment is older (0 = off)
+    uint16_t sync_every;    // fsync after this many records (0 = only on close)
+    uint32_t chunk_bytes;   // write coalescing chunk (see chunkwriter.h)
+};
+
+// Where a record landed; used by the frame index.
+struct SegLocation
+{
+    uint32_t seq;
+    uint32_t offset;        // of the record header
+    uint32_t size;          // header + meta + jpeg
+    SegStream stream;
+};
+
+struct SegStats
+{
+    uint32_t seq;           // current segment
+    uint32_t records;       // appended since boot
+    uint64_t bytes;         // appended since boot
+    uint32_t rollovers;
+    uint32_t errors;
+    uint64_t write_us;      // time spent in segstore_append()
+    uint32_t chunks;        // aligned chunk writes issued
+};
+
+// Mounts the container under <root>/seg and resumes after the highest
+// existing segment number. root is the VFS mount point (e.g. "/sdcard").
+bool segstore_init(const char *root, const SegConfig &cfg);
+
+// Appends one frame. epoch may be 0 when wall time is not known yet.
+bool segstore_append(uint32_t frame_id,
+                     uint32_t epoch,
+                     const FrameMeta *meta,
+                     const uint8_t *jpeg,
+                     size_t jpeg_len,
+                     SegLocation *loc = nullptr,
+                     SegStream stream = SEG_STREAM_DETECT);
+
+// Forces buffered data and the FAT directory entry to the card.
+void segstore_sync();
+
+// Closes the current segment(s) (next append opens a new one).
+void segstore_close(SegStream stream);
+void segstore_close();
+
+struct SegRecovery
+{
+    bool     head_valid;    // false on first boot: nothing was checked
+    uint32_t us;            // boot recovery time
+    uint32_t segments;      // segment tails checked
+    uint32_t records;       // records found intact after the checkpoint
+    uint64_t scanned;       // bytes read and CRC checked
+    uint64_t truncated;     // bytes cut off torn tails
+    uint32_t removed;       // segments without a valid header, deleted
+};
+
+const SegRecovery &segstore_recovery();
+
+// False if recovery cut the record (or its whole segment) off at boot.
+bool segstore_record_intact(SegStream stream, uint32_t seq, uint32_t offset, uint32_t size);
+
+// An opaque value saved with each checkpoint (the frame index stores its
+// current day file there) and returned at the next boot.
+void segstore_set_tag(uint32_t tag);
+uint32_t segstore_boot_tag();
+
+// Seq of the segment open for writing in stream, 0 if none.
+uint32_t segstore_open_seq(SegStream stream);
+
+// Checks the record header at offset of an open segment file and gives
+// the JPEG span. False if the header is bad or the record is not
+// completely on the card yet (still staged, see segstore_sync()).
+bool segstore_locate_jpeg(int fd, uint32_t offset, uint32_t *frame_id,
+                          uint32_t *jpeg_off, uint32_t *jpeg_len);
+
+// "SEG_000042.VSG" -> DETECT, 42. False for other names.
+bool segstore_parse_name(const char *name, SegStream *stream, uint32_t *seq);
+void segstore_path(SegStream stream, uint32_t seq, char *out, size_t out_sz);
+
+const SegStats &segstore_stats();
+
+// Longest encoded meta: header, every box, the trigger block
+static constexpr size_t SEG_META_MAX = 12 + FRAME_META_MAX_BOXES * 10 + 18;
+
+// Encodes meta in the v1 record layout. Returns bytes written (0 if cap is too small).
+size_t segstore_encode_meta(const FrameMeta &meta, uint8_t *out, size_t cap);
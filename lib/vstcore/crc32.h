@@ -0,0 +1,43 @@
+// lib/vstcore/crc32.h — CRC-32 (IEEE, zlib compatible) for storage records
+//
+// On the ESP32 this is the ROM routine behind esp_crc32_le(); on the host
+// (host/ benchmarks) a small table version gives identical results.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include "esp_crc.h"
+
+static inline uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    return esp_crc32_le(crc, (const uint8_t*)data, (uint32_t)len);
+}
+
+#else
+
+static inline uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    static uint32_t table[256];
+    static bool ready = false;
+
+    if (!ready)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            table[i] = c;
+        }
+        ready = true;
+    }
+
+    const uint8_t *p = (const uint8_t*)data;
+    crc = ~crc;
+    while (len--)
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+#endif
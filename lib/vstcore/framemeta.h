@@ -0,0 +1,71 @@
+// lib/vstcore/framemeta.h — per-frame inference metadata
+//
+// Shared by VSTPRO (filled straight from AI.perf() / AI.boxes()) and the
+// Receiver (parsed from the broker "JSON {...}" line, framemeta_json.h).
+// Fixed size, no heap; boxes beyond FRAME_META_MAX_BOXES are counted in
+// boxes_dropped but not stored.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr size_t FRAME_META_MAX_BOXES = 16;
+
+struct FrameBox
+{
+    uint8_t  target;
+    uint8_t  score;     // percent
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+};
+
+struct FramePerf
+{
+    uint16_t preprocess;    // ms
+    uint16_t inference;     // ms
+    uint16_t postprocess;   // ms
+};
+
+// Two-phase capture: the result that asked for the image. The stored
+// boxes and image come from a later capture; confirmed says whether its
+// boxes still pass the same image policy.
+struct FrameTrigger
+{
+    bool      valid;        // false: boxes and image are from one capture
+    bool      confirmed;
+    uint8_t   box_count;
+    FrameBox  best;         // highest scoring box of the trigger result
+    uint32_t  lag_ms;       // trigger capture to stored capture
+};
+
+struct FrameMeta
+{
+    bool      valid;
+    uint32_t  frame;
+    FramePerf perf;
+    uint8_t   box_count;
+    uint8_t   boxes_dropped;
+    FrameBox  boxes[FRAME_META_MAX_BOXES];
+    uint64_t  capture_us;   // esp_timer when the image was taken, 0 = unknown
+    int64_t   capture_ms;   // the same in UTC ms (timesync.h), 0 = no network time yet
+    FrameTrigger trigger;
+};
+
+// Index of the highest scoring box, or -1 when there are none.
+static inline int framemeta_best_box(const FrameMeta &meta)
+{
+    int best = -1;
+    for (int i = 0; i < (int)meta.box_count; i++)
+    {
+        if (best < 0 || meta.boxes[i].score > meta.boxes[best].score)
+            best = i;
+    }
+    return best;
+}
+
+// A detection in the stored capture or in the result that triggered it
+static inline bool framemeta_detected(const FrameMeta &meta)
+{
+    return meta.box_count || (meta.trigger.valid && meta.trigger.box_count);
+}
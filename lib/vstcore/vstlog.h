@@ -0,0 +1,10 @@
+// lib/vstcore/vstlog.h — logging for modules that also build on the host
+#pragma once
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#define VST_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <cstdio>
+#define VST_LOG(...) printf(__VA_ARGS__)
+#endif
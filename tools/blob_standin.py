@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Minimal Azure Blob endpoint for host tests when Azurite is not at hand.
+
+Implements what VSTPRO/src/azblob.cpp uses, path-style like Azurite
+(http://127.0.0.1:10000/<account>/<container>/<blob>):
+
+  PUT ?restype=container             create container (201 / 409)
+  PUT ?comp=block&blockid=<id>       stage a block (201)
+  PUT ?comp=blocklist                commit <Latest> ids (201 / 400 InvalidBlockList)
+  PUT                                Put Blob, whole blob in one request (201)
+  GET (x-ms-range: bytes=a-b)        read a committed blob (200 / 206 / 404 / 416)
+  GET ?restype=container&comp=list   List Blobs (prefix, marker, maxresults)
+  DELETE                             delete a blob (202 / 404)
+
+SAS query parameters are accepted and ignored. Committed blobs are also
+written under --dir so they can be opened as files.
+
+    python3 blob_standin.py --port 10000 --dir /tmp/vst_blobs
+"""
+
+import argparse
+import os
+import re
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, unquote, urlsplit
+from xml.sax.saxutils import escape
+
+LOCK = threading.Lock()
+CONTAINERS = set()
+STAGED = {}         # (container, blob) -> {block id: bytes}
+BLOBS = {}          # (container, blob) -> bytes
+STATS = {"blocks": 0, "commits": 0, "rejected": 0, "lists": 0}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            super().log_message(fmt, *args)
+
+    def reply(self, status, body=b"", headers=None):
+        self.send_response(status)
+        for k, v in (headers or {}).items():
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if body and self.command != "HEAD":
+            self.wfile.write(body)
+
+    def target(self):
+        u = urlsplit(self.path)
+        parts = unquote(u.path).lstrip("/").split("/", 2)
+        q = {k: v[0] for k, v in parse_qs(u.query).items()}
+        container = parts[1] if len(parts) > 1 else ""
+        blob = parts[2] if len(parts) > 2 else ""
+        return container, blob, q
+
+    def body(self):
+        n = int(self.headers.get("Content-Length") or 0)
+        return self.rfile.read(n) if n else b""
+
+    def do_PUT(self):
+        container, blob, q = self.target()
+        data = self.body()
+        with LOCK:
+            if q.get("restype") == "container":
+                if container in CONTAINERS:
+                    return self.reply(409)
+                CONTAINERS.add(container)
+                return self.reply(201)
+
+            if container not in CONTAINERS:
+                return self.reply(404)
+            key = (container, blob)
+
+            if q.get("comp") == "block":
+                STAGED.setdefault(key, {})[q.get("blockid", "")] = data
+                STATS["blocks"] += 1
+                return self.reply(201)
+
+            if q.get("comp") == "blocklist":
+                ids = re.findall(r"<(?:Latest|Uncommitted)>([^<]*)</", data.decode(errors="replace"))
+                staged = STAGED.get(key, {})
+                if not ids or any(i not in staged for i in ids):
+                    STATS["rejected"] += 1
+                    return self.reply(400, b"InvalidBlockList")
+                BLOBS[key] = b"".join(staged[i] for i in ids)
+                STAGED.pop(key, None)
+                STATS["commits"] += 1
+                self.save(key)
+                return self.reply(201)
+
+            BLOBS[key] = data           # Put Blob
+            self.save(key)
+            return self.reply(201)
+
+    def do_GET(self):
+        container, blob, q = self.target()
+        if q.get("restype") == "container" and q.get("comp") == "list":
+            return self.list(container, q)
+        with LOCK:
+            data = BLOBS.get((container, blob))
+        if data is None:
+            return self.reply(404)
+        m = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("x-ms-range") or self.headers.get("Range") or "")
+        if not m:
+            return self.reply(200, data)
+        a = int(m.group(1))
+        if a >= len(data):
+            return self.reply(416)      # InvalidRange, nothing at that offset yet
+        b = min(int(m.group(2)) if m.group(2) else len(data) - 1, len(data) - 1)
+        return self.reply(206, data[a:b + 1], {"Content-Range": "bytes %d-%d/%d" % (a, b, len(data))})
+
+    def do_DELETE(self):
+        container, blob, q = self.target()
+        key = (container, blob)
+        with LOCK:
+            if BLOBS.pop(key, None) is None:
+                return self.reply(404)
+        if self.server.dir:
+            try:
+                os.remove(os.path.join(self.server.dir, *key))
+            except OSError:
+                pass
+        return self.reply(202)
+
+    def list(self, container, q):
+        prefix = q.get("prefix", "")
+        marker = q.get("marker", "")
+        most = int(q.get("maxresults") or 5000)
+        with LOCK:
+            if container not in CONTAINERS:
+                return self.reply(404)
+            names = sorted(b for c, b in BLOBS if c == container and b.startswith(prefix) and b > marker)
+            sizes = {b: len(BLOBS[(container, b)]) for b in names[:most]}
+        page, rest = names[:most], names[most:]
+        xml = ['<?xml version="1.0" encoding="utf-8"?>',
+               '<EnumerationResults ContainerName="%s"><Prefix>%s</Prefix><Blobs>' % (escape(container), escape(prefix))]
+        for b in page:
+            xml.append("<Blob><Name>%s</Name><Properties><Content-Length>%d</Content-Length>"
+                       "<BlobType>BlockBlob</BlobType></Properties></Blob>" % (escape(b), sizes[b]))
+        # The marker is the last name returned; the next page starts after it
+        xml.append("</Blobs><NextMarker>%s</NextMarker></EnumerationResults>" % (escape(page[-1]) if rest else ""))
+        STATS["lists"] += 1
+        return self.reply(200, "".join(xml).encode(), {"Content-Type": "application/xml"})
+
+    def save(self, key):
+        if not self.server.dir:
+            return
+        path = os.path.join(self.server.dir, *key)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(BLOBS[key])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=10000)
+    ap.add_argument("--dir", default="", help="also write committed blobs here")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    srv = ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+    srv.dir = args.dir
+    srv.verbose = args.verbose
+    print("blob stand-in on http://127.0.0.1:%d" % args.port, flush=True)
+    try:
+        srv.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("stats:", STATS)
+
+
+if __name__ == "__main__":
+    main()
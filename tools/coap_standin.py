@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Local CoAP server for VSTPRO hornet alerts (VSTPRO/src/alert.h).
+
+Accepts POST /<path> over UDP, ACKs confirmable messages with 2.04
+Changed (piggybacked, same message id and token), and decodes the alert
+payload:
+
+  u8 version, u8 node length, node id, u32 epoch, u32 frame id,
+  u16 frames, u16 seq, u8 target, u8 score, u16 x, y, w, h   (little endian)
+
+Retransmissions (same peer and message id) are ACKed again but printed
+once. --drop N ignores the first N datagrams, to exercise the node's
+retransmission; --loss P drops at random.
+
+    python3 coap_standin.py --port 5683 [--log /tmp/vst_alerts.jsonl]
+"""
+
+import argparse
+import json
+import random
+import socket
+import struct
+import sys
+import time
+from datetime import datetime, timezone
+
+CON, NON, ACK, RST = 0, 1, 2, 3
+CHANGED = 0x44      # 2.04
+OPT_URI_PATH = 11
+
+
+def parse_coap(d):
+    """-> (type, code, msg id, token, {option: [values]}, payload) or None"""
+    if len(d) < 4 or d[0] >> 6 != 1:
+        return None
+    typ, tkl, code = (d[0] >> 4) & 3, d[0] & 15, d[1]
+    mid = d[2] << 8 | d[3]
+    token, i = d[4:4 + tkl], 4 + tkl
+    opts, num = {}, 0
+    while i < len(d) and d[i] != 0xFF:
+        delta, length = d[i] >> 4, d[i] & 15
+        i += 1
+        if delta == 13:
+            delta, i = d[i] + 13, i + 1
+        elif delta == 14:
+            delta, i = (d[i] << 8 | d[i + 1]) + 269, i + 2
+        if length == 13:
+            length, i = d[i] + 13, i + 1
+        elif length == 14:
+            length, i = (d[i] << 8 | d[i + 1]) + 269, i + 2
+        num += delta
+        opts.setdefault(num, []).append(d[i:i + length])
+        i += length
+    payload = d[i + 1:] if i < len(d) else b""
+    return typ, code, mid, token, opts, payload
+
+
+def parse_alert(p):
+    if len(p) < 2 or p[0] != 1 or len(p) < 2 + p[1] + 22:
+        return None
+    n = p[1]
+    node = p[2:2 + n].decode(errors="replace")
+    epoch, frame, frames, seq, target, score, x, y, w, h = struct.unpack_from("<IIHHBBHHHH", p, 2 + n)
+    return {"node": node, "epoch": epoch, "frame": frame, "frames": frames, "seq": seq,
+            "target": target, "score": score, "box": [x, y, w, h]}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=5683)
+    ap.add_argument("--path", default="alert", help="expected Uri-Path")
+    ap.add_argument("--log", default="", help="append one JSON line per alert")
+    ap.add_argument("--drop", type=int, default=0, help="ignore the first N datagrams")
+    ap.add_argument("--loss", type=float, default=0.0, help="drop probability")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("127.0.0.1", args.port))
+    print("CoAP stand-in on udp://127.0.0.1:%d/%s" % (args.port, args.path), flush=True)
+
+    seen = {}       # (peer, msg id) -> ACK sent
+    stats = {"datagrams": 0, "dropped": 0, "alerts": 0, "duplicates": 0, "rejected": 0}
+    log = open(args.log, "a") if args.log else None
+    try:
+        while True:
+            d, peer = sock.recvfrom(2048)
+            stats["datagrams"] += 1
+            if stats["datagrams"] <= args.drop or random.random() < args.loss:
+                stats["dropped"] += 1
+                continue
+
+            m = parse_coap(d)
+            if not m:
+                continue
+            typ, code, mid, token, opts, payload = m
+
+            key = (peer, mid)
+            if key in seen:
+                stats["duplicates"] += 1
+                if seen[key]:
+                    sock.sendto(seen[key], peer)
+                continue
+
+            path = "/".join(v.decode(errors="replace") for v in opts.get(OPT_URI_PATH, []))
+            alert = parse_alert(payload) if code == 0x02 and path == args.path else None
+            resp_code = CHANGED if alert else 0x80      # 4.00 Bad Request
+            ack = bytes([0x40 | ACK << 4 | len(token), resp_code, mid >> 8, mid & 0xFF]) + token
+            seen[key] = ack if typ == CON else b""
+            if typ == CON:
+                sock.sendto(ack, peer)
+
+            if not alert:
+                stats["rejected"] += 1
+                print("rejected: code %d.%02d path '%s', %d B" % (code >> 5, code & 31, path, len(payload)),
+                      file=sys.stderr)
+                continue
+            stats["alerts"] += 1
+            alert["received"] = time.time()
+            when = datetime.fromtimestamp(alert["epoch"], timezone.utc).strftime("%H:%M:%S") \
+                if alert["epoch"] else "no time"
+            print("alert %s #%d: target %d %d%% frame %d (%d frames) at %s, %d B datagram" %
+                  (alert["node"], alert["seq"], alert["target"], alert["score"], alert["frame"],
+                   alert["frames"], when, len(d)), flush=True)
+            if log:
+                log.write(json.dumps(alert) + "\n")
+                log.flush()
+    except KeyboardInterrupt:
+        pass
+    print("stats:", stats)
+
+
+if __name__ == "__main__":
+    main()
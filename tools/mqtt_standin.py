@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+"""Minimal MQTT 3.1.1 broker for the VSTPRO MQTT link (VSTPRO/src/mqttlink.h).
+
+Enough of a broker to run the node's MQTT session against when Mosquitto
+is not installed:
+
+  CONNECT / CONNACK (clean or persistent session by client id, takeover),
+  SUBSCRIBE / SUBACK (+ and # wildcards, QoS 0/1), PUBLISH QoS 0/1 with
+  PUBACK after the message was routed, PINGREQ, DISCONNECT, keep-alive
+  expiry at 1.5 x the client's value.
+
+A persistent session (clean session 0) keeps its subscriptions and queues
+QoS 1 messages while its client is away; they are delivered on the next
+CONNECT. Messages from one client are routed and acknowledged in order.
+No retained messages, no QoS 2, no will.
+
+    python3 mqtt_standin.py --port 1883 [--log /tmp/vst_mqtt.jsonl] [--dir /tmp/vst_mqtt]
+    python3 mqtt_standin.py pub --topic vst-0001/cmd "full 20260601/120455_001042"
+
+--kill-after N closes the connection of whichever client sends the N-th
+PUBLISH (counted over all clients, once), without acknowledging it, to
+exercise the node's lost-session path. The pub subcommand is a one-shot
+client (also works against Mosquitto).
+"""
+
+import argparse
+import json
+import os
+import socket
+import socketserver
+import struct
+import sys
+import threading
+import time
+
+
+def mqtt_str(s):
+    b = s.encode() if isinstance(s, str) else s
+    return struct.pack(">H", len(b)) + b
+
+
+def packet(kind, flags, body):
+    n, rl = len(body), b""
+    while True:
+        d, n = n % 128, n // 128
+        rl += bytes([d | (0x80 if n else 0)])
+        if not n:
+            break
+    return bytes([kind << 4 | flags]) + rl + body
+
+
+def read_packet(f):
+    """-> (type, flags, body) or None at EOF"""
+    h = f.read(1)
+    if not h:
+        return None
+    n, mult = 0, 1
+    while True:
+        b = f.read(1)
+        if not b:
+            return None
+        n += (b[0] & 0x7F) * mult
+        mult *= 128
+        if not b[0] & 0x80:
+            break
+    body = f.read(n)
+    if len(body) < n:
+        return None
+    return h[0] >> 4, h[0] & 0x0F, body
+
+
+def take_str(b, i):
+    n = struct.unpack(">H", b[i:i + 2])[0]
+    return b[i + 2:i + 2 + n].decode(errors="replace"), i + 2 + n
+
+
+def matches(flt, topic):
+    f, t = flt.split("/"), topic.split("/")
+    for i, part in enumerate(f):
+        if part == "#":
+            return True
+        if i >= len(t) or (part != "+" and part != t[i]):
+            return False
+    return len(f) == len(t)
+
+
+class Session:
+    def __init__(self, cid):
+        self.cid = cid
+        self.subs = {}          # filter -> qos
+        self.queue = []         # (topic, payload) while offline
+        self.conn = None        # Handler while online
+        self.pid = 0
+
+
+class Broker:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.sessions = {}
+        self.received = 0
+        self.log = open(args.log, "a") if args.log else None
+        self.stats = {"connects": 0, "publishes": 0, "bytes": 0, "delivered": 0, "queued": 0, "killed": 0}
+
+    def route(self, sender, topic, payload, qos):
+        """Caller holds the lock"""
+        self.stats["publishes"] += 1
+        self.stats["bytes"] += len(payload)
+        if self.log:
+            self.log.write(json.dumps({"t": round(time.time(), 3), "client": sender, "topic": topic,
+                                       "bytes": len(payload)}) + "\n")
+            self.log.flush()
+        if self.args.dir:
+            path = os.path.join(self.args.dir, *[p for p in topic.split("/") if p not in ("", ".", "..")])
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, "wb") as f:
+                f.write(payload)
+        for s in self.sessions.values():
+            q = max((sq for flt, sq in s.subs.items() if matches(flt, topic)), default=None)
+            if q is None:
+                continue
+            q = min(q, qos)
+            if s.conn:
+                s.conn.deliver(s, topic, payload, q)
+                self.stats["delivered"] += 1
+            elif q:
+                s.queue.append((topic, payload))
+                self.stats["queued"] += 1
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def setup(self):
+        super().setup()
+        self.wlock = threading.Lock()
+        self.session = None
+
+    def write(self, data):
+        with self.wlock:
+            try:
+                self.wfile.write(data)
+                self.wfile.flush()
+            except OSError:
+                pass
+
+    def deliver(self, s, topic, payload, qos):
+        body = mqtt_str(topic)
+        if qos:
+            s.pid = s.pid % 65535 + 1
+            body += struct.pack(">H", s.pid)
+        self.write(packet(3, qos << 1, body + payload))
+
+    def handle(self):
+        b = self.server.broker
+        p = read_packet(self.rfile)
+        if not p or p[0] != 1:
+            return
+        body = p[2]
+        _, i = take_str(body, 0)
+        flags = body[i + 1]
+        keep = struct.unpack(">H", body[i + 2:i + 4])[0]
+        cid, i = take_str(body, i + 4)
+        clean = bool(flags & 0x02)
+        if keep:
+            self.request.settimeout(keep * 1.5)
+
+        with b.lock:
+            s = b.sessions.get(cid)
+            present = s is not None and not clean
+            if s and s.conn:
+                try:
+                    s.conn.request.shutdown(socket.SHUT_RDWR)     # takeover
+                except OSError:
+                    pass
+            if not present:
+                s = b.sessions[cid] = Session(cid)
+            s.conn = self
+            self.session = s
+            b.stats["connects"] += 1
+            self.write(packet(2, 0, bytes([1 if present else 0, 0])))
+            queued, s.queue = s.queue, []
+            for topic, payload in queued:
+                self.deliver(s, topic, payload, 1)
+        print("connect %s (%s session%s, keep-alive %d s)" %
+              (cid, "clean" if clean else "persistent", ", %d queued" % len(queued) if queued else "", keep),
+              flush=True)
+
+        try:
+            self.loop(b, s)
+        except (OSError, ValueError):
+            pass
+        finally:
+            with b.lock:
+                if s.conn is self:
+                    s.conn = None
+                if clean and b.sessions.get(cid) is s:
+                    del b.sessions[cid]
+            print("gone %s" % cid, flush=True)
+
+    def loop(self, b, s):
+        while True:
+            p = read_packet(self.rfile)
+            if not p:
+                return
+            kind, flags, body = p
+            if kind == 3:                                   # PUBLISH
+                qos = (flags >> 1) & 3
+                topic, i = take_str(body, 0)
+                pid = body[i:i + 2] if qos else b""
+                payload = body[i + 2:] if qos else body[i:]
+                with b.lock:
+                    b.received += 1
+                    kill = b.received == b.args.kill_after
+                if kill:
+                    b.stats["killed"] += 1
+                    print("kill %s on publish %d (%s)" % (s.cid, b.received, topic), flush=True)
+                    return
+                with b.lock:
+                    b.route(s.cid, topic, payload, min(qos, 1))
+                    if qos:
+                        self.write(packet(4, 0, pid))
+            elif kind == 8:                                 # SUBSCRIBE
+                pid, i, granted = body[:2], 2, b""
+                with b.lock:
+                    while i < len(body):
+                        flt, i = take_str(body, i)
+                        q = min(body[i], 1)
+                        i += 1
+                        s.subs[flt] = q
+                        granted += bytes([q])
+                self.write(packet(9, 0, pid + granted))
+            elif kind == 10:                                # UNSUBSCRIBE
+                i = 2
+                with b.lock:
+                    while i < len(body):
+                        flt, i = take_str(body, i)
+                        s.subs.pop(flt, None)
+                self.write(packet(11, 0, body[:2]))
+            elif kind == 12:                                # PINGREQ
+                self.write(packet(13, 0, b""))
+            elif kind == 14:                                # DISCONNECT
+                return
+
+
+class Server(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def serve(args):
+    server = Server(("127.0.0.1", args.port), Handler)
+    server.broker = Broker(args)
+    print("MQTT stand-in on 127.0.0.1:%d" % args.port, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print("stats:", server.broker.stats)
+
+
+def pub(args):
+    s = socket.create_connection((args.host, args.port), timeout=10)
+    f = s.makefile("rb")
+    s.sendall(packet(1, 0, mqtt_str("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 30) + mqtt_str(args.client)))
+    p = read_packet(f)
+    if not p or p[0] != 2 or p[2][1] != 0:
+        sys.exit("CONNECT refused")
+    s.sendall(packet(3, 2, mqtt_str(args.topic) + struct.pack(">H", 1) + args.message.encode()))
+    p = read_packet(f)
+    if not p or p[0] != 4:
+        sys.exit("no PUBACK")
+    s.sendall(packet(14, 0, b""))
+    s.close()
+    print("published to %s: %s" % (args.topic, args.message))
+
+
+def main():
+    if len(sys.argv) > 1 and sys.argv[1] == "pub":
+        ap = argparse.ArgumentParser(description="publish one QoS 1 message")
+        ap.add_argument("--host", default="127.0.0.1")
+        ap.add_argument("--port", type=int, default=1883)
+        ap.add_argument("--client", default="vst-tools")
+        ap.add_argument("--topic", required=True)
+        ap.add_argument("message")
+        return pub(ap.parse_args(sys.argv[2:]))
+
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--log", default="", help="append one JSON line per PUBLISH")
+    ap.add_argument("--dir", default="", help="also write each message to <dir>/<topic>")
+    ap.add_argument("--kill-after", type=int, default=0, help="drop the client of the N-th PUBLISH")
+    serve(ap.parse_args())
+
+
+if __name__ == "__main__":
+    main()
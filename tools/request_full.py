@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+request_full.py — ask a VSTPRO node for full frames behind its thumbnails
+
+With thumbnail-first upload (VSTPRO/src/uploader.h) a node reads
+<container>/<device>/requests.txt every UP_REQUEST_POLL_MS and uploads the
+full JPEG of every line appended since its last read. This appends lines
+to that blob (read, append, Put Blob).
+
+Usage:
+    python3 request_full.py --device vst-0001 20260601/120455_001042
+    python3 request_full.py --endpoint https://acct.blob.core.windows.net \\
+        --sas "sv=...&sig=..." vst-0001/20260601/120455_001042_t.jpg
+
+A frame may be named by its thumbnail or blob name; the node looks for
+"YYYYMMDD/HHMMSS_<frame id>" in each line. Never rewrite or shorten the
+blob: the node keeps a byte offset into it.
+"""
+
+import argparse
+import sys
+import urllib.error
+import urllib.request
+
+VERSION = "2019-12-12"   # as azblob.cpp
+
+
+def blob_url(args):
+    url = "%s/%s/%s/requests.txt" % (args.endpoint.rstrip("/"), args.container, args.device)
+    return url + ("?" + args.sas if args.sas else "")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("frames", nargs="+", help="YYYYMMDD/HHMMSS_<frame id> or a thumbnail name")
+    ap.add_argument("--endpoint", default="http://127.0.0.1:10000/devstoreaccount1")
+    ap.add_argument("--container", default="frames")
+    ap.add_argument("--device", default="vst-0001")
+    ap.add_argument("--sas", default="", help="query string without '?'")
+    args = ap.parse_args()
+
+    url = blob_url(args)
+    try:
+        with urllib.request.urlopen(urllib.request.Request(url, headers={"x-ms-version": VERSION})) as r:
+            old = r.read()
+    except urllib.error.HTTPError as e:
+        if e.code != 404:
+            print("GET requests.txt: HTTP %d" % e.code, file=sys.stderr)
+            return 1
+        old = b""
+
+    add = "".join(f.strip() + "\n" for f in args.frames).encode()
+    req = urllib.request.Request(url, data=old + add, method="PUT", headers={
+        "x-ms-version": VERSION,
+        "x-ms-blob-type": "BlockBlob",
+        "Content-Type": "text/plain",
+    })
+    try:
+        urllib.request.urlopen(req).close()
+    except urllib.error.HTTPError as e:
+        print("PUT requests.txt: HTTP %d" % e.code, file=sys.stderr)
+        return 1
+    print("requested %d frame(s), requests.txt now %d B" % (len(args.frames), len(old) + len(add)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,980 @@
+#!/usr/bin/env python3
+"""SIM7080 stand-in on a pseudo-terminal.
+
+Speaks the subset of the SIM7070/7080 AT dialect the firmware uses, so the
+uplink code (VSTPRO/src/modem_at.* and above) can be run on a PC without a
+SIM card:
+
+  AT, ATE0/1, +CLTS, +CTZR, +CEREG?, +CREG?, +CCLK?
+  +CNCFG, +CNACT (PDP context 0)
+  +SHCONF, +CSSLCFG, +SHSSL, +SHCONN, +SHSTATE?, +SHDISC,
+  +SHCHEAD, +SHAHEAD, +SHBOD, +SHREQ, +SHREAD    (HTTP client)
+  +CAOPEN, +CASEND, +CARECV, +CACLOSE, +CASTATE? (UDP sockets, +CADATAIND)
+  +SMCONF, +SMCONN, +SMSUB, +SMPUB, +SMDISC, +SMSTATE? (MQTT 3.1.1 client,
+  +SMSUB / +SMSTATE URCs)
+  +CPSMS, +CEDRXS, +CEREG=4 (granted timers), +CPSMSTATUS
+
+HTTP requests are really sent, to whatever host the firmware configured
+with AT+SHCONF="URL" (Azurite or tools/blob_standin.py on localhost),
+UDP sockets are real sockets (tools/coap_standin.py for alerts) and the
+MQTT client talks to a real broker (Mosquitto or tools/mqtt_standin.py).
+
+    python3 sim7080_emu.py --link /tmp/vst_modem
+    # then point the host harness at /tmp/vst_modem
+
+Power: with AT+CPSMS=1 the modem enters PSM once it was left alone for the
+active time (T3324) with no bearer or connection up; in PSM and while
+powered off it ignores the UART. SIGUSR1 is a PWRKEY pulse (power on, wake
+from PSM, or a normal power down when awake), SIGUSR2 switches the supply
+rails off / on. Time spent awake, in PSM and off is printed with the stats.
+
+Faults and limits, for retry and throughput benches (host/run.sh faults).
+All random draws come from one generator seeded with --seed, so the same
+firmware run sees the same faults:
+
+  --error-rate P      ERROR instead of the answer to network commands
+                      (CNACT=0,1, SHCONN, SHREQ, CAOPEN, SMCONN, SMSUB)
+  --drop-rate P       no answer at all to the same commands (timeouts)
+  --http-fail-rate P  AT+SHREQ answers OK, then +SHREQ: ...,705,0 and the
+                      HTTP connection is gone
+  --outage S:L,...    coverage lost L seconds from S seconds after start:
+                      not registered, bearer / sockets / MQTT dropped with
+                      their URCs, +CEREG: 2 / +CEREG: 1 when AT+CEREG=1
+  --baud N            UART pacing both ways (10 bits per byte)
+  --uplink-kbps N     radio uplink: HTTP bodies, datagrams, MQTT packets
+  --downlink-kbps N   radio downlink: HTTP responses
+"""
+
+import argparse
+import http.client
+import os
+import pty
+import random
+import select
+import signal
+import socket
+import struct
+import sys
+import time
+import tty
+from datetime import datetime, timezone
+from urllib.parse import urlsplit
+
+
+def split_args(s):
+    """'"URL","http://x",5' -> ['URL', 'http://x', '5']"""
+    out, cur, quoted = [], "", False
+    for c in s:
+        if c == '"':
+            quoted = not quoted
+        elif c == "," and not quoted:
+            out.append(cur)
+            cur = ""
+        else:
+            cur += c
+    out.append(cur)
+    return out
+
+
+def gprs_timer(bits, units):
+    """TS 24.008 GPRS timer 2 / 3 octet as bits -> seconds, None = deactivated"""
+    if len(bits) != 8 or set(bits) - set("01"):
+        return None
+    v = int(bits, 2)
+    unit = units.get(v >> 5)
+    return None if unit is None else unit * (v & 31)
+
+
+T3324_UNITS = {0: 2, 1: 60, 2: 360}
+T3412_UNITS = {3: 2, 4: 30, 5: 60, 0: 600, 1: 3600, 2: 36000, 6: 1152000}
+
+
+def mqtt_str(s):
+    b = s.encode() if isinstance(s, str) else s
+    return struct.pack(">H", len(b)) + b
+
+
+def mqtt_packet(kind, flags, body):
+    n, rl = len(body), b""
+    while True:
+        d, n = n % 128, n // 128
+        rl += bytes([d | (0x80 if n else 0)])
+        if not n:
+            break
+    return bytes([kind << 4 | flags]) + rl + body
+
+
+def mqtt_take(buf):
+    """(type, flags, body, rest) of the first whole packet in buf, or None"""
+    n, mult, i = 0, 1, 1
+    while True:
+        if i >= len(buf):
+            return None
+        n += (buf[i] & 0x7F) * mult
+        mult *= 128
+        i += 1
+        if not buf[i - 1] & 0x80:
+            break
+    if len(buf) < i + n:
+        return None
+    return buf[0] >> 4, buf[0] & 0x0F, buf[i:i + n], buf[i + n:]
+
+
+class Modem:
+    METHODS = {1: "GET", 2: "PUT", 3: "POST", 4: "PATCH", 5: "HEAD"}
+
+    def __init__(self, fd, args):
+        self.fd = fd
+        self.args = args
+        self.t0 = time.monotonic()
+        self.echo = True
+        self.rx = b""
+        self.body_left = 0          # > 0: collecting AT+SHBOD payload
+        self.pdp = False
+        self.sh = {"URL": "", "BODYLEN": "1024", "HEADERLEN": "350"}
+        self.sh_conn = None
+        self.headers = {}
+        self.body = b""
+        self.resp = b""
+        self.socks = {}             # cid -> UDP socket
+        self.rx_dgrams = {}         # cid -> datagrams not read yet
+        self.send_cid = None        # collecting AT+CASEND payload for this cid
+        self.sm = {"URL": "", "CLIENTID": "", "KEEPTIME": "60", "CLEANSS": "0",
+                   "ASYNCMODE": "0", "USERNAME": "", "PASSWORD": ""}
+        self.mq = None              # MQTT broker socket
+        self.mq_rx = b""
+        self.mq_pid = 0
+        self.mq_tx_at = 0.0         # last packet to the broker (keep-alive)
+        self.pub_topic = None       # collecting AT+SMPUB payload for this topic
+        self.pub_qos = 0
+        self.timers = []            # (due, fn): one-way latency of MQTT packets
+        self.stats = {"commands": 0, "requests": 0, "body_bytes": 0, "datagrams": 0,
+                      "mqtt_connects": 0, "mqtt_publishes": 0, "mqtt_received": 0,
+                      "pwrkey": 0, "psm_entries": 0, "ignored_bytes": 0,
+                      "injected_errors": 0, "dropped": 0, "http_failed": 0, "outages": 0}
+        self.power = "on"           # on / psm / off
+        self.rails = True
+        self.power_at = time.monotonic()
+        self.power_s = {"on": 0.0, "psm": 0.0, "off": 0.0}
+        self.last_use = time.monotonic()
+        self.cereg_n = 0
+        self.psm = None             # (tau bits, active time bits) from AT+CPSMS
+        self.edrx = None
+        self.psm_urc = False
+        self.clts = False           # AT+CLTS=1: *PSUTTZ when the network sends the time
+        self.reg_urcs = False       # registration URCs sent since boot
+        self.rng = random.Random(args.seed)
+        self.start = time.monotonic()   # --outage is relative to this, not to boots
+        self.outage = False
+        self.up_free = 0.0          # radio uplink busy until (--uplink-kbps)
+
+    # ---- power --------------------------------------------------------
+    def set_power(self, state):
+        now = time.monotonic()
+        self.power_s[self.power] += now - self.power_at
+        self.power_at = now
+        if state != self.power:
+            print("power: %s -> %s" % (self.power, state), file=sys.stderr, flush=True)
+        self.power = state
+
+    def drop_links(self):
+        self.pdp = False
+        if self.sh_conn:
+            self.sh_conn.close()
+            self.sh_conn = None
+        for cid in list(self.socks):
+            self.socks.pop(cid).close()
+        self.rx_dgrams = {}
+        self.mqtt_drop(urc=False)
+
+    def pwrkey(self):
+        self.stats["pwrkey"] += 1
+        if not self.rails:
+            return
+        if self.power == "off":                         # boot: registers again
+            self.set_power("on")
+            self.t0 = self.last_use = time.monotonic()
+            self.echo, self.rx, self.body_left, self.cereg_n = True, b"", 0, 0
+            self.clts = self.reg_urcs = False
+        elif self.power == "psm":
+            self.set_power("on")
+            self.last_use = time.monotonic()
+            if self.psm_urc:
+                self.line('+CPSMSTATUS: "EXIT PSM"')
+        else:
+            self.line("NORMAL POWER DOWN")
+            self.drop_links()
+            self.set_power("off")
+
+    def toggle_rails(self):
+        self.rails = not self.rails
+        print("power: rails %s" % ("on" if self.rails else "off"), file=sys.stderr, flush=True)
+        if not self.rails:
+            self.drop_links()
+            self.set_power("off")
+
+    def reg_due(self):
+        """seconds until the registration URCs are due, None if sent"""
+        if self.reg_urcs or self.power != "on":
+            return None
+        now = time.monotonic()
+        due = self.t0 + self.args.reg_delay
+        for start, length in self.args.outage:
+            if self.start + start <= max(now, due) < self.start + start + length:
+                due = self.start + start + length
+        return max(0.0, due - now)
+
+    def network_urcs(self):
+        """+CEREG (AT+CEREG=1/2/4) and *PSUTTZ (AT+CLTS=1) once registered"""
+        if self.reg_urcs or self.power != "on" or not self.registered():
+            return
+        self.reg_urcs = True
+        if self.cereg_n >= 4 and self.psm:
+            self.line('+CEREG: 1,"1A2B","01A2D101",7,,,"%s","%s"' % (self.psm[1], self.psm[0]))
+        elif self.cereg_n >= 2:
+            self.line('+CEREG: 1,"1A2B","01A2D101",7')
+        elif self.cereg_n == 1:
+            self.line("+CEREG: 1")
+        if self.clts:
+            t = datetime.now(timezone.utc)
+            self.line('*PSUTTZ: %d,%d,%d,%d,%d,%d,"+00",0' % (t.year, t.month, t.day, t.hour, t.minute, t.second))
+            self.line("DST: 0")
+
+    def in_outage(self):
+        t = time.monotonic() - self.start
+        return any(start <= t < start + length for start, length in self.args.outage)
+
+    def coverage(self):
+        """--outage: links go down when coverage is lost, URCs again after"""
+        out = self.in_outage()
+        if out == self.outage:
+            return
+        self.outage = out
+        print("coverage %s" % ("lost" if out else "back"), file=sys.stderr, flush=True)
+        if not out:
+            self.reg_urcs = False       # +CEREG: 1 (and the time) once more
+            return
+        self.stats["outages"] += 1
+        if self.power != "on":
+            return
+        pdp = self.pdp
+        self.mqtt_drop(urc=bool(self.mq))
+        self.drop_links()
+        if pdp:
+            self.line("+APP PDP: 0,DEACTIVE")
+        if self.cereg_n:
+            self.line("+CEREG: 2")
+
+    def tick(self):
+        """PSM after the active time with nothing open"""
+        self.coverage()
+        self.network_urcs()
+        if self.power != "on" or not self.psm or not self.registered():
+            return
+        if self.pdp or self.sh_conn or self.socks or self.mq:
+            return
+        active = gprs_timer(self.psm[1], T3324_UNITS)
+        if active is None or time.monotonic() - self.last_use < active:
+            return
+        if self.psm_urc:
+            self.line('+CPSMSTATUS: "ENTER PSM"')
+        self.stats["psm_entries"] += 1
+        self.set_power("psm")
+
+    # ---- output -------------------------------------------------------
+    def send(self, data):
+        if isinstance(data, str):
+            data = data.encode()
+        if self.args.baud:
+            time.sleep(len(data) * 10.0 / self.args.baud)
+        os.write(self.fd, data)
+
+    def line(self, s):
+        self.send("\r\n" + s + "\r\n")
+
+    def ok(self):
+        self.line("OK")
+
+    def error(self):
+        self.line("ERROR")
+
+    # ---- input --------------------------------------------------------
+    def feed(self, data):
+        if self.power != "on":
+            self.stats["ignored_bytes"] += len(data)
+            return
+        if self.args.baud:
+            time.sleep(len(data) * 10.0 / self.args.baud)
+        self.last_use = time.monotonic()
+        self.rx += data
+        while self.rx:
+            if self.body_left:
+                take = self.rx[: self.body_left]
+                self.rx = self.rx[len(take):]
+                self.body += take
+                self.body_left -= len(take)
+                if not self.body_left:
+                    if self.send_cid is not None:
+                        self.udp_send()
+                    elif self.pub_topic is not None:
+                        self.mqtt_publish()
+                    else:
+                        self.stats["body_bytes"] += len(self.body)
+                        self.ok()
+                continue
+
+            end = self.rx.find(b"\r")
+            if end < 0:
+                return
+            raw = self.rx[:end].strip(b"\n").decode(errors="replace")
+            self.rx = self.rx[end + 1:]
+            if self.rx.startswith(b"\n"):
+                self.rx = self.rx[1:]
+            if not raw:
+                continue
+            if self.echo:
+                self.send(raw + "\r\n")
+            self.command(raw)
+
+    def registered(self):
+        return time.monotonic() - self.t0 >= self.args.reg_delay and not self.in_outage()
+
+    # ---- faults and link limits ---------------------------------------
+    FAULTY = ("CNACT", "SHCONN", "SHREQ", "CAOPEN", "SMCONN", "SMSUB")
+
+    def fault(self, name, arg):
+        """'error', 'drop' or None for a network command"""
+        if name not in self.FAULTY or (name == "CNACT" and not arg.endswith(",1")):
+            return None
+        x = self.rng.random()
+        if x < self.args.error_rate:
+            self.stats["injected_errors"] += 1
+            return "error"
+        if x < self.args.error_rate + self.args.drop_rate:
+            self.stats["dropped"] += 1
+            return "drop"
+        return None
+
+    def uplink(self, n):
+        """Seconds until n more bytes are through the radio (--uplink-kbps);
+        packets sent back to back queue behind each other."""
+        if not self.args.uplink_kbps:
+            return 0.0
+        now = time.monotonic()
+        self.up_free = max(self.up_free, now) + n * 8 / (self.args.uplink_kbps * 1000.0)
+        return self.up_free - now
+
+    def downlink(self, n):
+        return n * 8 / (self.args.downlink_kbps * 1000.0) if self.args.downlink_kbps else 0.0
+
+    # ---- commands -----------------------------------------------------
+    def command(self, raw):
+        self.stats["commands"] += 1
+        if self.args.verbose:
+            print(">>", raw[:120], file=sys.stderr)
+        up = raw.upper()
+        if up in ("AT", "ATI"):
+            return self.ok()
+        if up.startswith("ATE"):
+            self.echo = up.endswith("1")
+            return self.ok()
+        if not up.startswith("AT+"):
+            return self.error()
+
+        body = raw[3:]
+        name = body
+        for sep in ("=", "?"):
+            name = name.split(sep, 1)[0]
+        name = name.upper()
+        arg = body[len(name) + 1:] if body[len(name):].startswith("=") else ""
+        query = body.endswith("?")
+
+        handler = getattr(self, "cmd_" + name.lower(), None)
+        if handler is None:
+            return self.error()
+        f = None if query else self.fault(name, arg)
+        if f == "drop":
+            if self.args.verbose:
+                print("   dropped", file=sys.stderr)
+            return
+        if f == "error":
+            return self.error()
+        handler(arg, query)
+
+    def cmd_clts(self, arg, query):
+        if not query:
+            self.clts = arg == "1"
+        self.ok()
+
+    def cmd_ctzr(self, arg, query):
+        self.ok()
+
+    cmd_cncfg = cmd_ctzr
+    cmd_csslcfg = cmd_ctzr
+    cmd_shssl = cmd_ctzr
+
+    def cmd_cereg(self, arg, query):
+        if query:
+            stat = 1 if self.registered() else 2
+            if self.cereg_n >= 4 and stat == 1 and self.psm:
+                # the network grants what was asked for
+                self.line('+CEREG: %d,1,"1A2B","01A2D101",7,,,"%s","%s"' %
+                          (self.cereg_n, self.psm[1], self.psm[0]))
+            elif self.cereg_n >= 2 and stat == 1:
+                self.line('+CEREG: %d,1,"1A2B","01A2D101",7' % self.cereg_n)
+            else:
+                self.line("+CEREG: %d,%d" % (self.cereg_n, stat))
+        elif arg:
+            self.cereg_n = int(arg) if arg.isdigit() else 0
+        self.ok()
+
+    def cmd_cpsms(self, arg, query):
+        if query:
+            tau, act = self.psm or ("", "")
+            self.line('+CPSMS: %d,,,"%s","%s"' % (1 if self.psm else 0, tau, act))
+            return self.ok()
+        a = split_args(arg)
+        if a[0] == "1":
+            if len(a) < 5 or gprs_timer(a[3], T3412_UNITS) is None or gprs_timer(a[4], T3324_UNITS) is None:
+                return self.error()
+            self.psm = (a[3], a[4])
+        else:
+            self.psm = None
+        self.ok()
+
+    def cmd_cedrxs(self, arg, query):
+        if query:
+            self.line('+CEDRXS: 4,"%s"' % (self.edrx or "0000"))
+            return self.ok()
+        a = split_args(arg)
+        self.edrx = a[2] if a[0] in ("1", "2") and len(a) >= 3 else None
+        self.ok()
+
+    def cmd_cpsmstatus(self, arg, query):
+        self.psm_urc = arg == "1"
+        self.ok()
+
+    def cmd_creg(self, arg, query):
+        if query:
+            self.line("+CREG: 0,%d" % (1 if self.registered() else 2))
+        self.ok()
+
+    def cmd_cclk(self, arg, query):
+        if self.registered():
+            now = datetime.now(timezone.utc)
+        else:
+            now = datetime(1980, 1, 6, tzinfo=timezone.utc)   # modem RTC default
+        self.line('+CCLK: "%s+00"' % now.strftime("%y/%m/%d,%H:%M:%S"))
+        self.ok()
+
+    def cmd_cnact(self, arg, query):
+        if query:
+            self.line('+CNACT: 0,%d,"%s"' % (1 if self.pdp else 0, "10.0.0.2" if self.pdp else "0.0.0.0"))
+            self.line('+CNACT: 1,0,"0.0.0.0"')
+            return self.ok()
+        a = split_args(arg)
+        if len(a) < 2 or a[0] != "0":
+            return self.error()
+        if a[1] == "1" and not self.registered():
+            return self.error()
+        self.ok()
+        if a[1] == "1" and not self.pdp and self.args.pdp_ms:
+            time.sleep(self.args.pdp_ms / 1000.0)   # attach + bearer setup
+        self.pdp = a[1] == "1"
+        if not self.pdp:
+            for cid in list(self.socks):
+                self.socks.pop(cid).close()
+                self.rx_dgrams.pop(cid, None)
+            self.mqtt_drop(urc=bool(self.mq))
+        self.line("+APP PDP: 0,%s" % ("ACTIVE" if self.pdp else "DEACTIVE"))
+
+    # ---- HTTP (AT+SH*) ------------------------------------------------
+    def cmd_shconf(self, arg, query):
+        a = split_args(arg)
+        if len(a) != 2:
+            return self.error()
+        self.sh[a[0].upper()] = a[1]
+        self.ok()
+
+    def cmd_shconn(self, arg, query):
+        u = urlsplit(self.sh["URL"])
+        if not self.pdp or not u.hostname:
+            return self.error()
+        port = u.port or (443 if u.scheme == "https" else 80)
+        cls = http.client.HTTPSConnection if u.scheme == "https" else http.client.HTTPConnection
+        if self.args.connect_ms:
+            time.sleep(self.args.connect_ms / 1000.0)   # TCP (+ TLS) handshake
+        try:
+            conn = cls(u.hostname, port, timeout=30)
+            conn.connect()
+        except OSError:
+            return self.error()
+        self.sh_conn = conn
+        self.ok()
+
+    def cmd_shstate(self, arg, query):
+        self.line("+SHSTATE: %d" % (1 if self.sh_conn else 0))
+        self.ok()
+
+    def cmd_shdisc(self, arg, query):
+        if self.sh_conn:
+            self.sh_conn.close()
+        self.sh_conn = None
+        self.ok()
+
+    def cmd_shchead(self, arg, query):
+        self.headers = {}
+        self.ok()
+
+    def cmd_shahead(self, arg, query):
+        a = split_args(arg)
+        if len(a) != 2:
+            return self.error()
+        self.headers[a[0]] = a[1]
+        self.ok()
+
+    def cmd_shbod(self, arg, query):
+        a = split_args(arg)
+        n = int(a[0]) if a and a[0].isdigit() else -1
+        if n < 0 or n > int(self.sh["BODYLEN"]):
+            return self.error()
+        self.body = b""
+        self.body_left = n
+        self.send("\r\n> ")
+        if n == 0:
+            self.ok()
+
+    def cmd_shreq(self, arg, query):
+        a = split_args(arg)
+        method = self.METHODS.get(int(a[1]) if len(a) > 1 and a[1].isdigit() else 0)
+        if not self.sh_conn or not method:
+            return self.error()
+        self.ok()
+
+        body = self.body if method in ("PUT", "POST", "PATCH") else None
+        head = sum(len(k) + len(v) + 4 for k, v in self.headers.items()) + len(a[0]) + 16
+        time.sleep(self.args.latency_ms / 1000.0 + self.uplink(head + len(body or b"")))
+        self.stats["requests"] += 1
+        if self.rng.random() < self.args.http_fail_rate:
+            self.stats["http_failed"] += 1
+            self.sh_conn.close()
+            self.sh_conn = None
+            self.body, self.resp = b"", b""
+            return self.line('+SHREQ: "%s",705,0' % method)
+        try:
+            self.sh_conn.request(method, a[0], body=body, headers=self.headers)
+            r = self.sh_conn.getresponse()
+            self.resp = r.read()
+            status = r.status
+            time.sleep(self.downlink(len(self.resp) + 200))
+        except (OSError, http.client.HTTPException):
+            self.sh_conn.close()
+            self.sh_conn = None
+            self.resp = b""
+            status = 705        # modem-side "connection failed"
+        self.body = b""
+        self.line('+SHREQ: "%s",%d,%d' % (method, status, len(self.resp)))
+
+    def cmd_shread(self, arg, query):
+        a = split_args(arg)
+        try:
+            start, n = int(a[0]), int(a[1])
+        except (IndexError, ValueError):
+            return self.error()
+        chunk = self.resp[start:start + n]
+        if not chunk:
+            return self.error()
+        self.ok()
+        self.send("\r\n+SHREAD: %d\r\n" % len(chunk))
+        self.send(chunk)
+
+    # ---- UDP sockets (AT+CA*) -----------------------------------------
+    def cmd_caopen(self, arg, query):
+        a = split_args(arg)
+        if len(a) < 5 or not a[0].isdigit() or a[2].upper() != "UDP" or not self.pdp:
+            return self.error()
+        cid = int(a[0])
+        if cid in self.socks:
+            self.line("+CAOPEN: %d,4" % cid)      # already in use
+            return self.ok()
+        try:
+            s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            s.connect((a[3], int(a[4])))
+        except (OSError, ValueError):
+            self.line("+CAOPEN: %d,1" % cid)
+            return self.ok()
+        self.socks[cid] = s
+        self.rx_dgrams[cid] = []
+        self.line("+CAOPEN: %d,0" % cid)
+        self.ok()
+
+    def cmd_casend(self, arg, query):
+        a = split_args(arg)
+        try:
+            cid, n = int(a[0]), int(a[1])
+        except (IndexError, ValueError):
+            return self.error()
+        if cid not in self.socks or not self.pdp or not 0 < n <= 1460:
+            return self.error()
+        self.send_cid = cid
+        self.body = b""
+        self.body_left = n
+        self.send("\r\n> ")
+
+    def udp_send(self):
+        cid, data = self.send_cid, self.body
+        self.send_cid = None
+        self.body = b""
+        time.sleep(self.args.latency_ms / 2000.0 + self.uplink(len(data) + 28))  # one way
+        try:
+            self.socks[cid].send(data)
+        except OSError:
+            pass                                        # UDP: lost, not an error
+        self.stats["datagrams"] += 1
+        self.ok()
+
+    def udp_readable(self, cid):
+        try:
+            data = self.socks[cid].recv(2048)
+        except OSError:
+            return
+        if self.args.latency_ms:
+            time.sleep(self.args.latency_ms / 2000.0)
+        self.rx_dgrams[cid].append(data)
+        self.line("+CADATAIND: %d" % cid)
+
+    def cmd_carecv(self, arg, query):
+        a = split_args(arg)
+        try:
+            cid, n = int(a[0]), int(a[1])
+        except (IndexError, ValueError):
+            return self.error()
+        if cid not in self.socks:
+            return self.error()
+        q = self.rx_dgrams[cid]
+        if not q:
+            self.line("+CARECV: 0")
+            return self.ok()
+        data = q.pop(0)[:n]
+        self.send(b"\r\n+CARECV: %d," % len(data) + data + b"\r\n")
+        self.ok()
+
+    def cmd_caclose(self, arg, query):
+        cid = int(arg) if arg.isdigit() else -1
+        s = self.socks.pop(cid, None)
+        if s is None:
+            return self.error()
+        s.close()
+        self.rx_dgrams.pop(cid, None)
+        self.ok()
+
+    def cmd_castate(self, arg, query):
+        for cid in sorted(self.socks):
+            self.line("+CASTATE: %d,1" % cid)
+        self.ok()
+
+    # ---- MQTT (AT+SM*) ------------------------------------------------
+    # Packets to and from the broker are delayed by half of --latency-ms
+    # each way (self.timers), so pipelined publishes overlap like on air.
+    def later(self, delay_s, fn):
+        due = time.monotonic() + delay_s
+        i = len(self.timers)
+        while i and self.timers[i - 1][0] > due:    # --uplink-kbps queues out of order
+            i -= 1
+        self.timers.insert(i, (due, fn))
+
+    def run_timers(self):
+        now = time.monotonic()
+        while self.timers and self.timers[0][0] <= now:
+            self.timers.pop(0)[1]()
+
+    def run_all_timers(self):
+        """Everything queued goes now: a blocking command must not overtake it"""
+        while self.timers:
+            self.timers.pop(0)[1]()
+
+    def next_timer(self):
+        return self.timers[0][0] - time.monotonic() if self.timers else None
+
+    def mqtt_write(self, pkt, now=False):
+        self.mq_tx_at = time.monotonic()
+        sock = self.mq
+        air = self.uplink(len(pkt) + 40)
+
+        def go():
+            if self.mq is sock and sock:
+                try:
+                    sock.sendall(pkt)
+                except OSError:
+                    self.mqtt_drop(urc=True)
+        if now:
+            time.sleep(air)
+            go()
+        elif not self.args.latency_ms and not air:
+            go()
+        else:
+            self.later(self.args.latency_ms / 2000.0 + air, go)
+
+    def mqtt_drop(self, urc):
+        if self.mq:
+            self.mq.close()
+        self.mq = None
+        self.mq_rx = b""
+        self.timers = []
+        if urc:
+            self.line("+SMSTATE: 0")
+
+    def mqtt_wait(self, want, timeout=10.0):
+        """Blocks for a packet of type want (CONNACK, SUBACK, PUBACK in sync
+        mode); PUBLISHes on the way become URCs."""
+        end = time.monotonic() + timeout
+        while self.mq:
+            while True:
+                p = mqtt_take(self.mq_rx)
+                if not p:
+                    break
+                kind, flags, body, self.mq_rx = p
+                if kind == want:
+                    return body
+                self.mqtt_packet_in(kind, flags, body, delay=False)
+            left = end - time.monotonic()
+            if left <= 0:
+                return None
+            r, _, _ = select.select([self.mq], [], [], left)
+            if not r:
+                return None
+            data = self.mq.recv(65536)
+            if not data:
+                self.mqtt_drop(urc=True)
+                return None
+            self.mq_rx += data
+        return None
+
+    def mqtt_readable(self):
+        try:
+            data = self.mq.recv(65536)
+        except OSError:
+            data = b""
+        if not data:
+            return self.mqtt_drop(urc=True)
+        self.mq_rx += data
+        while self.mq:
+            p = mqtt_take(self.mq_rx)
+            if not p:
+                break
+            kind, flags, body, self.mq_rx = p
+            self.mqtt_packet_in(kind, flags, body, delay=True)
+
+    def mqtt_buffered(self):
+        """Packets that came in behind the one a blocking command waited for"""
+        while self.mq:
+            p = mqtt_take(self.mq_rx)
+            if not p:
+                break
+            kind, flags, body, self.mq_rx = p
+            self.mqtt_packet_in(kind, flags, body, delay=False)
+
+    def mqtt_packet_in(self, kind, flags, body, delay):
+        if kind != 3:                       # PUBACK, PINGRESP, ...: nothing to report
+            return
+        qos = (flags >> 1) & 3
+        n = struct.unpack(">H", body[:2])[0]
+        topic = body[2:2 + n].decode(errors="replace")
+        rest = body[2 + n:]
+        if qos:
+            self.mqtt_write(mqtt_packet(4, 0, rest[:2]))    # PUBACK
+            rest = rest[2:]
+        self.stats["mqtt_received"] += 1
+        urc = '+SMSUB: "%s","%s"' % (topic, rest.decode(errors="replace"))
+        if delay and self.args.latency_ms:
+            self.later(self.args.latency_ms / 2000.0, lambda: self.line(urc))
+        else:
+            self.line(urc)
+
+    def mqtt_keepalive(self):
+        keep = int(self.sm["KEEPTIME"] or 0)
+        if self.mq and keep and time.monotonic() - self.mq_tx_at >= keep * 0.75:
+            self.mqtt_write(mqtt_packet(12, 0, b""))        # PINGREQ
+
+    def cmd_smconf(self, arg, query):
+        a = split_args(arg)
+        if len(a) < 2 or a[0].upper() not in self.sm:
+            return self.error()
+        self.sm[a[0].upper()] = ",".join(a[1:])
+        self.ok()
+
+    def cmd_smconn(self, arg, query):
+        url = split_args(self.sm["URL"])
+        host, port = url[0], int(url[1]) if len(url) > 1 and url[1].isdigit() else 1883
+        if not self.pdp or not host or self.mq:
+            return self.error()
+        lat = self.args.latency_ms / 1000.0
+        time.sleep(self.args.connect_ms / 1000.0 + lat)      # TCP handshake
+        try:
+            self.mq = socket.create_connection((host, port), timeout=10)
+        except OSError:
+            self.mq = None
+            return self.error()
+        flags = 0x02 if self.sm["CLEANSS"] == "1" else 0
+        payload = mqtt_str(self.sm["CLIENTID"])
+        if self.sm["USERNAME"]:
+            flags |= 0x80 | 0x40
+            payload += mqtt_str(self.sm["USERNAME"]) + mqtt_str(self.sm["PASSWORD"])
+        var = mqtt_str("MQTT") + bytes([4, flags]) + struct.pack(">H", int(self.sm["KEEPTIME"] or 0))
+        self.mqtt_write(mqtt_packet(1, 0, var + payload), now=True)
+        time.sleep(lat)                                       # CONNECT / CONNACK
+        ack = self.mqtt_wait(2)
+        if ack is None or len(ack) < 2 or ack[1] != 0:
+            self.mqtt_drop(urc=False)
+            return self.error()
+        self.stats["mqtt_connects"] += 1
+        self.ok()
+        self.mqtt_buffered()        # a persistent session's queued messages
+
+    def cmd_smsub(self, arg, query):
+        a = split_args(arg)
+        if not self.mq or not a[0]:
+            return self.error()
+        qos = int(a[1]) if len(a) > 1 and a[1].isdigit() else 0
+        self.run_all_timers()
+        self.mq_pid = self.mq_pid % 65535 + 1
+        body = struct.pack(">H", self.mq_pid) + mqtt_str(a[0]) + bytes([qos])
+        self.mqtt_write(mqtt_packet(8, 2, body), now=True)
+        time.sleep(self.args.latency_ms / 1000.0)
+        if self.mqtt_wait(9) is None:
+            return self.error()
+        self.ok()
+        self.mqtt_buffered()
+
+    def cmd_smdisc(self, arg, query):
+        if not self.mq:
+            return self.error()
+        self.run_all_timers()
+        self.mqtt_write(mqtt_packet(14, 0, b""), now=True)
+        self.mqtt_drop(urc=False)
+        self.ok()
+
+    def cmd_smstate(self, arg, query):
+        self.line("+SMSTATE: %d" % (1 if self.mq else 0))
+        self.ok()
+
+    def cmd_smpub(self, arg, query):
+        a = split_args(arg)
+        try:
+            topic, n, qos = a[0], int(a[1]), int(a[2]) if len(a) > 2 else 0
+        except (IndexError, ValueError):
+            return self.error()
+        if not self.mq or not topic or not 0 < n <= 1024 or qos > 1:
+            return self.error()
+        self.pub_topic, self.pub_qos = topic, qos
+        self.body = b""
+        self.body_left = n
+        self.send("\r\n> ")
+
+    def mqtt_publish(self):
+        topic, qos, data = self.pub_topic, self.pub_qos, self.body
+        self.pub_topic = None
+        self.body = b""
+        body = mqtt_str(topic)
+        if qos:
+            self.mq_pid = self.mq_pid % 65535 + 1
+            body += struct.pack(">H", self.mq_pid)
+        self.stats["mqtt_publishes"] += 1
+        if self.sm["ASYNCMODE"] == "1" or not qos:
+            # on the socket: OK now, the PUBACK comes in the background
+            self.mqtt_write(mqtt_packet(3, qos << 1, body + data))
+            return self.ok()
+        self.run_all_timers()
+        self.mqtt_write(mqtt_packet(3, qos << 1, body + data), now=True)
+        time.sleep(self.args.latency_ms / 1000.0)
+        if self.mqtt_wait(4) is None:
+            return self.error()
+        self.ok()
+        self.mqtt_buffered()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--link", default="/tmp/vst_modem", help="symlink to the pty slave")
+    ap.add_argument("--reg-delay", type=float, default=0.0, help="seconds until registered")
+    ap.add_argument("--latency-ms", type=float, default=0.0, help="added to every HTTP request / UDP round trip")
+    ap.add_argument("--pdp-ms", type=float, default=0.0, help="bearer activation time (AT+CNACT=0,1)")
+    ap.add_argument("--connect-ms", type=float, default=0.0,
+                    help="added to every connection setup (AT+SHCONN, AT+SMCONN): TCP / TLS handshakes")
+    ap.add_argument("--seed", type=int, default=1, help="for the fault draws: same seed, same faults")
+    ap.add_argument("--error-rate", type=float, default=0.0, help="network commands answered ERROR")
+    ap.add_argument("--drop-rate", type=float, default=0.0, help="network commands not answered at all")
+    ap.add_argument("--http-fail-rate", type=float, default=0.0, help="AT+SHREQ ending in 705, connection lost")
+    ap.add_argument("--outage", default="", help="coverage lost: START:LEN[,START:LEN...] seconds after start")
+    ap.add_argument("--baud", type=int, default=0, help="UART speed, 0 = as fast as the pty")
+    ap.add_argument("--uplink-kbps", type=float, default=0.0, help="radio uplink, 0 = unlimited")
+    ap.add_argument("--downlink-kbps", type=float, default=0.0, help="radio downlink, 0 = unlimited")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+    try:
+        args.outage = [tuple(float(x) for x in o.split(":")) for o in args.outage.split(",") if o]
+        assert all(len(o) == 2 for o in args.outage)
+    except (ValueError, AssertionError):
+        ap.error("--outage wants START:LEN[,START:LEN...]")
+
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    name = os.ttyname(slave)
+    try:
+        os.unlink(args.link)
+    except FileNotFoundError:
+        pass
+    os.symlink(name, args.link)
+    print("SIM7080 emulator on %s -> %s" % (args.link, name), flush=True)
+
+    modem = Modem(master, args)
+    # PWRKEY / rails as signals; the wakeup pipe ends the select at once
+    sig_r, sig_w = os.pipe()
+    os.set_blocking(sig_w, False)
+    signal.set_wakeup_fd(sig_w)
+    pending = []
+    signal.signal(signal.SIGUSR1, lambda *_: pending.append(modem.pwrkey))
+    signal.signal(signal.SIGUSR2, lambda *_: pending.append(modem.toggle_rails))
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))      # stats on kill too
+    try:
+        while True:
+            socks = {s: cid for cid, s in modem.socks.items()}
+            mq = [modem.mq] if modem.mq else []
+            wait = modem.next_timer()
+            wait = 1.0 if wait is None else min(1.0, max(0.0, wait))
+            reg = modem.reg_due()
+            if reg is not None:
+                wait = min(wait, reg)
+            r, _, _ = select.select([master, sig_r] + list(socks) + mq, [], [], wait)
+            if sig_r in r:
+                os.read(sig_r, 64)
+            while pending:
+                pending.pop(0)()
+            modem.tick()
+            modem.run_timers()
+            for s in r:
+                if s in socks and socks[s] in modem.socks:
+                    modem.udp_readable(socks[s])
+                elif mq and s is mq[0] and modem.mq is s:
+                    modem.mqtt_readable()
+            modem.mqtt_keepalive()
+            if master in r:
+                try:
+                    data = os.read(master, 4096)
+                except OSError:
+                    data = b""
+                if data:
+                    modem.feed(data)
+                else:
+                    time.sleep(0.05)    # no reader on the slave side right now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.unlink(args.link)
+        modem.set_power(modem.power)
+        print("stats:", modem.stats)
+        print("power: %s" % ", ".join("%s %.1f s" % kv for kv in modem.power_s.items()))
+
+
+if __name__ == "__main__":
+    main()
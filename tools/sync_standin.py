@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Sync service for VSTPRO manifests (VSTPRO/src/upsync.h).
+
+Answers POST <any path> with the frames of a manifest the container is
+missing. Blob Storage cannot compare a manifest by itself; in the cloud
+this is a small function next to the container. Here it lists the
+container with List Blobs, so it runs against Azurite or blob_standin.py:
+
+  VSM1 <device> <t|f>                 request header
+  <e0>-<e1> <id0>-<id1> <n> <hash>    one chunk per line
+  <e0>-<e1> <id0>-<id1>               reply: missing ranges
+
+For each chunk the blobs <device>/YYYYMMDD/HHMMSS_<id>[_t].jpg with the
+epoch and id in range are counted and hashed (sum of CRC-32 over
+u32 id, u32 epoch, little endian). Equal: nothing is missing. Otherwise
+the whole chunk is answered; the node splits it and asks again, down to
+single frames. The ids between the ones found say nothing (the node
+lists only some of its frames), so no narrower range would be safe.
+
+    python3 sync_standin.py --port 10001 --blob http://127.0.0.1:10000/devstoreaccount1 --container frames
+"""
+
+import argparse
+import calendar
+import re
+import struct
+import threading
+import time
+import urllib.request
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import quote
+
+REPLY_MAX = 3500        # the node reads the answer into one upload block
+
+NAME = re.compile(r"^(?P<dev>.+)/(?P<date>\d{8})/(?P<hms>\d{6})_(?P<id>\d+)(?P<t>_t)?\.jpg$")
+LOCK = threading.Lock()
+STATS = {"manifests": 0, "chunks": 0, "complete": 0, "ranges": 0, "lists": 0}
+
+
+def frame_hash(fid, epoch):
+    return zlib.crc32(struct.pack("<II", fid & 0xFFFFFFFF, epoch & 0xFFFFFFFF)) & 0xFFFFFFFF
+
+
+def day_of(epoch):
+    return time.strftime("%Y%m%d", time.gmtime(epoch))
+
+
+class Lister:
+    """List Blobs per <device>/<date>/ prefix, one listing per request"""
+
+    def __init__(self, base, container, sas):
+        self.url = "%s/%s?restype=container&comp=list" % (base.rstrip("/"), container)
+        self.sas = sas.lstrip("?")
+        self.cache = {}
+
+    def frames(self, device, date, thumbs):
+        key = (device, date)
+        if key not in self.cache:
+            self.cache[key] = self.fetch("%s/%s/" % (device, date))
+        out = []
+        for name in self.cache[key]:
+            m = NAME.match(name)
+            if not m or bool(m.group("t")) != thumbs:
+                continue
+            d, hms = m.group("date"), m.group("hms")
+            epoch = calendar.timegm((int(d[:4]), int(d[4:6]), int(d[6:]),
+                                     int(hms[:2]), int(hms[2:4]), int(hms[4:]), 0, 0, 0))
+            out.append((epoch, int(m.group("id"))))
+        return out
+
+    def fetch(self, prefix):
+        names, marker = [], ""
+        while True:
+            url = self.url + "&prefix=" + quote(prefix, safe="") + ("&marker=" + quote(marker, safe="") if marker else "")
+            if self.sas:
+                url += "&" + self.sas
+            with urllib.request.urlopen(url, timeout=10) as r:
+                xml = r.read().decode(errors="replace")
+            with LOCK:
+                STATS["lists"] += 1
+            names += re.findall(r"<Name>([^<]*)</Name>", xml)
+            m = re.search(r"<NextMarker>([^<]+)</NextMarker>", xml)
+            if not m:
+                return names
+            marker = m.group(1)
+
+
+def answer(body, lister):
+    lines = body.decode(errors="replace").splitlines()
+    head = lines[0].split() if lines else []
+    if len(head) != 3 or head[0] != "VSM1":
+        return None
+    device, thumbs = head[1], head[2] == "t"
+    reply, size = [], 0
+    chunks = complete = 0
+    for line in lines[1:]:
+        m = re.match(r"^(\d+)-(\d+) (\d+)-(\d+) (\d+) ([0-9a-fA-F]{8})$", line.strip())
+        if not m:
+            continue
+        e0, e1, id0, id1, n = (int(m.group(i)) for i in range(1, 6))
+        want = int(m.group(6), 16)
+        chunks += 1
+        have = set()
+        for date in sorted({day_of(e0), day_of(e1)}):
+            for epoch, fid in lister.frames(device, date, thumbs):
+                if e0 <= epoch <= e1 and id0 <= fid <= id1:
+                    have.add((epoch, fid))
+        got = sum(frame_hash(fid, epoch) for epoch, fid in have) & 0xFFFFFFFF
+        if len(have) == n and got == want:
+            complete += 1
+            continue
+        text = "%d-%d %d-%d\n" % (e0, e1, id0, id1)
+        if size + len(text) > REPLY_MAX:
+            break       # the node syncs the rest in its next round
+        reply.append(text)
+        size += len(text)
+    with LOCK:
+        STATS["manifests"] += 1
+        STATS["chunks"] += chunks
+        STATS["complete"] += complete
+        STATS["ranges"] += len(reply)
+    return device, chunks, complete, "".join(reply).encode()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.verbose:
+            super().log_message(fmt, *args)
+
+    def reply(self, status, body=b""):
+        self.send_response(status)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if body:
+            self.wfile.write(body)
+
+    def do_POST(self):
+        n = int(self.headers.get("Content-Length") or 0)
+        body = self.rfile.read(n) if n else b""
+        try:
+            res = answer(body, Lister(self.server.blob, self.server.container, self.server.sas))
+        except OSError as e:
+            print("list failed:", e, flush=True)
+            return self.reply(502)
+        if res is None:
+            return self.reply(400, b"not a VSM1 manifest\n")
+        device, chunks, complete, out = res
+        print("%s: %d chunks, %d complete, %d range(s) missing" %
+              (device, chunks, complete, out.count(b"\n")), flush=True)
+        return self.reply(200, out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=10001)
+    ap.add_argument("--blob", default="http://127.0.0.1:10000/devstoreaccount1", help="blob account URL")
+    ap.add_argument("--container", default="frames")
+    ap.add_argument("--sas", default="", help="SAS query string for List Blobs")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    srv = ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+    srv.blob, srv.container, srv.sas = args.blob, args.container, args.sas
+    srv.verbose = args.verbose
+    print("sync stand-in on http://127.0.0.1:%d -> %s/%s" % (args.port, args.blob, args.container), flush=True)
+    try:
+        srv.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("stats:", STATS)
+
+
+if __name__ == "__main__":
+    main()
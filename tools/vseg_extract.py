@@ -0,0 +1,142 @@
+"""
+vseg_extract.py — rebuild individual JPEGs from VSG segment files
+
+Reads the append-only segment container written by segstore.cpp
+(Receiver and VSTPRO) and writes one JPEG per record, plus a JSON
+sidecar with the inference metadata.
+
+Usage:
+    python vseg_extract.py E:\\seg --out frames
+    python vseg_extract.py SEG_000012.VSG --out frames --no-meta
+
+Records that fail their CRC stop extraction of that segment (a torn
+tail after power loss); earlier records are still recovered.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import struct
+import sys
+import zlib
+
+SEG_FILE_MAGIC = 0x47455356  # "VSEG"
+SEG_REC_MAGIC = 0x43455256   # "VREC"
+SEG_HDR_LEN = 32
+REC_HDR_LEN = 32
+REC_FRAME = 1
+
+
+def decode_meta(buf):
+    if len(buf) < 12:
+        return None
+    frame, pre, inf, post, count, dropped = struct.unpack_from("<IHHHBB", buf, 0)
+    boxes = []
+    off = 12
+    for _ in range(count):
+        if off + 10 > len(buf):
+            break
+        target, score, x, y, w, h = struct.unpack_from("<BBHHHH", buf, off)
+        boxes.append({"target": target, "score": score, "x": x, "y": y, "w": w, "h": h})
+        off += 10
+    out = {
+        "frame": frame,
+        "perf": {"preprocess": pre, "inference": inf, "postprocess": post},
+        "boxes": boxes,
+        "boxes_dropped": dropped,
+    }
+    # Two-phase: the result that asked for the image (a different capture)
+    if off + 18 <= len(buf) and buf[off] == ord("T"):
+        flags, count, _, lag = struct.unpack_from("<BBBI", buf, off + 1)
+        target, score, x, y, w, h = struct.unpack_from("<BBHHHH", buf, off + 8)
+        out["trigger"] = {
+            "confirmed": bool(flags & 1),
+            "boxes": count,
+            "lag_ms": lag,
+            "best": {"target": target, "score": score, "x": x, "y": y, "w": w, "h": h},
+        }
+    return out
+
+
+def iter_records(path):
+    """Yields (offset, frame_id, epoch, meta_bytes, jpeg_bytes); stops at the first bad record."""
+    with open(path, "rb") as f:
+        hdr = f.read(SEG_HDR_LEN)
+        if len(hdr) < SEG_HDR_LEN or struct.unpack_from("<I", hdr, 0)[0] != SEG_FILE_MAGIC:
+            print(f"⚠ {path}: not a segment file", file=sys.stderr)
+            return
+        if zlib.crc32(hdr[:28]) != struct.unpack_from("<I", hdr, 28)[0]:
+            print(f"⚠ {path}: segment header CRC mismatch", file=sys.stderr)
+            return
+
+        offset = SEG_HDR_LEN
+        while True:
+            rec = f.read(REC_HDR_LEN)
+            if len(rec) == 0:
+                return
+            if len(rec) < REC_HDR_LEN:
+                print(f"⚠ {path}@{offset}: truncated record header", file=sys.stderr)
+                return
+
+            (magic, hdr_len, rtype, _flags, frame_id, epoch,
+             meta_len, jpeg_len, data_crc, hdr_crc) = struct.unpack("<IHBBIIIIII", rec)
+
+            if magic != SEG_REC_MAGIC or zlib.crc32(rec[:28]) != hdr_crc:
+                print(f"⚠ {path}@{offset}: bad record header, stopping", file=sys.stderr)
+                return
+
+            f.seek(hdr_len - REC_HDR_LEN, os.SEEK_CUR)
+            meta = f.read(meta_len)
+            jpeg = f.read(jpeg_len)
+            if len(meta) != meta_len or len(jpeg) != jpeg_len or \
+                    zlib.crc32(jpeg, zlib.crc32(meta)) != data_crc:
+                print(f"⚠ {path}@{offset}: torn record (frame {frame_id}), stopping", file=sys.stderr)
+                return
+
+            if rtype == REC_FRAME:
+                yield offset, frame_id, epoch, meta, jpeg
+            offset += hdr_len + meta_len + jpeg_len
+
+
+def frame_name(frame_id, epoch):
+    if epoch:
+        ts = datetime.datetime.fromtimestamp(epoch, datetime.timezone.utc).strftime("%Y%m%d_%H%M%S")
+        return f"{ts}_frame_{frame_id:06d}"
+    return f"frame_{frame_id:06d}"
+
+
+def segment_files(src):
+    if os.path.isdir(src):
+        return sorted(os.path.join(src, n) for n in os.listdir(src) if n.upper().endswith(".VSG"))
+    return [src]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Extract JPEGs from VSG segment files")
+    ap.add_argument("src", help="segment file or directory containing SEG_/EMP_*.VSG")
+    ap.add_argument("--out", default="frames", help="output directory")
+    ap.add_argument("--no-meta", action="store_true", help="do not write JSON sidecars")
+    args = ap.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+
+    total = 0
+    for seg in segment_files(args.src):
+        count = 0
+        for _off, frame_id, epoch, meta, jpeg in iter_records(seg):
+            name = frame_name(frame_id, epoch)
+            with open(os.path.join(args.out, name + ".jpg"), "wb") as f:
+                f.write(jpeg)
+            if not args.no_meta and meta:
+                with open(os.path.join(args.out, name + ".json"), "w") as f:
+                    json.dump(decode_meta(meta), f)
+            count += 1
+        print(f"{os.path.basename(seg)}: {count} frames")
+        total += count
+
+    print(f"✅ {total} frames written to {args.out}")
+
+
+if __name__ == "__main__":
+    main()
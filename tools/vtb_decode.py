@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+vtb_decode.py — turn VSTPRO telemetry batches (.vtb) back into CSV
+
+Reads the VTB1 payloads written by VSTPRO/src/telemetry.cpp (one blob per
+radio session) and prints one line per record, with the same detection
+column as the SD card's meta/*.CSV:
+
+    frame,epoch,boxes,detections
+    1042,1781352000,1,3:86:212:140:52:38
+
+Usage:
+    python3 vtb_decode.py 120455_001042.vtb
+    python3 vtb_decode.py /tmp/vst_blobs --summary    (all .vtb below a folder)
+"""
+
+import argparse
+import os
+import sys
+
+MAGIC = b"VTB1"
+
+
+def varint(buf, off):
+    v, shift = 0, 0
+    while True:
+        if off >= len(buf):
+            raise ValueError("truncated varint")
+        b = buf[off]
+        off += 1
+        v |= (b & 0x7F) << shift
+        if b < 0x80:
+            return v, off
+        shift += 7
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def decode(buf):
+    """Returns (frames_seen, [(frame_id, epoch, [(target, score, x, y, w, h), ...]), ...])."""
+    if buf[:4] != MAGIC:
+        raise ValueError("not a VTB1 batch")
+    off = 4
+    frames, off = varint(buf, off)
+    n, off = varint(buf, off)
+    frame_id, off = varint(buf, off)
+    epoch, off = varint(buf, off)
+
+    records = []
+    for _ in range(n):
+        d, off = varint(buf, off)
+        dt, off = varint(buf, off)
+        frame_id += d
+        epoch += unzigzag(dt)
+        count = buf[off]
+        off += 1
+        boxes = []
+        for _ in range(count):
+            target, score = buf[off], buf[off + 1]
+            off += 2
+            x, off = varint(buf, off)
+            y, off = varint(buf, off)
+            w, off = varint(buf, off)
+            h, off = varint(buf, off)
+            boxes.append((target, score, x, y, w, h))
+        records.append((frame_id, epoch, boxes))
+    if off != len(buf):
+        raise ValueError("%d trailing bytes" % (len(buf) - off))
+    return frames, records
+
+
+def batch_files(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, names in os.walk(p):
+                for name in sorted(names):
+                    if name.endswith(".vtb"):
+                        yield os.path.join(root, name)
+        else:
+            yield p
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("paths", nargs="+", help=".vtb files or folders")
+    ap.add_argument("--summary", action="store_true", help="totals only, no CSV")
+    args = ap.parse_args()
+
+    batches = frames = records = detections = size = bad = 0
+    if not args.summary:
+        print("frame,epoch,boxes,detections")
+    for path in batch_files(args.paths):
+        with open(path, "rb") as f:
+            buf = f.read()
+        try:
+            seen, recs = decode(buf)
+        except (ValueError, IndexError) as e:
+            print(f"⚠ {path}: {e}", file=sys.stderr)
+            bad += 1
+            continue
+        batches += 1
+        frames += seen
+        records += len(recs)
+        size += len(buf)
+        for frame_id, epoch, boxes in recs:
+            detections += len(boxes)
+            if not args.summary:
+                print("%d,%d,%d,%s" % (frame_id, epoch, len(boxes),
+                                       "|".join(":".join(str(v) for v in b) for b in boxes)))
+
+    print("%d batches, %d frames, %d records, %d detections, %d B (%.1f B/detection)%s"
+          % (batches, frames, records, detections, size, size / detections if detections else 0,
+             ", %d unreadable" % bad if bad else ""), file=sys.stderr if not args.summary else sys.stdout)
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())